@@ -0,0 +1,233 @@
+#ifndef AMBIENT_OCCLUSION_H
+#define AMBIENT_OCCLUSION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <common.h>
+#include <Shader.h>
+#include <GpuTimer.h>
+#include <RenderSettings.h>
+
+namespace KooNan
+{
+	// Screen space ambient occlusion of the main pass at half the window size.
+	// The main pass shades while it rasterizes, so the occlusion comes from a depth
+	// prepass drawn at half resolution before it: BeginDepth, the caller draws the
+	// opaque scene with a position only shader, EndDepth, then Compute traces the
+	// horizons (landscape/ssao.fs) and denoises them, optionally over time
+	// (landscape/ssao_resolve.fs). terrain.fs and model.fs upsample the result
+	// with depth aware weights and darken their ambient terms with it.
+	class AmbientOcclusion
+	{
+	private:
+		unsigned int depthFrameBuffer;
+		unsigned int depthTexture;
+		unsigned int rawFrameBuffer;
+		unsigned int rawTexture; // R8, straight from the horizons
+		unsigned int historyFrameBuffers[2];
+		unsigned int historyTextures[2]; // RG16F occlusion and linear depth, the lit shaders read historyTextures[current]
+		unsigned int emptyVAO;
+		int width, height;
+		int current;
+		bool historyValid;
+		unsigned int frame;
+		GLboolean clipDistance; // state of GL_CLIP_DISTANCE0 around the prepass
+		glm::mat4 lastViewProjection;
+		Shader hbaoShader;
+		Shader resolveShader;
+		GpuTimer timer;
+	public:
+		AmbientOcclusion() : width(0), height(0), current(0), historyValid(false), frame(0), clipDistance(GL_FALSE), lastViewProjection(1.0f),
+			hbaoShader("landscape/fullscreen.vs", "landscape/ssao.fs"), resolveShader("landscape/fullscreen.vs", "landscape/ssao_resolve.fs")
+		{
+			glGenFramebuffers(1, &depthFrameBuffer);
+			glGenTextures(1, &depthTexture);
+			glGenFramebuffers(1, &rawFrameBuffer);
+			glGenTextures(1, &rawTexture);
+			glGenFramebuffers(2, historyFrameBuffers);
+			glGenTextures(2, historyTextures);
+			glGenVertexArrays(1, &emptyVAO);
+			fitToWindow();
+			glBindFramebuffer(GL_FRAMEBUFFER, depthFrameBuffer);
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+			glBindFramebuffer(GL_FRAMEBUFFER, rawFrameBuffer);
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, rawTexture, 0);
+			glDrawBuffer(GL_COLOR_ATTACHMENT0);
+			for (int i = 0; i < 2; i++)
+			{
+				glBindFramebuffer(GL_FRAMEBUFFER, historyFrameBuffers[i]);
+				glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, historyTextures[i], 0);
+				glDrawBuffer(GL_COLOR_ATTACHMENT0);
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
+		void cleanUp()
+		{
+			glDeleteFramebuffers(1, &depthFrameBuffer);
+			glDeleteTextures(1, &depthTexture);
+			glDeleteFramebuffers(1, &rawFrameBuffer);
+			glDeleteTextures(1, &rawTexture);
+			glDeleteFramebuffers(2, historyFrameBuffers);
+			glDeleteTextures(2, historyTextures);
+			glDeleteVertexArrays(1, &emptyVAO);
+			timer.cleanUp();
+		}
+
+		// BeginDepth: bind the cleared half size depth target and start timing
+		void BeginDepth()
+		{
+			timer.Begin();
+			if (fitToWindow())
+				historyValid = false;
+			glBindFramebuffer(GL_FRAMEBUFFER, depthFrameBuffer);
+			glViewport(0, 0, width, height);
+			glEnable(GL_DEPTH_TEST);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			// the water passes leave the clip plane on, the position only shader does not write it
+			clipDistance = glIsEnabled(GL_CLIP_DISTANCE0);
+			glDisable(GL_CLIP_DISTANCE0);
+		}
+		void EndDepth()
+		{
+			if (clipDistance)
+				glEnable(GL_CLIP_DISTANCE0);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, Common::SCR_WIDTH, Common::SCR_HEIGHT);
+		}
+
+		// Compute: occlusion of the depth just drawn, stops the timer and leaves the window bound
+		//   projection, view: of the main camera, the same the depth was drawn with
+		void Compute(const glm::mat4& projection, const glm::mat4& view)
+		{
+			GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST), blend = glIsEnabled(GL_BLEND), clip = glIsEnabled(GL_CLIP_DISTANCE0);
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
+			glDisable(GL_CLIP_DISTANCE0);
+			glViewport(0, 0, width, height);
+			glm::mat4 invProjection = glm::inverse(projection);
+			frame++;
+
+			glBindFramebuffer(GL_FRAMEBUFFER, rawFrameBuffer);
+			hbaoShader.use();
+			hbaoShader.setMat4("projection", projection);
+			hbaoShader.setMat4("invProjection", invProjection);
+			hbaoShader.setFloat("radius", RenderSettings::ssaoRadius);
+			hbaoShader.setFloat("intensity", RenderSettings::ssaoIntensity);
+			hbaoShader.setInt("directions", RenderSettings::ssaoDirections);
+			hbaoShader.setInt("steps", RenderSettings::ssaoSteps);
+			// golden ratio steps cover the turns evenly while the history accumulates them
+			hbaoShader.setFloat("frameJitter", RenderSettings::ssaoTemporal ? (frame % 64) * 0.618034f : 0.0f);
+			hbaoShader.setInt("depthMap", 0);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, depthTexture);
+			drawFullScreen();
+
+			int previous = current;
+			current = 1 - current;
+			glBindFramebuffer(GL_FRAMEBUFFER, historyFrameBuffers[current]);
+			resolveShader.use();
+			resolveShader.setMat4("invProjection", invProjection);
+			resolveShader.setMat4("invView", glm::inverse(view));
+			resolveShader.setMat4("prevViewProjection", lastViewProjection);
+			resolveShader.setFloat("nearPlane", Common::perspective_clipping_near);
+			resolveShader.setFloat("farPlane", Common::perspective_clipping_far);
+			resolveShader.setFloat("historyBlend", RenderSettings::ssaoTemporal && historyValid ? RenderSettings::ssaoHistoryBlend : 0.0f);
+			resolveShader.setInt("rawMap", 0);
+			resolveShader.setInt("depthMap", 1);
+			resolveShader.setInt("historyMap", 2);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, rawTexture);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, depthTexture);
+			glActiveTexture(GL_TEXTURE2);
+			glBindTexture(GL_TEXTURE_2D, historyTextures[previous]);
+			drawFullScreen();
+			glActiveTexture(GL_TEXTURE0);
+			historyValid = true;
+			lastViewProjection = projection * view;
+
+			if (depthTest) glEnable(GL_DEPTH_TEST);
+			if (blend) glEnable(GL_BLEND);
+			if (clip) glEnable(GL_CLIP_DISTANCE0);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, Common::SCR_WIDTH, Common::SCR_HEIGHT);
+			timer.End();
+		}
+
+		// Bind: the occlusion for ScreenOcclusion in terrain.fs and model.fs, only valid for the main view
+		void Bind(Shader& shader, int unit)
+		{
+			shader.use();
+			shader.setInt("ssaoMap", unit);
+			shader.setInt("ssao", 1);
+			shader.setVec2("ssaoNearFar", glm::vec2(Common::perspective_clipping_near, Common::perspective_clipping_far));
+			glActiveTexture(GL_TEXTURE0 + unit);
+			glBindTexture(GL_TEXTURE_2D, historyTextures[current]);
+			glActiveTexture(GL_TEXTURE0);
+		}
+		// Unbind: other views draw with the same shaders, they must not read the occlusion
+		void Unbind(Shader& shader)
+		{
+			shader.use();
+			shader.setInt("ssao", 0);
+		}
+
+		// Invalidate: the next frame starts without history, e.g. after the effect was off
+		void Invalidate()
+		{
+			historyValid = false;
+		}
+
+		float Milliseconds() const
+		{
+			return timer.Milliseconds();
+		}
+
+	private:
+		void drawFullScreen()
+		{
+			glBindVertexArray(emptyVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glBindVertexArray(0);
+		}
+
+		// fitToWindow: half the window, rounded up; returns whether the size changed
+		bool fitToWindow()
+		{
+			int w = ((int)Common::SCR_WIDTH + 1) / 2;
+			int h = ((int)Common::SCR_HEIGHT + 1) / 2;
+			w = w > 0 ? w : 1;
+			h = h > 0 ? h : 1;
+			if (w == width && h == height)
+				return false;
+			width = w;
+			height = h;
+			glBindTexture(GL_TEXTURE_2D, depthTexture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)nullptr);
+			SetSampling(GL_NEAREST);
+			glBindTexture(GL_TEXTURE_2D, rawTexture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, (void*)nullptr);
+			SetSampling(GL_NEAREST);
+			for (int i = 0; i < 2; i++)
+			{
+				glBindTexture(GL_TEXTURE_2D, historyTextures[i]);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, width, height, 0, GL_RG, GL_FLOAT, (void*)nullptr);
+				SetSampling(GL_LINEAR);
+			}
+			glBindTexture(GL_TEXTURE_2D, 0);
+			return true;
+		}
+		static void SetSampling(GLint filter)
+		{
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+	};
+}
+
+#endif // !AMBIENT_OCCLUSION_H
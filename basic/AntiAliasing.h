@@ -0,0 +1,378 @@
+#ifndef ANTI_ALIASING_H
+#define ANTI_ALIASING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <common.h>
+#include <Shader.h>
+#include <GpuTimer.h>
+#include <RenderSettings.h>
+#include <RenderStats.h>
+
+namespace KooNan
+{
+	// Antialiasing of the finished 8 bit frame on its way into the window, in place of
+	// multisampling the whole main pass. FXAA (landscape/fxaa.fs) and SMAA (landscape/smaa_*.fs)
+	// only look at the image. TAA (landscape/taa.fs) jitters the projection of the main pass by
+	// a different subpixel offset every frame through Common::projectionJitter and accumulates
+	// the frames, reprojected with the camera motion recovered from the depth.
+	// With the HDR pipeline the tonemapping writes into the input target of this class,
+	// otherwise it reads the scene target directly.
+	class AntiAliasing
+	{
+	public:
+		static const int JITTER_PHASES = 8; // length of the Halton sequence of the jitter
+		static const int COMPARE_FRAMES = 90; // frames each mode is drawn for by the comparison
+		static const int COMPARE_WARMUP = 30; // of those, frames before the timing starts; TAA converges meanwhile
+	private:
+		unsigned int inputFrameBuffer;
+		unsigned int inputTexture; // RGB8, the tonemapped frame
+		unsigned int edgesFrameBuffer;
+		unsigned int edgesTexture; // RG8
+		unsigned int weightsFrameBuffer;
+		unsigned int weightsTexture; // RGBA8
+		unsigned int historyFrameBuffers[2];
+		unsigned int historyTextures[2]; // R11G11B10F, the last output of TAA is historyTextures[current]
+		unsigned int emptyVAO;
+		int width, height;
+		int current;
+		bool historyValid;
+		unsigned int frame;
+		glm::vec2 jitter;
+		glm::mat4 lastViewProjection; // without the jitter
+		int compareMode; // -1 when no comparison runs
+		int compareFrame;
+		float compareMs;
+		Shader fxaaShader;
+		Shader smaaEdgesShader;
+		Shader smaaWeightsShader;
+		Shader smaaBlendShader;
+		Shader taaShader;
+		Shader presentShader;
+		GpuTimer timer;
+	public:
+		AntiAliasing() : width(0), height(0), current(0), historyValid(false), frame(0), jitter(0.0f), lastViewProjection(1.0f),
+			compareMode(-1), compareFrame(0), compareMs(0.0f),
+			fxaaShader("landscape/fullscreen.vs", "landscape/fxaa.fs"),
+			smaaEdgesShader("landscape/fullscreen.vs", "landscape/smaa_edges.fs"),
+			smaaWeightsShader("landscape/fullscreen.vs", "landscape/smaa_weights.fs"),
+			smaaBlendShader("landscape/fullscreen.vs", "landscape/smaa_blend.fs"),
+			taaShader("landscape/fullscreen.vs", "landscape/taa.fs"),
+			presentShader("landscape/fullscreen.vs", "landscape/present.fs")
+		{
+			glGenFramebuffers(1, &inputFrameBuffer);
+			glGenTextures(1, &inputTexture);
+			glGenFramebuffers(1, &edgesFrameBuffer);
+			glGenTextures(1, &edgesTexture);
+			glGenFramebuffers(1, &weightsFrameBuffer);
+			glGenTextures(1, &weightsTexture);
+			glGenFramebuffers(2, historyFrameBuffers);
+			glGenTextures(2, historyTextures);
+			glGenVertexArrays(1, &emptyVAO);
+			fitToWindow();
+			attach(inputFrameBuffer, inputTexture);
+			attach(edgesFrameBuffer, edgesTexture);
+			attach(weightsFrameBuffer, weightsTexture);
+			for (int i = 0; i < 2; i++)
+				attach(historyFrameBuffers[i], historyTextures[i]);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
+		void cleanUp()
+		{
+			glDeleteFramebuffers(1, &inputFrameBuffer);
+			glDeleteTextures(1, &inputTexture);
+			glDeleteFramebuffers(1, &edgesFrameBuffer);
+			glDeleteTextures(1, &edgesTexture);
+			glDeleteFramebuffers(1, &weightsFrameBuffer);
+			glDeleteTextures(1, &weightsTexture);
+			glDeleteFramebuffers(2, historyFrameBuffers);
+			glDeleteTextures(2, historyTextures);
+			glDeleteVertexArrays(1, &emptyVAO);
+			timer.cleanUp();
+		}
+
+		// ActiveMode: the mode of this frame, the comparison overrides RenderSettings::antiAliasing
+		AntiAliasingMode ActiveMode() const
+		{
+			return compareMode >= 0 ? (AntiAliasingMode)compareMode : RenderSettings::antiAliasing;
+		}
+		// Enabled: whether Apply has to run, the main pass then draws offscreen
+		bool Enabled() const
+		{
+			return compareMode >= 0 || RenderSettings::antiAliasing != AntiAliasingMode::Off;
+		}
+
+		// NextFrame: start a requested comparison and pick the jitter of this frame,
+		// call once per frame before anything is drawn with the main camera
+		void NextFrame()
+		{
+			if (RenderSettings::antiAliasingComparison && compareMode < 0)
+			{
+				compareMode = 0;
+				compareFrame = 0;
+				compareMs = 0.0f;
+				RenderStats::antiAliasingCompareMode = compareMode;
+			}
+			frame++;
+			if (!Enabled())
+				historyValid = false;
+			if (ActiveMode() != AntiAliasingMode::TAA)
+			{
+				jitter = glm::vec2(0.0f);
+				return;
+			}
+			int index = (int)(frame % JITTER_PHASES) + 1;
+			// one pixel is 2 / size in NDC
+			jitter = (glm::vec2(Halton(index, 2), Halton(index, 3)) - 0.5f) * 2.0f
+				/ glm::vec2((float)Common::SCR_WIDTH, (float)Common::SCR_HEIGHT);
+		}
+		// Jitter: subpixel offset of the main pass this frame, in NDC; for Common::projectionJitter
+		glm::vec2 Jitter() const
+		{
+			return jitter;
+		}
+
+		// InputFrameBuffer: 8 bit target the size of the window, for the tonemapping to write into
+		unsigned int InputFrameBuffer()
+		{
+			fitToWindow();
+			return inputFrameBuffer;
+		}
+		unsigned int InputTexture()
+		{
+			return inputTexture;
+		}
+
+		// Apply: antialias the frame into the window, leaves the window bound
+		//   image: the 8 bit frame, the size of the window
+		//   depth: depth of the main pass, for the reprojection of TAA
+		//   projection: of the main pass, with the jitter of this frame
+		void Apply(unsigned int image, unsigned int depth, const glm::mat4& projection, const glm::mat4& view)
+		{
+			fitToWindow();
+			GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST), blend = glIsEnabled(GL_BLEND), clip = glIsEnabled(GL_CLIP_DISTANCE0);
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
+			glDisable(GL_CLIP_DISTANCE0);
+			glBindVertexArray(emptyVAO);
+			glActiveTexture(GL_TEXTURE0);
+
+			AntiAliasingMode mode = ActiveMode();
+			glm::mat4 unjittered = projection;
+			unjittered[2][0] -= jitter.x;
+			unjittered[2][1] -= jitter.y;
+			timer.Begin();
+			switch (mode)
+			{
+			case AntiAliasingMode::FXAA:
+				Fxaa(image);
+				break;
+			case AntiAliasingMode::SMAA:
+				Smaa(image);
+				break;
+			case AntiAliasingMode::TAA:
+				Taa(image, depth, glm::inverse(projection * view));
+				break;
+			default:
+				present(image);
+				break;
+			}
+			timer.End();
+			RenderStats::antiAliasingGpuMs = timer.Milliseconds();
+			if (mode != AntiAliasingMode::TAA)
+				historyValid = false;
+			lastViewProjection = unjittered * view;
+			if (compareMode >= 0)
+				Compare();
+
+			glBindVertexArray(0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			if (depthTest) glEnable(GL_DEPTH_TEST);
+			if (blend) glEnable(GL_BLEND);
+			if (clip) glEnable(GL_CLIP_DISTANCE0);
+		}
+
+	private:
+		void bindWindow()
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, Common::SCR_WIDTH, Common::SCR_HEIGHT);
+		}
+		void present(unsigned int image)
+		{
+			bindWindow();
+			presentShader.use();
+			presentShader.setInt("image", 0);
+			glBindTexture(GL_TEXTURE_2D, image);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+		void Fxaa(unsigned int image)
+		{
+			bindWindow();
+			fxaaShader.use();
+			fxaaShader.setInt("image", 0);
+			fxaaShader.setVec2("texel", 1.0f / glm::vec2((float)width, (float)height));
+			fxaaShader.setFloat("edgeThreshold", RenderSettings::fxaaEdgeThreshold);
+			fxaaShader.setFloat("edgeThresholdMin", RenderSettings::fxaaEdgeThresholdMin);
+			fxaaShader.setFloat("subpixel", RenderSettings::fxaaSubpixel);
+			glBindTexture(GL_TEXTURE_2D, image);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+		void Smaa(unsigned int image)
+		{
+			glViewport(0, 0, width, height);
+			glBindFramebuffer(GL_FRAMEBUFFER, edgesFrameBuffer);
+			smaaEdgesShader.use();
+			smaaEdgesShader.setInt("image", 0);
+			smaaEdgesShader.setFloat("threshold", RenderSettings::smaaThreshold);
+			glBindTexture(GL_TEXTURE_2D, image);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, weightsFrameBuffer);
+			smaaWeightsShader.use();
+			smaaWeightsShader.setInt("edgesMap", 0);
+			smaaWeightsShader.setInt("maxSearch", glm::max(RenderSettings::smaaMaxSearch, 1));
+			glBindTexture(GL_TEXTURE_2D, edgesTexture);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+
+			bindWindow();
+			smaaBlendShader.use();
+			smaaBlendShader.setInt("image", 0);
+			smaaBlendShader.setInt("weightsMap", 1);
+			glBindTexture(GL_TEXTURE_2D, image);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, weightsTexture);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glActiveTexture(GL_TEXTURE0);
+		}
+		void Taa(unsigned int image, unsigned int depth, const glm::mat4& invViewProjection)
+		{
+			int next = 1 - current;
+			glBindFramebuffer(GL_FRAMEBUFFER, historyFrameBuffers[next]);
+			glViewport(0, 0, width, height);
+			taaShader.use();
+			taaShader.setInt("image", 0);
+			taaShader.setInt("depthMap", 1);
+			taaShader.setInt("historyMap", 2);
+			taaShader.setMat4("invViewProjection", invViewProjection);
+			taaShader.setMat4("prevViewProjection", lastViewProjection);
+			taaShader.setFloat("feedback", RenderSettings::taaFeedback);
+			taaShader.setInt("historyValid", historyValid ? 1 : 0);
+			glBindTexture(GL_TEXTURE_2D, image);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, depth);
+			glActiveTexture(GL_TEXTURE2);
+			glBindTexture(GL_TEXTURE_2D, historyTextures[current]);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glActiveTexture(GL_TEXTURE0);
+			current = next;
+			historyValid = true;
+			present(historyTextures[current]);
+		}
+
+		// Compare: time the mode of the running comparison, save the window and go on to the next
+		// mode once it has been drawn long enough
+		void Compare()
+		{
+			compareFrame++;
+			if (compareFrame > COMPARE_WARMUP)
+				compareMs += timer.Milliseconds();
+			if (compareFrame < COMPARE_FRAMES)
+				return;
+			AntiAliasingMode mode = (AntiAliasingMode)compareMode;
+			RenderStats::antiAliasingCompareMs[compareMode] = compareMs / (float)(COMPARE_FRAMES - COMPARE_WARMUP);
+			std::string name = RenderSettings::AntiAliasingName(mode);
+			for (char& c : name)
+				c = (char)std::tolower((unsigned char)c);
+			SaveWindow("aa_compare_" + name + ".ppm");
+			compareMode++;
+			compareFrame = 0;
+			compareMs = 0.0f;
+			if (compareMode == (int)AntiAliasingMode::Count)
+			{
+				compareMode = -1;
+				RenderSettings::antiAliasingComparison = false;
+				std::cout << "Antialiasing comparison, GPU ms:";
+				for (int i = 0; i < (int)AntiAliasingMode::Count; i++)
+					std::cout << " " << RenderSettings::AntiAliasingName((AntiAliasingMode)i) << " " << RenderStats::antiAliasingCompareMs[i];
+				std::cout << std::endl;
+			}
+			historyValid = false;
+			RenderStats::antiAliasingCompareMode = compareMode;
+		}
+		// SaveWindow: the window as a binary PPM, top row first
+		void SaveWindow(const std::string& path)
+		{
+			int w = Common::SCR_WIDTH, h = Common::SCR_HEIGHT;
+			std::vector<unsigned char> pixels(w * h * 3);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			std::ofstream file(path, std::ios::binary);
+			if (!file)
+			{
+				std::cout << "Failed to write " << path << std::endl;
+				return;
+			}
+			file << "P6\n" << w << " " << h << "\n255\n";
+			for (int y = h - 1; y >= 0; y--)
+				file.write((const char*)&pixels[y * w * 3], w * 3);
+		}
+
+		static float Halton(int index, int base)
+		{
+			float f = 1.0f, result = 0.0f;
+			for (; index > 0; index /= base)
+			{
+				f /= (float)base;
+				result += f * (float)(index % base);
+			}
+			return result;
+		}
+
+		void attach(unsigned int frameBuffer, unsigned int texture)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+			glDrawBuffer(GL_COLOR_ATTACHMENT0);
+		}
+		void allocate(unsigned int texture, GLint format, GLenum layout, GLint filter)
+		{
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, layout, GL_UNSIGNED_BYTE, (void*)nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		void fitToWindow()
+		{
+			int w = Common::SCR_WIDTH > 0 ? Common::SCR_WIDTH : 1;
+			int h = Common::SCR_HEIGHT > 0 ? Common::SCR_HEIGHT : 1;
+			if (w == width && h == height)
+				return;
+			width = w;
+			height = h;
+			historyValid = false;
+			// FXAA samples between texels, the others fetch them
+			allocate(inputTexture, GL_RGB8, GL_RGB, GL_LINEAR);
+			allocate(edgesTexture, GL_RG8, GL_RG, GL_NEAREST);
+			allocate(weightsTexture, GL_RGBA8, GL_RGBA, GL_NEAREST);
+			for (int i = 0; i < 2; i++)
+				allocate(historyTextures[i], GL_R11F_G11F_B10F, GL_RGB, GL_LINEAR);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+	};
+}
+
+#endif // !ANTI_ALIASING_H
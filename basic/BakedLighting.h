@@ -0,0 +1,112 @@
+#ifndef BAKEDLIGHTING_H
+#define BAKEDLIGHTING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <Shader.h>
+#include <LightBaker.h>
+#include <GameObject.h>
+#include <RenderSettings.h>
+
+#include <vector>
+#include <string>
+
+namespace KooNan
+{
+	// The bake of LightBaker on the GPU: a lightmap over the terrain for terrain.fs and a
+	// vertex buffer per static object for model.fs. Only the parts that still fit the scene
+	// are used; objects that move afterwards drop theirs in GameObject::Update.
+	class BakedLighting
+	{
+	private:
+		unsigned int terrainTexture;
+		bool terrainValid;
+		glm::vec2 terrainOrigin, terrainExtent;
+		unsigned int objectsBaked;
+	public:
+		BakedLighting() : terrainValid(false), terrainOrigin(0.0f), terrainExtent(1.0f), objectsBaked(0)
+		{
+			glGenTextures(1, &terrainTexture);
+		}
+		void cleanUp()
+		{
+			glDeleteTextures(1, &terrainTexture);
+		}
+
+		// Load: read a bake and apply it
+		//   return: whether anything of it still fits
+		bool Load(const std::string& path, const std::vector<Terrain>& chunks)
+		{
+			BakedScene scene;
+			if (!scene.Load(path))
+				return false;
+			Apply(scene, chunks);
+			return terrainValid || objectsBaked > 0;
+		}
+
+		// Apply: upload the terrain lightmap if it was baked for these heights, and hand each
+		// baked object to the static object standing where it was baked
+		void Apply(const BakedScene& scene, const std::vector<Terrain>& chunks)
+		{
+			terrainValid = !scene.terrain.empty() && scene.terrainChecksum == LightBaker::TerrainChecksum(chunks);
+			if (terrainValid)
+			{
+				terrainOrigin = scene.terrainOrigin;
+				terrainExtent = scene.terrainExtent;
+				glBindTexture(GL_TEXTURE_2D, terrainTexture);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, scene.terrainWidth, scene.terrainHeight, 0, GL_RGBA, GL_FLOAT, scene.terrain.data());
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glBindTexture(GL_TEXTURE_2D, 0);
+			}
+			objectsBaked = 0;
+			std::vector<bool> used(scene.objects.size(), false);
+			for (GameObject* obj : GameObject::gameObjList)
+			{
+				obj->ClearBakedLighting();
+				if (obj->IsDynamic())
+					continue;
+				for (size_t i = 0; i < scene.objects.size(); i++)
+					if (!used[i] && LightBaker::Matches(scene.objects[i], *obj) && obj->SetBakedLighting(scene.objects[i].levels))
+					{
+						used[i] = true;
+						objectsBaked++;
+						break;
+					}
+			}
+		}
+
+		// InvalidateTerrain: the heights changed, terrain.fs goes back to the light's ambient
+		void InvalidateTerrain()
+		{
+			terrainValid = false;
+		}
+
+		// Bind: the terrain lightmap and its placement for terrain.fs
+		void Bind(Shader& shader, int unit)
+		{
+			shader.use();
+			shader.setInt("lightmap", unit);
+			shader.setVec2("lightmapOrigin", terrainOrigin);
+			shader.setVec2("lightmapExtent", terrainExtent);
+			shader.setInt("bakedLighting", RenderSettings::bakedLighting && terrainValid ? RenderSettings::BakedLightingMode() : 0);
+			glActiveTexture(GL_TEXTURE0 + unit);
+			glBindTexture(GL_TEXTURE_2D, terrainTexture);
+			glActiveTexture(GL_TEXTURE0);
+		}
+
+		bool TerrainBaked() const
+		{
+			return terrainValid;
+		}
+		unsigned int ObjectsBaked() const
+		{
+			return objectsBaked;
+		}
+	};
+}
+
+#endif // !BAKEDLIGHTING_H
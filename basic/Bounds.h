@@ -0,0 +1,172 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <cmath>
+
+namespace KooNan
+{
+	// Axis aligned bounding box in world space
+	struct AABB
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+
+		AABB() : min(FLT_MAX), max(-FLT_MAX) {}
+		AABB(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+
+		bool IsValid() const
+		{
+			return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+		}
+		glm::vec3 Center() const
+		{
+			return (min + max) * 0.5f;
+		}
+		glm::vec3 Extent() const
+		{
+			return (max - min) * 0.5f;
+		}
+		float SurfaceArea() const
+		{
+			glm::vec3 d = max - min;
+			return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+		}
+		void Expand(const glm::vec3& p)
+		{
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+		void Expand(const AABB& other)
+		{
+			min = glm::min(min, other.min);
+			max = glm::max(max, other.max);
+		}
+		bool Contains(const AABB& other) const
+		{
+			return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z &&
+				other.max.x <= max.x && other.max.y <= max.y && other.max.z <= max.z;
+		}
+		bool Intersects(const AABB& other) const
+		{
+			return min.x <= other.max.x && other.min.x <= max.x &&
+				min.y <= other.max.y && other.min.y <= max.y &&
+				min.z <= other.max.z && other.min.z <= max.z;
+		}
+		static AABB Merge(const AABB& a, const AABB& b)
+		{
+			return AABB(glm::min(a.min, b.min), glm::max(a.max, b.max));
+		}
+		// Transform: bounds of this box after an affine transform (Arvo's method)
+		AABB Transform(const glm::mat4& mat) const
+		{
+			glm::vec3 c = glm::vec3(mat * glm::vec4(Center(), 1.0f));
+			glm::vec3 e = Extent();
+			glm::vec3 ne;
+			for (int i = 0; i < 3; i++)
+				ne[i] = fabs(mat[0][i]) * e.x + fabs(mat[1][i]) * e.y + fabs(mat[2][i]) * e.z;
+			return AABB(c - ne, c + ne);
+		}
+	};
+
+	struct Ray
+	{
+		glm::vec3 origin;
+		glm::vec3 dir;
+	};
+
+	// IntersectRay: slab test of a ray against a box
+	//   tmax: the far limit of the ray
+	//   tHit: entry distance if intersected
+	//   返回是否相交
+	inline bool IntersectRay(const Ray& ray, const AABB& box, float tmax, float& tHit)
+	{
+		float tmin = 0.0f;
+		for (int i = 0; i < 3; i++)
+		{
+			if (fabs(ray.dir[i]) < 1e-8f)
+			{
+				if (ray.origin[i] < box.min[i] || ray.origin[i] > box.max[i])
+					return false;
+				continue;
+			}
+			float inv = 1.0f / ray.dir[i];
+			float t1 = (box.min[i] - ray.origin[i]) * inv;
+			float t2 = (box.max[i] - ray.origin[i]) * inv;
+			if (t1 > t2) { float t = t1; t1 = t2; t2 = t; }
+			tmin = t1 > tmin ? t1 : tmin;
+			tmax = t2 < tmax ? t2 : tmax;
+			if (tmin > tmax)
+				return false;
+		}
+		tHit = tmin;
+		return true;
+	}
+
+	inline bool IntersectSphere(const glm::vec3& center, float radius, const AABB& box)
+	{
+		glm::vec3 closest = glm::clamp(center, box.min, box.max);
+		glm::vec3 d = closest - center;
+		return glm::dot(d, d) <= radius * radius;
+	}
+
+	// IsClipped: whether the whole box lies where dot(plane, p) < 0, the side gl_ClipDistance discards
+	inline bool IsClipped(const glm::vec4& plane, const AABB& box)
+	{
+		glm::vec3 n = glm::vec3(plane);
+		glm::vec3 pv(n.x >= 0 ? box.max.x : box.min.x, n.y >= 0 ? box.max.y : box.min.y, n.z >= 0 ? box.max.z : box.min.z);
+		return glm::dot(n, pv) + plane.w < 0.0f;
+	}
+
+	enum class FrustumTest
+	{
+		Outside, Intersect, Inside
+	};
+
+	// View frustum described by six inward facing planes (xyz: normal, w: distance)
+	struct Frustum
+	{
+		glm::vec4 planes[6];
+
+		Frustum() {}
+		// extract the planes from a projection * view matrix (Gribb & Hartmann)
+		explicit Frustum(const glm::mat4& viewProjection)
+		{
+			glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+			glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+			glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+			glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+			planes[0] = row3 + row0; // left
+			planes[1] = row3 - row0; // right
+			planes[2] = row3 + row1; // bottom
+			planes[3] = row3 - row1; // top
+			planes[4] = row3 + row2; // near
+			planes[5] = row3 - row2; // far
+			for (int i = 0; i < 6; i++)
+				planes[i] /= glm::length(glm::vec3(planes[i]));
+		}
+		FrustumTest Test(const AABB& box) const
+		{
+			FrustumTest result = FrustumTest::Inside;
+			for (int i = 0; i < 6; i++)
+			{
+				glm::vec3 n = glm::vec3(planes[i]);
+				glm::vec3 pv(n.x >= 0 ? box.max.x : box.min.x, n.y >= 0 ? box.max.y : box.min.y, n.z >= 0 ? box.max.z : box.min.z);
+				glm::vec3 nv(n.x >= 0 ? box.min.x : box.max.x, n.y >= 0 ? box.min.y : box.max.y, n.z >= 0 ? box.min.z : box.max.z);
+				if (glm::dot(n, pv) + planes[i].w < 0.0f)
+					return FrustumTest::Outside;
+				if (glm::dot(n, nv) + planes[i].w < 0.0f)
+					result = FrustumTest::Intersect;
+			}
+			return result;
+		}
+		bool Intersects(const AABB& box) const
+		{
+			return Test(box) != FrustumTest::Outside;
+		}
+	};
+}
+
+#endif // !BOUNDS_H
@@ -0,0 +1,132 @@
+#ifndef EVSM_FILTER_H
+#define EVSM_FILTER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <common.h>
+#include <Shader.h>
+#include <shadow.h>
+#include <RenderSettings.h>
+
+namespace KooNan
+{
+	// Exponential variance shadow maps of the cascades. The depth of a cascade is warped
+	// into two moments at half its resolution, blurred with a separable Gaussian and
+	// mipmapped, so receivers get a filtered shadow from one texture fetch.
+	class EvsmFilter
+	{
+	public:
+		static const unsigned int SIZE = Shadow_Frame_Buffer::CASCADE_SIZE / 2;
+	private:
+		unsigned int momentsArray; // RG32F, one layer per cascade, mipmapped
+		unsigned int temp[2]; // the two blur passes ping-pong through these
+		unsigned int frameBuffer;
+		unsigned int emptyVAO;
+		bool layerValid[Shadow_Frame_Buffer::CASCADES];
+		Shader momentsShader;
+		Shader blurShader;
+	public:
+		EvsmFilter() : momentsShader("landscape/fullscreen.vs", "landscape/evsm_moments.fs"),
+			blurShader("landscape/fullscreen.vs", "landscape/evsm_blur.fs")
+		{
+			glGenTextures(1, &momentsArray);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, momentsArray);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RG32F, SIZE, SIZE, Shadow_Frame_Buffer::CASCADES, 0, GL_RG, GL_FLOAT, NULL);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+			glGenTextures(2, temp);
+			for (unsigned int tex : temp)
+			{
+				glBindTexture(GL_TEXTURE_2D, tex);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, SIZE, SIZE, 0, GL_RG, GL_FLOAT, NULL);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			}
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glGenFramebuffers(1, &frameBuffer);
+			glGenVertexArrays(1, &emptyVAO);
+			Invalidate();
+		}
+		void cleanUp()
+		{
+			glDeleteTextures(1, &momentsArray);
+			glDeleteTextures(2, temp);
+			glDeleteFramebuffers(1, &frameBuffer);
+			glDeleteVertexArrays(1, &emptyVAO);
+		}
+
+		// Invalidate: the moments no longer follow the depth, e.g. while another filter is in use
+		void Invalidate()
+		{
+			for (bool& valid : layerValid)
+				valid = false;
+		}
+		bool IsValid(int cascade) const
+		{
+			return layerValid[cascade];
+		}
+
+		// Update: moments of one cascade from its depth layer, call GenerateMipmaps after the last one
+		//   depthArray: Shadow_Frame_Buffer::getShadowTexture
+		void Update(int cascade, unsigned int depthArray)
+		{
+			GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST), blend = glIsEnabled(GL_BLEND), clip = glIsEnabled(GL_CLIP_DISTANCE0);
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
+			glDisable(GL_CLIP_DISTANCE0);
+			glViewport(0, 0, SIZE, SIZE);
+			glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+			glBindVertexArray(emptyVAO);
+
+			momentsShader.use();
+			momentsShader.setInt("depthMap", 0);
+			momentsShader.setInt("cascade", cascade);
+			momentsShader.setFloat("exponent", RenderSettings::evsmExponent);
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, temp[0], 0);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+
+			blurShader.use();
+			blurShader.setInt("source", 0);
+			blurShader.setInt("radius", RenderSettings::evsmBlurRadius);
+			blurShader.setVec2("direction", glm::vec2(1.0f / SIZE, 0.0f));
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, temp[1], 0);
+			glBindTexture(GL_TEXTURE_2D, temp[0]);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+
+			blurShader.setVec2("direction", glm::vec2(0.0f, 1.0f / SIZE));
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, momentsArray, 0, cascade);
+			glBindTexture(GL_TEXTURE_2D, temp[1]);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glBindVertexArray(0);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			if (depthTest) glEnable(GL_DEPTH_TEST);
+			if (blend) glEnable(GL_BLEND);
+			if (clip) glEnable(GL_CLIP_DISTANCE0);
+			layerValid[cascade] = true;
+		}
+		void GenerateMipmaps()
+		{
+			glBindTexture(GL_TEXTURE_2D_ARRAY, momentsArray);
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		}
+
+		// getMomentsTexture: GL_TEXTURE_2D_ARRAY, read as evsmMap by terrain.fs and model.fs
+		unsigned int getMomentsTexture()
+		{
+			return momentsArray;
+		}
+	};
+}
+
+#endif // !EVSM_FILTER_H
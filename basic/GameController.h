@@ -12,6 +12,7 @@
 #include <common.h>
 #include <GameObject.h>
 #include <mousepicker.h>
+#include <RenderSettings.h>
 
 #include <unordered_map>
 #include <fstream>
@@ -35,6 +36,12 @@ using nlohmann::json;
 #define SAVEJSON_LIGHT_CONSTANT "constant"
 #define SAVEJSON_LIGHT_LINEAR "linear"
 #define SAVEJSON_LIGHT_QUADRATIC "quadratic"
+#define SAVEJSON_WATERBODYLIST "WaterBodyList"
+#define SAVEJSON_WATERBODY_HEIGHT "height"
+#define SAVEJSON_WATERBODY_OUTLINE "outline"
+#define SAVEJSON_PROBELIST "ReflectionProbeList"
+#define SAVEJSON_PROBE_POSITION "position"
+#define SAVEJSON_PROBE_RADIUS "radius"
 
 namespace KooNan
 {
@@ -97,6 +104,10 @@ namespace KooNan
 		static bool ctrlPressedLast; // һѭǷctrl
 		static bool altPressedLast; // һѭǷalt
 		static bool midBtnPressedLast; // һѭǷм
+		static bool f3PressedLast; // F3 toggles the stats overlay
+		static bool f4PressedLast; // F4 cycles the quality presets
+		static bool f5PressedLast; // F5 cycles the antialiasing modes
+		static bool f6PressedLast; // F6 starts the antialiasing comparison
 	public:
 		static void initGameController(GLFWwindow* window)
 		{
@@ -162,6 +173,7 @@ namespace KooNan
 					{// ½
 						glm::mat4 modelMat = glm::translate(glm::mat4(1.0f), t);
 						helperGameObj = new GameObject(selectedModel.c_str(), modelMat, true);
+						helperGameObj->SetDynamic(true);
 						selectedModel = "";
 					}
 					else if (helperGameObj)
@@ -261,6 +273,23 @@ namespace KooNan
 					mainLight->AddPointLight(PointLight{ pos,constant,linear,quadratic,ambient,diffuse,specular });
 				}
 
+				// ponds and lakes above the sea level, outline as x0, z0, x1, z1, ...
+				for (auto& it : gameInfo[SAVEJSON_WATERBODYLIST]) {
+					float height = it[SAVEJSON_WATERBODY_HEIGHT];
+					vector<glm::vec2> outline;
+					for (size_t i = 0; i + 1 < it[SAVEJSON_WATERBODY_OUTLINE].size(); i += 2)
+						outline.push_back(glm::vec2(it[SAVEJSON_WATERBODY_OUTLINE][i], it[SAVEJSON_WATERBODY_OUTLINE][i + 1]));
+					if (mainScene) mainScene->AddWaterBody(outline, height);
+				}
+
+				// reflection probes
+				for (auto& it : gameInfo[SAVEJSON_PROBELIST]) {
+					ReflectionProbe probe;
+					for (int i = 0; i < 3; ++i) probe.position[i] = it[SAVEJSON_PROBE_POSITION][i];
+					probe.radius = it[SAVEJSON_PROBE_RADIUS];
+					if (mainScene) mainScene->reflectionProbes.push_back(probe);
+				}
+
 			}
 			else {
 				cout << "Failed to open save file!" << endl;
@@ -327,6 +356,34 @@ namespace KooNan
 				}
 				gameInfo[SAVEJSON_POINTLIGHTLIST] = pointLights;
 
+				// water bodies, the chunk grid water comes from the scene itself
+				json waterBodies = json::array();
+				if (mainScene)
+					for (Water& w : mainScene->all_water_chunks) {
+						if (w.getOutline().empty()) continue;
+						json body;
+						body[SAVEJSON_WATERBODY_HEIGHT] = w.getHeight();
+						body[SAVEJSON_WATERBODY_OUTLINE] = json::array();
+						for (const glm::vec2& p : w.getOutline()) {
+							body[SAVEJSON_WATERBODY_OUTLINE].push_back(p.x);
+							body[SAVEJSON_WATERBODY_OUTLINE].push_back(p.y);
+						}
+						waterBodies.push_back(body);
+					}
+				gameInfo[SAVEJSON_WATERBODYLIST] = waterBodies;
+
+				// reflection probes
+				json probes = json::array();
+				if (mainScene)
+					for (const ReflectionProbe& p : mainScene->reflectionProbes) {
+						json probe;
+						probe[SAVEJSON_PROBE_POSITION] = json::array();
+						for (int i = 0; i < 3; ++i) probe[SAVEJSON_PROBE_POSITION].push_back(p.position[i]);
+						probe[SAVEJSON_PROBE_RADIUS] = p.radius;
+						probes.push_back(probe);
+					}
+				gameInfo[SAVEJSON_PROBELIST] = probes;
+
 				fout << gameInfo.dump(4);
 				fout.close();
 				cout << "Saving successfully done." << endl;
@@ -376,6 +433,10 @@ namespace KooNan
 	bool GameController::ctrlPressedLast = false;
 	bool GameController::altPressedLast = false;
 	bool GameController::midBtnPressedLast = false;
+	bool GameController::f3PressedLast = false;
+	bool GameController::f4PressedLast = false;
+	bool GameController::f5PressedLast = false;
+	bool GameController::f6PressedLast = false;
 
 	Scene* GameController::mainScene = NULL;
 	Light* GameController::mainLight = NULL;
@@ -450,6 +511,23 @@ namespace KooNan
 		if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 			glfwSetWindowShouldClose(window, true);
 
+		bool f3Pressed = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
+		if (f3Pressed && !f3PressedLast)
+			RenderSettings::showStats = !RenderSettings::showStats;
+		f3PressedLast = f3Pressed;
+		bool f4Pressed = glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS;
+		if (f4Pressed && !f4PressedLast)
+			RenderSettings::ApplyPreset((QualityPreset)(((int)RenderSettings::preset + 1) % (int)QualityPreset::Count));
+		f4PressedLast = f4Pressed;
+		bool f5Pressed = glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS;
+		if (f5Pressed && !f5PressedLast)
+			RenderSettings::antiAliasing = (AntiAliasingMode)(((int)RenderSettings::antiAliasing + 1) % (int)AntiAliasingMode::Count);
+		f5PressedLast = f5Pressed;
+		bool f6Pressed = glfwGetKey(window, GLFW_KEY_F6) == GLFW_PRESS;
+		if (f6Pressed && !f6PressedLast)
+			RenderSettings::antiAliasingComparison = true;
+		f6PressedLast = f6Pressed;
+
 		if (gameMode == GameMode::Creating)
 		{
 			if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
@@ -495,16 +573,14 @@ namespace KooNan
 
 				if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
 					if (helperGameObj) // ȷ
+					{
+						helperGameObj->SetDynamic(false);
 						helperGameObj = NULL;
+					}
 				if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS)
 					if (helperGameObj) // Ƴ
 					{
-						auto itr = GameObject::gameObjList.begin();
-						for (; itr != GameObject::gameObjList.end(); ++itr)
-							if (*itr == helperGameObj)
-								break;
-						GameObject::gameObjList.erase(itr);
-						delete helperGameObj;
+						delete helperGameObj; // unlinks itself from gameObjList
 						helperGameObj = NULL;
 					}
 			}
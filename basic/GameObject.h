@@ -3,6 +3,8 @@
 #include <Shader.h>
 #include <FileSystem.h>
 #include <Model.h>
+#include <SpatialIndex.h>
+#include <RenderSettings.h>
 
 #include <list>
 
@@ -12,6 +14,9 @@ namespace KooNan
 	{
 		// ȫֱ
 	public:
+		static AABBTree<GameObject> spatialIndex; // BVH over the world bounds of gameObjList
+		static unsigned int sceneVersion; // bumped whenever an object is added, moved or removed
+		static std::vector<AABB> changedRegions; // world bounds touched by static objects, Render takes them for the shadow cache
 		static std::list<GameObject*> gameObjList; // Ϸ
 	public:
 		glm::vec3 pos; // λ
@@ -22,9 +27,14 @@ namespace KooNan
 		string modelPath;
 	private:
 		Model* model;
+		std::list<GameObject*>::iterator listItr; // position in gameObjList, for O(1) removal
+		int proxyId; // leaf in spatialIndex
+		unsigned int lodLevels[(int)RenderPass::Count]; // last level chosen per pass, before bias
+		bool dynamic; // moves every frame, e.g. while being placed; kept out of the cached shadows
+		std::vector<std::vector<unsigned int>> bakedBuffers; // [level][mesh]: ambient and AO per vertex from LightBaker, empty if not baked
 	public:
 		GameObject(const std::string& modelPath, const glm::mat4& modelMat = glm::mat4(1.0f), bool IsPickable = false, const glm::vec3 position = glm::vec3(0.0f), const float rotateY = 0.0f, const glm::vec3 scale = glm::vec3(0.2f))
-			: pos(position), rotY(rotateY), sca(scale)
+			: pos(position), rotY(rotateY), sca(scale), dynamic(false)
 		{
 			this->modelMat = modelMat;
 			this->IsPickable = IsPickable;
@@ -38,19 +48,152 @@ namespace KooNan
 			else
 				// ģѼ
 				this->model = Model::modelList[FileSystem::getPath(modelPath)];
-			gameObjList.push_back(this);
+			for (unsigned int& lod : lodLevels)
+				lod = 0;
+			listItr = gameObjList.insert(gameObjList.end(), this);
+			proxyId = spatialIndex.CreateProxy(GetWorldBounds(), this);
+			sceneVersion++;
+			changedRegions.push_back(GetWorldBounds());
 		}
 
+		// unlinks itself from gameObjList and spatialIndex
 		~GameObject()
 		{
-
+			ClearBakedLighting();
+			if (!dynamic)
+				changedRegions.push_back(GetWorldBounds());
+			spatialIndex.DestroyProxy(proxyId);
+			gameObjList.erase(listItr);
+			sceneVersion++;
 		}
 
 		void Update()
 		{
+			ClearBakedLighting(); // baked where it stood
+			if (!dynamic)
+				changedRegions.push_back(GetWorldBounds());
 			modelMat = glm::translate(glm::mat4(1.0f), pos); // λ
 			modelMat = glm::rotate(modelMat, rotY, glm::vec3(0.0f, 1.0f, 0.0f));
 			modelMat = glm::scale(modelMat, sca); // 
+			spatialIndex.MoveProxy(proxyId, GetWorldBounds());
+			sceneVersion++;
+			if (!dynamic)
+				changedRegions.push_back(GetWorldBounds());
+		}
+
+		// SetDynamic: move the object between the cached static shadows and the per frame ones
+		void SetDynamic(bool isDynamic)
+		{
+			if (dynamic == isDynamic)
+				return;
+			dynamic = isDynamic;
+			changedRegions.push_back(GetWorldBounds());
+		}
+		bool IsDynamic() const
+		{
+			return dynamic;
+		}
+
+		// SetBakedLighting: upload the per vertex ambient of every mesh of every level
+		//   levels: [level][mesh][vertex] as in BakedObject, must fit the model
+		//   return: false if it does not, nothing is changed then
+		bool SetBakedLighting(const std::vector<std::vector<std::vector<glm::vec4>>>& levels)
+		{
+			if (levels.size() != model->NumLods())
+				return false;
+			for (unsigned int level = 0; level < levels.size(); level++)
+			{
+				vector<Mesh>& meshes = model->Level(level);
+				if (levels[level].size() != meshes.size())
+					return false;
+				for (size_t m = 0; m < meshes.size(); m++)
+					if (levels[level][m].size() != meshes[m].vertices_simple.size())
+						return false;
+			}
+			ClearBakedLighting();
+			bakedBuffers.resize(levels.size());
+			for (size_t level = 0; level < levels.size(); level++)
+			{
+				bakedBuffers[level].resize(levels[level].size());
+				glGenBuffers((GLsizei)bakedBuffers[level].size(), bakedBuffers[level].data());
+				for (size_t m = 0; m < levels[level].size(); m++)
+				{
+					glBindBuffer(GL_ARRAY_BUFFER, bakedBuffers[level][m]);
+					glBufferData(GL_ARRAY_BUFFER, levels[level][m].size() * sizeof(glm::vec4), levels[level][m].data(), GL_STATIC_DRAW);
+				}
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			return true;
+		}
+		void ClearBakedLighting()
+		{
+			for (std::vector<unsigned int>& level : bakedBuffers)
+				glDeleteBuffers((GLsizei)level.size(), level.data());
+			bakedBuffers.clear();
+		}
+		bool HasBakedLighting() const
+		{
+			return !bakedBuffers.empty();
+		}
+
+		Model* GetModel() const
+		{
+			return model;
+		}
+
+		// GetWorldBounds: model bounds transformed by modelMat
+		AABB GetWorldBounds() const
+		{
+			AABB local(model->boundsMin, model->boundsMax);
+			if (!local.IsValid()) // model failed to load, keep a point at the origin of the object
+				local = AABB(glm::vec3(0.0f), glm::vec3(0.0f));
+			return local.Transform(modelMat);
+		}
+
+		// CollectVisible: objects whose bounds touch the frustum of projection * view
+		static std::vector<GameObject*> CollectVisible(const glm::mat4& viewProjection)
+		{
+			std::vector<GameObject*> visible;
+			spatialIndex.QueryFrustum(Frustum(viewProjection), [&visible](GameObject* obj) { visible.push_back(obj); });
+			return visible;
+		}
+
+		// ScreenSize: projected diameter of the bounds sphere as a fraction of the screen height
+		//   fovy: vertical field of view in degrees
+		float ScreenSize(const glm::vec3& viewPos, float fovy) const
+		{
+			AABB box = GetWorldBounds();
+			float radius = glm::length(box.Extent());
+			float dist = glm::length(box.Center() - viewPos);
+			return dist <= radius ? 1.0f : radius / (dist * tan(glm::radians(fovy) * 0.5f));
+		}
+
+		// SelectLod: detail level from the projected size of the bounds
+		//   pass: the level is remembered per pass, a level only changes once the size
+		//         leaves its range by the hysteresis margin
+		//   viewPos, fovy: camera the size is measured for, fovy in degrees
+		//   返回LOD level, with the bias of pass applied
+		unsigned int SelectLod(RenderPass pass, const glm::vec3& viewPos, float fovy)
+		{
+			unsigned int numLods = model->NumLods();
+			if (numLods == 1)
+				return 0;
+			float size = ScreenSize(viewPos, fovy);
+
+			// coarser only below size * (1 - h), finer only above size * (1 + h)
+			unsigned int coarse = 0, fine = 0;
+			for (unsigned int i = 0; i + 1 < numLods && i < 3; i++)
+			{
+				if (size < RenderSettings::lodScreenSizes[i] * (1.0f - RenderSettings::lodHysteresis)) coarse++;
+				if (size < RenderSettings::lodScreenSizes[i] * (1.0f + RenderSettings::lodHysteresis)) fine++;
+			}
+			unsigned int& last = lodLevels[(int)pass];
+			if (last < coarse)
+				last = coarse;
+			else if (last > fine)
+				last = fine;
+			int lod = (int)last + RenderSettings::lodBias[(int)pass];
+			return (unsigned int)glm::clamp(lod, 0, (int)numLods - 1);
 		}
 
 		void Draw(Shader& shader,
@@ -58,7 +201,8 @@ namespace KooNan
 			const glm::mat4& projectionMat,
 			const glm::mat4& viewMat = glm::mat4(1.0f),
 			const glm::vec4& clippling_plane = glm::vec4(0.0f, -1.0f, 0.0f, 999999.0f),
-			bool isHit = false)
+			bool isHit = false,
+			unsigned int lod = 0)
 		{
 			shader.use();
 			if (isHit)
@@ -70,7 +214,11 @@ namespace KooNan
 			shader.setVec4("plane", clippling_plane);
 			shader.setVec3("viewPos", viewPos);
 			shader.setMat4("model", modelMat);
-			model->Draw(&shader);
+			const std::vector<unsigned int>* baked = nullptr;
+			if (RenderSettings::bakedLighting && !bakedBuffers.empty())
+				baked = &bakedBuffers[glm::min(lod, model->NumLods() - 1)];
+			shader.setInt("bakedLighting", baked ? RenderSettings::BakedLightingMode() : 0);
+			model->Draw(&shader, lod, baked);
 		}
 
 		static void Draw(Mesh& mesh, Shader& shader,
@@ -91,12 +239,14 @@ namespace KooNan
 			shader.setVec4("plane", clippling_plane);
 			shader.setVec3("viewPos", viewPos);
 			shader.setMat4("model", modelMat);
+			shader.setInt("bakedLighting", 0);
 			mesh.Draw(&shader);
 		}
 
 		void Pick(Shader& shader, unsigned int objIndex, unsigned int drawIndex,
 			const glm::mat4& projectionMat,
-			const glm::mat4& viewMat = glm::mat4(1.0f))
+			const glm::mat4& viewMat = glm::mat4(1.0f),
+			unsigned int lod = 0)
 		{
 			shader.use();
 			shader.setMat4("projection", projectionMat);
@@ -104,7 +254,7 @@ namespace KooNan
 			shader.setMat4("model", modelMat);
 			shader.setUint("drawIndex", drawIndex);
 			shader.setUint("objIndex", objIndex);
-			model->Draw(&shader);
+			model->Draw(&shader, lod);
 		}
 
 		static void Pick(Mesh& mesh, Shader& shader, unsigned int objIndex, unsigned int drawIndex,
@@ -122,5 +272,8 @@ namespace KooNan
 		}
 	};
 
+	AABBTree<GameObject> GameObject::spatialIndex;
+	unsigned int GameObject::sceneVersion = 0;
+	std::vector<AABB> GameObject::changedRegions;
 	std::list<GameObject*> GameObject::gameObjList;
 }
\ No newline at end of file
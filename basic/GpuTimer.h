@@ -0,0 +1,79 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <glad/glad.h>
+
+namespace KooNan
+{
+	// GPU time of a block of draw calls, measured with GL_TIME_ELAPSED queries.
+	// A small ring of queries keeps the CPU from waiting on the result; the
+	// reported time lags a few frames behind. Timers must not be nested.
+	class GpuTimer
+	{
+	private:
+		static const int RING_SIZE = 3;
+		unsigned int queries[RING_SIZE];
+		bool pending[RING_SIZE];
+		int next;
+		bool active;
+		float lastMs;
+	public:
+		GpuTimer() : next(0), active(false), lastMs(0.0f)
+		{
+			glGenQueries(RING_SIZE, queries);
+			for (bool& p : pending)
+				p = false;
+		}
+		// cleanUp: release the GL objects, call before the context is destroyed
+		void cleanUp()
+		{
+			glDeleteQueries(RING_SIZE, queries);
+		}
+
+		// Begin: start timing, does nothing while every query of the ring is still in flight
+		void Begin()
+		{
+			Collect();
+			active = !pending[next];
+			if (active)
+				glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+		}
+		void End()
+		{
+			if (!active)
+				return;
+			glEndQuery(GL_TIME_ELAPSED);
+			pending[next] = true;
+			next = (next + 1) % RING_SIZE;
+			active = false;
+		}
+
+		// Milliseconds: the latest result that came back
+		float Milliseconds() const
+		{
+			return lastMs;
+		}
+
+	private:
+		void Collect()
+		{
+			// oldest first, so the newest available result wins
+			for (int i = 0; i < RING_SIZE; i++)
+			{
+				int q = (next + i) % RING_SIZE;
+				if (!pending[q])
+					continue;
+				GLint available = 0;
+				glGetQueryObjectiv(queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+				if (!available)
+					break;
+				GLuint64 ns = 0;
+				glGetQueryObjectui64v(queries[q], GL_QUERY_RESULT, &ns);
+				pending[q] = false;
+				lastMs = ns / 1e6f;
+			}
+		}
+	};
+}
+
+#endif // !GPUTIMER_H
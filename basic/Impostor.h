@@ -0,0 +1,361 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <Shader.h>
+#include <model.h>
+#include <light.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+
+namespace KooNan
+{
+	// Octahedral impostor of one model: GRID x GRID orthographic views of the model,
+	// spread over the sphere of view directions, stored in an albedo and a normal + depth atlas.
+	// The bake needs a GL context but no visible window; its result is cached next to
+	// the model as <model>.impostor.
+	class ImpostorAtlas
+	{
+	public:
+		static const int GRID = 8;
+		static const int FRAME_SIZE = 128;
+		static const int ATLAS_SIZE = GRID * FRAME_SIZE;
+
+		unsigned int albedoTex, normalDepthTex;
+		glm::vec3 center; // bounds center in model space
+		float radius; // bounds sphere radius in model space
+	private:
+		static const unsigned int CACHE_MAGIC = 0x504D494B; // "KIMP"
+		static const unsigned int CACHE_VERSION = 1;
+	public:
+		// ImpostorAtlas: load the cached atlas of a model, bake and cache it if missing or stale
+		//   modelPath: the file the model was loaded from
+		//   bakeShader: model/impostor_bake shader
+		ImpostorAtlas(Model& model, const std::string& modelPath, Shader& bakeShader)
+		{
+			glm::vec3 bmin = model.boundsMin, bmax = model.boundsMax;
+			if (bmin.x > bmax.x)
+				bmin = bmax = glm::vec3(0.0f);
+			center = (bmin + bmax) * 0.5f;
+			radius = glm::max(glm::length(bmax - bmin) * 0.5f, 1e-3f);
+
+			albedoTex = CreateTexture();
+			normalDepthTex = CreateTexture();
+			std::string cachePath = modelPath + ".impostor";
+			if (!Load(cachePath, modelPath))
+			{
+				Bake(model, bakeShader);
+				Save(cachePath, modelPath);
+			}
+			glBindTexture(GL_TEXTURE_2D, albedoTex);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glBindTexture(GL_TEXTURE_2D, normalDepthTex);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+		~ImpostorAtlas()
+		{
+			glDeleteTextures(1, &albedoTex);
+			glDeleteTextures(1, &normalDepthTex);
+		}
+
+		// OctDecode: view direction of an octahedral coordinate in [0, 1]^2, y up
+		static glm::vec3 OctDecode(glm::vec2 uv)
+		{
+			glm::vec2 p = uv * 2.0f - 1.0f;
+			glm::vec3 n(p.x, 1.0f - fabs(p.x) - fabs(p.y), p.y);
+			if (n.y < 0.0f)
+			{
+				float x = n.x;
+				n.x = (1.0f - fabs(n.z)) * (x >= 0.0f ? 1.0f : -1.0f);
+				n.z = (1.0f - fabs(x)) * (n.z >= 0.0f ? 1.0f : -1.0f);
+			}
+			return glm::normalize(n);
+		}
+
+		// FrameBasis: image axes of the view looking along -dir
+		static void FrameBasis(const glm::vec3& dir, glm::vec3& right, glm::vec3& up)
+		{
+			glm::vec3 worldUp = fabs(dir.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			right = glm::normalize(glm::cross(worldUp, dir));
+			up = glm::cross(dir, right);
+		}
+
+		// IsVegetation: models under model/rsc/plants get impostors
+		static bool IsVegetation(const std::string& modelPath)
+		{
+			return modelPath.find("plants") != std::string::npos;
+		}
+
+	private:
+		static unsigned int CreateTexture()
+		{
+			unsigned int tex;
+			glGenTextures(1, &tex);
+			glBindTexture(GL_TEXTURE_2D, tex);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, ATLAS_SIZE, ATLAS_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			return tex;
+		}
+
+		void Bake(Model& model, Shader& bakeShader)
+		{
+			GLint lastFbo, lastViewport[4];
+			glGetIntegerv(GL_FRAMEBUFFER_BINDING, &lastFbo);
+			glGetIntegerv(GL_VIEWPORT, lastViewport);
+			GLboolean cull = glIsEnabled(GL_CULL_FACE), clip = glIsEnabled(GL_CLIP_DISTANCE0);
+
+			unsigned int fbo, depthRbo;
+			glGenFramebuffers(1, &fbo);
+			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTex, 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalDepthTex, 0);
+			glGenRenderbuffers(1, &depthRbo);
+			glBindRenderbuffer(GL_RENDERBUFFER, depthRbo);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, ATLAS_SIZE, ATLAS_SIZE);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRbo);
+			GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+			glDrawBuffers(2, attachments);
+
+			glViewport(0, 0, ATLAS_SIZE, ATLAS_SIZE);
+			glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glEnable(GL_DEPTH_TEST);
+			glDisable(GL_CULL_FACE);
+			glDisable(GL_CLIP_DISTANCE0);
+
+			bakeShader.use();
+			// depth 0.5 lies on the plane through the center, see impostor.fs
+			bakeShader.setMat4("projection", glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius));
+			for (int y = 0; y < GRID; y++)
+				for (int x = 0; x < GRID; x++)
+				{
+					glm::vec3 dir = OctDecode(glm::vec2(x, y) / (float)(GRID - 1));
+					glm::vec3 right, up;
+					FrameBasis(dir, right, up);
+					bakeShader.setMat4("view", glm::lookAt(center + dir * 2.0f * radius, center, up));
+					glViewport(x * FRAME_SIZE, y * FRAME_SIZE, FRAME_SIZE, FRAME_SIZE);
+					model.Draw(&bakeShader);
+				}
+
+			glBindFramebuffer(GL_FRAMEBUFFER, lastFbo);
+			glViewport(lastViewport[0], lastViewport[1], lastViewport[2], lastViewport[3]);
+			if (cull) glEnable(GL_CULL_FACE);
+			if (clip) glEnable(GL_CLIP_DISTANCE0);
+			glDeleteRenderbuffers(1, &depthRbo);
+			glDeleteFramebuffers(1, &fbo);
+		}
+
+		static void CacheStamp(const std::string& path, unsigned long long& size, long long& time)
+		{
+			std::error_code ec;
+			size = (unsigned long long)std::filesystem::file_size(path, ec);
+			time = (long long)std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+		}
+
+		bool Load(const std::string& cachePath, const std::string& modelPath)
+		{
+			std::ifstream in(cachePath, std::ios::binary);
+			if (!in)
+				return false;
+			unsigned int magic = 0, version = 0;
+			int grid = 0, frameSize = 0;
+			unsigned long long size, cachedSize = 0;
+			long long time, cachedTime = 0;
+			CacheStamp(modelPath, size, time);
+			in.read((char*)&magic, sizeof(magic));
+			in.read((char*)&version, sizeof(version));
+			in.read((char*)&cachedSize, sizeof(cachedSize));
+			in.read((char*)&cachedTime, sizeof(cachedTime));
+			in.read((char*)&grid, sizeof(grid));
+			in.read((char*)&frameSize, sizeof(frameSize));
+			if (!in || magic != CACHE_MAGIC || version != CACHE_VERSION || cachedSize != size || cachedTime != time ||
+				grid != GRID || frameSize != FRAME_SIZE)
+				return false;
+			std::vector<unsigned char> albedo(ATLAS_SIZE * ATLAS_SIZE * 4), normalDepth(ATLAS_SIZE * ATLAS_SIZE * 4);
+			in.read((char*)albedo.data(), albedo.size());
+			in.read((char*)normalDepth.data(), normalDepth.size());
+			if (!in)
+				return false;
+			glBindTexture(GL_TEXTURE_2D, albedoTex);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ATLAS_SIZE, ATLAS_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, albedo.data());
+			glBindTexture(GL_TEXTURE_2D, normalDepthTex);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ATLAS_SIZE, ATLAS_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, normalDepth.data());
+			glBindTexture(GL_TEXTURE_2D, 0);
+			return true;
+		}
+
+		void Save(const std::string& cachePath, const std::string& modelPath) const
+		{
+			std::ofstream out(cachePath, std::ios::binary);
+			if (!out)
+			{
+				std::cout << "Impostor cache could not be written to " << cachePath << std::endl;
+				return;
+			}
+			unsigned int magic = CACHE_MAGIC, version = CACHE_VERSION;
+			int grid = GRID, frameSize = FRAME_SIZE;
+			unsigned long long size;
+			long long time;
+			CacheStamp(modelPath, size, time);
+			std::vector<unsigned char> albedo(ATLAS_SIZE * ATLAS_SIZE * 4), normalDepth(ATLAS_SIZE * ATLAS_SIZE * 4);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glBindTexture(GL_TEXTURE_2D, albedoTex);
+			glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, albedo.data());
+			glBindTexture(GL_TEXTURE_2D, normalDepthTex);
+			glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, normalDepth.data());
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			out.write((const char*)&magic, sizeof(magic));
+			out.write((const char*)&version, sizeof(version));
+			out.write((const char*)&size, sizeof(size));
+			out.write((const char*)&time, sizeof(time));
+			out.write((const char*)&grid, sizeof(grid));
+			out.write((const char*)&frameSize, sizeof(frameSize));
+			out.write((const char*)albedo.data(), albedo.size());
+			out.write((const char*)normalDepth.data(), normalDepth.size());
+		}
+	};
+
+	// Draws far vegetation as instanced camera facing quads sampling the atlases.
+	// Objects are queued per model during a pass and drawn with one call per model by Flush.
+	class ImpostorRenderer
+	{
+	private:
+		struct Instance
+		{
+			glm::mat4 model;
+			float fade;
+		};
+		struct Batch
+		{
+			ImpostorAtlas* atlas;
+			std::vector<Instance> instances;
+		};
+		Shader bakeShader;
+		Shader drawShader;
+		std::unordered_map<Model*, Batch> batches;
+		unsigned int quadVAO, quadVBO, instanceVBO;
+	public:
+		ImpostorRenderer() : bakeShader("model/impostor_bake.vs", "model/impostor_bake.fs"), drawShader("model/impostor.vs", "model/impostor.fs")
+		{
+			float corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+			glGenVertexArrays(1, &quadVAO);
+			glGenBuffers(1, &quadVBO);
+			glGenBuffers(1, &instanceVBO);
+			glBindVertexArray(quadVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+			glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+			for (int i = 0; i < 4; i++)
+			{
+				glEnableVertexAttribArray(1 + i);
+				glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offsetof(Instance, model) + i * sizeof(glm::vec4)));
+				glVertexAttribDivisor(1 + i, 1);
+			}
+			glEnableVertexAttribArray(5);
+			glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, fade));
+			glVertexAttribDivisor(5, 1);
+			glBindVertexArray(0);
+		}
+
+		// Prepare: load or bake the atlases of every vegetation model loaded so far
+		void Prepare()
+		{
+			for (auto& p : Model::modelList)
+				if (ImpostorAtlas::IsVegetation(p.first))
+					GetAtlas(p.second, p.first);
+		}
+
+		// Add: queue an object for the next Flush
+		//   fade: share of its pixels the impostor covers, 1 when the mesh is not drawn at all
+		//   返回false if the object's model has no impostor
+		bool Add(Model* model, const std::string& modelPath, const glm::mat4& modelMat, float fade)
+		{
+			if (!ImpostorAtlas::IsVegetation(modelPath))
+				return false;
+			Batch& batch = GetAtlas(model, modelPath);
+			batch.instances.push_back(Instance{ modelMat, fade });
+			return true;
+		}
+
+		// Flush: draw and clear the queued impostors
+		void Flush(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& viewPos, const glm::vec4& clipping_plane, Light& light)
+		{
+			bool any = false;
+			for (auto& p : batches)
+				any = any || !p.second.instances.empty();
+			if (!any)
+				return;
+			light.SetLight(drawShader);
+			drawShader.use();
+			drawShader.setMat4("projection", projection);
+			drawShader.setMat4("view", view);
+			drawShader.setVec3("viewPos", viewPos);
+			drawShader.setVec4("plane", clipping_plane);
+			drawShader.setInt("gridSize", ImpostorAtlas::GRID);
+			drawShader.setInt("albedoAtlas", 0);
+			drawShader.setInt("normalDepthAtlas", 1);
+			GLboolean cull = glIsEnabled(GL_CULL_FACE);
+			glDisable(GL_CULL_FACE);
+			glBindVertexArray(quadVAO);
+			for (auto& p : batches)
+			{
+				Batch& batch = p.second;
+				if (batch.instances.empty())
+					continue;
+				drawShader.setVec3("boundsCenter", batch.atlas->center);
+				drawShader.setFloat("boundsRadius", batch.atlas->radius);
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, batch.atlas->albedoTex);
+				glActiveTexture(GL_TEXTURE1);
+				glBindTexture(GL_TEXTURE_2D, batch.atlas->normalDepthTex);
+				glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+				glBufferData(GL_ARRAY_BUFFER, batch.instances.size() * sizeof(Instance), batch.instances.data(), GL_STREAM_DRAW);
+				glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)batch.instances.size());
+				batch.instances.clear();
+			}
+			glBindVertexArray(0);
+			glActiveTexture(GL_TEXTURE0);
+			if (cull)
+				glEnable(GL_CULL_FACE);
+		}
+
+		// cleanUp: release the GL objects, call before the context is destroyed
+		void cleanUp()
+		{
+			for (auto& p : batches)
+				delete p.second.atlas;
+			batches.clear();
+			glDeleteBuffers(1, &instanceVBO);
+			glDeleteBuffers(1, &quadVBO);
+			glDeleteVertexArrays(1, &quadVAO);
+		}
+
+	private:
+		Batch& GetAtlas(Model* model, const std::string& modelPath)
+		{
+			auto it = batches.find(model);
+			if (it != batches.end())
+				return it->second;
+			Batch& batch = batches[model];
+			batch.atlas = new ImpostorAtlas(*model, modelPath, bakeShader);
+			return batch;
+		}
+	};
+}
+
+#endif // !IMPOSTOR_H
@@ -0,0 +1,486 @@
+#ifndef LIGHTBAKER_H
+#define LIGHTBAKER_H
+
+#include <glm/glm.hpp>
+
+#include <GameObject.h>
+#include <TriangleBVH.h>
+#include <WorkStealingScheduler.h>
+#include <RenderSettings.h>
+#include <terrain.h>
+#include <light.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <climits>
+#include <cfloat>
+#include <cmath>
+
+namespace KooNan
+{
+	// Baked ambient of one static object, per vertex of every mesh of every LOD level
+	struct BakedObject
+	{
+		std::string modelPath;
+		glm::mat4 modelMat;
+		std::vector<std::vector<std::vector<glm::vec4>>> levels; // [level][mesh][vertex]: rgb ambient light, a ambient occlusion
+	};
+
+	// Everything LightBaker produced, stored next to the save file
+	struct BakedScene
+	{
+		static const unsigned int MAGIC = 0x4D4C4E4B; // "KNLM"
+		static const unsigned int VERSION = 1;
+
+		unsigned int terrainChecksum; // LightBaker::TerrainChecksum of the heights it was baked with
+		glm::vec2 terrainOrigin; // world x, z of the corner of the terrain lightmap
+		glm::vec2 terrainExtent; // world size the lightmap covers
+		int terrainWidth, terrainHeight; // texels
+		std::vector<glm::vec4> terrain; // row z at z * terrainWidth, the same channels as BakedObject
+		std::vector<BakedObject> objects;
+
+		BakedScene() : terrainChecksum(0), terrainOrigin(0.0f), terrainExtent(0.0f), terrainWidth(0), terrainHeight(0) {}
+
+		bool Save(const std::string& path) const
+		{
+			std::ofstream out(path, std::ios::binary);
+			if (!out)
+			{
+				std::cout << "Baked lighting could not be written to " << path << std::endl;
+				return false;
+			}
+			unsigned int magic = MAGIC, version = VERSION, numObjects = (unsigned int)objects.size();
+			out.write((const char*)&magic, sizeof(magic));
+			out.write((const char*)&version, sizeof(version));
+			out.write((const char*)&terrainChecksum, sizeof(terrainChecksum));
+			out.write((const char*)&terrainOrigin, sizeof(terrainOrigin));
+			out.write((const char*)&terrainExtent, sizeof(terrainExtent));
+			out.write((const char*)&terrainWidth, sizeof(terrainWidth));
+			out.write((const char*)&terrainHeight, sizeof(terrainHeight));
+			WriteArray(out, terrain);
+			out.write((const char*)&numObjects, sizeof(numObjects));
+			for (const BakedObject& obj : objects)
+			{
+				unsigned int pathLength = (unsigned int)obj.modelPath.size(), numLevels = (unsigned int)obj.levels.size();
+				out.write((const char*)&pathLength, sizeof(pathLength));
+				out.write(obj.modelPath.data(), pathLength);
+				out.write((const char*)&obj.modelMat, sizeof(obj.modelMat));
+				out.write((const char*)&numLevels, sizeof(numLevels));
+				for (const std::vector<std::vector<glm::vec4>>& level : obj.levels)
+				{
+					unsigned int numMeshes = (unsigned int)level.size();
+					out.write((const char*)&numMeshes, sizeof(numMeshes));
+					for (const std::vector<glm::vec4>& mesh : level)
+						WriteArray(out, mesh);
+				}
+			}
+			return (bool)out;
+		}
+
+		bool Load(const std::string& path)
+		{
+			std::ifstream in(path, std::ios::binary);
+			if (!in)
+				return false;
+			unsigned int magic = 0, version = 0, numObjects = 0;
+			in.read((char*)&magic, sizeof(magic));
+			in.read((char*)&version, sizeof(version));
+			if (!in || magic != MAGIC || version != VERSION)
+				return false;
+			in.read((char*)&terrainChecksum, sizeof(terrainChecksum));
+			in.read((char*)&terrainOrigin, sizeof(terrainOrigin));
+			in.read((char*)&terrainExtent, sizeof(terrainExtent));
+			in.read((char*)&terrainWidth, sizeof(terrainWidth));
+			in.read((char*)&terrainHeight, sizeof(terrainHeight));
+			if (!ReadArray(in, terrain) || terrain.size() != (size_t)terrainWidth * terrainHeight)
+				return false;
+			in.read((char*)&numObjects, sizeof(numObjects));
+			if (!in)
+				return false;
+			objects.resize(numObjects);
+			for (BakedObject& obj : objects)
+			{
+				unsigned int pathLength = 0, numLevels = 0;
+				in.read((char*)&pathLength, sizeof(pathLength));
+				if (!in || pathLength > 4096)
+					return false;
+				obj.modelPath.resize(pathLength);
+				in.read(&obj.modelPath[0], pathLength);
+				in.read((char*)&obj.modelMat, sizeof(obj.modelMat));
+				in.read((char*)&numLevels, sizeof(numLevels));
+				if (!in || numLevels > 16)
+					return false;
+				obj.levels.resize(numLevels);
+				for (std::vector<std::vector<glm::vec4>>& level : obj.levels)
+				{
+					unsigned int numMeshes = 0;
+					in.read((char*)&numMeshes, sizeof(numMeshes));
+					if (!in || numMeshes > 65536)
+						return false;
+					level.resize(numMeshes);
+					for (std::vector<glm::vec4>& mesh : level)
+						if (!ReadArray(in, mesh))
+							return false;
+				}
+			}
+			return true;
+		}
+
+	private:
+		static void WriteArray(std::ofstream& out, const std::vector<glm::vec4>& data)
+		{
+			unsigned int count = (unsigned int)data.size();
+			out.write((const char*)&count, sizeof(count));
+			out.write((const char*)data.data(), count * sizeof(glm::vec4));
+		}
+		static bool ReadArray(std::ifstream& in, std::vector<glm::vec4>& data)
+		{
+			unsigned int count = 0;
+			in.read((char*)&count, sizeof(count));
+			if (!in || count > (1u << 26))
+				return false;
+			data.resize(count);
+			in.read((char*)data.data(), count * sizeof(glm::vec4));
+			return (bool)in;
+		}
+	};
+
+	// Offline ambient light and AO of the terrain and the static objects, on the CPU only.
+	// Cosine distributed rays leave every terrain lightmap texel and every object vertex and are
+	// traced through a BVH of the whole static scene. Rays that escape see the sky, rays that hit
+	// pick up the sun and the point lights reflected off the surface they hit (one bounce), and the
+	// share of rays blocked within RenderSettings::lightmapAoDistance is the AO. The ambient terms
+	// of the point lights are added on top, darkened by that AO, so the shaders can drop theirs.
+	// Texels and vertices are split across all cores with WorkStealingScheduler, their cost varies a lot.
+	class LightBaker
+	{
+	private:
+		static constexpr float RAY_BIAS = 0.01f; // rays start this far off the surface
+		struct Sample
+		{
+			glm::vec3 position;
+			glm::vec3 normal;
+			glm::vec4* out;
+		};
+		struct LightSource
+		{
+			PointLight light;
+			AABB housing; // bounds of the object the light sits in, its walls do not block it; invalid if none
+		};
+		TriangleBVH bvh;
+		std::vector<float> albedo; // per triangle of bvh
+		DirLight sun;
+		std::vector<LightSource> lights;
+		std::vector<Sample> samples;
+	public:
+		// Bake: trace the terrain chunks, the static objects of GameObject::gameObjList and the lights
+		//   result: replaced with the new bake
+		void Bake(std::vector<Terrain>& chunks, Light& light, BakedScene& result)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			result = BakedScene();
+			samples.clear();
+			CollectLights(light);
+			BuildScene(chunks);
+			AddTerrainSamples(chunks, result);
+			AddObjectSamples(result);
+
+			WorkStealingScheduler scheduler;
+			scheduler.ParallelRange(0, (int)samples.size(), 64, [this](int i) { BakeSample(samples[i], (uint32_t)i); });
+
+			float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			std::cout << "Baked lighting: " << samples.size() << " samples, " << bvh.NumTriangles() << " triangles, "
+				<< scheduler.NumThreads() << " threads, " << scheduler.Steals() << " steals, " << ms << " ms" << std::endl;
+			samples.clear();
+			bvh.Clear();
+			albedo.clear();
+		}
+
+		// TerrainChecksum: FNV-1a over the heights of all chunks, a bake only fits the terrain it was made for
+		static unsigned int TerrainChecksum(const std::vector<Terrain>& chunks)
+		{
+			uint32_t hash = 2166136261u;
+			for (const Terrain& chunk : chunks)
+			{
+				const std::vector<float>& heights = chunk.GetHeights();
+				const unsigned char* bytes = (const unsigned char*)heights.data();
+				for (size_t i = 0; i < heights.size() * sizeof(float); i++)
+					hash = (hash ^ bytes[i]) * 16777619u;
+			}
+			return hash;
+		}
+
+		// Matches: whether a baked object was made for obj where it stands now
+		static bool Matches(const BakedObject& baked, const GameObject& obj)
+		{
+			if (baked.modelPath != obj.modelPath)
+				return false;
+			for (int c = 0; c < 4; c++)
+				for (int r = 0; r < 4; r++)
+					if (std::fabs(baked.modelMat[c][r] - obj.modelMat[c][r]) > 1e-4f)
+						return false;
+			return true;
+		}
+
+	private:
+		void CollectLights(Light& light)
+		{
+			sun = *light.getDirectionLight();
+			lights.clear();
+			for (unsigned int i = 0; i < light.numOfPointLight(); i++)
+			{
+				LightSource source;
+				source.light = *light.getPointLightAt(i);
+				AABB point(source.light.position, source.light.position);
+				bool housed = false;
+				GameObject::spatialIndex.QueryBox(point, [&](GameObject* obj) {
+					AABB bounds = obj->GetWorldBounds();
+					if (!housed && !obj->IsDynamic() && bounds.Contains(point))
+					{
+						source.housing = bounds;
+						housed = true;
+					}
+				});
+				lights.push_back(source);
+			}
+		}
+
+		void BuildScene(std::vector<Terrain>& chunks)
+		{
+			bvh.Clear();
+			albedo.clear();
+			for (Terrain& chunk : chunks)
+			{
+				const Mesh& mesh = chunk.GetMesh();
+				for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+				{
+					bvh.AddTriangle(mesh.vertices_simple[mesh.indices[i]].Position, mesh.vertices_simple[mesh.indices[i + 1]].Position,
+						mesh.vertices_simple[mesh.indices[i + 2]].Position);
+					albedo.push_back(RenderSettings::lightmapGroundAlbedo);
+				}
+			}
+			for (GameObject* obj : GameObject::gameObjList)
+			{
+				if (obj->IsDynamic())
+					continue;
+				for (const Mesh& mesh : obj->GetModel()->meshes)
+				{
+					std::vector<glm::vec3> world(mesh.vertices_simple.size());
+					for (size_t v = 0; v < world.size(); v++)
+						world[v] = glm::vec3(obj->modelMat * glm::vec4(mesh.vertices_simple[v].Position, 1.0f));
+					for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+					{
+						bvh.AddTriangle(world[mesh.indices[i]], world[mesh.indices[i + 1]], world[mesh.indices[i + 2]]);
+						albedo.push_back(RenderSettings::lightmapObjectAlbedo);
+					}
+				}
+			}
+			bvh.Build();
+		}
+
+		// AddTerrainSamples: one texel grid over the chunk grid, lightmapResolution texels per chunk side
+		void AddTerrainSamples(std::vector<Terrain>& chunks, BakedScene& result)
+		{
+			if (chunks.empty())
+				return;
+			int minX = INT_MAX, minZ = INT_MAX, maxX = INT_MIN, maxZ = INT_MIN;
+			for (const Terrain& chunk : chunks)
+			{
+				minX = glm::min(minX, chunk.GetGridX());
+				minZ = glm::min(minZ, chunk.GetGridZ());
+				maxX = glm::max(maxX, chunk.GetGridX());
+				maxZ = glm::max(maxZ, chunk.GetGridZ());
+			}
+			int gridW = maxX - minX + 1, gridH = maxZ - minZ + 1;
+			std::vector<const Terrain*> grid(gridW * gridH, nullptr);
+			for (const Terrain& chunk : chunks)
+				grid[(chunk.GetGridZ() - minZ) * gridW + chunk.GetGridX() - minX] = &chunk;
+			const Terrain& first = chunks.front();
+			float size = first.GetSize();
+			int res = RenderSettings::lightmapResolution;
+			result.terrainChecksum = TerrainChecksum(chunks);
+			result.terrainOrigin = first.GetFirstVertex() - glm::vec2(first.GetGridX() - minX, first.GetGridZ() - minZ) * size;
+			result.terrainExtent = glm::vec2(gridW, gridH) * size;
+			result.terrainWidth = gridW * res;
+			result.terrainHeight = gridH * res;
+			result.terrain.assign((size_t)result.terrainWidth * result.terrainHeight, glm::vec4(sun.ambient, 1.0f));
+
+			for (int tz = 0; tz < result.terrainHeight; tz++)
+				for (int tx = 0; tx < result.terrainWidth; tx++)
+				{
+					const Terrain* chunk = grid[(tz / res) * gridW + tx / res];
+					if (!chunk)
+						continue;
+					const std::vector<Vertex_Simple>& vertices = chunk->GetMesh().vertices_simple;
+					int n = chunk->GetVertexCount();
+					float gx = ((tx % res) + 0.5f) / res * (n - 1), gz = ((tz % res) + 0.5f) / res * (n - 1);
+					int j = glm::min((int)gx, n - 2), i = glm::min((int)gz, n - 2);
+					float fx = gx - j, fz = gz - i;
+					const Vertex_Simple& v00 = vertices[j + i * n];
+					const Vertex_Simple& v10 = vertices[j + 1 + i * n];
+					const Vertex_Simple& v01 = vertices[j + (i + 1) * n];
+					const Vertex_Simple& v11 = vertices[j + 1 + (i + 1) * n];
+					// on the triangle of the cell, split along (1, 0)-(0, 1) like Terrain::generateIndex
+					Sample s;
+					if (fx <= 1.0f - fz)
+						s.position = v00.Position + (v10.Position - v00.Position) * fx + (v01.Position - v00.Position) * fz;
+					else
+						s.position = v11.Position + (v10.Position - v11.Position) * (1.0f - fz) + (v01.Position - v11.Position) * (1.0f - fx);
+					s.normal = glm::normalize(glm::mix(glm::mix(v00.Normal, v10.Normal, fx), glm::mix(v01.Normal, v11.Normal, fx), fz));
+					s.out = &result.terrain[(size_t)tz * result.terrainWidth + tx];
+					samples.push_back(s);
+				}
+		}
+
+		// AddObjectSamples: every vertex of every level of the static objects
+		void AddObjectSamples(BakedScene& result)
+		{
+			for (GameObject* obj : GameObject::gameObjList)
+			{
+				if (obj->IsDynamic())
+					continue;
+				Model* model = obj->GetModel();
+				BakedObject baked;
+				baked.modelPath = obj->modelPath;
+				baked.modelMat = obj->modelMat;
+				baked.levels.resize(model->NumLods());
+				for (unsigned int level = 0; level < model->NumLods(); level++)
+					for (const Mesh& mesh : model->Level(level))
+						baked.levels[level].push_back(std::vector<glm::vec4>(mesh.vertices_simple.size()));
+				result.objects.push_back(baked);
+			}
+			// the arrays stay put from here on, the samples point into them
+			size_t next = 0;
+			for (GameObject* obj : GameObject::gameObjList)
+			{
+				if (obj->IsDynamic())
+					continue;
+				BakedObject& baked = result.objects[next++];
+				glm::mat3 normalMat = glm::transpose(glm::inverse(glm::mat3(obj->modelMat)));
+				for (unsigned int level = 0; level < baked.levels.size(); level++)
+				{
+					const std::vector<Mesh>& meshes = obj->GetModel()->Level(level);
+					for (size_t m = 0; m < meshes.size(); m++)
+						for (size_t v = 0; v < meshes[m].vertices_simple.size(); v++)
+						{
+							const Vertex_Simple& vertex = meshes[m].vertices_simple[v];
+							Sample s;
+							s.position = glm::vec3(obj->modelMat * glm::vec4(vertex.Position, 1.0f));
+							s.normal = normalMat * vertex.Normal;
+							float len = glm::length(s.normal);
+							s.normal = len > 0.0f ? s.normal / len : glm::vec3(0.0f, 1.0f, 0.0f);
+							s.out = &baked.levels[level][m][v];
+							samples.push_back(s);
+						}
+				}
+			}
+		}
+
+		static float Attenuation(const PointLight& light, float distance)
+		{
+			return 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+		}
+
+		// Visible: whether point light i reaches p, not counting the walls of its housing
+		bool Visible(const LightSource& source, const glm::vec3& p, const glm::vec3& dir, float distance) const
+		{
+			float skip = 0.0f;
+			if (source.housing.IsValid())
+			{
+				// distance from the light to where the segment leaves the housing
+				skip = FLT_MAX;
+				for (int a = 0; a < 3; a++)
+				{
+					if (std::fabs(dir[a]) < 1e-8f)
+						continue;
+					float bound = -dir[a] > 0.0f ? source.housing.max[a] : source.housing.min[a];
+					skip = glm::min(skip, (bound - source.light.position[a]) / -dir[a]);
+				}
+			}
+			float reach = distance - glm::max(skip, RAY_BIAS);
+			return reach <= 0.0f || !bvh.Occluded({ p, dir }, reach);
+		}
+
+		// DirectLight: sun and point lights arriving at p, as the shaders would light it
+		glm::vec3 DirectLight(const glm::vec3& p, const glm::vec3& n) const
+		{
+			glm::vec3 result(0.0f);
+			glm::vec3 toSun = -glm::normalize(sun.direction);
+			float c = glm::dot(n, toSun);
+			if (c > 0.0f && !bvh.Occluded({ p, toSun }, FLT_MAX))
+				result += sun.diffuse * c;
+			for (const LightSource& source : lights)
+			{
+				glm::vec3 d = source.light.position - p;
+				float distance = glm::length(d);
+				if (distance <= 0.0f)
+					continue;
+				d /= distance;
+				c = glm::dot(n, d);
+				if (c > 0.0f && Visible(source, p, d, distance))
+					result += source.light.diffuse * c * Attenuation(source.light, distance);
+			}
+			return result;
+		}
+
+		static float Random(uint32_t& state)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return (state >> 8) * (1.0f / 16777216.0f);
+		}
+
+		void BakeSample(const Sample& s, uint32_t index) const
+		{
+			// Wang hash of the index, the bake comes out the same however the work was split
+			uint32_t state = (index ^ 61u) ^ (index >> 16);
+			state *= 9u;
+			state ^= state >> 4;
+			state *= 0x27d4eb2du;
+			state ^= state >> 15;
+			if (state == 0)
+				state = 1;
+			glm::vec3 up = std::fabs(s.normal.y) < 0.999f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+			glm::vec3 tangent = glm::normalize(glm::cross(up, s.normal));
+			glm::vec3 bitangent = glm::cross(s.normal, tangent);
+			glm::vec3 origin = s.position + s.normal * RAY_BIAS;
+
+			int count = glm::max(RenderSettings::lightmapSamples, 1);
+			glm::vec3 radiance(0.0f);
+			int open = 0;
+			for (int k = 0; k < count; k++)
+			{
+				// cosine weighted, so the plain average of the radiance is the ambient the shaders expect
+				float u1 = Random(state), u2 = Random(state);
+				float r = std::sqrt(u1), phi = 2.0f * 3.14159265f * u2;
+				glm::vec3 dir = tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + s.normal * std::sqrt(glm::max(1.0f - u1, 0.0f));
+				TriangleBVH::Hit hit;
+				if (!bvh.Intersect({ origin, dir }, FLT_MAX, hit))
+				{
+					radiance += sun.ambient;
+					open++;
+					continue;
+				}
+				if (hit.t >= RenderSettings::lightmapAoDistance)
+					open++;
+				glm::vec3 n = glm::normalize(hit.normal);
+				if (glm::dot(n, dir) > 0.0f)
+					n = -n;
+				glm::vec3 p = origin + dir * hit.t + n * RAY_BIAS;
+				radiance += albedo[hit.triangle] * (sun.ambient + DirectLight(p, n));
+			}
+			float ao = (float)open / count;
+			glm::vec3 ambient = radiance / (float)count;
+			for (const LightSource& source : lights)
+				ambient += source.light.ambient * Attenuation(source.light, glm::distance(s.position, source.light.position)) * ao;
+			*s.out = glm::vec4(ambient, ao);
+		}
+	};
+}
+
+#endif // !LIGHTBAKER_H
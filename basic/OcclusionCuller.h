@@ -0,0 +1,232 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <glm/glm.hpp>
+
+#include <Bounds.h>
+#include <ThreadPool.h>
+
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KOONAN_OCCLUSION_SSE
+#endif
+
+namespace KooNan
+{
+	// CPU occlusion culler.
+	// Occluder triangles are rasterized into a small depth buffer (nearest depth wins,
+	// so the result does not depend on submission or thread order), then the screen
+	// rectangle of each occludee box is tested against it. Needs no GL context.
+	// Coverage is inner conservative: a triangle only writes the pixels it covers
+	// entirely, with its farthest depth over the pixel, so a gap narrower than a
+	// pixel of this buffer never hides what is seen through it.
+	class OcclusionCuller
+	{
+	public:
+		static const int BUFFER_WIDTH = 256; // must be a multiple of 4
+		static const int BUFFER_HEIGHT = 128;
+		static const int BAND_HEIGHT = 8; // rows rasterized by one task
+	private:
+		struct ScreenTriangle
+		{
+			glm::vec2 v0, v1, v2;
+			float zA, zB, zC; // depth plane: z = zA * x + zB * y + zC
+			int minX, maxX, minY, maxY;
+		};
+		glm::mat4 viewProjection;
+		std::vector<glm::vec3> occluderVertices; // world space, three per triangle
+		std::vector<ScreenTriangle> triangles;
+		std::vector<float> depth;
+	public:
+		OcclusionCuller() : viewProjection(1.0f), depth(BUFFER_WIDTH * BUFFER_HEIGHT, 1.0f) {}
+
+		// Begin: start a new frame
+		//   viewProjection: projection * view of the camera the buffer is built for
+		void Begin(const glm::mat4& viewProjection)
+		{
+			this->viewProjection = viewProjection;
+			occluderVertices.clear();
+			triangles.clear();
+		}
+
+		// AddOccluder: queue the triangles of an occluder
+		//   localTriangles: three vertices per triangle, in model space
+		//   modelMat: model matrix of the occluder
+		void AddOccluder(const std::vector<glm::vec3>& localTriangles, const glm::mat4& modelMat)
+		{
+			for (const glm::vec3& v : localTriangles)
+				occluderVertices.push_back(glm::vec3(modelMat * glm::vec4(v, 1.0f)));
+		}
+
+		// Rasterize: fill the depth buffer with all queued occluders
+		void Rasterize()
+		{
+			SetupTriangles();
+			std::fill(depth.begin(), depth.end(), 1.0f);
+			int bands = (BUFFER_HEIGHT + BAND_HEIGHT - 1) / BAND_HEIGHT;
+			ThreadPool::Instance().ParallelFor(bands, [this](int band) {
+				int y0 = band * BAND_HEIGHT;
+				int y1 = std::min(y0 + BAND_HEIGHT, (int)BUFFER_HEIGHT);
+				for (const ScreenTriangle& tri : triangles)
+					if (tri.maxY >= y0 && tri.minY < y1)
+						RasterizeTriangle(tri, std::max(tri.minY, y0), std::min(tri.maxY, y1 - 1));
+			});
+		}
+
+		// IsVisible: whether any part of the box may be in front of the occluders
+		bool IsVisible(const AABB& box) const
+		{
+			float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+			for (int i = 0; i < 8; i++)
+			{
+				glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+				glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+				if (clip.w <= 1e-4f)
+					return true; // crosses the camera plane
+				glm::vec3 s = ToScreen(clip);
+				minX = std::min(minX, s.x); maxX = std::max(maxX, s.x);
+				minY = std::min(minY, s.y); maxY = std::max(maxY, s.y);
+				minZ = std::min(minZ, s.z);
+			}
+			if (minZ < 0.0f)
+				return true;
+			int x0 = std::max((int)floor(minX), 0), x1 = std::min((int)floor(maxX), BUFFER_WIDTH - 1);
+			int y0 = std::max((int)floor(minY), 0), y1 = std::min((int)floor(maxY), BUFFER_HEIGHT - 1);
+			for (int y = y0; y <= y1; y++)
+				for (int x = x0; x <= x1; x++)
+					if (depth[y * BUFFER_WIDTH + x] >= minZ)
+						return true;
+			return false;
+		}
+
+		size_t NumTriangles() const
+		{
+			return triangles.size();
+		}
+		// GetDepth: depth buffer in [0, 1], row major from the bottom row
+		const std::vector<float>& GetDepth() const
+		{
+			return depth;
+		}
+
+	private:
+		glm::vec3 ToScreen(const glm::vec4& clip) const
+		{
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			return glm::vec3((ndc.x * 0.5f + 0.5f) * BUFFER_WIDTH, (ndc.y * 0.5f + 0.5f) * BUFFER_HEIGHT, ndc.z * 0.5f + 0.5f);
+		}
+
+		void SetupTriangles()
+		{
+			size_t n = occluderVertices.size() / 3;
+			std::vector<ScreenTriangle> setup(n);
+			std::vector<char> valid(n, 0);
+			int chunks = (int)((n + 255) / 256);
+			ThreadPool::Instance().ParallelFor(chunks, [&](int chunk) {
+				size_t end = std::min(n, (size_t)(chunk + 1) * 256);
+				for (size_t i = (size_t)chunk * 256; i < end; i++)
+					valid[i] = SetupTriangle(&occluderVertices[3 * i], setup[i]);
+			});
+			// compact in submission order so the result stays deterministic
+			triangles.clear();
+			for (size_t i = 0; i < n; i++)
+				if (valid[i])
+					triangles.push_back(setup[i]);
+		}
+
+		bool SetupTriangle(const glm::vec3* v, ScreenTriangle& tri) const
+		{
+			glm::vec3 s[3];
+			for (int k = 0; k < 3; k++)
+			{
+				glm::vec4 clip = viewProjection * glm::vec4(v[k], 1.0f);
+				if (clip.w <= 1e-4f)
+					return false; // dropping an occluder is always conservative
+				s[k] = ToScreen(clip);
+			}
+			float area = (s[1].x - s[0].x) * (s[2].y - s[0].y) - (s[2].x - s[0].x) * (s[1].y - s[0].y);
+			if (fabs(area) < 1e-6f)
+				return false;
+			if (area < 0.0f)
+				std::swap(s[1], s[2]); // counter clockwise from here on
+			tri.v0 = glm::vec2(s[0]); tri.v1 = glm::vec2(s[1]); tri.v2 = glm::vec2(s[2]);
+			// solve the depth plane through the three vertices
+			glm::vec3 e1 = s[1] - s[0], e2 = s[2] - s[0];
+			glm::vec3 n = glm::cross(e1, e2);
+			tri.zA = -n.x / n.z;
+			tri.zB = -n.y / n.z;
+			tri.zC = s[0].z - tri.zA * s[0].x - tri.zB * s[0].y;
+			float minX = std::min(s[0].x, std::min(s[1].x, s[2].x)), maxX = std::max(s[0].x, std::max(s[1].x, s[2].x));
+			float minY = std::min(s[0].y, std::min(s[1].y, s[2].y)), maxY = std::max(s[0].y, std::max(s[1].y, s[2].y));
+			tri.minX = std::max((int)floor(minX), 0);
+			tri.maxX = std::min((int)ceil(maxX), BUFFER_WIDTH - 1);
+			tri.minY = std::max((int)floor(minY), 0);
+			tri.maxY = std::min((int)ceil(maxY), BUFFER_HEIGHT - 1);
+			return tri.minX <= tri.maxX && tri.minY <= tri.maxY;
+		}
+
+		// edge function of (a, b) at p, positive on the left side
+		static float Edge(const glm::vec2& a, const glm::vec2& b, float px, float py)
+		{
+			return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+		}
+
+		void RasterizeTriangle(const ScreenTriangle& tri, int y0, int y1)
+		{
+			// per pixel steps of the three edge functions
+			float dx0 = -(tri.v2.y - tri.v1.y), dx1 = -(tri.v0.y - tri.v2.y), dx2 = -(tri.v1.y - tri.v0.y);
+			float dy0 = tri.v2.x - tri.v1.x, dy1 = tri.v0.x - tri.v2.x, dy2 = tri.v1.x - tri.v0.x;
+			// the edge functions and the depth are taken at the worst corner of the pixel instead of its center:
+			// an edge moves in by half a pixel along each axis, the depth moves to its farthest value
+			float inset0 = 0.5f * (fabs(dx0) + fabs(dy0));
+			float inset1 = 0.5f * (fabs(dx1) + fabs(dy1));
+			float inset2 = 0.5f * (fabs(dx2) + fabs(dy2));
+			float zFar = 0.5f * (fabs(tri.zA) + fabs(tri.zB));
+			int xStart = tri.minX & ~3;
+			for (int y = y0; y <= y1; y++)
+			{
+				float py = y + 0.5f, px = xStart + 0.5f;
+				float w0 = Edge(tri.v1, tri.v2, px, py) - inset0;
+				float w1 = Edge(tri.v2, tri.v0, px, py) - inset1;
+				float w2 = Edge(tri.v0, tri.v1, px, py) - inset2;
+				float z = tri.zA * px + tri.zB * py + tri.zC + zFar;
+				float* row = &depth[y * BUFFER_WIDTH];
+#ifdef KOONAN_OCCLUSION_SSE
+				__m128 ramp = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+				__m128 vw0 = _mm_add_ps(_mm_set1_ps(w0), _mm_mul_ps(ramp, _mm_set1_ps(dx0)));
+				__m128 vw1 = _mm_add_ps(_mm_set1_ps(w1), _mm_mul_ps(ramp, _mm_set1_ps(dx1)));
+				__m128 vw2 = _mm_add_ps(_mm_set1_ps(w2), _mm_mul_ps(ramp, _mm_set1_ps(dx2)));
+				__m128 vz = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(ramp, _mm_set1_ps(tri.zA)));
+				__m128 step0 = _mm_set1_ps(4.0f * dx0), step1 = _mm_set1_ps(4.0f * dx1), step2 = _mm_set1_ps(4.0f * dx2);
+				__m128 stepZ = _mm_set1_ps(4.0f * tri.zA);
+				__m128 zero = _mm_setzero_ps();
+				for (int x = xStart; x <= tri.maxX; x += 4)
+				{
+					__m128 inside = _mm_and_ps(_mm_cmpge_ps(vw0, zero), _mm_and_ps(_mm_cmpge_ps(vw1, zero), _mm_cmpge_ps(vw2, zero)));
+					if (_mm_movemask_ps(inside))
+					{
+						__m128 old = _mm_loadu_ps(row + x);
+						__m128 nearest = _mm_min_ps(old, vz);
+						_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+					}
+					vw0 = _mm_add_ps(vw0, step0); vw1 = _mm_add_ps(vw1, step1); vw2 = _mm_add_ps(vw2, step2);
+					vz = _mm_add_ps(vz, stepZ);
+				}
+#else
+				for (int x = xStart; x <= tri.maxX; x++)
+				{
+					if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f && z < row[x])
+						row[x] = z;
+					w0 += dx0; w1 += dx1; w2 += dx2;
+					z += tri.zA;
+				}
+#endif
+			}
+		}
+	};
+}
+
+#endif // !OCCLUSIONCULLER_H
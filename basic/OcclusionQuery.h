@@ -0,0 +1,196 @@
+#ifndef OCCLUSIONQUERY_H
+#define OCCLUSIONQUERY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <Shader.h>
+#include <Bounds.h>
+#include <RenderSettings.h>
+#include <RenderStats.h>
+
+#include <unordered_map>
+#include <functional>
+
+namespace KooNan
+{
+	// Temporally coherent hardware occlusion queries for heavy objects (after CHC++).
+	// Objects visible last frame are drawn directly and re-queried every few frames;
+	// objects hidden last frame only cost a bounding box draw. Results are read one
+	// or more frames later, never waited for.
+	class HardwareOcclusion
+	{
+	private:
+		struct QueryState
+		{
+			unsigned int query;
+			bool pending;
+			bool visible;
+			unsigned int lastQueried;
+			unsigned int lastSeen;
+		};
+		std::unordered_map<const void*, QueryState> states;
+		unsigned int frameIndex;
+		unsigned int boxVAO, boxVBO;
+	public:
+		static const unsigned int REQUERY_INTERVAL = 4; // frames between queries of a visible object
+		static const unsigned int FORGET_AFTER = 120; // frames after which an unseen object's query is released
+
+		HardwareOcclusion() : frameIndex(0)
+		{
+			// unit cube, 36 vertices
+			float v[] = {
+				0,0,0, 1,0,0, 1,1,0, 1,1,0, 0,1,0, 0,0,0,
+				0,0,1, 1,1,1, 1,0,1, 1,1,1, 0,0,1, 0,1,1,
+				0,0,0, 0,1,0, 0,1,1, 0,1,1, 0,0,1, 0,0,0,
+				1,0,0, 1,0,1, 1,1,1, 1,1,1, 1,1,0, 1,0,0,
+				0,0,0, 0,0,1, 1,0,1, 1,0,1, 1,0,0, 0,0,0,
+				0,1,0, 1,1,0, 1,1,1, 1,1,1, 0,1,1, 0,1,0
+			};
+			glGenVertexArrays(1, &boxVAO);
+			glGenBuffers(1, &boxVBO);
+			glBindVertexArray(boxVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(v), v, GL_STATIC_DRAW);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+			glBindVertexArray(0);
+		}
+		// cleanUp: release the GL objects, call before the context is destroyed
+		void cleanUp()
+		{
+			for (auto& it : states)
+				glDeleteQueries(1, &it.second.query);
+			glDeleteBuffers(1, &boxVBO);
+			glDeleteVertexArrays(1, &boxVAO);
+			states.clear();
+		}
+
+		// BeginFrame: advance the frame counter and release queries of objects gone for a while
+		void BeginFrame()
+		{
+			frameIndex++;
+			for (auto it = states.begin(); it != states.end();)
+			{
+				if (frameIndex - it->second.lastSeen > FORGET_AFTER)
+				{
+					glDeleteQueries(1, &it->second.query);
+					it = states.erase(it);
+				}
+				else
+					++it;
+			}
+		}
+
+		// Draw: draw an object through the query state machine
+		//   key: identity of the object
+		//   box: world bounds of the object
+		//   cameraInside: the camera is inside box, the object is then always drawn
+		//   draw: draws the object itself
+		//   boxShader: position only shader with model/view/projection uniforms
+		void Draw(const void* key, const AABB& box, bool cameraInside, OcclusionQueryMode mode,
+			const std::function<void()>& draw, Shader& boxShader, const glm::mat4& projection, const glm::mat4& view)
+		{
+			QueryState& s = GetState(key);
+			s.lastSeen = frameIndex;
+			CollectResult(s);
+			if (cameraInside)
+				s.visible = true;
+
+			if (s.visible)
+			{
+				RenderStats::heavyDrawn++;
+				if (!s.pending && frameIndex - s.lastQueried >= REQUERY_INTERVAL)
+				{
+					// the object's own draw doubles as the query
+					glBeginQuery(GL_ANY_SAMPLES_PASSED, s.query);
+					draw();
+					glEndQuery(GL_ANY_SAMPLES_PASSED);
+					Issued(s);
+				}
+				else
+					draw();
+				return;
+			}
+
+			if (!s.pending)
+			{
+				DrawBox(s, box, boxShader, projection, view);
+				Issued(s);
+			}
+			if (mode == OcclusionQueryMode::ConditionalRender)
+			{
+				glBeginConditionalRender(s.query, GL_QUERY_NO_WAIT);
+				draw();
+				glEndConditionalRender();
+				RenderStats::heavyConditional++;
+			}
+			else
+				RenderStats::heavySkipped++;
+		}
+
+	private:
+		QueryState& GetState(const void* key)
+		{
+			auto it = states.find(key);
+			if (it != states.end())
+				return it->second;
+			QueryState s;
+			glGenQueries(1, &s.query);
+			s.pending = false;
+			s.visible = true;
+			s.lastQueried = 0;
+			s.lastSeen = frameIndex;
+			return states[key] = s;
+		}
+
+		void CollectResult(QueryState& s)
+		{
+			if (!s.pending)
+				return;
+			GLint available = 0;
+			glGetQueryObjectiv(s.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				return;
+			GLuint anySamples = 0;
+			glGetQueryObjectuiv(s.query, GL_QUERY_RESULT, &anySamples);
+			s.pending = false;
+			s.visible = anySamples != 0;
+			RenderStats::queryResults++;
+			if (!s.visible)
+				RenderStats::queryOccluded++;
+		}
+
+		void Issued(QueryState& s)
+		{
+			s.pending = true;
+			s.lastQueried = frameIndex;
+			RenderStats::queriesIssued++;
+		}
+
+		void DrawBox(QueryState& s, const AABB& box, Shader& boxShader, const glm::mat4& projection, const glm::mat4& view)
+		{
+			glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), box.min), box.max - box.min);
+			boxShader.use();
+			boxShader.setMat4("projection", projection);
+			boxShader.setMat4("view", view);
+			boxShader.setMat4("model", model);
+			GLboolean cull = glIsEnabled(GL_CULL_FACE);
+			glDisable(GL_CULL_FACE);
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			glDepthMask(GL_FALSE);
+			glBeginQuery(GL_ANY_SAMPLES_PASSED, s.query);
+			glBindVertexArray(boxVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 36);
+			glBindVertexArray(0);
+			glEndQuery(GL_ANY_SAMPLES_PASSED);
+			glDepthMask(GL_TRUE);
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			if (cull)
+				glEnable(GL_CULL_FACE);
+		}
+	};
+}
+
+#endif // !OCCLUSIONQUERY_H
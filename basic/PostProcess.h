@@ -0,0 +1,179 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <common.h>
+#include <Shader.h>
+#include <GpuTimer.h>
+#include <RenderSettings.h>
+#include <RenderStats.h>
+
+namespace KooNan
+{
+	// From the HDR scene to the window. The bloom chain halves the size level by level, the
+	// first level being half the window (landscape/bloom_downsample.fs), then walks back up
+	// adding each level onto the one above (landscape/bloom_upsample.fs). landscape/tonemap.fs
+	// adds the top level to the scene, exposes, tonemaps, grades and dithers in one pass.
+	class PostProcess
+	{
+	public:
+		static const int MAX_LEVELS = 8;
+	private:
+		unsigned int frameBuffers[MAX_LEVELS];
+		unsigned int textures[MAX_LEVELS]; // R11G11B10F
+		int widths[MAX_LEVELS], heights[MAX_LEVELS];
+		int levels; // allocated for the current window
+		unsigned int emptyVAO;
+		unsigned int frame;
+		Shader downsampleShader;
+		Shader upsampleShader;
+		Shader tonemapShader;
+		GpuTimer downsampleTimer, upsampleTimer, tonemapTimer;
+	public:
+		PostProcess() : levels(0), frame(0),
+			downsampleShader("landscape/fullscreen.vs", "landscape/bloom_downsample.fs"),
+			upsampleShader("landscape/fullscreen.vs", "landscape/bloom_upsample.fs"),
+			tonemapShader("landscape/fullscreen.vs", "landscape/tonemap.fs")
+		{
+			glGenFramebuffers(MAX_LEVELS, frameBuffers);
+			glGenTextures(MAX_LEVELS, textures);
+			for (int i = 0; i < MAX_LEVELS; i++)
+				widths[i] = heights[i] = 0;
+			glGenVertexArrays(1, &emptyVAO);
+		}
+		void cleanUp()
+		{
+			glDeleteFramebuffers(MAX_LEVELS, frameBuffers);
+			glDeleteTextures(MAX_LEVELS, textures);
+			glDeleteVertexArrays(1, &emptyVAO);
+			downsampleTimer.cleanUp();
+			upsampleTimer.cleanUp();
+			tonemapTimer.cleanUp();
+		}
+
+		// Apply: bloom and tonemap the scene into the window or an 8 bit target, leaves the target bound
+		//   sceneColor: the HDR main pass, the size of the window
+		//   target: framebuffer the size of the window, 0 for the window itself
+		void Apply(unsigned int sceneColor, unsigned int target = 0)
+		{
+			GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST), blend = glIsEnabled(GL_BLEND), clip = glIsEnabled(GL_CLIP_DISTANCE0);
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
+			glDisable(GL_CLIP_DISTANCE0);
+			glBindVertexArray(emptyVAO);
+			glActiveTexture(GL_TEXTURE0);
+			frame++;
+
+			bool bloom = RenderSettings::bloom && fitToWindow() > 0;
+			if (bloom)
+			{
+				downsampleTimer.Begin();
+				Downsample(sceneColor);
+				downsampleTimer.End();
+				upsampleTimer.Begin();
+				Upsample();
+				upsampleTimer.End();
+			}
+			RenderStats::bloomDownGpuMs = bloom ? downsampleTimer.Milliseconds() : 0.0f;
+			RenderStats::bloomUpGpuMs = bloom ? upsampleTimer.Milliseconds() : 0.0f;
+
+			tonemapTimer.Begin();
+			glBindFramebuffer(GL_FRAMEBUFFER, target);
+			glViewport(0, 0, Common::SCR_WIDTH, Common::SCR_HEIGHT);
+			tonemapShader.use();
+			tonemapShader.setInt("scene", 0);
+			tonemapShader.setInt("bloomMap", 1);
+			tonemapShader.setInt("bloom", bloom ? 1 : 0);
+			tonemapShader.setFloat("bloomIntensity", RenderSettings::bloomIntensity);
+			tonemapShader.setFloat("exposure", RenderSettings::exposure);
+			tonemapShader.setFloat("contrast", RenderSettings::contrast);
+			tonemapShader.setFloat("saturation", RenderSettings::saturation);
+			tonemapShader.setInt("dither", RenderSettings::dither ? 1 : 0);
+			tonemapShader.setFloat("frameNoise", (float)(frame % 64) * 5.588238f);
+			glBindTexture(GL_TEXTURE_2D, sceneColor);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, textures[0]);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glActiveTexture(GL_TEXTURE0);
+			tonemapTimer.End();
+			RenderStats::tonemapGpuMs = tonemapTimer.Milliseconds();
+
+			glBindVertexArray(0);
+			if (depthTest) glEnable(GL_DEPTH_TEST);
+			if (blend) glEnable(GL_BLEND);
+			if (clip) glEnable(GL_CLIP_DISTANCE0);
+		}
+
+	private:
+		void Downsample(unsigned int sceneColor)
+		{
+			downsampleShader.use();
+			downsampleShader.setInt("source", 0);
+			downsampleShader.setFloat("threshold", RenderSettings::bloomThreshold);
+			downsampleShader.setFloat("knee", RenderSettings::bloomKnee);
+			for (int i = 0; i < levels; i++)
+			{
+				glBindFramebuffer(GL_FRAMEBUFFER, frameBuffers[i]);
+				glViewport(0, 0, widths[i], heights[i]);
+				glm::vec2 sourceSize = i == 0 ? glm::vec2(Common::SCR_WIDTH, Common::SCR_HEIGHT) : glm::vec2(widths[i - 1], heights[i - 1]);
+				downsampleShader.setVec2("sourceTexel", 1.0f / sourceSize);
+				downsampleShader.setInt("prefilter", i == 0 ? 1 : 0);
+				glBindTexture(GL_TEXTURE_2D, i == 0 ? sceneColor : textures[i - 1]);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+			}
+		}
+		void Upsample()
+		{
+			upsampleShader.use();
+			upsampleShader.setInt("source", 0);
+			upsampleShader.setFloat("radius", RenderSettings::bloomRadius);
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_ONE, GL_ONE);
+			for (int i = levels - 1; i > 0; i--)
+			{
+				glBindFramebuffer(GL_FRAMEBUFFER, frameBuffers[i - 1]);
+				glViewport(0, 0, widths[i - 1], heights[i - 1]);
+				upsampleShader.setVec2("sourceTexel", 1.0f / glm::vec2(widths[i], heights[i]));
+				glBindTexture(GL_TEXTURE_2D, textures[i]);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+			}
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glDisable(GL_BLEND);
+		}
+
+		// fitToWindow: the chain for the window size and RenderSettings::bloomLevels, stops at 2 texels
+		//   return: levels in use
+		int fitToWindow()
+		{
+			int wanted = glm::clamp(RenderSettings::bloomLevels, 1, MAX_LEVELS);
+			int w = ((int)Common::SCR_WIDTH + 1) / 2, h = ((int)Common::SCR_HEIGHT + 1) / 2;
+			int count = 0;
+			for (; count < wanted && w >= 2 && h >= 2; count++)
+			{
+				if (widths[count] != w || heights[count] != h)
+				{
+					widths[count] = w;
+					heights[count] = h;
+					glBindTexture(GL_TEXTURE_2D, textures[count]);
+					glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, w, h, 0, GL_RGB, GL_FLOAT, (void*)nullptr);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+					glBindFramebuffer(GL_FRAMEBUFFER, frameBuffers[count]);
+					glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textures[count], 0);
+					glDrawBuffer(GL_COLOR_ATTACHMENT0);
+				}
+				w = (w + 1) / 2;
+				h = (h + 1) / 2;
+			}
+			glBindTexture(GL_TEXTURE_2D, 0);
+			levels = count;
+			return levels;
+		}
+	};
+}
+
+#endif // !POST_PROCESS_H
@@ -0,0 +1,291 @@
+#ifndef REFLECTION_PROBES_H
+#define REFLECTION_PROBES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common.h>
+#include <Shader.h>
+#include <scene.h>
+#include <shadow.h>
+#include <GameObject.h>
+#include <RenderSettings.h>
+
+#include <vector>
+#include <functional>
+
+namespace KooNan
+{
+	// Prefiltered environment cube maps for the specular of model.fs. Each placed probe
+	// captures the static scene around it once, again when a static object in its radius
+	// changes, and convolves
+	// the capture into a mip chain of rising roughness (landscape/probe_prefilter.fs). The
+	// sky gets a probe of its own for the objects outside all probes. GL 3.3 has no cube
+	// map arrays, so each probe is its own cube map and every object binds the one nearest
+	// to it before it is drawn.
+	class ReflectionProbes
+	{
+	public:
+		static const int LEVELS = 6; // mips of each probe, roughness rises linearly from 0 at mip 0
+		// draws the scene into the bound cube face for projection, view and the view position
+		typedef std::function<void(const glm::mat4&, const glm::mat4&, const glm::vec3&)> DrawFunc;
+	private:
+		struct Probe
+		{
+			glm::vec3 position;
+			float radius;
+			unsigned int cubeMap;
+			bool valid; // cubeMap shows the scene around position
+		};
+		std::vector<Probe> probes; // follows Scene::reflectionProbes
+		Probe sky; // valid while the skybox does not change
+		unsigned int captureFrameBuffer;
+		unsigned int captureDepth;
+		unsigned int captureCube; // source of the prefiltering, mipmapped
+		unsigned int emptyVAO;
+		int size; // face size of all cube maps
+		Shader prefilterShader;
+	public:
+		ReflectionProbes() : captureCube(0), size(0),
+			prefilterShader("landscape/fullscreen.vs", "landscape/probe_prefilter.fs")
+		{
+			glGenFramebuffers(1, &captureFrameBuffer);
+			glGenRenderbuffers(1, &captureDepth);
+			glGenVertexArrays(1, &emptyVAO);
+			// the rough mips are a few texels wide, filtering across the face edges hides the seams
+			glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+			sky.position = glm::vec3(0.0f);
+			sky.radius = 0.0f;
+			sky.cubeMap = 0;
+			sky.valid = false;
+		}
+		void cleanUp()
+		{
+			for (Probe& probe : probes)
+				glDeleteTextures(1, &probe.cubeMap);
+			probes.clear();
+			glDeleteTextures(1, &sky.cubeMap);
+			glDeleteTextures(1, &captureCube);
+			glDeleteRenderbuffers(1, &captureDepth);
+			glDeleteFramebuffers(1, &captureFrameBuffer);
+			glDeleteVertexArrays(1, &emptyVAO);
+		}
+
+		// Update: follow the placements and capture the probes that are out of date, at most
+		// RenderSettings::reflectionProbeUpdates per call; the sky probe comes first
+		//   drawSky: the skybox alone
+		//   drawScene: the static scene
+		//   return: number of probes captured
+		unsigned int Update(const std::vector<ReflectionProbe>& placements, DrawFunc drawSky, DrawFunc drawScene)
+		{
+			if (size != RenderSettings::reflectionProbeSize)
+				Resize(RenderSettings::reflectionProbeSize);
+			while (probes.size() > placements.size())
+			{
+				glDeleteTextures(1, &probes.back().cubeMap);
+				probes.pop_back();
+			}
+			for (size_t i = 0; i < placements.size(); i++)
+			{
+				if (i == probes.size())
+				{
+					Probe probe;
+					probe.cubeMap = CreateCubeMap();
+					probe.valid = false;
+					probes.push_back(probe);
+				}
+				Probe& probe = probes[i];
+				if (probe.position != placements[i].position)
+					probe.valid = false;
+				probe.position = placements[i].position;
+				probe.radius = placements[i].radius;
+			}
+
+			unsigned int captured = 0;
+			if (!sky.valid)
+			{
+				Capture(sky, drawSky);
+				captured++;
+			}
+			for (Probe& probe : probes)
+			{
+				if (captured >= (unsigned int)RenderSettings::reflectionProbeUpdates)
+					break;
+				if (!probe.valid)
+				{
+					Capture(probe, drawScene);
+					captured++;
+				}
+			}
+			return captured;
+		}
+
+		// Invalidate: capture all placed probes again, e.g. after terrain edits
+		void Invalidate()
+		{
+			for (Probe& probe : probes)
+				probe.valid = false;
+		}
+		// InvalidateRegions: capture again the probes whose radius touches a changed world box
+		//   regions: GameObject::changedRegions, only static objects add to it after they are placed
+		void InvalidateRegions(const std::vector<AABB>& regions)
+		{
+			for (Probe& probe : probes)
+				for (const AABB& region : regions)
+					if (IntersectSphere(probe.position, probe.radius, region))
+					{
+						probe.valid = false;
+						break;
+					}
+		}
+		// InvalidateSky: the skybox changed, so did every probe that sees it
+		void InvalidateSky()
+		{
+			sky.valid = false;
+			Invalidate();
+		}
+
+		// Bind: the probe for an object centered at point, for ProbeReflection in model.fs;
+		// the nearest captured probe whose radius holds point, otherwise the sky
+		void Bind(Shader& shader, int unit, const glm::vec3& point)
+		{
+			const Probe* best = &sky;
+			float bestDistance = 0.0f;
+			for (const Probe& probe : probes)
+			{
+				float distance = glm::length(point - probe.position);
+				if (probe.valid && distance < probe.radius && (best == &sky || distance < bestDistance))
+				{
+					best = &probe;
+					bestDistance = distance;
+				}
+			}
+			shader.use();
+			shader.setInt("reflectionProbeMap", unit);
+			shader.setInt("reflectionProbe", sky.valid ? 1 : 0);
+			shader.setFloat("reflectionProbeLod", RenderSettings::reflectionProbeRoughness * (LEVELS - 1));
+			shader.setFloat("reflectionProbeStrength", RenderSettings::reflectionProbeStrength);
+			glActiveTexture(GL_TEXTURE0 + unit);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, best->cubeMap);
+			glActiveTexture(GL_TEXTURE0);
+		}
+		// Unbind: no probe reflection, e.g. while capturing or with the probes off
+		static void Unbind(Shader& shader)
+		{
+			shader.use();
+			shader.setInt("reflectionProbe", 0);
+		}
+
+		unsigned int NumProbes() const
+		{
+			return (unsigned int)probes.size();
+		}
+
+	private:
+		// Capture: draw the six faces around the probe and prefilter them into its mips
+		void Capture(Probe& probe, DrawFunc draw)
+		{
+			GLboolean clip = glIsEnabled(GL_CLIP_DISTANCE0), blend = glIsEnabled(GL_BLEND);
+			glDisable(GL_CLIP_DISTANCE0);
+			glDisable(GL_BLEND);
+			glEnable(GL_DEPTH_TEST);
+			glBindFramebuffer(GL_FRAMEBUFFER, captureFrameBuffer);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureDepth);
+			glViewport(0, 0, size, size);
+			glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f,
+				Common::perspective_clipping_near, Common::perspective_clipping_far);
+			for (int face = 0; face < 6; face++)
+			{
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, captureCube, 0);
+				glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				draw(projection, PointShadowAtlas::FaceView(probe.position, face), probe.position);
+			}
+			glBindTexture(GL_TEXTURE_CUBE_MAP, captureCube);
+			glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+			glDisable(GL_DEPTH_TEST);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, 0);
+			prefilterShader.use();
+			prefilterShader.setInt("environment", 0);
+			prefilterShader.setFloat("environmentSize", (float)size);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, captureCube);
+			glBindVertexArray(emptyVAO);
+			for (int level = 0; level < LEVELS; level++)
+			{
+				int levelSize = glm::max(size >> level, 1);
+				glViewport(0, 0, levelSize, levelSize);
+				prefilterShader.setFloat("roughness", (float)level / (LEVELS - 1));
+				for (int face = 0; face < 6; face++)
+				{
+					glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, probe.cubeMap, level);
+					prefilterShader.setInt("face", face);
+					glDrawArrays(GL_TRIANGLES, 0, 3);
+				}
+			}
+			glBindVertexArray(0);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+			if (clip) glEnable(GL_CLIP_DISTANCE0);
+			if (blend) glEnable(GL_BLEND);
+			glEnable(GL_DEPTH_TEST);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, Common::SCR_WIDTH, Common::SCR_HEIGHT);
+			probe.valid = true;
+		}
+
+		// Resize: new cube maps of the face size, all probes are captured again
+		void Resize(int newSize)
+		{
+			size = newSize;
+			glDeleteTextures(1, &captureCube);
+			glGenTextures(1, &captureCube);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, captureCube);
+			for (int face = 0; face < 6; face++)
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB16F, size, size, 0, GL_RGB, GL_FLOAT, NULL);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			glBindRenderbuffer(GL_RENDERBUFFER, captureDepth);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+			glBindRenderbuffer(GL_RENDERBUFFER, 0);
+			for (Probe& probe : probes)
+			{
+				glDeleteTextures(1, &probe.cubeMap);
+				probe.cubeMap = CreateCubeMap();
+			}
+			glDeleteTextures(1, &sky.cubeMap);
+			sky.cubeMap = CreateCubeMap();
+			InvalidateSky();
+		}
+
+		// CreateCubeMap: storage for the LEVELS mips of a probe
+		unsigned int CreateCubeMap()
+		{
+			unsigned int cubeMap;
+			glGenTextures(1, &cubeMap);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMap);
+			for (int level = 0; level < LEVELS; level++)
+			{
+				int levelSize = glm::max(size >> level, 1);
+				for (int face = 0; face < 6; face++)
+					glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB16F, levelSize, levelSize, 0, GL_RGB, GL_FLOAT, NULL);
+			}
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, LEVELS - 1);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+			return cubeMap;
+		}
+	};
+}
+
+#endif // !REFLECTION_PROBES_H
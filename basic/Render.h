@@ -10,6 +10,23 @@
 #include <vector>
 #include <shadow.h>
 #include <GameController.h>
+#include <OcclusionCuller.h>
+#include <OcclusionQuery.h>
+#include <GpuTimer.h>
+#include <SceneFrameBuffer.h>
+#include <ScreenSpaceReflection.h>
+#include <Impostor.h>
+#include <EvsmFilter.h>
+#include <BakedLighting.h>
+#include <AmbientOcclusion.h>
+#include <ReflectionProbes.h>
+#include <PostProcess.h>
+#include <AntiAliasing.h>
+#include <VolumetricFog.h>
+#include <RenderSettings.h>
+#include <RenderStats.h>
+#include <algorithm>
+#include <unordered_map>
 
 namespace KooNan
 {
@@ -21,79 +38,138 @@ namespace KooNan
 		Water_Frame_Buffer& waterfb;
 		PickingTexture& mouse_picking;
 		Shadow_Frame_Buffer& shadowfb;
+		std::vector<GameObject*> pickedObjs; // objIndex - 1 of the picking pass -> object
+		OcclusionCuller occlusionCuller;
+		HardwareOcclusion hardwareOcclusion;
+		ImpostorRenderer impostors;
+		GpuTimer passTimers[(int)RenderPass::Count];
+		Scene_Frame_Buffer sceneFb; // main pass target while an effect reads the scene back
+		ScreenSpaceReflection ssr;
+		Shader layeredShader; // model.fs behind a geometry shader writing gl_Layer
+		PointShadowAtlas pointShadows;
+		EvsmFilter evsm; // prefiltered copy of the cascades, RenderSettings::shadowFilter
+		Shader pointShadowShader; // model.vs writing the distance to the light as depth
+		BakedLighting bakedLighting; // --bake-lighting results for the saved scene
+		AmbientOcclusion ambientOcclusion; // of the main pass, RenderSettings::ssao
+		ReflectionProbes reflectionProbes; // environment of the model specular, RenderSettings::reflectionProbes
+		PostProcess postProcess; // bloom and tonemapping of sceneFb, RenderSettings::hdr
+		AntiAliasing antiAliasing; // of the finished frame, RenderSettings::antiAliasing
+		VolumetricFog volumetricFog; // over sceneFb, RenderSettings::volumetricFog
+		// view the reflection texture was last drawn from
+		struct ReflectionView
+		{
+			glm::vec3 position, front;
+			float zoom, waterHeight;
+			unsigned int width, height, sceneVersion;
+			unsigned int age; // frames since it was drawn
+			bool valid;
+		};
+		// water surfaces at one height share a reflection and a refraction
+		struct WaterLevel
+		{
+			float height;
+			Water_Frame_Buffer* targets; // the lowest level draws into waterfb, the others own theirs
+			// visibility of the level in the main pass, read back one or more frames later
+			unsigned int query;
+			bool queryPending;
+			bool visible;
+			bool texturesValid; // the reflection and refraction passes ran at least once
+			bool planar; // large enough on screen for its own passes, otherwise it reflects the skybox
+			bool refractionDrawn; // DrawReflection already filled the refraction target this frame
+			ReflectionView reflectionView;
+		};
+		std::vector<WaterLevel> waterLevels; // ascending height, follows Scene::getWaterLevels
+		bool timeOfDayShown; // RenderSettings::timeOfDay when the probes last saw the sky
+		glm::vec3 probeSunDirection; // towards the sun when the probes last saw the sky
 	public:
 		Render(Scene& main_scene, Light& main_light, Water_Frame_Buffer& waterfb, PickingTexture& mouse_picking, Shadow_Frame_Buffer& shadowfb):
-			main_scene(main_scene), main_light(main_light),waterfb(waterfb), mouse_picking(mouse_picking),shadowfb(shadowfb)
+			main_scene(main_scene), main_light(main_light),waterfb(waterfb), mouse_picking(mouse_picking),shadowfb(shadowfb),
+			layeredShader("model/model_layered.vs", "model/model.fs", "model/model_layered.gs"),
+			pointShadowShader("model/model.vs", "landscape/point_shadow.fs"),
+			timeOfDayShown(false), probeSunDirection(0.0f)
 		{
 			main_scene.TerrainShader.use();
 			main_light.SetLight(main_scene.TerrainShader);
 
 			main_scene.WaterShader.use();
 			main_light.SetLight(main_scene.WaterShader);
+			SetShadowSamplers(main_scene.TerrainShader);
+			SetShadowSamplers(layeredShader);
+			// the water views drawn in one pass go without probes, the sampler still needs its own unit
+			layeredShader.use();
+			layeredShader.setInt("reflectionProbeMap", 14);
+			ReflectionProbes::Unbind(layeredShader);
+
+			impostors.Prepare();
+			bakedLighting.Load(Common::lightingFileName, main_scene.all_terrain_chunks);
+		}
+		void cleanUp()
+		{
+			ReleaseWaterLevels();
+			for (GpuTimer& timer : passTimers)
+				timer.cleanUp();
+			sceneFb.cleanUp();
+			ssr.cleanUp();
+			hardwareOcclusion.cleanUp();
+			impostors.cleanUp();
+			pointShadows.cleanUp();
+			evsm.cleanUp();
+			bakedLighting.cleanUp();
+			ambientOcclusion.cleanUp();
+			reflectionProbes.cleanUp();
+			postProcess.cleanUp();
+			antiAliasing.cleanUp();
+			volumetricFog.cleanUp();
 		}
 		void InitLighting(Shader& shader)
 		{
 			main_light.SetLight(shader);
+			SetShadowSamplers(shader);
+			shader.setInt("reflectionProbeMap", 14);
+		}
+		// AdvanceTimeOfDay: move the sun and, once it moved a step, the sky and the light; call before the frame is drawn
+		void AdvanceTimeOfDay(float deltaTime)
+		{
+			if (RenderSettings::timeOfDay != timeOfDayShown)
+			{
+				timeOfDayShown = RenderSettings::timeOfDay;
+				reflectionProbes.InvalidateSky();
+			}
+			if (!RenderSettings::timeOfDay)
+				return;
+			RenderStats::skyUpdated = main_scene.atmosphere.Update(deltaTime, *main_light.getDirectionLight());
+			// the probes capture the sky again only after larger steps, each capture redraws the probe scenes
+			glm::vec3 sun = -glm::normalize(main_light.GetDirLightDirection());
+			if (glm::dot(sun, probeSunDirection) < glm::cos(glm::radians(RenderSettings::reflectionProbeSunStep)))
+			{
+				probeSunDirection = sun;
+				reflectionProbes.InvalidateSky();
+			}
 		}
 		void DrawReflection(Shader& modelShader)
 		{
-			main_scene.TerrainShader.use();
-			main_light.SetLight(main_scene.TerrainShader);
-			modelShader.use();
-			InitLighting(modelShader);
-
-			glm::vec4 clipping_plane = glm::vec4(0.0, 1.0, 0.0, -main_scene.getWaterHeight());
-			glEnable(GL_CLIP_DISTANCE0);
-			waterfb.bindReflectionFrameBuffer();
-			glEnable(GL_DEPTH_TEST);
-			// render
-			// ------
-			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-			// Set the main camera to the position and direction of reflection
-			float distance = 2 * (GameController::mainCamera.Position.y - main_scene.getWaterHeight());
-			GameController::mainCamera.Position.y -= distance;
-			GameController::mainCamera.Pitch = -GameController::mainCamera.Pitch;
-
-			DrawObjects(modelShader, clipping_plane, false);
-
-			// we now draw as many light bulbs as we have point lights.
-			main_light.Draw(GameController::mainCamera, clipping_plane);
-			//render the main scene
-			main_scene.Draw(GameController::deltaTime, GameController::mainCamera, clipping_plane, false);
-
-			//Restore the main camera
-			GameController::mainCamera.Position.y += distance;
-			GameController::mainCamera.Pitch = -GameController::mainCamera.Pitch;
-			GameController::mainCamera.GetViewMatrix();
-
-			waterfb.unbindCurrentFrameBuffer();
+			UpdateWaterLevels();
+			if (RenderSettings::waterReflectionMode == WaterReflectionMode::ScreenSpace)
+			{
+				for (WaterLevel& level : waterLevels)
+					level.reflectionView.valid = false; // traced in DrawAll instead
+				return;
+			}
+			GpuTimer& timer = passTimers[(int)RenderPass::Reflection];
+			timer.Begin();
+			for (WaterLevel& level : waterLevels)
+				DrawReflection(modelShader, level);
+			timer.End();
+			RenderStats::passGpuMs[(int)RenderPass::Reflection] = timer.Milliseconds();
 		}
 		void DrawRefraction(Shader& modelShader)
 		{
-			main_scene.TerrainShader.use();
-			main_light.SetLight(main_scene.TerrainShader);
-			modelShader.use();
-			InitLighting(modelShader);
-
-			glm::vec4 clipping_plane = glm::vec4(0.0, -1.0, 0.0, main_scene.getWaterHeight());
-			glEnable(GL_CLIP_DISTANCE0);
-			waterfb.bindRefractionFrameBuffer();
-			glEnable(GL_DEPTH_TEST);
-			// render
-			// ------
-			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-			DrawObjects(modelShader, clipping_plane, false);
-
-			// we now draw as many light bulbs as we have point lights.
-			main_light.Draw(GameController::mainCamera, clipping_plane);
-			//render the main scene
-			main_scene.Draw(GameController::deltaTime, GameController::mainCamera, clipping_plane, false);
-
-			waterfb.unbindCurrentFrameBuffer();
+			GpuTimer& timer = passTimers[(int)RenderPass::Refraction];
+			timer.Begin();
+			for (WaterLevel& level : waterLevels)
+				DrawRefraction(modelShader, level);
+			timer.End();
+			RenderStats::passGpuMs[(int)RenderPass::Refraction] = timer.Milliseconds();
 		}
 		void DrawAll(Shader& pickingShader,Shader& modelShader, Shader& shadowShader)
 		{
@@ -103,6 +179,11 @@ namespace KooNan
 			main_light.SetLight(main_scene.TerrainShader);
 			modelShader.use();
 			InitLighting(modelShader);
+			if (main_scene.ApplyTerrainEdits())
+			{
+				bakedLighting.InvalidateTerrain();
+				reflectionProbes.Invalidate();
+			}
 
 			glm::vec4 clipping_plane = glm::vec4(0.0, -1.0, 0.0, 99999.0f);
 
@@ -126,96 +207,1080 @@ namespace KooNan
 			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+			GpuTimer& shadowTimer = passTimers[(int)RenderPass::Shadow];
+			shadowTimer.Begin();
 			DrawShadowMap(shadowShader);
+			DrawPointShadows(modelShader, main_scene.TerrainShader);
+			reflectionProbes.InvalidateRegions(GameObject::changedRegions);
+			GameObject::changedRegions.clear();
+			// the terrain shades itself and the objects through the horizon map, it is not in the cascades
+			main_scene.horizon.Bind(modelShader, 10);
+			main_scene.horizon.Bind(layeredShader, 10);
+			main_scene.horizon.Bind(main_scene.TerrainShader, 10);
+			bakedLighting.Bind(main_scene.TerrainShader, 12);
+			SetShadowUniforms(modelShader);
+			SetShadowUniforms(layeredShader);
+			SetShadowUniforms(main_scene.TerrainShader);
+			shadowTimer.End();
+			RenderStats::passGpuMs[(int)RenderPass::Shadow] = shadowTimer.Milliseconds();
 
-			
-			DrawObjects(modelShader, clipping_plane, true);
-			main_light.Draw(GameController::mainCamera, clipping_plane);
+			if (RenderSettings::reflectionProbes)
+				UpdateReflectionProbes(modelShader);
+
+			// everything drawn with the main camera from here on is jittered for TAA
+			antiAliasing.NextFrame();
+			Common::projectionJitter = antiAliasing.Jitter();
+
+			if (RenderSettings::ssao)
+			{
+				DrawAmbientOcclusion(shadowShader);
+				ambientOcclusion.Bind(modelShader, 13);
+				ambientOcclusion.Bind(main_scene.TerrainShader, 13);
+			}
+			else
+				ambientOcclusion.Invalidate();
+
+			bool screenSpaceReflection = RenderSettings::waterReflectionMode == WaterReflectionMode::ScreenSpace;
+			bool antiAliased = antiAliasing.Enabled();
+			bool offscreen = screenSpaceReflection || RenderSettings::hdr || antiAliased || RenderSettings::volumetricFog;
+			if (offscreen)
+			{
+				sceneFb.bindFrameBuffer();
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			}
+
+			GpuTimer& mainTimer = passTimers[(int)RenderPass::Main];
+			mainTimer.Begin();
+			DrawObjects(modelShader, clipping_plane, RenderPass::Main, &shadowShader);
+			if (RenderSettings::cullPolicies[(int)RenderPass::Main].gizmos)
+				main_light.Draw(GameController::mainCamera, clipping_plane);
 
 
 			glEnable(GL_BLEND);
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-			main_scene.setReflectText(waterfb.getReflectionTexture());
-			main_scene.setRefractText(waterfb.getRefractionTexture());
-			main_scene.setDepthMap(waterfb.getRefractionDepthTexture());
 			main_scene.setShadowMap(shadowfb.getShadowTexture());
-			main_scene.TerrainShader.use();
-			main_scene.TerrainShader.setMat4("lightProjection", shadowfb.lightProjection);//Bad implementation
-			main_scene.TerrainShader.setMat4("lightView", shadowfb.lightView);//Bad implementation
-			main_scene.Draw(GameController::deltaTime, GameController::mainCamera, clipping_plane, true, true);
+			main_scene.Draw(GameController::deltaTime, GameController::mainCamera, clipping_plane, false, true);
+			main_scene.AdvanceWater(GameController::deltaTime);
+			for (WaterLevel& level : waterLevels)
+			{
+				if (!level.planar)
+				{
+					main_scene.setReflectionMode(2);
+					DrawWater(level);
+					continue;
+				}
+				main_scene.setRefractText(level.targets->getRefractionTexture());
+				main_scene.setDepthMap(level.targets->getRefractionDepthTexture());
+				if (screenSpaceReflection)
+				{
+					// the opaque scene is finished, trace the water reflection through it
+					if (WaterPassesNeeded(level))
+					{
+						ssr.Draw(sceneFb, main_scene.getSkyCubeMap(), Common::GetPerspectiveMat(GameController::mainCamera),
+							GameController::mainCamera.GetViewMatrix(), level.height);
+						sceneFb.bindFrameBuffer();
+					}
+					main_scene.setReflectText(ssr.getReflectionTexture());
+					main_scene.setReflectionMode(1);
+				}
+				else
+				{
+					main_scene.setReflectText(level.targets->getReflectionTexture());
+					main_scene.setReflectionMode(0);
+				}
+				DrawWater(level);
+			}
 
 
 			glDisable(GL_BLEND);
+			mainTimer.End();
+			RenderStats::passGpuMs[(int)RenderPass::Main] = mainTimer.Milliseconds();
+			glm::mat4 projection = Common::GetPerspectiveMat(GameController::mainCamera);
+			Common::projectionJitter = glm::vec2(0.0f);
+			if (RenderSettings::volumetricFog)
+				volumetricFog.Apply(sceneFb.getColorTexture(), sceneFb.getDepthTexture(), shadowfb, *main_light.getDirectionLight(),
+					projection, GameController::mainCamera.GetViewMatrix(), GameController::mainCamera.Position);
+			else
+				volumetricFog.Invalidate();
+			if (offscreen && !RenderSettings::hdr && !antiAliased)
+				sceneFb.present();
+			if (RenderSettings::hdr)
+				postProcess.Apply(sceneFb.getColorTexture(), antiAliased ? antiAliasing.InputFrameBuffer() : 0);
+			if (antiAliased)
+				antiAliasing.Apply(RenderSettings::hdr ? antiAliasing.InputTexture() : sceneFb.getColorTexture(),
+					sceneFb.getDepthTexture(), projection, GameController::mainCamera.GetViewMatrix());
+			if (RenderSettings::ssao)
+			{
+				ambientOcclusion.Unbind(modelShader);
+				ambientOcclusion.Unbind(main_scene.TerrainShader);
+			}
 		}
 		private:
-			void DrawObjects(Shader& modelShader, glm::vec4 clippling_plane, bool IsAfterPicking)
+			// UpdateReflectionProbes: capture the probes placed or changed since the last frame, with
+			// the static objects and the terrain; the captures themselves reflect nothing
+			void UpdateReflectionProbes(Shader& modelShader)
 			{
+				ReflectionProbes::Unbind(modelShader);
+				ReflectionProbes::DrawFunc drawSky = [&](const glm::mat4& projection, const glm::mat4& view, const glm::vec3& viewPos) {
+					main_scene.DrawView(projection, view, viewPos, false);
+				};
+				ReflectionProbes::DrawFunc drawScene = [&](const glm::mat4& projection, const glm::mat4& view, const glm::vec3& viewPos) {
+					main_scene.DrawView(projection, view, viewPos, true);
+					float minScreenSize = RenderSettings::cullPolicies[(int)RenderPass::Main].minScreenSize;
+					glEnable(GL_CULL_FACE);
+					for (GameObject* obj : GameObject::CollectVisible(projection * view))
+					{
+						if (obj->IsDynamic() || obj->ScreenSize(viewPos, 90.0f) < minScreenSize)
+							continue;
+						obj->Draw(modelShader, viewPos, projection, view);
+					}
+					glDisable(GL_CULL_FACE);
+				};
+				RenderStats::probesCaptured = reflectionProbes.Update(main_scene.reflectionProbes, drawSky, drawScene);
+			}
+			// BindProbe: the reflection probe of an object, right before it is drawn with model.fs
+			void BindProbe(Shader& modelShader, GameObject* obj)
+			{
+				if (RenderSettings::reflectionProbes)
+					reflectionProbes.Bind(modelShader, 14, obj->GetWorldBounds().Center());
+				else
+					ReflectionProbes::Unbind(modelShader);
+			}
+			// DrawAmbientOcclusion: half size depth of what the main pass will draw, then its occlusion.
+			// Objects the main pass fades into impostors are left out, their dithered meshes
+			// would punch holes into the depth.
+			void DrawAmbientOcclusion(Shader& depthShader)
+			{
+				Camera& cam = GameController::mainCamera;
+				glm::mat4 projection = Common::GetPerspectiveMat(cam);
+				glm::mat4 view = cam.GetViewMatrix();
+				float minScreenSize = RenderSettings::cullPolicies[(int)RenderPass::Main].minScreenSize;
+				ambientOcclusion.BeginDepth();
+				main_scene.DrawTerrainDepth(depthShader, projection, view);
 				glEnable(GL_CULL_FACE);
+				for (GameObject* obj : GameObject::CollectVisible(projection * view))
+				{
+					if (ImpostorFade(obj, RenderPass::Main) > 0.0f || obj->ScreenSize(cam.Position, cam.Zoom) < minScreenSize)
+						continue;
+					obj->Draw(depthShader, cam.Position, projection, view, glm::vec4(0.0f, -1.0f, 0.0f, 999999.0f), false,
+						obj->SelectLod(RenderPass::Main, cam.Position, cam.Zoom));
+				}
+				glDisable(GL_CULL_FACE);
+				ambientOcclusion.EndDepth();
+				ambientOcclusion.Compute(projection, view);
+				RenderStats::ssaoGpuMs = ambientOcclusion.Milliseconds();
+			}
+			// DrawReflection: mirrored camera pass of one level, unless it is hidden, small or unchanged
+			void DrawReflection(Shader& modelShader, WaterLevel& level)
+			{
+				if (!level.planar || !WaterPassesNeeded(level))
+					return;
+				if (ReflectionReusable(level))
+				{
+					RenderStats::reflectionsReused++;
+					return;
+				}
+				if (RenderSettings::layeredWaterPasses)
+				{
+					DrawWaterLayered(modelShader, level);
+					return;
+				}
+				main_scene.TerrainShader.use();
+				main_light.SetLight(main_scene.TerrainShader);
+				modelShader.use();
+				InitLighting(modelShader);
+
+				glm::vec4 clipping_plane = glm::vec4(0.0, 1.0, 0.0, -level.height);
+				glEnable(GL_CLIP_DISTANCE0);
+				level.targets->bindReflectionFrameBuffer();
+				glEnable(GL_DEPTH_TEST);
+				// render
+				// ------
+				glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+				// Set the main camera to the position and direction of reflection
+				float distance = 2 * (GameController::mainCamera.Position.y - level.height);
+				GameController::mainCamera.Position.y -= distance;
+				GameController::mainCamera.Pitch = -GameController::mainCamera.Pitch;
+
+				DrawObjects(modelShader, clipping_plane, RenderPass::Reflection);
+
+				// we now draw as many light bulbs as we have point lights.
+				if (RenderSettings::cullPolicies[(int)RenderPass::Reflection].gizmos)
+					main_light.Draw(GameController::mainCamera, clipping_plane);
+				//render the main scene
+				main_scene.Draw(GameController::deltaTime, GameController::mainCamera, clipping_plane, false);
+
+				//Restore the main camera
+				GameController::mainCamera.Position.y += distance;
+				GameController::mainCamera.Pitch = -GameController::mainCamera.Pitch;
+				GameController::mainCamera.GetViewMatrix();
+
+				level.targets->unbindCurrentFrameBuffer();
+				RememberReflectionView(level);
+			}
+			void DrawRefraction(Shader& modelShader, WaterLevel& level)
+			{
+				if (level.refractionDrawn)
+				{
+					level.refractionDrawn = false;
+					return;
+				}
+				if (!level.planar)
+					return;
+				if (!WaterPassesNeeded(level))
+				{
+					RenderStats::waterLevelsSkipped++;
+					return;
+				}
+				main_scene.TerrainShader.use();
+				main_light.SetLight(main_scene.TerrainShader);
+				modelShader.use();
+				InitLighting(modelShader);
+
+				glm::vec4 clipping_plane = glm::vec4(0.0, -1.0, 0.0, level.height);
+				glEnable(GL_CLIP_DISTANCE0);
+				level.targets->bindRefractionFrameBuffer();
+				glEnable(GL_DEPTH_TEST);
+				// render
+				// ------
+				glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+				DrawObjects(modelShader, clipping_plane, RenderPass::Refraction);
+
+				// we now draw as many light bulbs as we have point lights.
+				if (RenderSettings::cullPolicies[(int)RenderPass::Refraction].gizmos)
+					main_light.Draw(GameController::mainCamera, clipping_plane);
+				//render the main scene
+				main_scene.Draw(GameController::deltaTime, GameController::mainCamera, clipping_plane, false);
+
+				level.targets->unbindCurrentFrameBuffer();
+				level.texturesValid = true;
+			}
+			// DrawWaterLayered: reflection and refraction in one traversal of the objects. Each object
+			// is submitted once with a mask of the views it shows in; model_layered.gs emits its
+			// triangles into those layers. Terrain, sky and vegetation crossing into impostors differ
+			// per view and are drawn layer by layer. Specular highlights use the real camera in both.
+			void DrawWaterLayered(Shader& modelShader, WaterLevel& level)
+			{
+				main_scene.TerrainShader.use();
+				main_light.SetLight(main_scene.TerrainShader);
+				modelShader.use();
+				InitLighting(modelShader);
+				main_light.SetLight(layeredShader);
+
+				const int layers[2] = { Water_Frame_Buffer::REFLECTION_LAYER, Water_Frame_Buffer::REFRACTION_LAYER };
+				const RenderPass passes[2] = { RenderPass::Reflection, RenderPass::Refraction };
+				Camera& cam = GameController::mainCamera;
+				float waterHeight = level.height;
+				glm::vec4 planes[2] = { glm::vec4(0.0, 1.0, 0.0, -waterHeight), glm::vec4(0.0, -1.0, 0.0, waterHeight) };
+				glm::vec3 viewPos = cam.Position;
+				float distance = 2 * (cam.Position.y - waterHeight);
+				glm::mat4 projection = Common::GetPerspectiveMat(cam);
+				glm::mat4 views[2];
+
+				struct LayeredObject
+				{
+					GameObject* obj;
+					unsigned int mask;
+					unsigned int lod; // the finer of the two views
+				};
+				std::vector<LayeredObject> shared;
+				std::unordered_map<GameObject*, size_t> sharedIndex;
+				std::vector<GameObject*> perLayer[2];
+				for (int i = 0; i < 2; i++)
+				{
+					// the reflection camera is the main camera mirrored in the water plane
+					if (i == 0)
+					{
+						cam.Position.y -= distance;
+						cam.Pitch = -cam.Pitch;
+					}
+					views[i] = cam.GetViewMatrix();
+					for (GameObject* obj : CollectPassObjects(passes[i], projection, views[i], planes[i]))
+					{
+						if (ImpostorFade(obj, passes[i]) > 0.0f && ImpostorAtlas::IsVegetation(obj->modelPath))
+						{
+							perLayer[i].push_back(obj);
+							continue;
+						}
+						unsigned int lod = obj->SelectLod(passes[i], cam.Position, cam.Zoom);
+						auto it = sharedIndex.find(obj);
+						if (it == sharedIndex.end())
+						{
+							sharedIndex[obj] = shared.size();
+							shared.push_back(LayeredObject{ obj, 1u << layers[i], lod });
+						}
+						else
+						{
+							shared[it->second].mask |= 1u << layers[i];
+							shared[it->second].lod = glm::min(shared[it->second].lod, lod);
+						}
+					}
+					if (i == 0)
+					{
+						cam.Position.y += distance;
+						cam.Pitch = -cam.Pitch;
+					}
+				}
+				cam.GetViewMatrix();
+
+				glEnable(GL_CLIP_DISTANCE0);
+				glEnable(GL_DEPTH_TEST);
+				level.targets->bindLayeredFrameBuffer();
+				glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glEnable(GL_CULL_FACE);
+				layeredShader.use();
+				for (int i = 0; i < 2; i++)
+				{
+					std::string index = "[" + std::to_string(layers[i]) + "]";
+					layeredShader.setMat4("viewProjections" + index, projection * views[i]);
+					layeredShader.setVec4("planes" + index, planes[i]);
+				}
+				for (const LayeredObject& lo : shared)
+				{
+					layeredShader.use();
+					layeredShader.setInt("layerMask", (int)lo.mask);
+					lo.obj->Draw(layeredShader, viewPos, projection, views[1], planes[1], false, lo.lod);
+				}
+				glDisable(GL_CULL_FACE);
+
+				for (int i = 0; i < 2; i++)
+				{
+					level.targets->bindLayer(layers[i]);
+					if (i == 0)
+					{
+						cam.Position.y -= distance;
+						cam.Pitch = -cam.Pitch;
+					}
+					DrawObjectList(modelShader, perLayer[i], planes[i], passes[i], projection, views[i], NULL, NULL);
+					if (RenderSettings::cullPolicies[(int)passes[i]].gizmos)
+						main_light.Draw(cam, planes[i]);
+					main_scene.Draw(GameController::deltaTime, cam, planes[i], false);
+					if (i == 0)
+					{
+						cam.Position.y += distance;
+						cam.Pitch = -cam.Pitch;
+						cam.GetViewMatrix();
+					}
+				}
+				level.targets->resolveLayers();
+
+				RenderStats::waterPassesLayered = true;
+				RememberReflectionView(level);
+				level.texturesValid = true;
+				level.refractionDrawn = true;
+			}
+			// UpdateWaterLevels: follow the water heights of the scene and pick the levels worth their own passes
+			void UpdateWaterLevels()
+			{
+				std::vector<float> heights = main_scene.getWaterLevels();
+				bool unchanged = heights.size() == waterLevels.size();
+				for (size_t i = 0; unchanged && i < heights.size(); i++)
+					unchanged = heights[i] == waterLevels[i].height;
+				if (!unchanged)
+				{
+					ReleaseWaterLevels();
+					for (size_t i = 0; i < heights.size(); i++)
+					{
+						WaterLevel level;
+						level.height = heights[i];
+						level.targets = i == 0 ? &waterfb : new Water_Frame_Buffer();
+						glGenQueries(1, &level.query);
+						level.queryPending = false;
+						level.visible = true;
+						level.texturesValid = false;
+						level.planar = true;
+						level.refractionDrawn = false;
+						level.reflectionView.valid = false;
+						waterLevels.push_back(level);
+					}
+				}
+
+				Camera& cam = GameController::mainCamera;
+				RenderStats::waterLevels = (unsigned int)waterLevels.size();
+				for (WaterLevel& level : waterLevels)
+				{
+					// projected size of the whole level, measured from its closest point
+					AABB box = main_scene.getWaterLevelBounds(level.height);
+					glm::vec3 closest = glm::clamp(cam.Position, box.min, box.max);
+					float dist = glm::length(closest - cam.Position);
+					float radius = glm::length(box.Extent());
+					float size = dist <= radius ? 1.0f : radius / (dist * tan(glm::radians(cam.Zoom) * 0.5f));
+					level.planar = size >= RenderSettings::waterPlanarMinScreenSize;
+					if (!level.planar)
+					{
+						// the query state is stale once the level gets its passes back
+						level.visible = true;
+						RenderStats::waterLevelsSkyOnly++;
+					}
+				}
+			}
+			void ReleaseWaterLevels()
+			{
+				for (WaterLevel& level : waterLevels)
+				{
+					glDeleteQueries(1, &level.query);
+					if (level.targets != &waterfb)
+					{
+						level.targets->cleanUp();
+						delete level.targets;
+					}
+				}
+				waterLevels.clear();
+			}
+			// WaterPassesNeeded: whether the level may show this frame, the state only changes in DrawWater
+			bool WaterPassesNeeded(const WaterLevel& level)
+			{
+				if (!RenderSettings::waterPassSkipping || !level.texturesValid)
+					return true;
+				if (!main_scene.IsWaterInFrustum(Common::GetPerspectiveMat(GameController::mainCamera) * GameController::mainCamera.GetViewMatrix(), level.height))
+					return false;
+				return level.visible;
+			}
+			// ReflectionReusable: whether the last reflection of the level still matches the view closely enough, ages it by a frame
+			bool ReflectionReusable(WaterLevel& level)
+			{
+				ReflectionView& last = level.reflectionView;
+				if (!RenderSettings::reflectionAmortization || !last.valid)
+					return false;
+				last.age++;
+				Camera& cam = GameController::mainCamera;
+				cam.GetViewMatrix(); // refreshes Front from the latest yaw and pitch
+				float turnCos = cos(glm::radians(RenderSettings::reflectionTurnThreshold));
+				return last.age < RenderSettings::reflectionMaxAge &&
+					glm::length(cam.Position - last.position) <= RenderSettings::reflectionMoveThreshold &&
+					glm::dot(cam.Front, last.front) >= turnCos &&
+					cam.Zoom == last.zoom && level.height == last.waterHeight &&
+					Common::SCR_WIDTH == last.width && Common::SCR_HEIGHT == last.height &&
+					GameObject::sceneVersion == last.sceneVersion;
+			}
+			void RememberReflectionView(WaterLevel& level)
+			{
+				Camera& cam = GameController::mainCamera;
+				ReflectionView& view = level.reflectionView;
+				view.position = cam.Position;
+				view.front = cam.Front;
+				view.zoom = cam.Zoom;
+				view.waterHeight = level.height;
+				view.width = Common::SCR_WIDTH;
+				view.height = Common::SCR_HEIGHT;
+				view.sceneVersion = GameObject::sceneVersion;
+				view.age = 0;
+				view.valid = true;
+			}
+			// DrawWater: draw one level in the main pass, counting its samples when it has passes to skip and no query is in flight
+			void DrawWater(WaterLevel& level)
+			{
+				if (level.queryPending)
+				{
+					GLint available = 0;
+					glGetQueryObjectiv(level.query, GL_QUERY_RESULT_AVAILABLE, &available);
+					if (available)
+					{
+						GLuint anySamples = 0;
+						glGetQueryObjectuiv(level.query, GL_QUERY_RESULT, &anySamples);
+						level.queryPending = false;
+						level.visible = anySamples != 0;
+					}
+				}
+				bool inFrustum = main_scene.IsWaterInFrustum(Common::GetPerspectiveMat(GameController::mainCamera) * GameController::mainCamera.GetViewMatrix(), level.height);
+				if (!inFrustum)
+				{
+					// outside the frustum says nothing about occlusion, assume visible once it comes back
+					level.visible = true;
+					return;
+				}
+				if (level.queryPending || !level.planar)
+				{
+					main_scene.DrawWater(GameController::mainCamera, level.height);
+					return;
+				}
+				glBeginQuery(GL_ANY_SAMPLES_PASSED, level.query);
+				main_scene.DrawWater(GameController::mainCamera, level.height);
+				glEndQuery(GL_ANY_SAMPLES_PASSED);
+				level.queryPending = true;
+			}
+			// DrawObjects: draw the game objects inside the view frustum
+			//   queryShader: position only shader for occlusion query boxes, the main pass passes one
+			void DrawObjects(Shader& modelShader, glm::vec4 clippling_plane, RenderPass pass, Shader* queryShader = NULL)
+			{
+				bool IsAfterPicking = pass == RenderPass::Main;
 				bool enablePicking = GameController::gameMode == GameMode::Creating &&
 					GameController::creatingMode == CreatingMode::Selecting &&
 					IsAfterPicking && !GameController::isCursorOnGui;
-				if (enablePicking)GameController::selectedGameObj = NULL;
+				GameObject* hitObj = NULL;
+				// ģʽķģʽûѡУҸԱѡУʰȡ
+				if (enablePicking)
+				{
+					GameController::selectedGameObj = NULL;
+					unsigned int hitObjID = (unsigned int)mouse_picking.ReadPixel(GameController::cursorX,
+						Common::SCR_HEIGHT - GameController::cursorY - 22).ObjID;//deviation of y under resolution 1920*1080 maybe 22
+					if (hitObjID > 0 && hitObjID <= pickedObjs.size())
+						hitObj = GameController::selectedGameObj = pickedObjs[hitObjID - 1];
+				}
 
-				auto itr = GameObject::gameObjList.begin();
-				for (int i = 0; i < GameObject::gameObjList.size(); i++, ++itr)
+				glm::mat4 projection = Common::GetPerspectiveMat(GameController::mainCamera);
+				glm::mat4 view = GameController::mainCamera.GetViewMatrix();
+				std::vector<GameObject*> visible = CollectPassObjects(pass, projection, view, clippling_plane);
+				DrawObjectList(modelShader, visible, clippling_plane, pass, projection, view, hitObj, queryShader);
+			}
+			// CollectPassObjects: objects a pass draws from the current main camera, after all of its culling
+			std::vector<GameObject*> CollectPassObjects(RenderPass pass, const glm::mat4& projection, const glm::mat4& view, const glm::vec4& clippling_plane)
+			{
+				std::vector<GameObject*> visible = CullByPolicy(GameObject::CollectVisible(projection * view), pass,
+					GameController::mainCamera.Position, GameController::mainCamera.Zoom);
+				if (pass == RenderPass::Main && RenderSettings::softwareOcclusion)
+				{
+					size_t numFrustumVisible = visible.size();
+					visible = CullOccluded(visible, projection * view, GameController::mainCamera.Position);
+					RenderStats::objectsOccludedCPU += (unsigned int)(numFrustumVisible - visible.size());
+				}
+				if (pass == RenderPass::Reflection || pass == RenderPass::Refraction)
+				{
+					size_t numUnclipped = visible.size();
+					visible.erase(std::remove_if(visible.begin(), visible.end(),
+						[&](GameObject* obj) { return IsClipped(clippling_plane, obj->GetWorldBounds()); }), visible.end());
+					RenderStats::clipCulled += (unsigned int)(numUnclipped - visible.size());
+				}
+				RenderStats::passObjects[(int)pass] += (unsigned int)visible.size();
+				return visible;
+			}
+			// DrawObjectList: draw culled objects from the current main camera, far vegetation as impostors
+			//   hitObj: object drawn highlighted, may be NULL
+			//   queryShader: position only shader for occlusion query boxes, NULL draws everything directly
+			void DrawObjectList(Shader& modelShader, const std::vector<GameObject*>& visible, const glm::vec4& clippling_plane, RenderPass pass,
+				const glm::mat4& projection, const glm::mat4& view, GameObject* hitObj, Shader* queryShader)
+			{
+				glEnable(GL_CULL_FACE);
+				bool useQueries = queryShader != NULL && RenderSettings::occlusionQueryMode != OcclusionQueryMode::Off;
+				std::vector<std::pair<float, GameObject*>> heavyObjs;
+				for (GameObject* obj : visible)
 				{
-					bool intersected = false;
-					// ģʽķģʽûѡУҸԱѡУʰȡ
-					if (enablePicking)
+					// far vegetation becomes an impostor, with a dithered cross-fade in between
+					float fade = ImpostorFade(obj, pass);
+					if (fade > 0.0f && impostors.Add(obj->GetModel(), obj->modelPath, obj->modelMat, fade))
 					{
-						float hitObjID = mouse_picking.ReadPixel(GameController::cursorX, 
-							Common::SCR_HEIGHT - GameController::cursorY - 22).ObjID;//deviation of y under resolution 1920*1080 maybe 22
-						if ((unsigned int)hitObjID == i + 1)
-						{
-							GameController::selectedGameObj = *itr;
-							intersected = true;
-						}
+						if (fade >= 1.0f)
+							continue;
+						BindProbe(modelShader, obj);
+						modelShader.use();
+						modelShader.setFloat("ditherFade", fade);
+						obj->Draw(modelShader, GameController::mainCamera.Position,
+							projection, view,
+							clippling_plane,
+							obj == hitObj,
+							obj->SelectLod(pass, GameController::mainCamera.Position, GameController::mainCamera.Zoom));
+						modelShader.setFloat("ditherFade", 0.0f);
+						continue;
+					}
+					if (useQueries && obj->GetModel()->numTriangles >= RenderSettings::occlusionQueryMinTriangles)
+					{
+						heavyObjs.push_back(std::make_pair(glm::length(obj->GetWorldBounds().Center() - GameController::mainCamera.Position), obj));
+						continue;
 					}
-					(*itr)->Draw(modelShader, GameController::mainCamera.Position,
-						Common::GetPerspectiveMat(GameController::mainCamera), GameController::mainCamera.GetViewMatrix(),
+					BindProbe(modelShader, obj);
+					obj->Draw(modelShader, GameController::mainCamera.Position,
+						projection, view,
 						clippling_plane,
-						intersected);
+						obj == hitObj,
+						obj->SelectLod(pass, GameController::mainCamera.Position, GameController::mainCamera.Zoom));
+				}
+
+				// heavy objects last and front to back, so their query boxes see as much depth as possible
+				if (useQueries)
+				{
+					hardwareOcclusion.BeginFrame();
+					std::sort(heavyObjs.begin(), heavyObjs.end(),
+						[](const std::pair<float, GameObject*>& l, const std::pair<float, GameObject*>& r) { return l.first < r.first; });
+					for (const std::pair<float, GameObject*>& heavy : heavyObjs)
+					{
+						GameObject* obj = heavy.second;
+						AABB box = obj->GetWorldBounds();
+						// the near plane may cut a box the camera is right next to
+						glm::vec3 margin(Common::perspective_clipping_near * 2.0f);
+						bool cameraInside = AABB(box.min - margin, box.max + margin).Contains(AABB(GameController::mainCamera.Position, GameController::mainCamera.Position));
+						hardwareOcclusion.Draw(obj, box, cameraInside, RenderSettings::occlusionQueryMode, [&]() {
+							BindProbe(modelShader, obj);
+							obj->Draw(modelShader, GameController::mainCamera.Position,
+								projection, view,
+								clippling_plane,
+								obj == hitObj,
+								obj->SelectLod(pass, GameController::mainCamera.Position, GameController::mainCamera.Zoom));
+						}, *queryShader, projection, view);
+					}
 				}
+				impostors.Flush(projection, view, GameController::mainCamera.Position, clippling_plane, main_light);
 				glDisable(GL_CULL_FACE);
 			}
+			// ImpostorFade: 0 below the impostor distance of the pass, rising to 1 across the fade band
+			float ImpostorFade(GameObject* obj, RenderPass pass) const
+			{
+				if (!RenderSettings::impostors)
+					return 0.0f;
+				float dist = glm::length(obj->GetWorldBounds().Center() - GameController::mainCamera.Position);
+				return glm::clamp((dist - RenderSettings::impostorDistance[(int)pass]) / RenderSettings::impostorFadeBand, 0.0f, 1.0f);
+			}
+			// CullByPolicy: drop what the cull policy of a pass leaves out
+			//   viewPos, fovy: camera distances and screen sizes are measured from
+			std::vector<GameObject*> CullByPolicy(const std::vector<GameObject*>& objs, RenderPass pass, const glm::vec3& viewPos, float fovy)
+			{
+				const CullPolicy& policy = RenderSettings::cullPolicies[(int)pass];
+				float maxDistance = policy.maxDistance;
+				// only VolumetricFog draws the fog, without it the cutoff would pop visible objects
+				if (RenderSettings::fogCulling && RenderSettings::volumetricFog)
+					maxDistance = glm::min(maxDistance, RenderSettings::FogCutoffDistance());
+				std::vector<GameObject*> result;
+				result.reserve(objs.size());
+				for (GameObject* obj : objs)
+				{
+					AABB box = obj->GetWorldBounds();
+					glm::vec3 closest = glm::clamp(viewPos, box.min, box.max);
+					if (glm::length(closest - viewPos) > maxDistance ||
+						(!policy.smallProps && glm::length(box.Extent()) < RenderSettings::smallPropRadius) ||
+						obj->ScreenSize(viewPos, fovy) < policy.minScreenSize)
+						continue;
+					result.push_back(obj);
+				}
+				RenderStats::policyCulled += (unsigned int)(objs.size() - result.size());
+				return result;
+			}
+			// CullOccluded: rasterize the largest nearby objects on the CPU and drop what they hide
+			std::vector<GameObject*> CullOccluded(const std::vector<GameObject*>& visible, const glm::mat4& viewProjection, const glm::vec3& viewPos)
+			{
+				std::vector<std::pair<float, GameObject*>> candidates;
+				for (GameObject* obj : visible)
+				{
+					if (obj->GetModel()->occluderTriangles.empty())
+						continue;
+					AABB box = obj->GetWorldBounds();
+					float radius = glm::length(box.Extent());
+					float dist = glm::max(glm::length(box.Center() - viewPos) - radius, 1.0f);
+					if (dist > RenderSettings::occluderMaxDistance)
+						continue;
+					candidates.push_back(std::make_pair(radius * radius / (dist * dist), obj)); // ~ projected area
+				}
+				size_t numOccluders = std::min(candidates.size(), (size_t)RenderSettings::maxOccluders);
+				std::partial_sort(candidates.begin(), candidates.begin() + numOccluders, candidates.end(),
+					[](const std::pair<float, GameObject*>& l, const std::pair<float, GameObject*>& r) { return l.first > r.first; });
+
+				occlusionCuller.Begin(viewProjection);
+				for (size_t i = 0; i < numOccluders; i++)
+					occlusionCuller.AddOccluder(candidates[i].second->GetModel()->occluderTriangles, candidates[i].second->modelMat);
+				occlusionCuller.Rasterize();
+
+				std::vector<GameObject*> result;
+				for (GameObject* obj : visible)
+					if (occlusionCuller.IsVisible(obj->GetWorldBounds()))
+						result.push_back(obj);
+				return result;
+			}
 			void PickObjects(Shader& modelShader)
 			{
 				glEnable(GL_CULL_FACE);
-				unsigned int object_counter = 0;
-				auto itr = GameObject::gameObjList.begin();
-				for (int i = 0; i < GameObject::gameObjList.size(); i++, ++itr)
+				glm::mat4 projection = Common::GetPerspectiveMat(GameController::mainCamera);
+				glm::mat4 view = GameController::mainCamera.GetViewMatrix();
+				pickedObjs.clear();
+				// only the pixel under the cursor is read back, so only the objects on its ray are drawn
+				glm::vec2 pixel(GameController::cursorX + 0.5f, Common::SCR_HEIGHT - GameController::cursorY - 22 + 0.5f);
+				glm::vec2 ndc = pixel / glm::vec2(Common::SCR_WIDTH, Common::SCR_HEIGHT) * 2.0f - 1.0f;
+				glm::mat4 invViewProjection = glm::inverse(projection * view);
+				glm::vec4 nearPoint = invViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+				glm::vec4 farPoint = invViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+				Ray ray;
+				ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+				ray.dir = glm::vec3(farPoint) / farPoint.w - ray.origin;
+				std::vector<GameObject*> hit;
+				// dir spans near to far, the whole ray is t in [0, 1]; every hit is kept, the depth test picks
+				GameObject::spatialIndex.QueryRay(ray, 1.0f, [&hit](GameObject* obj, float) { hit.push_back(obj); return 1.0f; });
+				for (GameObject* obj : CullByPolicy(hit, RenderPass::Main,
+					GameController::mainCamera.Position, GameController::mainCamera.Zoom))
 				{
-					if ((*itr)->IsPickable)
-						(*itr)->Pick(modelShader, ++object_counter, 0,
-							Common::GetPerspectiveMat(GameController::mainCamera), GameController::mainCamera.GetViewMatrix());
-
+					if (obj->IsPickable)
+					{
+						pickedObjs.push_back(obj);
+						obj->Pick(modelShader, pickedObjs.size(), 0, projection, view,
+							obj->SelectLod(RenderPass::Main, GameController::mainCamera.Position, GameController::mainCamera.Zoom));
+					}
 				}
 				glDisable(GL_CULL_FACE);
 			}
 			void DrawShadowMap(Shader& shadowShader)
 			{
 				Camera& cam = GameController::mainCamera;
-				glm::vec3 LightDir = main_light.GetDirLightDirection()*10.0f;
-				glm::vec3 DivPos = cam.Position;
-				DivPos.z -= 20.0f;
-				GLfloat near_plane = 1.0f, far_plane = 1000.0f;
-				shadowfb.lightProjection = glm::ortho(-50.0f, 50.0f, -80.0f, 20.0f, near_plane, far_plane);
-				shadowfb.lightView = glm::lookAt(DivPos - LightDir, DivPos, glm::vec3(0.0f, 1.0f, 0.0f));
-				glViewport(0, 0, shadowfb.SHADOW_WIDTH, shadowfb.SHADOW_HEIGHT);
-				shadowfb.bindFrameBuffer();
-				glClear(GL_DEPTH_BUFFER_BIT);
-				auto itr = GameObject::gameObjList.begin();
-				for (int i = 0; i < GameObject::gameObjList.size(); i++, ++itr)
+				glm::vec3 LightDir = glm::normalize(main_light.GetDirLightDirection());
+				glm::mat4 view = cam.GetViewMatrix();
+				float aspect = (float)Common::SCR_WIDTH / (float)Common::SCR_HEIGHT;
+				float nearPlane = Common::perspective_clipping_near;
+				float farPlane = glm::min(RenderSettings::shadowDistance, Common::perspective_clipping_far);
+				glm::vec3 lightUp = glm::abs(LightDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+				glViewport(0, 0, Shadow_Frame_Buffer::CASCADE_SIZE, Shadow_Frame_Buffer::CASCADE_SIZE);
+				float sliceNear = nearPlane;
+				bool changed[Shadow_Frame_Buffer::CASCADES];
+				// a new light direction turns RenderSettings::shadowSunUpdates cascades per frame, those furthest
+				// behind first; the others keep their depth and their old direction until it is their turn
+				bool turn[Shadow_Frame_Buffer::CASCADES];
+				int order[Shadow_Frame_Buffer::CASCADES];
+				for (int c = 0; c < Shadow_Frame_Buffer::CASCADES; c++)
+					order[c] = c;
+				std::stable_sort(order, order + Shadow_Frame_Buffer::CASCADES, [&](int a, int b) {
+					return glm::dot(shadowfb.cascadeCache[a].lightDir, LightDir) < glm::dot(shadowfb.cascadeCache[b].lightDir, LightDir);
+				});
+				int turnsLeft = RenderSettings::shadowSunUpdates;
+				for (int c : order)
 				{
-					(*itr)->Draw(shadowShader, cam.Position, shadowfb.lightProjection, shadowfb.lightView);
+					turn[c] = shadowfb.cascadeCache[c].valid && shadowfb.cascadeCache[c].lightDir != LightDir && turnsLeft > 0;
+					if (turn[c])
+						turnsLeft--;
+				}
+				for (int c = 0; c < Shadow_Frame_Buffer::CASCADES; c++)
+				{
+					// practical split scheme, a blend of logarithmic and uniform splits
+					float t = (float)(c + 1) / Shadow_Frame_Buffer::CASCADES;
+					float logSplit = nearPlane * pow(farPlane / nearPlane, t);
+					float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+					float sliceFar = glm::mix(uniformSplit, logSplit, RenderSettings::cascadeSplitLambda);
+					shadowfb.cascadeSplits[c] = sliceFar;
+
+					// bounding sphere of the slice, its size does not change as the camera turns
+					glm::mat4 toWorld = glm::inverse(glm::perspective(glm::radians(cam.Zoom), aspect, sliceNear, sliceFar) * view);
+					glm::vec3 corners[8];
+					glm::vec3 center(0.0f);
+					for (int i = 0; i < 8; i++)
+					{
+						glm::vec4 p = toWorld * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+						corners[i] = glm::vec3(p) / p.w;
+						center += corners[i] / 8.0f;
+					}
+					float radius = 0.0f;
+					for (const glm::vec3& corner : corners)
+						radius = glm::max(radius, glm::length(corner - center));
+				radius = ceil(radius * 16.0f) / 16.0f;
+					sliceNear = sliceFar;
+
+					// the cascade keeps its placement, and its static depth, while the slice stays inside
+					Shadow_Frame_Buffer::CascadeCache& cache = shadowfb.cascadeCache[c];
+					bool turned = cache.valid && cache.lightDir != LightDir;
+					bool replace = !RenderSettings::shadowCaching || !cache.valid || (turned && turn[c])
+						|| glm::length(center - cache.center) + radius > cache.radius
+						|| radius * RenderSettings::shadowCachePadding < cache.radius * 0.9f;
+					if (replace && turned)
+						RenderStats::shadowCascadesTurned++;
+					if (replace)
+					{
+						float padded = RenderSettings::shadowCaching ? ceil(radius * RenderSettings::shadowCachePadding * 16.0f) / 16.0f : radius;
+						// casters between the light and the slice must land in the depth range too
+						float back = padded + RenderSettings::shadowCasterMargin;
+						cache.lightView = glm::lookAt(center - LightDir * back, center, lightUp);
+						cache.lightProjection = glm::ortho(-padded, padded, -padded, padded, 0.0f, back + padded);
+						// snap the origin to whole texels, so the shadow edges do not crawl as the camera moves
+						glm::vec4 origin = cache.lightProjection * cache.lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+						glm::vec2 texel = glm::vec2(origin) * (Shadow_Frame_Buffer::CASCADE_SIZE * 0.5f);
+						glm::vec2 offset = (glm::round(texel) - texel) / (Shadow_Frame_Buffer::CASCADE_SIZE * 0.5f);
+						cache.lightProjection[3][0] += offset.x;
+						cache.lightProjection[3][1] += offset.y;
+						cache.center = center;
+						cache.radius = padded;
+						cache.lightDir = LightDir;
+						cache.valid = true;
+					}
+					glm::mat4 viewProjection = cache.lightProjection * cache.lightView;
+					shadowfb.cascadeViewProjection[c] = viewProjection;
+
+					bool patched = false;
+					if (replace)
+					{
+						shadowfb.bindCacheFrameBuffer(c);
+						glClear(GL_DEPTH_BUFFER_BIT);
+						DrawShadowCasters(shadowShader, cache, viewProjection, false);
+						RenderStats::shadowCascadesRedrawn++;
+					}
+					else
+					{
+						for (const AABB& region : GameObject::changedRegions)
+							patched = DrawShadowRegion(shadowShader, c, region) || patched;
+					}
+					shadowfb.compositeCascade(c);
+					bool dynamic = DrawShadowCasters(shadowShader, cache, viewProjection, true) > 0;
+					// the shadow map differs from last frame, what is derived from it must follow
+					changed[c] = replace || patched || dynamic || cache.hadDynamic;
+					cache.hadDynamic = dynamic;
 				}
 				shadowfb.unbindFrameBuffer();
+
+				if (RenderSettings::shadowFilter == ShadowFilter::EVSM)
+				{
+					bool updated = false;
+					for (int c = 0; c < Shadow_Frame_Buffer::CASCADES; c++)
+						if (changed[c] || !evsm.IsValid(c))
+						{
+							evsm.Update(c, shadowfb.getShadowTexture());
+							updated = true;
+							RenderStats::evsmCascadesFiltered++;
+						}
+					if (updated)
+						evsm.GenerateMipmaps();
+				}
+				else
+					evsm.Invalidate();
 				glViewport(0, 0, Common::SCR_WIDTH, Common::SCR_HEIGHT);
 				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 				
 
 			}
+
+			// DrawPointShadows: pick the point lights that get a slot of the atlas and redraw the slots
+			//   whose light moved or that a changed object touches; passes the slots to the lit shaders
+			void DrawPointShadows(Shader& modelShader, Shader& terrainShader)
+			{
+				Camera& cam = GameController::mainCamera;
+				int numLights = (int)glm::min(main_light.numOfPointLight(), (unsigned int)PointShadowAtlas::SLOTS);
+				int budget = RenderSettings::pointShadows ? glm::clamp(RenderSettings::pointShadowBudget, 0, PointShadowAtlas::SLOTS) : 0;
+
+				// importance: projected size of the light range, lights out of view get none
+				Frustum frustum(Common::GetPerspectiveMat(cam) * cam.GetViewMatrix());
+				std::vector<std::pair<float, int>> candidates;
+				float ranges[PointShadowAtlas::SLOTS];
+				for (int i = 0; i < numLights; i++)
+				{
+					PointLight* light = main_light.getPointLightAt(i);
+					ranges[i] = glm::min(LightRange(*light), RenderSettings::pointShadowMaxRange);
+					if (!frustum.Intersects(AABB(light->position - ranges[i], light->position + ranges[i])))
+						continue;
+					float dist = glm::length(light->position - cam.Position);
+					candidates.push_back({ dist <= ranges[i] ? FLT_MAX : ranges[i] / dist, i });
+				}
+				std::sort(candidates.begin(), candidates.end(), std::greater<std::pair<float, int>>());
+				if ((int)candidates.size() > budget)
+					candidates.resize(budget);
+
+				// lights that stay chosen keep their slot and its contents
+				int slotOfLight[PointShadowAtlas::SLOTS];
+				std::fill(slotOfLight, slotOfLight + PointShadowAtlas::SLOTS, -1);
+				for (int s = 0; s < PointShadowAtlas::SLOTS; s++)
+				{
+					PointShadowAtlas::Slot& slot = pointShadows.slots[s];
+					bool chosen = std::any_of(candidates.begin(), candidates.end(),
+						[&slot](const std::pair<float, int>& c) { return c.second == slot.light; });
+					if (chosen)
+						slotOfLight[slot.light] = s;
+					else
+						slot.light = -1;
+				}
+				for (const std::pair<float, int>& c : candidates)
+				{
+					if (slotOfLight[c.second] >= 0)
+						continue;
+					for (int s = 0; s < PointShadowAtlas::SLOTS; s++)
+						if (pointShadows.slots[s].light < 0)
+						{
+							pointShadows.slots[s].light = c.second;
+							pointShadows.slots[s].valid = false;
+							slotOfLight[c.second] = s;
+							break;
+						}
+				}
+
+				for (int s = 0; s < PointShadowAtlas::SLOTS; s++)
+				{
+					PointShadowAtlas::Slot& slot = pointShadows.slots[s];
+					if (slot.light < 0)
+						continue;
+					PointLight* light = main_light.getPointLightAt(slot.light);
+					float range = ranges[slot.light];
+					bool dirty = !slot.valid || slot.position != light->position || slot.range != range || slot.hadDynamic;
+					for (const AABB& region : GameObject::changedRegions)
+						dirty = dirty || IntersectSphere(light->position, range, region);
+					// a caster being placed moves every frame, the light follows it until it leaves the range
+					slot.hadDynamic = false;
+					GameObject::spatialIndex.QuerySphere(light->position, range, [&](GameObject* obj) {
+						// the tree holds fat boxes, test the tight ones
+						if (obj->IsDynamic() && IntersectSphere(light->position, range, obj->GetWorldBounds()))
+							slot.hadDynamic = dirty = true;
+					});
+					if (!dirty)
+						continue;
+					slot.position = light->position;
+					slot.range = range;
+					slot.valid = true;
+					DrawPointShadowSlot(s, slot);
+				}
+				pointShadows.unbindFrameBuffer();
+				glViewport(0, 0, Common::SCR_WIDTH, Common::SCR_HEIGHT);
+
+				glActiveTexture(GL_TEXTURE9);
+				glBindTexture(GL_TEXTURE_2D, pointShadows.getAtlasTexture());
+				glActiveTexture(GL_TEXTURE0);
+				Shader* litShaders[] = { &modelShader, &layeredShader, &terrainShader };
+				for (Shader* shader : litShaders)
+				{
+					shader->use();
+					shader->setInt("pointShadowAtlas", 9);
+					for (int i = 0; i < PointShadowAtlas::SLOTS; i++)
+					{
+						std::string index = "[" + std::to_string(i) + "]";
+						shader->setInt("pointShadowSlot" + index, i < numLights ? slotOfLight[i] : -1);
+						shader->setFloat("pointShadowRange" + index, i < numLights ? ranges[i] : 1.0f);
+					}
+				}
+				RenderStats::pointShadowLights = (unsigned int)candidates.size();
+			}
+
+			// DrawPointShadowSlot: the six faces of a slot; the slot is kept until the light or a caster in its
+			//   range changes, so the casters are culled as seen from the light, not from the camera
+			void DrawPointShadowSlot(int index, const PointShadowAtlas::Slot& slot)
+			{
+				Camera& cam = GameController::mainCamera;
+				glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, slot.range);
+				pointShadowShader.use();
+				pointShadowShader.setVec3("lightPos", slot.position);
+				pointShadowShader.setFloat("farPlane", slot.range);
+				for (int face = 0; face < PointShadowAtlas::FACES; face++)
+				{
+					glm::mat4 view = PointShadowAtlas::FaceView(slot.position, face);
+					pointShadows.bindFace(index, face);
+					for (GameObject* obj : GameObject::CollectVisible(projection * view))
+					{
+						// the lantern the light sits in would shade everything around it
+						AABB bounds = obj->GetWorldBounds();
+						if (glm::all(glm::greaterThanEqual(slot.position, bounds.min)) && glm::all(glm::lessThanEqual(slot.position, bounds.max)))
+							continue;
+						if (!IntersectSphere(slot.position, slot.range, bounds) ||
+							obj->ScreenSize(slot.position, 90.0f) * PointShadowAtlas::TILE_SIZE < RenderSettings::shadowCacheMinTexels)
+						{
+							RenderStats::policyCulled++;
+							continue;
+						}
+						RenderStats::passObjects[(int)RenderPass::Shadow]++;
+						obj->Draw(pointShadowShader, cam.Position, projection, view,
+							glm::vec4(0.0f, -1.0f, 0.0f, 999999.0f), false, CachedShadowLod(obj));
+					}
+				}
+				RenderStats::pointShadowsRedrawn++;
+			}
+
+			// SetShadowSamplers: texture units of the shadow inputs of terrain.fs and model.fs; samplers
+			//   of different types must not share a unit even before the first frame sets the rest
+			void SetShadowSamplers(Shader& shader)
+			{
+				shader.use();
+				shader.setInt("shadowMap", 5);
+				shader.setInt("pointShadowAtlas", 9);
+				shader.setInt("horizonMap", 10);
+				shader.setInt("evsmMap", 11);
+			}
+
+			// SetShadowUniforms: the cascades of this frame for terrain.fs and model.fs
+			void SetShadowUniforms(Shader& shader)
+			{
+				shader.use();
+				for (int i = 0; i < Shadow_Frame_Buffer::CASCADES; i++)
+				{
+					std::string index = "[" + std::to_string(i) + "]";
+					shader.setMat4("lightSpaceMatrices" + index, shadowfb.cascadeViewProjection[i]);
+					shader.setFloat("cascadeSplits" + index, shadowfb.cascadeSplits[i]);
+				}
+				shader.setInt("shadowFilter", (int)RenderSettings::shadowFilter);
+				shader.setFloat("evsmExponent", RenderSettings::evsmExponent);
+				shader.setFloat("evsmBleedReduction", RenderSettings::evsmBleedReduction);
+				glActiveTexture(GL_TEXTURE5);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, shadowfb.getShadowTexture());
+				glActiveTexture(GL_TEXTURE11);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, evsm.getMomentsTexture());
+				glActiveTexture(GL_TEXTURE0);
+			}
+
+			// DrawShadowCasters: the static or the dynamic casters inside viewProjection, into the bound cascade
+			//   viewProjection: volume the casters are collected from, the cascade itself or a part of it
+			//   dynamic: the dynamic casters are redrawn every frame and follow the camera's Shadow policy;
+			//            the static ones stay in the cache while the camera moves, so they are only
+			//            culled by their size in the cascade and drawn at the fixed shadowCacheLod
+			//   returns the number of casters drawn
+			unsigned int DrawShadowCasters(Shader& shadowShader, const Shadow_Frame_Buffer::CascadeCache& cache, const glm::mat4& viewProjection, bool dynamic)
+			{
+				unsigned int drawn = 0;
+				Camera& cam = GameController::mainCamera;
+				std::vector<GameObject*> casters;
+				for (GameObject* obj : GameObject::CollectVisible(viewProjection))
+					if (obj->IsDynamic() == dynamic)
+						casters.push_back(obj);
+				if (dynamic)
+					casters = CullByPolicy(casters, RenderPass::Shadow, cam.Position, cam.Zoom);
+				float texel = 2.0f * cache.radius / Shadow_Frame_Buffer::CASCADE_SIZE;
+				for (GameObject* obj : casters)
+				{
+					unsigned int lod;
+					if (dynamic) // sized from the main camera, shadows of far objects are as small as the objects
+						lod = obj->SelectLod(RenderPass::Shadow, cam.Position, cam.Zoom);
+					else
+					{
+						if (2.0f * glm::length(obj->GetWorldBounds().Extent()) < RenderSettings::shadowCacheMinTexels * texel)
+						{
+							RenderStats::policyCulled++;
+							continue;
+						}
+						lod = CachedShadowLod(obj);
+					}
+					RenderStats::passObjects[(int)RenderPass::Shadow]++;
+					drawn++;
+					obj->Draw(shadowShader, cam.Position, cache.lightProjection, cache.lightView,
+						glm::vec4(0.0f, -1.0f, 0.0f, 999999.0f), false, lod);
+				}
+				return drawn;
+			}
+			// CachedShadowLod: detail level of a static caster in a cached shadow, the same wherever the camera is
+			unsigned int CachedShadowLod(GameObject* obj)
+			{
+				return glm::min(RenderSettings::shadowCacheLod, obj->GetModel()->NumLods() - 1);
+			}
+
+			// DrawShadowRegion: redraw the static depth under a changed world box, the rest of the cascade stays
+			//   returns false when the box misses the cascade
+			bool DrawShadowRegion(Shader& shadowShader, int cascade, const AABB& region)
+			{
+				const Shadow_Frame_Buffer::CascadeCache& cache = shadowfb.cascadeCache[cascade];
+				// the footprint of the box on the cascade, in NDC
+				glm::mat4 viewProjection = cache.lightProjection * cache.lightView;
+				glm::vec2 lo(FLT_MAX), hi(-FLT_MAX);
+				for (int i = 0; i < 8; i++)
+				{
+					glm::vec3 corner(i & 1 ? region.max.x : region.min.x, i & 2 ? region.max.y : region.min.y, i & 4 ? region.max.z : region.min.z);
+					glm::vec2 p = glm::vec2(viewProjection * glm::vec4(corner, 1.0f));
+					lo = glm::min(lo, p);
+					hi = glm::max(hi, p);
+				}
+				// entirely off one side, the clamp below would still leave a one texel rectangle
+				if (hi.x < -1.0f || lo.x > 1.0f || hi.y < -1.0f || lo.y > 1.0f)
+					return false;
+				// one texel of margin for the filtering in terrain.fs
+				const float size = (float)Shadow_Frame_Buffer::CASCADE_SIZE;
+				glm::ivec2 pixelLo = glm::max(glm::ivec2(glm::floor((lo * 0.5f + 0.5f) * size)) - 1, glm::ivec2(0));
+				glm::ivec2 pixelHi = glm::min(glm::ivec2(glm::ceil((hi * 0.5f + 0.5f) * size)) + 1, glm::ivec2((int)size));
+				if (pixelHi.x <= pixelLo.x || pixelHi.y <= pixelLo.y)
+					return false;
+
+				// narrow the projection to the rectangle, so only the casters over it are collected
+				glm::vec2 ndcLo = glm::vec2(pixelLo) / size * 2.0f - 1.0f;
+				glm::vec2 ndcHi = glm::vec2(pixelHi) / size * 2.0f - 1.0f;
+				glm::mat4 toRect(1.0f);
+				toRect[0][0] = 2.0f / (ndcHi.x - ndcLo.x);
+				toRect[1][1] = 2.0f / (ndcHi.y - ndcLo.y);
+				toRect[3][0] = -(ndcHi.x + ndcLo.x) / (ndcHi.x - ndcLo.x);
+				toRect[3][1] = -(ndcHi.y + ndcLo.y) / (ndcHi.y - ndcLo.y);
+
+				shadowfb.bindCacheFrameBuffer(cascade);
+				glEnable(GL_SCISSOR_TEST);
+				glScissor(pixelLo.x, pixelLo.y, pixelHi.x - pixelLo.x, pixelHi.y - pixelLo.y);
+				glClear(GL_DEPTH_BUFFER_BIT);
+				DrawShadowCasters(shadowShader, cache, toRect * viewProjection, false);
+				glDisable(GL_SCISSOR_TEST);
+				RenderStats::shadowRegionsRedrawn++;
+				return true;
+			}
 			
     };
 }
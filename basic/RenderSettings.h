@@ -0,0 +1,399 @@
+#ifndef RENDERSETTINGS_H
+#define RENDERSETTINGS_H
+
+#include <cmath>
+
+namespace KooNan
+{
+	enum class OcclusionQueryMode
+	{
+		Off,
+		ConditionalRender, // hidden last time: query the box and let the GPU decide with glBeginConditionalRender
+		Skip // hidden last time: only query the box, draw again once a later result says visible
+	};
+
+	enum class RenderPass
+	{
+		Main, Reflection, Refraction, Shadow, Count
+	};
+
+	enum class WaterReflectionMode
+	{
+		Planar, // mirrored camera pass into Water_Frame_Buffer
+		ScreenSpace // traced through the main pass depth, sky box on misses
+	};
+
+	enum class ShadowFilter
+	{
+		PCF, // 3x3 depth comparisons per fragment
+		EVSM // exponential variance shadow maps, blurred and mipmapped once per update, see EvsmFilter
+	};
+
+	enum class AntiAliasingMode
+	{
+		Off,
+		FXAA, // one pass along the luma edges of the final image
+		SMAA, // morphological, edges, blend weights and neighbourhood blending
+		TAA, // jittered main pass accumulated over frames
+		Count
+	};
+
+	enum class QualityPreset
+	{
+		Low, Medium, High, Count
+	};
+
+	// What a pass may leave out
+	struct CullPolicy
+	{
+		float maxDistance; // objects whose bounds are further from the camera are dropped
+		float minScreenSize; // objects smaller than this fraction of the screen height are dropped
+		bool smallProps; // whether objects with a bounds radius below RenderSettings::smallPropRadius are drawn
+		bool gizmos; // whether the light cubes are drawn
+	};
+
+	// Switches and budgets of the optional rendering features
+	class RenderSettings
+	{
+	public:
+		// CPU occlusion culling of the main pass
+		static bool softwareOcclusion;
+		static unsigned int maxOccluders; // largest nearby objects rasterized per frame
+		static float occluderMaxDistance; // objects further away are never used as occluders
+		// hardware occlusion queries of the main pass
+		static OcclusionQueryMode occlusionQueryMode;
+		static unsigned int occlusionQueryMinTriangles; // only models at least this heavy are queried
+		// per pass culling
+		static CullPolicy cullPolicies[(int)RenderPass::Count];
+		static float smallPropRadius;
+
+		// distance fog, shared with terrain.vs, water.vs and VolumetricFog
+		static float fogDensity;
+		static float fogGradient;
+		static bool fogCulling; // drop objects the fog hides completely, while VolumetricFog draws it
+
+		// skip the reflection and refraction passes while no water can be seen
+		static bool waterPassSkipping;
+		// water levels smaller on screen than this reflect the skybox instead of getting their own passes
+		static float waterPlanarMinScreenSize;
+		// size of the water targets relative to the window, the DUDV distortion hides most of the loss
+		static float waterReflectionScale;
+		static float waterRefractionScale;
+		static WaterReflectionMode waterReflectionMode;
+		static float ssrScale; // size of the screen space reflection target relative to the window
+		static int ssrMaxSteps;
+		static float ssrThickness; // assumed depth of the surfaces in the depth buffer
+		// draw reflection and refraction in one traversal into a two layer target, see Render::DrawWaterLayered
+		static bool layeredWaterPasses;
+		// reuse the last reflection while the camera and the objects stay put
+		static bool reflectionAmortization;
+		static float reflectionMoveThreshold; // camera movement that forces a new reflection
+		static float reflectionTurnThreshold; // camera rotation that forces a new reflection, in degrees
+		static unsigned int reflectionMaxAge; // frames after which the reflection is redrawn anyway, catches light edits
+		// cascaded shadow map of the directional light
+		static float shadowDistance; // the last cascade ends here
+		static float cascadeSplitLambda; // 0: uniform splits, 1: logarithmic splits
+		static float shadowCasterMargin; // casters this far towards the light from a cascade still cast into it
+		// keep the static casters of each cascade and redraw only where objects changed, see Render::DrawShadowMap
+		static bool shadowCaching;
+		static float shadowCachePadding; // cascades are this much larger than their slice, room for the camera to move
+		// the cached static casters and the point shadow slots do not follow the camera: they are culled
+		// by their size in texels and drawn at one level
+		static float shadowCacheMinTexels; // casters narrower than this many texels of their cascade or slot face are left out
+		static unsigned int shadowCacheLod; // detail level of the cached casters
+		static ShadowFilter shadowFilter; // shadowFilter in terrain.fs and model.fs
+		static float evsmExponent; // depth warp, at most 42 so the squared moment stays in the float range
+		static int evsmBlurRadius; // texels of the moment maps on each side
+		static float evsmBleedReduction; // visibility below this is cut off, hides light leaking through overlapping casters
+		// shadows of the point lights, see PointShadowAtlas
+		static bool pointShadows;
+		static int pointShadowBudget; // atlas slots in use, the lights largest on screen get them
+		static float pointShadowMaxRange; // limit of the shadowed distance, for lights that barely fall off
+		// terrain self shadowing from the precomputed horizon, see HorizonMap
+		static bool horizonShadows;
+		static float horizonSearchDistance; // terrain further away does not block the sun, read when the map is computed
+		// ambient light and AO baked offline with --bake-lighting, see LightBaker
+		static bool bakedLighting; // use the bake where it still fits the scene
+		static int lightmapResolution; // terrain texels per chunk side
+		static int lightmapSamples; // hemisphere rays per texel or vertex
+		static float lightmapAoDistance; // occluders further away do not darken the AO
+		static float lightmapGroundAlbedo; // reflectance of the bounce, the textures are only on the GPU
+		static float lightmapObjectAlbedo;
+		// screen space ambient occlusion of the main pass, see AmbientOcclusion
+		static bool ssao;
+		static bool ssaoTemporal; // accumulate over frames with a turning pattern
+		static float ssaoRadius; // world size of the neighbourhood searched for occluders
+		static float ssaoIntensity;
+		static int ssaoDirections; // horizons traced per pixel
+		static int ssaoSteps; // depth samples along each horizon
+		static float ssaoHistoryBlend; // weight of the accumulated frames
+		// environment reflections of the models from placed probes, see ReflectionProbes
+		static bool reflectionProbes;
+		static int reflectionProbeSize; // face size of each probe
+		static int reflectionProbeUpdates; // captures per frame after the scene changed
+		static float reflectionProbeRoughness; // of all model surfaces, picks the prefiltered mip
+		static float reflectionProbeStrength;
+		static float reflectionProbeSunStep; // sun movement in degrees before the probes capture the sky again
+		// sun and sky from the time of day, see Atmosphere
+		static bool timeOfDay;
+		static float dayLength; // seconds per day, 0 stops the clock
+		static float sunStepDegrees; // the sun moves in steps this large, each one draws the sky again
+		static int shadowSunUpdates; // cascades turned towards a new sun per frame, the others keep the old one meanwhile
+		// HDR scene and water targets tonemapped into the window, see PostProcess
+		static bool hdr;
+		static bool bloom;
+		static int bloomLevels; // of the chain, the first is half the window
+		static float bloomThreshold; // brightness where the bloom starts
+		static float bloomKnee; // width of the soft transition around the threshold
+		static float bloomIntensity;
+		static float bloomRadius; // spread of each upsample step, in texels of the smaller level
+		static float exposure;
+		static float contrast;
+		static float saturation;
+		static bool dither; // hides the banding of the 8 bit window
+		// antialiasing of the finished frame, see AntiAliasing
+		static AntiAliasingMode antiAliasing;
+		static int msaaSamples; // of the window, read once at startup; only what is drawn straight into the window gets them
+		static float fxaaEdgeThreshold; // contrast relative to the brightest neighbour an edge needs
+		static float fxaaEdgeThresholdMin; // contrast an edge needs in dark areas
+		static float fxaaSubpixel;
+		static float smaaThreshold; // luma difference of an edge
+		static int smaaMaxSearch; // pixels followed along an edge in each direction
+		static float taaFeedback; // weight of the accumulated frames
+		// draw every mode in turn, time each and save what it looks like; keep the camera still meanwhile
+		static bool antiAliasingComparison;
+		// fog and light shafts of the sun at a quarter of the pixels, see VolumetricFog
+		static bool volumetricFog;
+		static float volumetricDistance; // the rays march through the sun cascades this far, the fog beyond is unshadowed
+		static float volumetricAnisotropy; // Henyey-Greenstein g, towards 1 the light gathers around the sun
+		static float volumetricIntensity; // scales the light the fog scatters
+		static float volumetricHistoryBlend; // weight of the accumulated frames
+		static float volumetricBudgetMs; // GPU time the steps per ray adapt to, sized for the reference machine
+		static int volumetricMinSteps;
+		static int volumetricMaxSteps;
+		// FFT waves on the sea level, see Ocean
+		static bool oceanWaves;
+		static int oceanResolution; // FFT size, a power of two
+		static float oceanPatchSize; // world size of one tile of the wave maps
+		static float oceanWindSpeed;
+		static float oceanWindAngle; // in degrees, from +x towards +z
+		static float oceanWaveHeight; // significant wave height
+		static float oceanChoppiness;
+		static float oceanFadeDistance; // the displacement fades out towards this distance from the camera
+		static float oceanGridExtent; // half size of the camera centered grid
+
+		// BakedLightingMode: bakedLighting in terrain.fs and model.fs where a bake fits; the baked
+		// ambient was lit by the sun of the bake, under the time of day only its AO still holds
+		static int BakedLightingMode()
+		{
+			return timeOfDay ? 2 : 1;
+		}
+
+		// FogCutoffDistance: distance at which the fog visibility falls below one 8 bit step
+		static float FogCutoffDistance()
+		{
+			return std::pow(std::log(255.0f), 1.0f / fogGradient) / fogDensity;
+		}
+
+		// mesh LOD selection
+		static float lodScreenSizes[3]; // LOD i + 1 is used below lodScreenSizes[i], in fractions of the screen height
+		static float lodHysteresis; // relative margin around each size before the level changes
+		static int lodBias[(int)RenderPass::Count]; // levels added per pass
+
+		// vegetation impostors
+		static bool impostors;
+		static float impostorDistance[(int)RenderPass::Count]; // impostors start this far away, per pass; the shadow pass keeps meshes
+		static float impostorFadeBand; // distance over which mesh and impostor cross-fade
+
+		// stats overlay, toggled with F3
+		static bool showStats;
+
+		// quality preset, cycled with F4
+		static QualityPreset preset;
+
+		// ApplyPreset: set the switches a preset controls, the others keep their values
+		static void ApplyPreset(QualityPreset p)
+		{
+			preset = p;
+			switch (p)
+			{
+			case QualityPreset::Low:
+				waterReflectionMode = WaterReflectionMode::ScreenSpace;
+				ssrScale = 0.25f;
+				ssrMaxSteps = 32;
+				waterRefractionScale = 0.25f;
+				oceanWaves = false;
+				pointShadowBudget = 0;
+				shadowFilter = ShadowFilter::PCF;
+				ssao = false;
+				reflectionProbeSize = 64;
+				hdr = false;
+				antiAliasing = AntiAliasingMode::FXAA;
+				volumetricFog = false;
+				break;
+			case QualityPreset::Medium:
+				waterReflectionMode = WaterReflectionMode::ScreenSpace;
+				ssrScale = 0.5f;
+				ssrMaxSteps = 48;
+				waterRefractionScale = 0.5f;
+				oceanWaves = true;
+				oceanResolution = 64;
+				pointShadowBudget = 2;
+				shadowFilter = ShadowFilter::EVSM;
+				ssao = true;
+				ssaoTemporal = false;
+				reflectionProbeSize = 128;
+				hdr = true;
+				bloom = true;
+				bloomLevels = 4;
+				antiAliasing = AntiAliasingMode::SMAA;
+				volumetricFog = true;
+				volumetricMaxSteps = 16;
+				break;
+			default:
+				waterReflectionMode = WaterReflectionMode::Planar;
+				waterReflectionScale = 0.5f;
+				waterRefractionScale = 0.5f;
+				oceanWaves = true;
+				oceanResolution = 128;
+				pointShadowBudget = 4;
+				shadowFilter = ShadowFilter::EVSM;
+				ssao = true;
+				ssaoTemporal = true;
+				reflectionProbeSize = 128;
+				hdr = true;
+				bloom = true;
+				bloomLevels = 6;
+				antiAliasing = AntiAliasingMode::TAA;
+				volumetricFog = true;
+				volumetricMaxSteps = 32;
+				break;
+			}
+		}
+		static const char* PresetName(QualityPreset p)
+		{
+			static const char* names[] = { "Low", "Medium", "High" };
+			return names[(int)p];
+		}
+		static const char* AntiAliasingName(AntiAliasingMode m)
+		{
+			static const char* names[] = { "Off", "FXAA", "SMAA", "TAA" };
+			return names[(int)m];
+		}
+	};
+
+	bool RenderSettings::softwareOcclusion = true;
+	unsigned int RenderSettings::maxOccluders = 16;
+	float RenderSettings::occluderMaxDistance = 150.0f;
+	OcclusionQueryMode RenderSettings::occlusionQueryMode = OcclusionQueryMode::ConditionalRender;
+	unsigned int RenderSettings::occlusionQueryMinTriangles = 20000;
+	CullPolicy RenderSettings::cullPolicies[(int)RenderPass::Count] = {
+		{ 1000.0f, 0.002f, true, true }, // Main
+		{ 250.0f, 0.02f, false, false }, // Reflection, distorted by the DUDV map anyway
+		{ 150.0f, 0.02f, false, false }, // Refraction, also darkened with depth
+		{ 300.0f, 0.005f, true, false } // Shadow, measured from the main camera
+	};
+	float RenderSettings::smallPropRadius = 0.5f;
+	float RenderSettings::fogDensity = 0.001f;
+	float RenderSettings::fogGradient = 1.5f;
+	bool RenderSettings::fogCulling = true;
+	bool RenderSettings::waterPassSkipping = true;
+	float RenderSettings::waterPlanarMinScreenSize = 0.1f;
+	float RenderSettings::waterReflectionScale = 0.5f;
+	float RenderSettings::waterRefractionScale = 0.5f;
+	WaterReflectionMode RenderSettings::waterReflectionMode = WaterReflectionMode::Planar;
+	float RenderSettings::ssrScale = 0.5f;
+	int RenderSettings::ssrMaxSteps = 48;
+	float RenderSettings::ssrThickness = 1.5f;
+	bool RenderSettings::layeredWaterPasses = false;
+	bool RenderSettings::reflectionAmortization = true;
+	float RenderSettings::reflectionMoveThreshold = 0.05f;
+	float RenderSettings::reflectionTurnThreshold = 0.25f;
+	unsigned int RenderSettings::reflectionMaxAge = 30;
+	float RenderSettings::shadowDistance = 300.0f;
+	float RenderSettings::cascadeSplitLambda = 0.75f;
+	float RenderSettings::shadowCasterMargin = 100.0f;
+	bool RenderSettings::shadowCaching = true;
+	float RenderSettings::shadowCachePadding = 1.25f;
+	float RenderSettings::shadowCacheMinTexels = 1.0f;
+	unsigned int RenderSettings::shadowCacheLod = 1;
+	ShadowFilter RenderSettings::shadowFilter = ShadowFilter::EVSM;
+	float RenderSettings::evsmExponent = 40.0f;
+	int RenderSettings::evsmBlurRadius = 2;
+	float RenderSettings::evsmBleedReduction = 0.2f;
+	bool RenderSettings::pointShadows = true;
+	int RenderSettings::pointShadowBudget = 4;
+	float RenderSettings::pointShadowMaxRange = 50.0f;
+	bool RenderSettings::horizonShadows = true;
+	float RenderSettings::horizonSearchDistance = 128.0f;
+	bool RenderSettings::bakedLighting = true;
+	int RenderSettings::lightmapResolution = 256;
+	int RenderSettings::lightmapSamples = 256;
+	float RenderSettings::lightmapAoDistance = 4.0f;
+	float RenderSettings::lightmapGroundAlbedo = 0.3f;
+	float RenderSettings::lightmapObjectAlbedo = 0.5f;
+	bool RenderSettings::ssao = true;
+	bool RenderSettings::ssaoTemporal = true;
+	float RenderSettings::ssaoRadius = 1.0f;
+	float RenderSettings::ssaoIntensity = 1.0f;
+	int RenderSettings::ssaoDirections = 4;
+	int RenderSettings::ssaoSteps = 4;
+	float RenderSettings::ssaoHistoryBlend = 0.9f;
+	bool RenderSettings::reflectionProbes = true;
+	int RenderSettings::reflectionProbeSize = 128;
+	int RenderSettings::reflectionProbeUpdates = 1;
+	float RenderSettings::reflectionProbeRoughness = 0.3f;
+	float RenderSettings::reflectionProbeStrength = 1.0f;
+	float RenderSettings::reflectionProbeSunStep = 3.0f;
+	bool RenderSettings::timeOfDay = true;
+	float RenderSettings::dayLength = 1200.0f;
+	float RenderSettings::sunStepDegrees = 0.25f;
+	int RenderSettings::shadowSunUpdates = 1;
+	bool RenderSettings::hdr = true;
+	bool RenderSettings::bloom = true;
+	int RenderSettings::bloomLevels = 6;
+	float RenderSettings::bloomThreshold = 1.0f;
+	float RenderSettings::bloomKnee = 0.5f;
+	float RenderSettings::bloomIntensity = 0.15f;
+	float RenderSettings::bloomRadius = 1.0f;
+	float RenderSettings::exposure = 1.0f;
+	float RenderSettings::contrast = 1.0f;
+	float RenderSettings::saturation = 1.0f;
+	bool RenderSettings::dither = true;
+	AntiAliasingMode RenderSettings::antiAliasing = AntiAliasingMode::TAA;
+	int RenderSettings::msaaSamples = 0;
+	float RenderSettings::fxaaEdgeThreshold = 0.125f;
+	float RenderSettings::fxaaEdgeThresholdMin = 0.0312f;
+	float RenderSettings::fxaaSubpixel = 0.75f;
+	float RenderSettings::smaaThreshold = 0.1f;
+	int RenderSettings::smaaMaxSearch = 16;
+	float RenderSettings::taaFeedback = 0.9f;
+	bool RenderSettings::antiAliasingComparison = false;
+	bool RenderSettings::volumetricFog = true;
+	float RenderSettings::volumetricDistance = 300.0f;
+	float RenderSettings::volumetricAnisotropy = 0.6f;
+	float RenderSettings::volumetricIntensity = 1.0f;
+	float RenderSettings::volumetricHistoryBlend = 0.9f;
+	float RenderSettings::volumetricBudgetMs = 1.0f;
+	int RenderSettings::volumetricMinSteps = 8;
+	int RenderSettings::volumetricMaxSteps = 32;
+	bool RenderSettings::oceanWaves = true;
+	int RenderSettings::oceanResolution = 128;
+	float RenderSettings::oceanPatchSize = 64.0f;
+	float RenderSettings::oceanWindSpeed = 8.0f;
+	float RenderSettings::oceanWindAngle = 30.0f;
+	float RenderSettings::oceanWaveHeight = 0.4f;
+	float RenderSettings::oceanChoppiness = 1.0f;
+	float RenderSettings::oceanFadeDistance = 150.0f;
+	float RenderSettings::oceanGridExtent = 500.0f;
+	float RenderSettings::lodScreenSizes[3] = { 0.35f, 0.15f, 0.05f };
+	float RenderSettings::lodHysteresis = 0.15f;
+	int RenderSettings::lodBias[(int)RenderPass::Count] = { 0, 1, 1, 1 };
+	bool RenderSettings::impostors = true;
+	float RenderSettings::impostorDistance[(int)RenderPass::Count] = { 60.0f, 30.0f, 30.0f, 0.0f };
+	float RenderSettings::impostorFadeBand = 10.0f;
+	bool RenderSettings::showStats = false;
+	QualityPreset RenderSettings::preset = QualityPreset::High;
+}
+
+#endif // !RENDERSETTINGS_H
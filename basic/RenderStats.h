@@ -0,0 +1,123 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <RenderSettings.h>
+
+namespace KooNan
+{
+	// Per frame counters shown by the stats overlay
+	class RenderStats
+	{
+	public:
+		static unsigned int passObjects[(int)RenderPass::Count]; // objects submitted by each pass
+		static unsigned int policyCulled; // objects dropped by the cull policies of all passes
+		static unsigned int objectsOccludedCPU; // main pass objects removed by the CPU occlusion culler
+		static unsigned int clipCulled; // water pass objects entirely on the clipped side of the water plane
+		static unsigned int waterLevels; // distinct water heights in the scene
+		static unsigned int waterLevelsSkipped; // levels that kept their reflection and refraction from an earlier frame
+		static unsigned int waterLevelsSkyOnly; // levels too small on screen for their own passes
+		static unsigned int reflectionsReused; // reflections kept because the view did not change enough
+		static bool waterPassesLayered; // both water views came from one layered traversal
+		static float passGpuMs[(int)RenderPass::Count]; // GPU time of each pass, a few frames old; 0 when the pass did not run
+		static float oceanCpuMs; // wave simulation of this frame, 0 when the waves are off
+		static unsigned int shadowCascadesRedrawn; // cascades whose static depth was drawn again from scratch
+		static unsigned int shadowRegionsRedrawn; // changed regions patched into the cached static depth
+		static unsigned int evsmCascadesFiltered; // cascades whose moments were blurred again
+		static unsigned int pointShadowLights; // point lights holding a slot of the shadow atlas
+		static unsigned int pointShadowsRedrawn; // slots whose six faces were drawn this frame
+		static unsigned int horizonTexelsUpdated; // horizon samples recomputed after terrain edits
+		static float horizonCpuMs;
+		static float ssaoGpuMs; // depth prepass, occlusion and resolve, a few frames old; 0 when off
+		static unsigned int probesCaptured; // reflection probes drawn and prefiltered this frame
+		static float bloomDownGpuMs; // the steps of PostProcess, a few frames old; 0 when they did not run
+		static float bloomUpGpuMs;
+		static float tonemapGpuMs;
+		static float antiAliasingGpuMs; // of AntiAliasing, a few frames old; 0 when off
+		static float volumetricGpuMs; // of VolumetricFog, a few frames old; 0 when off
+		static int volumetricSteps; // per ray, fitted to RenderSettings::volumetricBudgetMs
+		// results of the last antialiasing comparison, kept across frames; -1 when none ran yet
+		static float antiAliasingCompareMs[(int)AntiAliasingMode::Count];
+		static int antiAliasingCompareMode; // mode drawn by the running comparison, -1 when none runs
+		static bool skyUpdated; // the sun moved a step, the sky view table and the light were made again
+		static unsigned int shadowCascadesTurned; // cascades redrawn for a new sun direction, part of shadowCascadesRedrawn
+		// hardware occlusion queries
+		static unsigned int heavyDrawn; // heavy objects drawn because they were visible last time
+		static unsigned int heavyConditional; // heavy objects left to conditional rendering
+		static unsigned int heavySkipped; // heavy objects not drawn at all
+		static unsigned int queriesIssued;
+		static unsigned int queryResults; // results read back this frame
+		static unsigned int queryOccluded; // results that reported no visible sample
+
+		// BeginFrame: reset all counters, call once before rendering a frame
+		static void BeginFrame()
+		{
+			for (unsigned int& n : passObjects)
+				n = 0;
+			policyCulled = objectsOccludedCPU = clipCulled = 0;
+			waterLevels = waterLevelsSkipped = waterLevelsSkyOnly = reflectionsReused = 0;
+			waterPassesLayered = false;
+			for (float& ms : passGpuMs)
+				ms = 0.0f;
+			oceanCpuMs = 0.0f;
+			shadowCascadesRedrawn = shadowRegionsRedrawn = evsmCascadesFiltered = 0;
+			pointShadowLights = pointShadowsRedrawn = 0;
+			horizonTexelsUpdated = 0;
+			horizonCpuMs = 0.0f;
+			ssaoGpuMs = 0.0f;
+			probesCaptured = 0;
+			bloomDownGpuMs = bloomUpGpuMs = tonemapGpuMs = 0.0f;
+			antiAliasingGpuMs = 0.0f;
+			volumetricGpuMs = 0.0f;
+			volumetricSteps = 0;
+			skyUpdated = false;
+			shadowCascadesTurned = 0;
+			heavyDrawn = heavyConditional = heavySkipped = 0;
+			queriesIssued = queryResults = queryOccluded = 0;
+		}
+
+		// QueryHitRate: fraction of query results that reported the object hidden
+		static float QueryHitRate()
+		{
+			return queryResults == 0 ? 0.0f : (float)queryOccluded / queryResults;
+		}
+	};
+
+	unsigned int RenderStats::passObjects[(int)RenderPass::Count] = {};
+	unsigned int RenderStats::policyCulled = 0;
+	unsigned int RenderStats::objectsOccludedCPU = 0;
+	unsigned int RenderStats::clipCulled = 0;
+	unsigned int RenderStats::waterLevels = 0;
+	unsigned int RenderStats::waterLevelsSkipped = 0;
+	unsigned int RenderStats::waterLevelsSkyOnly = 0;
+	unsigned int RenderStats::reflectionsReused = 0;
+	bool RenderStats::waterPassesLayered = false;
+	float RenderStats::passGpuMs[(int)RenderPass::Count] = {};
+	float RenderStats::oceanCpuMs = 0.0f;
+	unsigned int RenderStats::shadowCascadesRedrawn = 0;
+	unsigned int RenderStats::shadowRegionsRedrawn = 0;
+	unsigned int RenderStats::evsmCascadesFiltered = 0;
+	unsigned int RenderStats::pointShadowLights = 0;
+	unsigned int RenderStats::pointShadowsRedrawn = 0;
+	unsigned int RenderStats::horizonTexelsUpdated = 0;
+	float RenderStats::horizonCpuMs = 0.0f;
+	float RenderStats::ssaoGpuMs = 0.0f;
+	unsigned int RenderStats::probesCaptured = 0;
+	float RenderStats::bloomDownGpuMs = 0.0f;
+	float RenderStats::bloomUpGpuMs = 0.0f;
+	float RenderStats::tonemapGpuMs = 0.0f;
+	float RenderStats::antiAliasingGpuMs = 0.0f;
+	float RenderStats::volumetricGpuMs = 0.0f;
+	int RenderStats::volumetricSteps = 0;
+	float RenderStats::antiAliasingCompareMs[(int)AntiAliasingMode::Count] = { -1.0f, -1.0f, -1.0f, -1.0f };
+	int RenderStats::antiAliasingCompareMode = -1;
+	bool RenderStats::skyUpdated = false;
+	unsigned int RenderStats::shadowCascadesTurned = 0;
+	unsigned int RenderStats::heavyDrawn = 0;
+	unsigned int RenderStats::heavyConditional = 0;
+	unsigned int RenderStats::heavySkipped = 0;
+	unsigned int RenderStats::queriesIssued = 0;
+	unsigned int RenderStats::queryResults = 0;
+	unsigned int RenderStats::queryOccluded = 0;
+}
+
+#endif // !RENDERSTATS_H
@@ -0,0 +1,135 @@
+#ifndef SCENE_FRAME_BUFFER_H
+#define SCENE_FRAME_BUFFER_H
+
+#include <glad/glad.h>
+#include <common.h>
+#include <Shader.h>
+#include <RenderSettings.h>
+
+namespace KooNan
+{
+	// Offscreen color and depth target of the main pass, for effects that read the
+	// finished scene back and for the HDR pipeline. Follows the window size. present()
+	// copies it to the window with a full screen triangle, glBlitFramebuffer cannot
+	// write into the multisampled default framebuffer.
+	class Scene_Frame_Buffer
+	{
+	private:
+		unsigned int frameBuffer;
+		unsigned int colorTexture;
+		unsigned int depthTexture;
+		unsigned int emptyVAO; // the full screen triangle comes from gl_VertexID
+		int width, height;
+		GLint colorFormat;
+		Shader presentShader;
+	public:
+		// ColorFormat: of the scene colors in every target drawn before the tonemapping
+		static GLint ColorFormat()
+		{
+			return RenderSettings::hdr ? GL_R11F_G11F_B10F : GL_RGB;
+		}
+
+		Scene_Frame_Buffer() : width(0), height(0), colorFormat(0), presentShader("landscape/fullscreen.vs", "landscape/present.fs")
+		{
+			glGenFramebuffers(1, &frameBuffer);
+			glGenTextures(1, &colorTexture);
+			glGenTextures(1, &depthTexture);
+			glGenVertexArrays(1, &emptyVAO);
+			fitToWindow();
+			glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTexture, 0);
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+			glDrawBuffer(GL_COLOR_ATTACHMENT0);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
+		void cleanUp()
+		{
+			glDeleteFramebuffers(1, &frameBuffer);
+			glDeleteTextures(1, &colorTexture);
+			glDeleteTextures(1, &depthTexture);
+			glDeleteVertexArrays(1, &emptyVAO);
+		}
+
+		void bindFrameBuffer()
+		{
+			fitToWindow();
+			glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+			glViewport(0, 0, width, height);
+		}
+		void unbindFrameBuffer()
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, Common::SCR_WIDTH, Common::SCR_HEIGHT);
+		}
+
+		// present: copy the color to the window, leaves the window bound
+		void present()
+		{
+			unbindFrameBuffer();
+			GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST), blend = glIsEnabled(GL_BLEND), clip = glIsEnabled(GL_CLIP_DISTANCE0);
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
+			glDisable(GL_CLIP_DISTANCE0);
+			presentShader.use();
+			presentShader.setInt("image", 0);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, colorTexture);
+			drawFullScreen();
+			if (depthTest) glEnable(GL_DEPTH_TEST);
+			if (blend) glEnable(GL_BLEND);
+			if (clip) glEnable(GL_CLIP_DISTANCE0);
+		}
+
+		// drawFullScreen: one triangle covering the viewport, for shaders built on landscape/fullscreen.vs
+		void drawFullScreen()
+		{
+			glBindVertexArray(emptyVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glBindVertexArray(0);
+		}
+
+		unsigned int getColorTexture()
+		{
+			return colorTexture;
+		}
+		unsigned int getDepthTexture()
+		{
+			return depthTexture;
+		}
+		int getWidth()
+		{
+			return width;
+		}
+		int getHeight()
+		{
+			return height;
+		}
+
+	private:
+		void fitToWindow()
+		{
+			int w = Common::SCR_WIDTH > 0 ? Common::SCR_WIDTH : 1;
+			int h = Common::SCR_HEIGHT > 0 ? Common::SCR_HEIGHT : 1;
+			if (w == width && h == height && colorFormat == ColorFormat())
+				return;
+			width = w;
+			height = h;
+			colorFormat = ColorFormat();
+			glBindTexture(GL_TEXTURE_2D, colorTexture);
+			glTexImage2D(GL_TEXTURE_2D, 0, colorFormat, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glBindTexture(GL_TEXTURE_2D, depthTexture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+	};
+}
+
+#endif // !SCENE_FRAME_BUFFER_H
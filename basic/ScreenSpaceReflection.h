@@ -0,0 +1,112 @@
+#ifndef SCREEN_SPACE_REFLECTION_H
+#define SCREEN_SPACE_REFLECTION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <common.h>
+#include <Shader.h>
+#include <SceneFrameBuffer.h>
+#include <RenderSettings.h>
+
+namespace KooNan
+{
+	// Water reflection traced through the depth and color of the main pass, at
+	// RenderSettings::ssrScale of the window. The result is indexed by screen
+	// coordinates, water.fs reads it when reflectionMode is 1.
+	class ScreenSpaceReflection
+	{
+	private:
+		unsigned int frameBuffer;
+		unsigned int reflectionTexture;
+		int width, height;
+		GLint colorFormat;
+		Shader ssrShader;
+	public:
+		ScreenSpaceReflection() : width(0), height(0), colorFormat(0), ssrShader("landscape/fullscreen.vs", "landscape/ssr.fs")
+		{
+			glGenFramebuffers(1, &frameBuffer);
+			glGenTextures(1, &reflectionTexture);
+			fitToWindow();
+			glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, reflectionTexture, 0);
+			glDrawBuffer(GL_COLOR_ATTACHMENT0);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
+		void cleanUp()
+		{
+			glDeleteFramebuffers(1, &frameBuffer);
+			glDeleteTextures(1, &reflectionTexture);
+		}
+
+		// Draw: trace the reflection of the water plane, leaves the window bound
+		//   scene: main pass target holding the finished opaque scene
+		//   skyboxCubeMap: fallback for rays leaving the screen
+		void Draw(Scene_Frame_Buffer& scene, unsigned int skyboxCubeMap, const glm::mat4& projection, const glm::mat4& view, float waterHeight)
+		{
+			fitToWindow();
+			glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+			glViewport(0, 0, width, height);
+			GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST), blend = glIsEnabled(GL_BLEND), clip = glIsEnabled(GL_CLIP_DISTANCE0);
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
+			glDisable(GL_CLIP_DISTANCE0);
+
+			ssrShader.use();
+			ssrShader.setMat4("projection", projection);
+			ssrShader.setMat4("view", view);
+			ssrShader.setMat4("invProjection", glm::inverse(projection));
+			ssrShader.setMat4("invView", glm::inverse(view));
+			ssrShader.setFloat("waterHeight", waterHeight);
+			ssrShader.setFloat("nearPlane", Common::perspective_clipping_near);
+			ssrShader.setFloat("farPlane", Common::perspective_clipping_far);
+			ssrShader.setInt("maxSteps", RenderSettings::ssrMaxSteps);
+			ssrShader.setFloat("thickness", RenderSettings::ssrThickness);
+			ssrShader.setInt("sceneColor", 0);
+			ssrShader.setInt("sceneDepth", 1);
+			ssrShader.setInt("skybox", 2);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, scene.getColorTexture());
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, scene.getDepthTexture());
+			glActiveTexture(GL_TEXTURE2);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxCubeMap);
+			scene.drawFullScreen();
+			glActiveTexture(GL_TEXTURE0);
+
+			if (depthTest) glEnable(GL_DEPTH_TEST);
+			if (blend) glEnable(GL_BLEND);
+			if (clip) glEnable(GL_CLIP_DISTANCE0);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, Common::SCR_WIDTH, Common::SCR_HEIGHT);
+		}
+
+		unsigned int getReflectionTexture()
+		{
+			return reflectionTexture;
+		}
+
+	private:
+		void fitToWindow()
+		{
+			int w = (int)(Common::SCR_WIDTH * RenderSettings::ssrScale + 0.5f);
+			int h = (int)(Common::SCR_HEIGHT * RenderSettings::ssrScale + 0.5f);
+			w = w > 0 ? w : 1;
+			h = h > 0 ? h : 1;
+			if (w == width && h == height && colorFormat == Scene_Frame_Buffer::ColorFormat())
+				return;
+			width = w;
+			height = h;
+			colorFormat = Scene_Frame_Buffer::ColorFormat();
+			glBindTexture(GL_TEXTURE_2D, reflectionTexture);
+			glTexImage2D(GL_TEXTURE_2D, 0, colorFormat, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+	};
+}
+
+#endif // !SCREEN_SPACE_REFLECTION_H
@@ -0,0 +1,400 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <Bounds.h>
+
+#include <vector>
+#include <cassert>
+
+namespace KooNan
+{
+	// Dynamic AABB tree (incrementally balanced BVH) over scene objects.
+	// Leaves store a "fat" box so that small moves don't touch the tree;
+	// proxies are reinserted only when an object leaves its fat box.
+	template<typename T>
+	class AABBTree
+	{
+	public:
+		static const int NullNode = -1;
+		// the tree is kept height balanced, so a depth first walk never holds more than height + 1 nodes
+		static const int StackSize = 64;
+	private:
+		struct Node
+		{
+			AABB box;
+			T* userData;
+			int parent; // doubles as the next pointer of the free list
+			int child1;
+			int child2;
+			int height; // leaf = 0, free node = -1
+			bool IsLeaf() const { return child1 == NullNode; }
+		};
+		std::vector<Node> nodes;
+		int root;
+		int freeList;
+		int proxyCount;
+		float fatMargin;
+	public:
+		AABBTree(float fatMargin = 0.2f) : root(NullNode), freeList(NullNode), proxyCount(0), fatMargin(fatMargin) {}
+
+		// CreateProxy: insert a box into the tree
+		//   box: tight world bounds
+		//   userData: object the proxy belongs to
+		//   返回proxy id
+		int CreateProxy(const AABB& box, T* userData)
+		{
+			int proxyId = AllocateNode();
+			glm::vec3 margin(fatMargin);
+			nodes[proxyId].box = AABB(box.min - margin, box.max + margin);
+			nodes[proxyId].userData = userData;
+			nodes[proxyId].height = 0;
+			InsertLeaf(proxyId);
+			proxyCount++;
+			return proxyId;
+		}
+
+		void DestroyProxy(int proxyId)
+		{
+			assert(0 <= proxyId && proxyId < (int)nodes.size() && nodes[proxyId].IsLeaf());
+			RemoveLeaf(proxyId);
+			FreeNode(proxyId);
+			proxyCount--;
+		}
+
+		// MoveProxy: refit a proxy after its object was transformed
+		//   返回是否重新插入了树
+		bool MoveProxy(int proxyId, const AABB& box)
+		{
+			assert(0 <= proxyId && proxyId < (int)nodes.size() && nodes[proxyId].IsLeaf());
+			if (nodes[proxyId].box.Contains(box))
+			{
+				// still inside the fat box, but shrink it back if the object got much smaller
+				glm::vec3 margin(4.0f * fatMargin);
+				AABB loose(box.min - margin, box.max + margin);
+				if (loose.Contains(nodes[proxyId].box))
+					return false;
+			}
+			RemoveLeaf(proxyId);
+			glm::vec3 margin(fatMargin);
+			nodes[proxyId].box = AABB(box.min - margin, box.max + margin);
+			InsertLeaf(proxyId);
+			return true;
+		}
+
+		T* GetUserData(int proxyId) const
+		{
+			return nodes[proxyId].userData;
+		}
+		const AABB& GetFatAABB(int proxyId) const
+		{
+			return nodes[proxyId].box;
+		}
+		int GetProxyCount() const
+		{
+			return proxyCount;
+		}
+		int GetHeight() const
+		{
+			return root == NullNode ? 0 : nodes[root].height;
+		}
+
+		// QueryFrustum: call callback(T*) for every proxy touching the frustum
+		//   subtrees fully inside the frustum are reported without further plane tests
+		template<typename Func>
+		void QueryFrustum(const Frustum& frustum, Func callback) const
+		{
+			if (root == NullNode) return;
+			int stack[StackSize];
+			int top = 0;
+			stack[top++] = root;
+			while (top > 0)
+			{
+				int id = stack[--top];
+				const Node& node = nodes[id];
+				FrustumTest t = frustum.Test(node.box);
+				if (t == FrustumTest::Outside)
+					continue;
+				if (node.IsLeaf())
+					callback(node.userData);
+				else if (t == FrustumTest::Inside)
+					ReportSubtree(id, callback);
+				else
+				{
+					assert(top + 2 <= StackSize);
+					stack[top++] = node.child1;
+					stack[top++] = node.child2;
+				}
+			}
+		}
+
+		// QueryBox: call callback(T*) for every proxy overlapping box
+		template<typename Func>
+		void QueryBox(const AABB& box, Func callback) const
+		{
+			Traverse([&box](const AABB& b) { return b.Intersects(box); }, callback);
+		}
+
+		// QuerySphere: call callback(T*) for every proxy overlapping the sphere
+		template<typename Func>
+		void QuerySphere(const glm::vec3& center, float radius, Func callback) const
+		{
+			Traverse([&center, radius](const AABB& b) { return IntersectSphere(center, radius, b); }, callback);
+		}
+
+		// QueryRay: call callback(T*, tEnter) for every proxy hit by the ray
+		//   callback returns the new far limit of the ray (return tEnter to clip, maxT to continue)
+		template<typename Func>
+		void QueryRay(const Ray& ray, float maxT, Func callback) const
+		{
+			if (root == NullNode) return;
+			int stack[StackSize];
+			int top = 0;
+			stack[top++] = root;
+			while (top > 0)
+			{
+				int id = stack[--top];
+				const Node& node = nodes[id];
+				float tHit;
+				if (!IntersectRay(ray, node.box, maxT, tHit))
+					continue;
+				if (node.IsLeaf())
+				{
+					float t = callback(node.userData, tHit);
+					if (t < maxT) maxT = t;
+					if (maxT <= 0.0f) return;
+				}
+				else
+				{
+					assert(top + 2 <= StackSize);
+					stack[top++] = node.child1;
+					stack[top++] = node.child2;
+				}
+			}
+		}
+
+	private:
+		template<typename Pred, typename Func>
+		void Traverse(Pred overlaps, Func callback) const
+		{
+			if (root == NullNode) return;
+			int stack[StackSize];
+			int top = 0;
+			stack[top++] = root;
+			while (top > 0)
+			{
+				int id = stack[--top];
+				const Node& node = nodes[id];
+				if (!overlaps(node.box))
+					continue;
+				if (node.IsLeaf())
+					callback(node.userData);
+				else
+				{
+					assert(top + 2 <= StackSize);
+					stack[top++] = node.child1;
+					stack[top++] = node.child2;
+				}
+			}
+		}
+
+		template<typename Func>
+		void ReportSubtree(int id, Func callback) const
+		{
+			const Node& node = nodes[id];
+			if (node.IsLeaf())
+			{
+				callback(node.userData);
+				return;
+			}
+			ReportSubtree(node.child1, callback);
+			ReportSubtree(node.child2, callback);
+		}
+
+		int AllocateNode()
+		{
+			int id;
+			if (freeList == NullNode)
+			{
+				nodes.push_back(Node());
+				id = (int)nodes.size() - 1;
+			}
+			else
+			{
+				id = freeList;
+				freeList = nodes[id].parent;
+			}
+			nodes[id].parent = NullNode;
+			nodes[id].child1 = NullNode;
+			nodes[id].child2 = NullNode;
+			nodes[id].height = 0;
+			nodes[id].userData = nullptr;
+			return id;
+		}
+
+		void FreeNode(int id)
+		{
+			nodes[id].parent = freeList;
+			nodes[id].height = -1;
+			freeList = id;
+		}
+
+		// Branch and bound descent using the surface area heuristic
+		void InsertLeaf(int leaf)
+		{
+			if (root == NullNode)
+			{
+				root = leaf;
+				nodes[root].parent = NullNode;
+				return;
+			}
+
+			AABB leafBox = nodes[leaf].box;
+			int index = root;
+			while (!nodes[index].IsLeaf())
+			{
+				int child1 = nodes[index].child1;
+				int child2 = nodes[index].child2;
+				float area = nodes[index].box.SurfaceArea();
+				float combinedArea = AABB::Merge(nodes[index].box, leafBox).SurfaceArea();
+				// cost of creating a new parent for this node and the new leaf
+				float cost = 2.0f * combinedArea;
+				// minimum cost of pushing the leaf further down the tree
+				float inheritanceCost = 2.0f * (combinedArea - area);
+				float cost1 = DescendCost(child1, leafBox) + inheritanceCost;
+				float cost2 = DescendCost(child2, leafBox) + inheritanceCost;
+				if (cost < cost1 && cost < cost2)
+					break;
+				index = cost1 < cost2 ? child1 : child2;
+			}
+
+			int sibling = index;
+			int oldParent = nodes[sibling].parent;
+			int newParent = AllocateNode();
+			nodes[newParent].parent = oldParent;
+			nodes[newParent].box = AABB::Merge(leafBox, nodes[sibling].box);
+			nodes[newParent].height = nodes[sibling].height + 1;
+			nodes[newParent].child1 = sibling;
+			nodes[newParent].child2 = leaf;
+			nodes[sibling].parent = newParent;
+			nodes[leaf].parent = newParent;
+			if (oldParent != NullNode)
+			{
+				if (nodes[oldParent].child1 == sibling)
+					nodes[oldParent].child1 = newParent;
+				else
+					nodes[oldParent].child2 = newParent;
+			}
+			else
+				root = newParent;
+
+			RefitFrom(nodes[leaf].parent);
+		}
+
+		float DescendCost(int child, const AABB& leafBox) const
+		{
+			AABB merged = AABB::Merge(leafBox, nodes[child].box);
+			if (nodes[child].IsLeaf())
+				return merged.SurfaceArea();
+			return merged.SurfaceArea() - nodes[child].box.SurfaceArea();
+		}
+
+		void RemoveLeaf(int leaf)
+		{
+			if (leaf == root)
+			{
+				root = NullNode;
+				return;
+			}
+			int parent = nodes[leaf].parent;
+			int grandParent = nodes[parent].parent;
+			int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+			if (grandParent != NullNode)
+			{
+				if (nodes[grandParent].child1 == parent)
+					nodes[grandParent].child1 = sibling;
+				else
+					nodes[grandParent].child2 = sibling;
+				nodes[sibling].parent = grandParent;
+				FreeNode(parent);
+				RefitFrom(grandParent);
+			}
+			else
+			{
+				root = sibling;
+				nodes[sibling].parent = NullNode;
+				FreeNode(parent);
+			}
+		}
+
+		// walk back up the tree fixing heights and boxes
+		void RefitFrom(int index)
+		{
+			while (index != NullNode)
+			{
+				index = Balance(index);
+				int child1 = nodes[index].child1;
+				int child2 = nodes[index].child2;
+				nodes[index].height = 1 + (nodes[child1].height > nodes[child2].height ? nodes[child1].height : nodes[child2].height);
+				nodes[index].box = AABB::Merge(nodes[child1].box, nodes[child2].box);
+				index = nodes[index].parent;
+			}
+		}
+
+		// Perform a left or right rotation if node A is imbalanced
+		//   返回新的子树根
+		int Balance(int iA)
+		{
+			Node& A = nodes[iA];
+			if (A.IsLeaf() || A.height < 2)
+				return iA;
+			int iB = A.child1;
+			int iC = A.child2;
+			int balance = nodes[iC].height - nodes[iB].height;
+			if (balance > 1)
+				return Rotate(iA, iC, iB);
+			if (balance < -1)
+				return Rotate(iA, iB, iC);
+			return iA;
+		}
+
+		// promote child "up" of A over its sibling "other"
+		int Rotate(int iA, int iUp, int iOther)
+		{
+			Node& A = nodes[iA];
+			Node& U = nodes[iUp];
+			int iF = U.child1;
+			int iG = U.child2;
+
+			U.child1 = iA;
+			U.parent = A.parent;
+			A.parent = iUp;
+			if (U.parent != NullNode)
+			{
+				if (nodes[U.parent].child1 == iA)
+					nodes[U.parent].child1 = iUp;
+				else
+					nodes[U.parent].child2 = iUp;
+			}
+			else
+				root = iUp;
+
+			// keep the taller grandchild under U, move the other one under A
+			int keep = nodes[iF].height > nodes[iG].height ? iF : iG;
+			int give = keep == iF ? iG : iF;
+			U.child2 = keep;
+			if (A.child1 == iUp)
+				A.child1 = give;
+			else
+				A.child2 = give;
+			nodes[give].parent = iA;
+
+			A.box = AABB::Merge(nodes[iOther].box, nodes[give].box);
+			U.box = AABB::Merge(A.box, nodes[keep].box);
+			A.height = 1 + (nodes[iOther].height > nodes[give].height ? nodes[iOther].height : nodes[give].height);
+			U.height = 1 + (A.height > nodes[keep].height ? A.height : nodes[keep].height);
+			return iUp;
+		}
+	};
+}
+
+#endif // !SPATIALINDEX_H
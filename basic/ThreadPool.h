@@ -0,0 +1,115 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+namespace KooNan
+{
+	// Fixed pool of worker threads running data parallel loops.
+	// The calling thread takes part in the loop, so ParallelFor on a pool
+	// with zero workers simply runs serially. Nested ParallelFor is not supported.
+	class ThreadPool
+	{
+	private:
+		std::vector<std::thread> workers;
+		std::mutex mtx;
+		std::condition_variable wakeCv;
+		std::condition_variable doneCv;
+		std::function<void(int)> job;
+		std::atomic<int> nextIndex;
+		int jobCount;
+		int busyWorkers;
+		unsigned int generation;
+		bool quit;
+	public:
+		// Instance: pool shared by the whole program, one worker per extra hardware thread
+		static ThreadPool& Instance()
+		{
+			static ThreadPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+			return pool;
+		}
+
+		explicit ThreadPool(unsigned int threadCount) : nextIndex(0), jobCount(0), busyWorkers(0), generation(0), quit(false)
+		{
+			for (unsigned int i = 0; i < threadCount; i++)
+				workers.emplace_back([this]() { WorkerLoop(); });
+		}
+
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lk(mtx);
+				quit = true;
+			}
+			wakeCv.notify_all();
+			for (std::thread& t : workers)
+				t.join();
+		}
+
+		unsigned int NumThreads() const
+		{
+			return (unsigned int)workers.size() + 1;
+		}
+
+		// ParallelFor: run func(i) for every i in [0, count) and wait for all of them
+		//   func: must be safe to call concurrently for different i
+		void ParallelFor(int count, const std::function<void(int)>& func)
+		{
+			if (count <= 0)
+				return;
+			if (workers.empty() || count == 1)
+			{
+				for (int i = 0; i < count; i++)
+					func(i);
+				return;
+			}
+			{
+				std::unique_lock<std::mutex> lk(mtx);
+				// stragglers of the previous loop must leave before the job is replaced
+				doneCv.wait(lk, [this]() { return busyWorkers == 0; });
+				job = func;
+				jobCount = count;
+				nextIndex = 0;
+				generation++;
+			}
+			wakeCv.notify_all();
+			RunIndices();
+			std::unique_lock<std::mutex> lk(mtx);
+			doneCv.wait(lk, [this]() { return busyWorkers == 0; });
+		}
+
+	private:
+		void RunIndices()
+		{
+			for (int i = nextIndex++; i < jobCount; i = nextIndex++)
+				job(i);
+		}
+
+		void WorkerLoop()
+		{
+			unsigned int seen = 0;
+			std::unique_lock<std::mutex> lk(mtx);
+			while (true)
+			{
+				wakeCv.wait(lk, [this, &seen]() { return quit || generation != seen; });
+				if (quit)
+					return;
+				seen = generation;
+				busyWorkers++;
+				lk.unlock();
+				RunIndices();
+				lk.lock();
+				busyWorkers--;
+				if (busyWorkers == 0)
+					doneCv.notify_all();
+			}
+		}
+	};
+}
+
+#endif // !THREADPOOL_H
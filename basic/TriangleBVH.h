@@ -0,0 +1,262 @@
+#ifndef TRIANGLEBVH_H
+#define TRIANGLEBVH_H
+
+#include <glm/glm.hpp>
+
+#include <Bounds.h>
+
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cassert>
+
+namespace KooNan
+{
+	// Static bounding volume hierarchy over world space triangles, for ray casts on the CPU.
+	// Built once with binned SAH splits, then only read, so it may be shared by many threads.
+	class TriangleBVH
+	{
+	public:
+		struct Hit
+		{
+			float t;
+			int triangle; // index in the order the triangles were added
+			glm::vec3 normal; // geometric, not normalized, facing the winding
+		};
+	private:
+		static const int BINS = 12;
+		static const int LEAF_SIZE = 4;
+		// a node this deep becomes a leaf whatever its size, so the traversal stack is bounded:
+		// it holds one pending sibling per level above the node plus the two children
+		static const int MAX_DEPTH = 48;
+		static const int STACK_SIZE = MAX_DEPTH + 1;
+		struct Node
+		{
+			AABB bounds;
+			int first; // leaf: first entry of order, inner: index of the right child (the left one follows the node)
+			int count; // triangles of a leaf, 0 for inner nodes
+		};
+		struct Triangle
+		{
+			glm::vec3 v0, e1, e2;
+		};
+		std::vector<Triangle> triangles;
+		std::vector<int> order; // triangles of the leaves, by position in the tree
+		std::vector<Node> nodes;
+	public:
+		void Clear()
+		{
+			triangles.clear();
+			order.clear();
+			nodes.clear();
+		}
+		void AddTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+		{
+			triangles.push_back({ a, b - a, c - a });
+		}
+		size_t NumTriangles() const
+		{
+			return triangles.size();
+		}
+
+		// Build: after the last AddTriangle
+		void Build()
+		{
+			nodes.clear();
+			order.resize(triangles.size());
+			for (size_t i = 0; i < order.size(); i++)
+				order[i] = (int)i;
+			if (triangles.empty())
+				return;
+			std::vector<AABB> boxes(triangles.size());
+			std::vector<glm::vec3> centers(triangles.size());
+			for (size_t i = 0; i < triangles.size(); i++)
+			{
+				const Triangle& tri = triangles[i];
+				boxes[i].Expand(tri.v0);
+				boxes[i].Expand(tri.v0 + tri.e1);
+				boxes[i].Expand(tri.v0 + tri.e2);
+				centers[i] = boxes[i].Center();
+			}
+			nodes.reserve(triangles.size() * 2 / LEAF_SIZE + 1);
+			BuildNode(boxes, centers, 0, (int)order.size(), 0);
+		}
+
+		// Intersect: closest hit along the ray before tmax
+		bool Intersect(const Ray& ray, float tmax, Hit& hit) const
+		{
+			hit.t = tmax;
+			hit.triangle = -1;
+			Traverse(ray, hit, false);
+			return hit.triangle >= 0;
+		}
+		// Occluded: whether anything lies along the ray before tmax
+		bool Occluded(const Ray& ray, float tmax) const
+		{
+			Hit hit;
+			hit.t = tmax;
+			hit.triangle = -1;
+			Traverse(ray, hit, true);
+			return hit.triangle >= 0;
+		}
+
+	private:
+		int BuildNode(const std::vector<AABB>& boxes, const std::vector<glm::vec3>& centers, int begin, int end, int depth)
+		{
+			int index = (int)nodes.size();
+			nodes.push_back(Node());
+			AABB bounds, centerBounds;
+			for (int i = begin; i < end; i++)
+			{
+				bounds.Expand(boxes[order[i]]);
+				centerBounds.Expand(centers[order[i]]);
+			}
+			nodes[index].bounds = bounds;
+			int count = end - begin;
+			int axis = 0;
+			glm::vec3 extent = centerBounds.max - centerBounds.min;
+			if (extent.y > extent[axis]) axis = 1;
+			if (extent.z > extent[axis]) axis = 2;
+			if (count <= LEAF_SIZE || extent[axis] <= 0.0f || depth >= MAX_DEPTH)
+				return MakeLeaf(index, begin, count);
+
+			// binned surface area heuristic along the widest axis of the centers
+			AABB binBounds[BINS];
+			int binCounts[BINS] = { 0 };
+			float scale = BINS / extent[axis];
+			auto binOf = [&](int tri) {
+				return glm::min((int)((centers[tri][axis] - centerBounds.min[axis]) * scale), BINS - 1);
+			};
+			for (int i = begin; i < end; i++)
+			{
+				int b = binOf(order[i]);
+				binCounts[b]++;
+				binBounds[b].Expand(boxes[order[i]]);
+			}
+			float leftArea[BINS - 1];
+			int leftCount[BINS - 1];
+			AABB acc;
+			int n = 0;
+			for (int b = 0; b < BINS - 1; b++)
+			{
+				acc.Expand(binBounds[b]);
+				n += binCounts[b];
+				leftArea[b] = n > 0 ? acc.SurfaceArea() : 0.0f;
+				leftCount[b] = n;
+			}
+			float bestCost = FLT_MAX;
+			int bestSplit = -1;
+			acc = AABB();
+			n = 0;
+			for (int b = BINS - 1; b > 0; b--)
+			{
+				acc.Expand(binBounds[b]);
+				n += binCounts[b];
+				float cost = leftArea[b - 1] * leftCount[b - 1] + (n > 0 ? acc.SurfaceArea() : 0.0f) * n;
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestSplit = b;
+				}
+			}
+			if (bestCost >= bounds.SurfaceArea() * count && count <= LEAF_SIZE * 4)
+				return MakeLeaf(index, begin, count);
+			int mid = (int)(std::partition(order.begin() + begin, order.begin() + end,
+				[&](int tri) { return binOf(tri) < bestSplit; }) - order.begin());
+			if (mid == begin || mid == end)
+				mid = begin + count / 2;
+
+			BuildNode(boxes, centers, begin, mid, depth + 1);
+			int right = BuildNode(boxes, centers, mid, end, depth + 1);
+			nodes[index].first = right;
+			nodes[index].count = 0;
+			return index;
+		}
+		int MakeLeaf(int index, int begin, int count)
+		{
+			nodes[index].first = begin;
+			nodes[index].count = count;
+			return index;
+		}
+
+		static bool HitsBox(const AABB& box, const glm::vec3& origin, const glm::vec3& invDir, float tmax)
+		{
+			glm::vec3 t1 = (box.min - origin) * invDir;
+			glm::vec3 t2 = (box.max - origin) * invDir;
+			glm::vec3 tNear = glm::min(t1, t2), tFar = glm::max(t1, t2);
+			float enter = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+			float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, tmax));
+			return enter <= exit;
+		}
+
+		// Moller-Trumbore, both faces
+		static bool HitsTriangle(const Triangle& tri, const Ray& ray, float tmax, float& t)
+		{
+			glm::vec3 p = glm::cross(ray.dir, tri.e2);
+			float det = glm::dot(tri.e1, p);
+			if (std::fabs(det) < 1e-10f)
+				return false;
+			float inv = 1.0f / det;
+			glm::vec3 s = ray.origin - tri.v0;
+			float u = glm::dot(s, p) * inv;
+			if (u < 0.0f || u > 1.0f)
+				return false;
+			glm::vec3 q = glm::cross(s, tri.e1);
+			float v = glm::dot(ray.dir, q) * inv;
+			if (v < 0.0f || u + v > 1.0f)
+				return false;
+			t = glm::dot(tri.e2, q) * inv;
+			return t > 0.0f && t < tmax;
+		}
+
+		void Traverse(const Ray& ray, Hit& hit, bool anyHit) const
+		{
+			if (nodes.empty())
+				return;
+			glm::vec3 invDir;
+			for (int i = 0; i < 3; i++)
+				invDir[i] = std::fabs(ray.dir[i]) > 1e-12f ? 1.0f / ray.dir[i] : (ray.dir[i] < 0.0f ? -1e12f : 1e12f);
+			int stack[STACK_SIZE];
+			int top = 0;
+			stack[top++] = 0;
+			while (top > 0)
+			{
+				const Node& node = nodes[stack[--top]];
+				if (!HitsBox(node.bounds, ray.origin, invDir, hit.t))
+					continue;
+				if (node.count == 0)
+				{
+					int left = (int)(&node - &nodes[0]) + 1;
+					// visit the nearer child first
+					int axis = 0;
+					glm::vec3 d = nodes[node.first].bounds.Center() - nodes[left].bounds.Center();
+					if (std::fabs(d.y) > std::fabs(d[axis])) axis = 1;
+					if (std::fabs(d.z) > std::fabs(d[axis])) axis = 2;
+					bool rightFirst = ray.dir[axis] * d[axis] < 0.0f;
+					assert(top + 2 <= STACK_SIZE);
+					stack[top++] = rightFirst ? left : node.first;
+					stack[top++] = rightFirst ? node.first : left;
+					continue;
+				}
+				for (int i = node.first; i < node.first + node.count; i++)
+				{
+					float t;
+					if (!HitsTriangle(triangles[order[i]], ray, hit.t, t))
+						continue;
+					hit.t = t;
+					hit.triangle = order[i];
+					if (anyHit)
+						return;
+				}
+			}
+			if (hit.triangle >= 0)
+			{
+				const Triangle& tri = triangles[hit.triangle];
+				hit.normal = glm::cross(tri.e1, tri.e2);
+			}
+		}
+	};
+}
+
+#endif // !TRIANGLEBVH_H
@@ -0,0 +1,340 @@
+#ifndef VOLUMETRIC_FOG_H
+#define VOLUMETRIC_FOG_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <common.h>
+#include <Shader.h>
+#include <GpuTimer.h>
+#include <light.h>
+#include <shadow.h>
+#include <RenderSettings.h>
+#include <RenderStats.h>
+
+namespace KooNan
+{
+	// Fog and light shafts of the sun over the finished main pass. The rays are marched
+	// through the sun cascades at half the width and height (landscape/volumetric_fog.fs),
+	// blended over the frames (landscape/volumetric_resolve.fs) and brought back to the
+	// full size with depth aware weights while they are laid over the scene
+	// (landscape/volumetric_composite.fs). The steps per ray follow the measured GPU
+	// time, so the pass stays within RenderSettings::volumetricBudgetMs.
+	class VolumetricFog
+	{
+	public:
+		static const int NOISE_SIZE = 64; // side of the blue noise tile, NOISE_SIZE - 1 masks in volumetric_fog.fs
+	private:
+		unsigned int fogFrameBuffer;
+		unsigned int fogTexture; // RGBA16F, light and transmittance of this frame
+		unsigned int fogDepthTexture; // R32F, view depth of each ray
+		unsigned int historyFrameBuffers[2];
+		unsigned int historyTextures[2]; // RGBA16F, the composite reads historyTextures[current]
+		unsigned int compositeFrameBuffer; // the scene color without its depth, which the composite reads
+		unsigned int noiseTexture;
+		unsigned int emptyVAO;
+		int width, height; // of the fog, half the window
+		int current;
+		bool historyValid;
+		unsigned int frame;
+		int steps;
+		glm::mat4 lastViewProjection;
+		Shader fogShader;
+		Shader resolveShader;
+		Shader compositeShader;
+		GpuTimer timer;
+	public:
+		VolumetricFog() : width(0), height(0), current(0), historyValid(false), frame(0),
+			steps(RenderSettings::volumetricMaxSteps), lastViewProjection(1.0f),
+			fogShader("landscape/fullscreen.vs", "landscape/volumetric_fog.fs"),
+			resolveShader("landscape/fullscreen.vs", "landscape/volumetric_resolve.fs"),
+			compositeShader("landscape/fullscreen.vs", "landscape/volumetric_composite.fs")
+		{
+			glGenFramebuffers(1, &fogFrameBuffer);
+			glGenTextures(1, &fogTexture);
+			glGenTextures(1, &fogDepthTexture);
+			glGenFramebuffers(2, historyFrameBuffers);
+			glGenTextures(2, historyTextures);
+			glGenFramebuffers(1, &compositeFrameBuffer);
+			glGenTextures(1, &noiseTexture);
+			glGenVertexArrays(1, &emptyVAO);
+			fitToWindow();
+			glBindFramebuffer(GL_FRAMEBUFFER, fogFrameBuffer);
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, fogTexture, 0);
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, fogDepthTexture, 0);
+			GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+			glDrawBuffers(2, drawBuffers);
+			for (int i = 0; i < 2; i++)
+			{
+				glBindFramebuffer(GL_FRAMEBUFFER, historyFrameBuffers[i]);
+				glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, historyTextures[i], 0);
+				glDrawBuffer(GL_COLOR_ATTACHMENT0);
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+			std::vector<unsigned char> noise = BlueNoise(NOISE_SIZE);
+			glBindTexture(GL_TEXTURE_2D, noiseTexture);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, NOISE_SIZE, NOISE_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, noise.data());
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+		void cleanUp()
+		{
+			glDeleteFramebuffers(1, &fogFrameBuffer);
+			glDeleteTextures(1, &fogTexture);
+			glDeleteTextures(1, &fogDepthTexture);
+			glDeleteFramebuffers(2, historyFrameBuffers);
+			glDeleteTextures(2, historyTextures);
+			glDeleteFramebuffers(1, &compositeFrameBuffer);
+			glDeleteTextures(1, &noiseTexture);
+			glDeleteVertexArrays(1, &emptyVAO);
+			timer.cleanUp();
+		}
+
+		// Invalidate: forget the history, for frames without the fog
+		void Invalidate()
+		{
+			historyValid = false;
+		}
+
+		// Apply: march, resolve and lay the fog over the scene color
+		//   sceneColor, sceneDepth: the finished main pass, the size of the window
+		//   projection: of the main pass
+		void Apply(unsigned int sceneColor, unsigned int sceneDepth, Shadow_Frame_Buffer& shadowfb, const DirLight& sun,
+			const glm::mat4& projection, const glm::mat4& view, const glm::vec3& viewPos)
+		{
+			fitToWindow();
+			GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST), blend = glIsEnabled(GL_BLEND), clip = glIsEnabled(GL_CLIP_DISTANCE0);
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
+			glDisable(GL_CLIP_DISTANCE0);
+			glBindVertexArray(emptyVAO);
+			frame++;
+			glm::mat4 viewProjection = projection * view;
+			glm::mat4 invViewProjection = glm::inverse(viewProjection);
+			glm::vec3 viewForward = -glm::vec3(glm::inverse(view)[2]);
+
+			timer.Begin();
+			glBindFramebuffer(GL_FRAMEBUFFER, fogFrameBuffer);
+			glViewport(0, 0, width, height);
+			fogShader.use();
+			fogShader.setInt("depthMap", 0);
+			fogShader.setInt("shadowMap", 1);
+			fogShader.setInt("blueNoise", 2);
+			for (int i = 0; i < Shadow_Frame_Buffer::CASCADES; i++)
+			{
+				std::string index = "[" + std::to_string(i) + "]";
+				fogShader.setMat4("lightSpaceMatrices" + index, shadowfb.cascadeViewProjection[i]);
+				fogShader.setFloat("cascadeSplits" + index, shadowfb.cascadeSplits[i]);
+			}
+			fogShader.setMat4("invViewProjection", invViewProjection);
+			fogShader.setVec3("viewPos", viewPos);
+			fogShader.setVec3("viewForward", viewForward);
+			fogShader.setFloat("farPlane", Common::perspective_clipping_far);
+			fogShader.setVec3("sunDirection", -glm::normalize(sun.direction));
+			fogShader.setVec3("sunColor", sun.diffuse);
+			fogShader.setVec3("ambientColor", sun.ambient);
+			fogShader.setFloat("fogDensity", RenderSettings::fogDensity);
+			fogShader.setFloat("fogGradient", RenderSettings::fogGradient);
+			fogShader.setFloat("anisotropy", RenderSettings::volumetricAnisotropy);
+			fogShader.setFloat("intensity", RenderSettings::volumetricIntensity);
+			fogShader.setFloat("maxDistance", RenderSettings::volumetricDistance);
+			fogShader.setInt("steps", steps);
+			fogShader.setFloat("noiseOffset", (float)(frame % 64) * 0.618034f);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, sceneDepth);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, shadowfb.getShadowTexture());
+			glActiveTexture(GL_TEXTURE2);
+			glBindTexture(GL_TEXTURE_2D, noiseTexture);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+
+			int next = 1 - current;
+			glBindFramebuffer(GL_FRAMEBUFFER, historyFrameBuffers[next]);
+			resolveShader.use();
+			resolveShader.setInt("fogMap", 0);
+			resolveShader.setInt("fogDepthMap", 1);
+			resolveShader.setInt("historyMap", 2);
+			resolveShader.setMat4("invViewProjection", invViewProjection);
+			resolveShader.setMat4("prevViewProjection", lastViewProjection);
+			resolveShader.setVec3("viewPos", viewPos);
+			resolveShader.setVec3("viewForward", viewForward);
+			resolveShader.setFloat("historyBlend", historyValid ? RenderSettings::volumetricHistoryBlend : 0.0f);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, fogTexture);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+			glBindTexture(GL_TEXTURE_2D, fogDepthTexture);
+			glActiveTexture(GL_TEXTURE2);
+			glBindTexture(GL_TEXTURE_2D, historyTextures[current]);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			current = next;
+			historyValid = true;
+			lastViewProjection = viewProjection;
+
+			glBindFramebuffer(GL_FRAMEBUFFER, compositeFrameBuffer);
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, sceneColor, 0);
+			glDrawBuffer(GL_COLOR_ATTACHMENT0);
+			glViewport(0, 0, Common::SCR_WIDTH, Common::SCR_HEIGHT);
+			compositeShader.use();
+			compositeShader.setInt("fogMap", 0);
+			compositeShader.setInt("fogDepthMap", 1);
+			compositeShader.setInt("depthMap", 2);
+			compositeShader.setFloat("nearPlane", Common::perspective_clipping_near);
+			compositeShader.setFloat("farPlane", Common::perspective_clipping_far);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, historyTextures[current]);
+			glActiveTexture(GL_TEXTURE2);
+			glBindTexture(GL_TEXTURE_2D, sceneDepth);
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_ONE, GL_SRC_ALPHA);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glDisable(GL_BLEND);
+			timer.End();
+			FitSteps();
+
+			for (int unit = 2; unit >= 0; unit--)
+			{
+				glActiveTexture(GL_TEXTURE0 + unit);
+				glBindTexture(GL_TEXTURE_2D, 0);
+			}
+			glBindVertexArray(0);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			if (depthTest) glEnable(GL_DEPTH_TEST);
+			if (blend) glEnable(GL_BLEND);
+			if (clip) glEnable(GL_CLIP_DISTANCE0);
+		}
+
+	private:
+		// FitSteps: one step more or less per frame, towards the steps that fit the budget
+		void FitSteps()
+		{
+			float ms = timer.Milliseconds();
+			int minSteps = glm::max(RenderSettings::volumetricMinSteps, 1);
+			int maxSteps = glm::max(RenderSettings::volumetricMaxSteps, minSteps);
+			if (ms > RenderSettings::volumetricBudgetMs)
+				steps--;
+			else if (ms < 0.8f * RenderSettings::volumetricBudgetMs)
+				steps++;
+			steps = glm::clamp(steps, minSteps, maxSteps);
+			RenderStats::volumetricGpuMs = ms;
+			RenderStats::volumetricSteps = steps;
+		}
+
+		// BlueNoise: ranks of a tileable blue noise pattern, made with the void and cluster method
+		// of Ulichney; the points of every rank threshold spread out evenly
+		static std::vector<unsigned char> BlueNoise(int size)
+		{
+			int n = size * size;
+			const float sigma = 1.5f;
+			// energy one point adds at each offset on the torus
+			std::vector<float> kernel(n);
+			for (int y = 0; y < size; y++)
+				for (int x = 0; x < size; x++)
+				{
+					float dx = (float)glm::min(x, size - x), dy = (float)glm::min(y, size - y);
+					kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+				}
+			std::vector<char> points(n, 0);
+			std::vector<float> energy(n, 0.0f);
+			auto toggle = [&](int p, bool on) {
+				points[p] = on ? 1 : 0;
+				float sign = on ? 1.0f : -1.0f;
+				int px = p % size, py = p / size;
+				for (int y = 0; y < size; y++)
+					for (int x = 0; x < size; x++)
+						energy[y * size + x] += sign * kernel[((y - py + size) % size) * size + (x - px + size) % size];
+			};
+			// the point in the densest cluster, or the empty spot in the largest void
+			auto extreme = [&](bool cluster) {
+				int best = -1;
+				for (int p = 0; p < n; p++)
+					if ((points[p] != 0) == cluster && (best < 0 || (cluster ? energy[p] > energy[best] : energy[p] < energy[best])))
+						best = p;
+				return best;
+			};
+
+			std::mt19937 rng(1);
+			int ones = n / 10;
+			for (int placed = 0; placed < ones;)
+			{
+				int p = (int)(rng() % (unsigned int)n);
+				if (points[p])
+					continue;
+				toggle(p, true);
+				placed++;
+			}
+			// move points out of clusters into voids until the pattern settles
+			for (int moves = 0; moves < n; moves++)
+			{
+				int cluster = extreme(true);
+				toggle(cluster, false);
+				int gap = extreme(false);
+				toggle(gap, true);
+				if (gap == cluster)
+					break;
+			}
+
+			std::vector<int> rank(n);
+			std::vector<char> initialPoints = points;
+			std::vector<float> initialEnergy = energy;
+			for (int r = ones - 1; r >= 0; r--)
+			{
+				int cluster = extreme(true);
+				toggle(cluster, false);
+				rank[cluster] = r;
+			}
+			points = initialPoints;
+			energy = initialEnergy;
+			for (int r = ones; r < n; r++)
+			{
+				int gap = extreme(false);
+				toggle(gap, true);
+				rank[gap] = r;
+			}
+
+			std::vector<unsigned char> noise(n);
+			for (int p = 0; p < n; p++)
+				noise[p] = (unsigned char)(rank[p] * 256 / n);
+			return noise;
+		}
+
+		void allocate(unsigned int texture, GLint format, GLenum layout, GLint filter)
+		{
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, layout, GL_FLOAT, (void*)nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		void fitToWindow()
+		{
+			int w = glm::max(((int)Common::SCR_WIDTH + 1) / 2, 1);
+			int h = glm::max(((int)Common::SCR_HEIGHT + 1) / 2, 1);
+			if (w == width && h == height)
+				return;
+			width = w;
+			height = h;
+			historyValid = false;
+			allocate(fogTexture, GL_RGBA16F, GL_RGBA, GL_NEAREST);
+			allocate(fogDepthTexture, GL_R32F, GL_RED, GL_NEAREST);
+			// the history is read between texels after the reprojection
+			for (int i = 0; i < 2; i++)
+				allocate(historyTextures[i], GL_RGBA16F, GL_RGBA, GL_LINEAR);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+	};
+}
+
+#endif // !VOLUMETRIC_FOG_H
@@ -0,0 +1,151 @@
+#ifndef WORKSTEALINGSCHEDULER_H
+#define WORKSTEALINGSCHEDULER_H
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+
+namespace KooNan
+{
+	// Task scheduler for long offline jobs of uneven cost, such as LightBaker.
+	// Every worker owns a deque: it pushes and pops its own tasks at the back and,
+	// once the deque is empty, steals the oldest task from the front of another one.
+	// Tasks may Spawn more tasks; Run returns when all of them have finished.
+	// Unlike ThreadPool the threads live only for one Run.
+	class WorkStealingScheduler
+	{
+	public:
+		typedef std::function<void()> Task;
+	private:
+		struct Worker
+		{
+			std::mutex mtx;
+			std::deque<Task> tasks;
+		};
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::atomic<int> pending; // spawned and not finished yet
+		std::atomic<unsigned int> steals;
+	public:
+		explicit WorkStealingScheduler(unsigned int threadCount = std::thread::hardware_concurrency())
+			: pending(0), steals(0)
+		{
+			if (threadCount == 0)
+				threadCount = 1;
+			for (unsigned int i = 0; i < threadCount; i++)
+				workers.emplace_back(new Worker());
+		}
+
+		unsigned int NumThreads() const
+		{
+			return (unsigned int)workers.size();
+		}
+		// Steals: tasks taken from another worker during the last Run
+		unsigned int Steals() const
+		{
+			return steals;
+		}
+
+		// Run: hand the roots out round robin and work until every task, spawned ones included, is done
+		void Run(std::vector<Task> roots)
+		{
+			steals = 0;
+			pending = (int)roots.size();
+			for (size_t i = 0; i < roots.size(); i++)
+				workers[i % workers.size()]->tasks.push_back(std::move(roots[i]));
+			std::vector<std::thread> threads;
+			for (unsigned int i = 1; i < workers.size(); i++)
+				threads.emplace_back([this, i]() { WorkerLoop(i); });
+			WorkerLoop(0);
+			for (std::thread& t : threads)
+				t.join();
+		}
+
+		// Spawn: queue a task on the calling worker, only from inside a task of Run
+		void Spawn(Task task)
+		{
+			pending++;
+			Worker& self = *workers[CurrentWorker()];
+			std::lock_guard<std::mutex> lk(self.mtx);
+			self.tasks.push_back(std::move(task));
+		}
+
+		// ParallelRange: func(i) for every i in [begin, end); ranges are halved until grain is left,
+		// the halves handed off are the ones the idle workers steal
+		void ParallelRange(int begin, int end, int grain, const std::function<void(int)>& func)
+		{
+			std::vector<Task> roots;
+			if (begin < end)
+				roots.push_back([this, begin, end, grain, &func]() { Split(begin, end, grain, func); });
+			Run(std::move(roots));
+		}
+
+	private:
+		static int& CurrentWorker()
+		{
+			static thread_local int index = 0;
+			return index;
+		}
+
+		void Split(int begin, int end, int grain, const std::function<void(int)>& func)
+		{
+			while (end - begin > grain)
+			{
+				int mid = begin + (end - begin) / 2;
+				Spawn([this, mid, end, grain, &func]() { Split(mid, end, grain, func); });
+				end = mid;
+			}
+			for (int i = begin; i < end; i++)
+				func(i);
+		}
+
+		bool Pop(unsigned int index, Task& task)
+		{
+			Worker& self = *workers[index];
+			std::lock_guard<std::mutex> lk(self.mtx);
+			if (self.tasks.empty())
+				return false;
+			task = std::move(self.tasks.back());
+			self.tasks.pop_back();
+			return true;
+		}
+
+		bool Steal(unsigned int index, Task& task)
+		{
+			for (unsigned int k = 1; k < workers.size(); k++)
+			{
+				Worker& victim = *workers[(index + k) % workers.size()];
+				std::lock_guard<std::mutex> lk(victim.mtx);
+				if (victim.tasks.empty())
+					continue;
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				steals++;
+				return true;
+			}
+			return false;
+		}
+
+		void WorkerLoop(unsigned int index)
+		{
+			CurrentWorker() = (int)index;
+			Task task;
+			while (pending > 0)
+			{
+				if (Pop(index, task) || Steal(index, task))
+				{
+					task();
+					task = nullptr;
+					pending--;
+				}
+				else
+					std::this_thread::yield();
+			}
+		}
+	};
+}
+
+#endif // !WORKSTEALINGSCHEDULER_H
@@ -14,11 +14,16 @@ namespace KooNan
 		static float perspective_clipping_near;
 		static float perspective_clipping_far;
 		static const string saveFileName;
+		static const string lightingFileName; // baked lighting of the saved scene, see LightBaker
+		static glm::vec2 projectionJitter; // subpixel offset in NDC of the main pass, see AntiAliasing
 		static glm::mat4 GetPerspectiveMat(Camera& cam)
 		{
-			return glm::perspective(glm::radians(cam.Zoom),
+			glm::mat4 projection = glm::perspective(glm::radians(cam.Zoom),
 				(float)Common::SCR_WIDTH / (float)Common::SCR_HEIGHT,
 				Common::perspective_clipping_near, Common::perspective_clipping_far);
+			projection[2][0] += projectionJitter.x;
+			projection[2][1] += projectionJitter.y;
+			return projection;
 		}
 
 	};
@@ -28,6 +33,8 @@ namespace KooNan
 	float Common::perspective_clipping_near = 0.1f;
 	float Common::perspective_clipping_far = 1000.0f;
 	const string Common::saveFileName = "Save.json";
+	const string Common::lightingFileName = "Save.lightmap";
+	glm::vec2 Common::projectionJitter = glm::vec2(0.0f);
 }
 
 #endif
\ No newline at end of file
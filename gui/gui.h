@@ -7,6 +7,8 @@
 #include <imgui/imgui_impl_opengl3.h>
 
 #include <GameController.h>
+#include <RenderSettings.h>
+#include <RenderStats.h>
 
 namespace KooNan
 {
@@ -278,18 +280,52 @@ namespace KooNan
 						}
 						if (i)ImGui::SameLine();
 						ImGui::BeginChild(i + 1, ImVec2(selectButtonSize.x, selectButtonSize.y));
-						ImGui::SliderFloat("X", &dl->direction.x, -100.f, 100.f);
-						ImGui::SliderFloat("Y", &dl->direction.y, -100.f, 100.f);
-						ImGui::SliderFloat("Z", &dl->direction.z, -100.f, 100.f);
-						ImGui::SliderFloat("R Ambient", &dl->ambient.r, 0.f, 1.f);
-						ImGui::SliderFloat("G Ambient", &dl->ambient.g, 0.f, 1.f);
-						ImGui::SliderFloat("B Ambient", &dl->ambient.b, 0.f, 1.f);
-						ImGui::SliderFloat("R Diffuse", &dl->diffuse.r, 0.f, 1.f);
-						ImGui::SliderFloat("G Diffuse", &dl->diffuse.g, 0.f, 1.f);
-						ImGui::SliderFloat("B Diffuse", &dl->diffuse.b, 0.f, 1.f);
-						ImGui::SliderFloat("R Specular", &dl->specular.r, 0.f, 1.f);
-						ImGui::SliderFloat("G Specular", &dl->specular.g, 0.f, 1.f);
-						ImGui::SliderFloat("B Specular", &dl->specular.b, 0.f, 1.f);
+						// the time of day drives the light, by hand it is edited directly
+						ImGui::Checkbox("Time of Day", &RenderSettings::timeOfDay);
+						if (RenderSettings::timeOfDay && GameController::mainScene) {
+							Atmosphere& atmosphere = GameController::mainScene->atmosphere;
+							ImGui::SliderFloat("Hour", &atmosphere.hours, 0.f, 24.f);
+							ImGui::SliderFloat("Day Length", &RenderSettings::dayLength, 0.f, 3600.f);
+							ImGui::SliderFloat("Latitude", &atmosphere.latitude, -90.f, 90.f);
+							ImGui::SliderFloat("Declination", &atmosphere.declination, -23.44f, 23.44f);
+						}
+						else {
+							ImGui::SliderFloat("X", &dl->direction.x, -100.f, 100.f);
+							ImGui::SliderFloat("Y", &dl->direction.y, -100.f, 100.f);
+							ImGui::SliderFloat("Z", &dl->direction.z, -100.f, 100.f);
+							ImGui::SliderFloat("R Ambient", &dl->ambient.r, 0.f, 1.f);
+							ImGui::SliderFloat("G Ambient", &dl->ambient.g, 0.f, 1.f);
+							ImGui::SliderFloat("B Ambient", &dl->ambient.b, 0.f, 1.f);
+							ImGui::SliderFloat("R Diffuse", &dl->diffuse.r, 0.f, 1.f);
+							ImGui::SliderFloat("G Diffuse", &dl->diffuse.g, 0.f, 1.f);
+							ImGui::SliderFloat("B Diffuse", &dl->diffuse.b, 0.f, 1.f);
+							ImGui::SliderFloat("R Specular", &dl->specular.r, 0.f, 1.f);
+							ImGui::SliderFloat("G Specular", &dl->specular.g, 0.f, 1.f);
+							ImGui::SliderFloat("B Specular", &dl->specular.b, 0.f, 1.f);
+						}
+						ImGui::EndChild();
+					}
+					if (GameController::mainScene) {
+						// reflection probes, captured again by the renderer whenever one moves
+						vector<ReflectionProbe>& probes = GameController::mainScene->reflectionProbes;
+						ImGui::SameLine();
+						ImGui::BeginChild("Reflection Probes", ImVec2(selectButtonSize.x, selectButtonSize.y));
+						if (ImGui::Button("Add Probe at Camera"))
+							probes.push_back(ReflectionProbe{ GameController::mainCamera.Position, 20.0f });
+						for (size_t j = 0; j < probes.size(); j++) {
+							ImGui::PushID((int)j);
+							ImGui::Separator();
+							ImGui::SliderFloat("X", &probes[j].position.x, -100.f, 100.f);
+							ImGui::SliderFloat("Y", &probes[j].position.y, -100.f, 100.f);
+							ImGui::SliderFloat("Z", &probes[j].position.z, -100.f, 100.f);
+							ImGui::SliderFloat("Radius", &probes[j].radius, 1.f, 100.f);
+							bool remove = ImGui::Button("Remove Probe");
+							ImGui::PopID();
+							if (remove) {
+								probes.erase(probes.begin() + j);
+								break;
+							}
+						}
 						ImGui::EndChild();
 					}
 
@@ -304,16 +340,12 @@ namespace KooNan
 					ImGui::SetWindowPos(ImVec2(GameController::lastCursorX, GameController::lastCursorY));
 					if (ImGui::Button("Transform", shotcutButtonSize)) {
 						GameController::helperGameObj = GameController::selectedGameObj;
+						GameController::helperGameObj->SetDynamic(true);
 						GameController::selectedGameObj = NULL;
 						GameController::creatingMode = CreatingMode::Placing;
 					}
 					if (ImGui::Button("Delete", shotcutButtonSize)) {
-						auto itr = GameObject::gameObjList.begin();
-						for (; itr != GameObject::gameObjList.end(); ++itr)
-							if (*itr == GameController::selectedGameObj)
-								break;
-						GameObject::gameObjList.erase(itr);
-						delete GameController::selectedGameObj;
+						delete GameController::selectedGameObj; // unlinks itself from gameObjList
 						GameController::selectedGameObj = NULL;
 						GameController::creatingMode = CreatingMode::Selecting;
 					}
@@ -334,6 +366,9 @@ namespace KooNan
 				}*/
 			}
 
+			if (RenderSettings::showStats)
+				drawStats();
+
 			// Render dear imgui into screen
 			ImGui::Render();
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -345,6 +380,78 @@ namespace KooNan
 		static const int buttonWidth2 = 100, buttonHeight2 = 17;
 		static const int menuWidth = 200;
 
+		// drawStats: overlay with the culling counters of the last frame
+		static void drawStats()
+		{
+			ImGui::SetNextWindowPos(ImVec2(10.0f, Common::SCR_HEIGHT - 10.0f), ImGuiCond_Always, ImVec2(0.0f, 1.0f));
+			ImGui::SetNextWindowBgAlpha(0.35f);
+			ImGui::Begin("Stats", 0, (menuFlags & ~ImGuiWindowFlags_NoBackground) | ImGuiWindowFlags_NoInputs);
+			ImGui::Text("%.1f FPS, %s preset (F4)", ImGui::GetIO().Framerate, RenderSettings::PresetName(RenderSettings::preset));
+			ImGui::Text("Objects: main %u, reflection %u, refraction %u, shadow %u",
+				RenderStats::passObjects[(int)RenderPass::Main], RenderStats::passObjects[(int)RenderPass::Reflection],
+				RenderStats::passObjects[(int)RenderPass::Refraction], RenderStats::passObjects[(int)RenderPass::Shadow]);
+			ImGui::Text("Pass policy culled: %u", RenderStats::policyCulled);
+			ImGui::Text("CPU occluded: %u", RenderStats::objectsOccludedCPU);
+			ImGui::Text("Clip plane culled: %u", RenderStats::clipCulled);
+			ImGui::Text("Water levels: %u, skipped %u, skybox only %u, reflections reused %u%s",
+				RenderStats::waterLevels, RenderStats::waterLevelsSkipped, RenderStats::waterLevelsSkyOnly,
+				RenderStats::reflectionsReused, RenderStats::waterPassesLayered ? ", layered" : "");
+			if (RenderSettings::shadowCaching)
+				ImGui::Text("Shadow cache: %u cascades redrawn, %u regions patched",
+					RenderStats::shadowCascadesRedrawn, RenderStats::shadowRegionsRedrawn);
+			if (RenderSettings::shadowFilter == ShadowFilter::EVSM)
+				ImGui::Text("Shadow filter: EVSM, %u cascades filtered", RenderStats::evsmCascadesFiltered);
+			if (RenderSettings::pointShadows)
+				ImGui::Text("Point shadows: %u lights, %u redrawn", RenderStats::pointShadowLights, RenderStats::pointShadowsRedrawn);
+			if (RenderStats::horizonTexelsUpdated > 0)
+				ImGui::Text("Horizon: %u samples updated, %.2f ms CPU", RenderStats::horizonTexelsUpdated, RenderStats::horizonCpuMs);
+			if (RenderSettings::reflectionProbes && GameController::mainScene)
+				ImGui::Text("Reflection probes: %u placed, %u captured",
+					(unsigned int)GameController::mainScene->reflectionProbes.size(), RenderStats::probesCaptured);
+			if (RenderSettings::timeOfDay && GameController::mainScene)
+				ImGui::Text("Sky: %.2f h%s, %u shadow cascades turned", GameController::mainScene->atmosphere.hours,
+					RenderStats::skyUpdated ? ", updated" : "", RenderStats::shadowCascadesTurned);
+			if (RenderSettings::ssao)
+				ImGui::Text("SSAO: half res%s, %.2f ms GPU", RenderSettings::ssaoTemporal ? ", temporal" : "", RenderStats::ssaoGpuMs);
+			if (RenderSettings::hdr)
+				ImGui::Text("HDR: bloom %s, down %.2f ms, up %.2f ms, tonemap %.2f ms GPU",
+					RenderSettings::bloom ? "on" : "off", RenderStats::bloomDownGpuMs, RenderStats::bloomUpGpuMs, RenderStats::tonemapGpuMs);
+			if (RenderSettings::volumetricFog)
+				ImGui::Text("Volumetric fog: %d steps, %.2f ms GPU, budget %.2f ms", RenderStats::volumetricSteps,
+					RenderStats::volumetricGpuMs, RenderSettings::volumetricBudgetMs);
+			ImGui::Text("Antialiasing: %s (F5, compare F6), %.2f ms GPU, %dx MSAA", RenderSettings::AntiAliasingName(RenderSettings::antiAliasing),
+				RenderStats::antiAliasingGpuMs, RenderSettings::msaaSamples);
+			if (RenderStats::antiAliasingCompareMode >= 0)
+				ImGui::Text("Comparing antialiasing: %s", RenderSettings::AntiAliasingName((AntiAliasingMode)RenderStats::antiAliasingCompareMode));
+			else if (RenderStats::antiAliasingCompareMs[0] >= 0.0f)
+				ImGui::Text("Antialiasing compared (F6): off %.2f, FXAA %.2f, SMAA %.2f, TAA %.2f ms, saved as aa_compare_*.ppm",
+					RenderStats::antiAliasingCompareMs[0], RenderStats::antiAliasingCompareMs[1],
+					RenderStats::antiAliasingCompareMs[2], RenderStats::antiAliasingCompareMs[3]);
+			if (RenderSettings::oceanWaves)
+				ImGui::Text("Ocean: %dx%d FFT, %.2f ms CPU", RenderSettings::oceanResolution, RenderSettings::oceanResolution,
+					RenderStats::oceanCpuMs);
+			if (RenderSettings::waterReflectionMode == WaterReflectionMode::ScreenSpace)
+				ImGui::Text("Water targets: screen space reflection x%.2f, refraction x%.2f",
+					RenderSettings::ssrScale, RenderSettings::waterRefractionScale);
+			else
+				ImGui::Text("Water targets: reflection x%.2f, refraction x%.2f",
+					RenderSettings::waterReflectionScale, RenderSettings::waterRefractionScale);
+			if (RenderStats::waterPassesLayered)
+				ImGui::Text("GPU ms: main %.2f, reflection + refraction %.2f, shadow %.2f",
+					RenderStats::passGpuMs[(int)RenderPass::Main], RenderStats::passGpuMs[(int)RenderPass::Reflection],
+					RenderStats::passGpuMs[(int)RenderPass::Shadow]);
+			else
+				ImGui::Text("GPU ms: main %.2f, reflection %.2f, refraction %.2f, shadow %.2f",
+					RenderStats::passGpuMs[(int)RenderPass::Main], RenderStats::passGpuMs[(int)RenderPass::Reflection],
+					RenderStats::passGpuMs[(int)RenderPass::Refraction], RenderStats::passGpuMs[(int)RenderPass::Shadow]);
+			ImGui::Separator();
+			ImGui::Text("Heavy objects: %u drawn, %u conditional, %u skipped",
+				RenderStats::heavyDrawn, RenderStats::heavyConditional, RenderStats::heavySkipped);
+			ImGui::Text("Queries: %u issued, %u results", RenderStats::queriesIssued, RenderStats::queryResults);
+			ImGui::Text("Query hit rate: %.0f%%", RenderStats::QueryHitRate() * 100.0f);
+			ImGui::End();
+		}
+
 		static void checkMouseOnGui(float minx = -1.f, float miny = -1.f, float maxx = -1.f, float maxy = -1.f)
 		{
 			float mix, miy, max, may;
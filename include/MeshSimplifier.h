@@ -0,0 +1,350 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <mesh.h>
+
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+
+// Quadric error metric mesh decimation (Garland & Heckbert) by half edge collapses.
+// A vertex always collapses onto one of its neighbours, so positions, normals and
+// texture coordinates never need to be interpolated. Open borders, including the
+// seams where texture coordinates or hard edges split a surface, get extra constraint
+// planes so that the outline of the mesh and its creases survive.
+class MeshSimplifier
+{
+public:
+	// Simplify: decimate a triangle list in place
+	//   vertices, indices: indexed triangles, rewritten with the simplified mesh
+	//   targetTriangles: stop once at most this many triangles are left
+	//   maxError: stop when the cheapest collapse costs more than this (squared distance)
+	static void Simplify(vector<Vertex_Simple>& vertices, vector<unsigned int>& indices, size_t targetTriangles, double maxError = 1e30)
+	{
+		MeshSimplifier s;
+		s.Weld(vertices, indices);
+		s.BuildQuadrics();
+		s.Collapse(targetTriangles, maxError);
+		s.Compact(vertices, indices);
+	}
+
+private:
+	// symmetric 4x4 matrix of the plane equations, upper triangle
+	struct Quadric
+	{
+		double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+		Quadric() { memset(this, 0, sizeof(Quadric)); }
+		Quadric(const glm::dvec3& n, double d, double w)
+		{
+			a2 = w * n.x * n.x; ab = w * n.x * n.y; ac = w * n.x * n.z; ad = w * n.x * d;
+			b2 = w * n.y * n.y; bc = w * n.y * n.z; bd = w * n.y * d;
+			c2 = w * n.z * n.z; cd = w * n.z * d;
+			d2 = w * d * d;
+		}
+		Quadric& operator+=(const Quadric& q)
+		{
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd;
+			d2 += q.d2;
+			return *this;
+		}
+		double Error(const glm::dvec3& p) const
+		{
+			double e = a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x
+				+ b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+				+ c2 * p.z * p.z + 2 * cd * p.z
+				+ d2;
+			return e > 0.0 ? e : 0.0;
+		}
+	};
+	struct Triangle
+	{
+		unsigned int v[3];
+		bool alive;
+	};
+	struct Candidate
+	{
+		double cost;
+		unsigned int from, to;
+		unsigned int fromVersion, toVersion;
+		bool operator<(const Candidate& other) const { return cost > other.cost; } // min heap
+	};
+
+	static constexpr double BORDER_WEIGHT = 10.0;
+	static constexpr double MIN_NORMAL_COS = 0.2; // reject collapses turning a face by more than ~78 degrees
+	static constexpr float WELD_NORMAL_COS = 0.866f; // corners whose normals differ by more than 30 degrees are a hard edge
+
+	vector<Vertex_Simple> verts;
+	vector<Triangle> tris;
+	vector<vector<unsigned int>> vertTris;
+	vector<Quadric> quadrics;
+	vector<unsigned int> versions;
+	vector<char> alive;
+	size_t aliveTris;
+	std::priority_queue<Candidate> heap;
+
+	// merge vertices sharing position and texture coordinates, assimp emits one per face corner;
+	// corners of a hard edge stay apart, the edge becomes a seam and keeps its split normals
+	void Weld(const vector<Vertex_Simple>& vertices, const vector<unsigned int>& indices)
+	{
+		struct Key
+		{
+			float p[5];
+			bool operator==(const Key& o) const { return memcmp(p, o.p, sizeof(p)) == 0; }
+		};
+		struct KeyHash
+		{
+			size_t operator()(const Key& k) const
+			{
+				size_t h = 0;
+				for (float f : k.p)
+				{
+					unsigned int bits;
+					memcpy(&bits, &f, sizeof(bits));
+					h = h * 1000003u ^ bits;
+				}
+				return h;
+			}
+		};
+		std::unordered_map<Key, vector<unsigned int>, KeyHash> lookup; // welded vertices at a key, one per normal
+		vector<unsigned int> remap(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const Vertex_Simple& v = vertices[i];
+			Key k = { { v.Position.x + 0.0f, v.Position.y + 0.0f, v.Position.z + 0.0f, v.TexCoords.x + 0.0f, v.TexCoords.y + 0.0f } }; // + 0.0f folds -0 into 0
+			vector<unsigned int>& welded = lookup[k];
+			remap[i] = (unsigned int)verts.size();
+			for (unsigned int w : welded)
+			{
+				// a missing normal (zero length) welds with anything
+				const glm::vec3& n = verts[w].Normal;
+				if (glm::dot(n, v.Normal) >= WELD_NORMAL_COS * glm::length(n) * glm::length(v.Normal))
+				{
+					remap[i] = w;
+					break;
+				}
+			}
+			if (remap[i] == verts.size())
+			{
+				welded.push_back(remap[i]);
+				verts.push_back(v);
+			}
+		}
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			Triangle t;
+			t.v[0] = remap[indices[i]]; t.v[1] = remap[indices[i + 1]]; t.v[2] = remap[indices[i + 2]];
+			t.alive = true;
+			if (t.v[0] != t.v[1] && t.v[1] != t.v[2] && t.v[2] != t.v[0])
+				tris.push_back(t);
+		}
+		aliveTris = tris.size();
+		vertTris.assign(verts.size(), vector<unsigned int>());
+		for (unsigned int t = 0; t < tris.size(); t++)
+			for (int k = 0; k < 3; k++)
+				vertTris[tris[t].v[k]].push_back(t);
+		versions.assign(verts.size(), 0);
+		alive.assign(verts.size(), 1);
+	}
+
+	glm::dvec3 Pos(unsigned int v) const
+	{
+		return glm::dvec3(verts[v].Position);
+	}
+
+	void BuildQuadrics()
+	{
+		quadrics.assign(verts.size(), Quadric());
+		std::unordered_map<unsigned long long, int> edgeUse;
+		for (const Triangle& t : tris)
+		{
+			glm::dvec3 p0 = Pos(t.v[0]), p1 = Pos(t.v[1]), p2 = Pos(t.v[2]);
+			glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+			double len = glm::length(n);
+			if (len < 1e-20)
+				continue;
+			n /= len;
+			Quadric q(n, -glm::dot(n, p0), 0.5 * len); // area weighted
+			for (int k = 0; k < 3; k++)
+			{
+				quadrics[t.v[k]] += q;
+				edgeUse[EdgeKey(t.v[k], t.v[(k + 1) % 3])]++;
+			}
+		}
+		// borders: a plane through the edge, perpendicular to its face
+		for (const Triangle& t : tris)
+		{
+			glm::dvec3 p0 = Pos(t.v[0]), p1 = Pos(t.v[1]), p2 = Pos(t.v[2]);
+			glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+			if (glm::length(n) < 1e-20)
+				continue;
+			n = glm::normalize(n);
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = t.v[k], b = t.v[(k + 1) % 3];
+				if (edgeUse[EdgeKey(a, b)] != 1)
+					continue;
+				glm::dvec3 e = Pos(b) - Pos(a);
+				glm::dvec3 bn = glm::cross(e, n);
+				double len = glm::length(bn);
+				if (len < 1e-20)
+					continue;
+				bn /= len;
+				Quadric q(bn, -glm::dot(bn, Pos(a)), BORDER_WEIGHT * glm::dot(e, e));
+				quadrics[a] += q;
+				quadrics[b] += q;
+			}
+		}
+	}
+
+	static unsigned long long EdgeKey(unsigned int a, unsigned int b)
+	{
+		if (a > b) std::swap(a, b);
+		return ((unsigned long long)a << 32) | b;
+	}
+
+	void PushCandidate(unsigned int from, unsigned int to)
+	{
+		Quadric q = quadrics[from];
+		q += quadrics[to];
+		heap.push(Candidate{ q.Error(Pos(to)), from, to, versions[from], versions[to] });
+	}
+
+	// vertices sharing a live triangle with v
+	void Neighbours(unsigned int v, vector<unsigned int>& out) const
+	{
+		out.clear();
+		for (unsigned int t : vertTris[v])
+		{
+			if (!tris[t].alive)
+				continue;
+			for (int k = 0; k < 3; k++)
+				if (tris[t].v[k] != v)
+					out.push_back(tris[t].v[k]);
+		}
+		sort(out.begin(), out.end());
+		out.erase(unique(out.begin(), out.end()), out.end());
+	}
+
+	// collapsing from onto to must keep the surface a manifold and must not fold faces over
+	bool CanCollapse(unsigned int from, unsigned int to, vector<unsigned int>& scratchA, vector<unsigned int>& scratchB) const
+	{
+		int shared = 0;
+		for (unsigned int t : vertTris[from])
+		{
+			const Triangle& tri = tris[t];
+			if (!tri.alive)
+				continue;
+			if (tri.v[0] == to || tri.v[1] == to || tri.v[2] == to)
+			{
+				shared++;
+				continue;
+			}
+			glm::dvec3 p[3], q[3];
+			for (int k = 0; k < 3; k++)
+			{
+				p[k] = Pos(tri.v[k]);
+				q[k] = tri.v[k] == from ? Pos(to) : p[k];
+			}
+			glm::dvec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+			glm::dvec3 n1 = glm::cross(q[1] - q[0], q[2] - q[0]);
+			double l0 = glm::length(n0), l1 = glm::length(n1);
+			if (l1 < 1e-20 || glm::dot(n0, n1) < MIN_NORMAL_COS * l0 * l1)
+				return false;
+		}
+		if (shared == 0)
+			return false;
+		// link condition: the two ends may only share the apexes of their common triangles
+		Neighbours(from, scratchA);
+		Neighbours(to, scratchB);
+		int common = 0;
+		for (size_t i = 0, j = 0; i < scratchA.size() && j < scratchB.size();)
+		{
+			if (scratchA[i] < scratchB[j]) i++;
+			else if (scratchA[i] > scratchB[j]) j++;
+			else { common++; i++; j++; }
+		}
+		return common <= shared;
+	}
+
+	void Collapse(size_t targetTriangles, double maxError)
+	{
+		for (const Triangle& t : tris)
+			for (int k = 0; k < 3; k++)
+				PushCandidate(t.v[k], t.v[(k + 1) % 3]), PushCandidate(t.v[(k + 1) % 3], t.v[k]);
+
+		vector<unsigned int> scratchA, scratchB, neighbours;
+		while (aliveTris > targetTriangles && !heap.empty())
+		{
+			Candidate c = heap.top();
+			heap.pop();
+			if (!alive[c.from] || !alive[c.to] || versions[c.from] != c.fromVersion || versions[c.to] != c.toVersion)
+				continue;
+			if (c.cost > maxError)
+				break;
+			if (!CanCollapse(c.from, c.to, scratchA, scratchB))
+				continue;
+
+			for (unsigned int t : vertTris[c.from])
+			{
+				Triangle& tri = tris[t];
+				if (!tri.alive)
+					continue;
+				if (tri.v[0] == c.to || tri.v[1] == c.to || tri.v[2] == c.to)
+				{
+					tri.alive = false;
+					aliveTris--;
+					continue;
+				}
+				for (int k = 0; k < 3; k++)
+					if (tri.v[k] == c.from)
+						tri.v[k] = c.to;
+				vertTris[c.to].push_back(t);
+			}
+			alive[c.from] = 0;
+			vertTris[c.from].clear();
+			quadrics[c.to] += quadrics[c.from];
+			versions[c.to]++;
+
+			// drop dead triangles from the survivor and requeue its edges
+			vector<unsigned int>& vt = vertTris[c.to];
+			vt.erase(remove_if(vt.begin(), vt.end(), [this](unsigned int t) { return !tris[t].alive; }), vt.end());
+			Neighbours(c.to, neighbours);
+			for (unsigned int n : neighbours)
+			{
+				PushCandidate(c.to, n);
+				PushCandidate(n, c.to);
+			}
+		}
+	}
+
+	void Compact(vector<Vertex_Simple>& vertices, vector<unsigned int>& indices) const
+	{
+		vector<unsigned int> remap(verts.size(), UINT32_MAX);
+		vertices.clear();
+		indices.clear();
+		for (const Triangle& t : tris)
+		{
+			if (!t.alive)
+				continue;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = t.v[k];
+				if (remap[v] == UINT32_MAX)
+				{
+					remap[v] = (unsigned int)vertices.size();
+					vertices.push_back(verts[v]);
+				}
+				indices.push_back(remap[v]);
+			}
+		}
+	}
+};
+
+#endif // !MESH_SIMPLIFIER_H
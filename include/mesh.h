@@ -95,7 +95,8 @@ public:
 	}
 
 	// render the mesh
-	void Draw(Shader *shader) 
+	//   bakedBuffer: vec4 per vertex fed to attribute 5, 0 leaves the attribute off
+	void Draw(Shader *shader, unsigned int bakedBuffer = 0) 
 	{
 		// bind appropriate textures
 		unsigned int diffuseNr  = 1;
@@ -125,6 +126,15 @@ public:
 		
 		// draw mesh
 		glBindVertexArray(VAO);
+		if (bakedBuffer)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, bakedBuffer);
+			glEnableVertexAttribArray(5);
+			glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		else
+			glDisableVertexAttribArray(5);
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
 		glBindVertexArray(0);
@@ -132,6 +142,13 @@ public:
 		// always good practice to set everything back to defaults once configured.
 		glActiveTexture(GL_TEXTURE0);
 	}
+	// updateVertices: upload vertices_simple again after it was changed in place
+	void updateVertices()
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, vertices_simple.size() * sizeof(Vertex_Simple), &vertices_simple[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
 	void cleanUp()
 	{
 		vertices_simple.clear();
@@ -15,6 +15,7 @@
 #include <assimp/postprocess.h>
 
 #include "mesh.h"
+#include "MeshSimplifier.h"
 #include "shader.h"
 #include "FileSystem.h"
 #include <string>
@@ -24,9 +25,13 @@
 #include <map>
 #include <vector>
 #include <unordered_map>
+#include <algorithm>
+#include <cfloat>
 
 #include <filesystem>
 
+#include <ThreadPool.h>
+
 using namespace std;
 
 unsigned int PreviewImageFromFile(const string& path);
@@ -48,9 +53,17 @@ public:
 	string directory;
 	bool gammaCorrection;
 	Texture* previewImage;
+	glm::vec3 boundsMin, boundsMax; // local space bounding box of all meshes
+	vector<glm::vec3> occluderTriangles; // largest faces of the model, three vertices each, for CPU occlusion culling
+	static const unsigned int MAX_OCCLUDER_TRIANGLES = 512;
+	unsigned int numTriangles;
+	vector<vector<Mesh>> lods; // lods[i - 1]: meshes of LOD i, simplified from meshes
+	static const unsigned int LOD_COUNT = 4; // including the full detail level
+	static const unsigned int LOD_MIN_TRIANGLES = 2000; // lighter models keep a single level
 
 	// constructor, expects a filepath to a 3D model.
-	Model(string const& path, ModelType type = ModelType::ComplexModel, bool gamma = false) : gammaCorrection(gamma)
+	Model(string const& path, ModelType type = ModelType::ComplexModel, bool gamma = false) : gammaCorrection(gamma),
+		boundsMin(FLT_MAX), boundsMax(-FLT_MAX), numTriangles(0)
 	{
 		loadModel(FileSystem::getPath(path));
 		if(type == ModelType::ComplexModel)
@@ -60,10 +73,24 @@ public:
 	}
 
 	// draws the model, and thus all its meshes
-	void Draw(Shader* shader)
+	//   lod: detail level, 0 is the full model, clamped to the levels available
+	//   bakedBuffers: per vertex ambient of each mesh of that level, see GameObject::SetBakedLighting
+	void Draw(Shader* shader, unsigned int lod = 0, const vector<unsigned int>* bakedBuffers = nullptr)
+	{
+		vector<Mesh>& level = Level(lod);
+		for (unsigned int i = 0; i < level.size(); i++)
+			level[i].Draw(shader, bakedBuffers ? (*bakedBuffers)[i] : 0);
+	}
+
+	// Level: meshes of a detail level, clamped like Draw
+	vector<Mesh>& Level(unsigned int lod)
+	{
+		return lod == 0 || lods.empty() ? meshes : lods[min(lod, (unsigned int)lods.size()) - 1];
+	}
+
+	unsigned int NumLods() const
 	{
-		for (unsigned int i = 0; i < meshes.size(); i++)
-			meshes[i].Draw(shader);
+		return 1 + (unsigned int)lods.size();
 	}
 
 	// load models from a path, which contains several folder of models.
@@ -145,6 +172,162 @@ private:
 
 		// process ASSIMP's root node recursively
 		processNode(scene->mRootNode, scene);
+		buildOccluder();
+		for (const Mesh& mesh : meshes)
+			numTriangles += (unsigned int)mesh.indices.size() / 3;
+		buildLods(path);
+	}
+
+	// fraction of the full triangle count kept by each level
+	static float LodRatio(unsigned int lod)
+	{
+		static const float ratios[LOD_COUNT] = { 1.0f, 0.5f, 0.2f, 0.07f };
+		return ratios[lod];
+	}
+
+	// simplified levels are generated once and cached next to the model as <model>.lod
+	void buildLods(const string& path)
+	{
+		if (numTriangles < LOD_MIN_TRIANGLES)
+			return;
+		size_t numMeshes = meshes.size();
+		vector<vector<Vertex_Simple>> lodVertices((LOD_COUNT - 1) * numMeshes);
+		vector<vector<unsigned int>> lodIndices((LOD_COUNT - 1) * numMeshes);
+		string cachePath = path + ".lod";
+		if (!readLodCache(cachePath, path, lodVertices, lodIndices))
+		{
+			KooNan::ThreadPool::Instance().ParallelFor((int)numMeshes, [&](int m) {
+				vector<Vertex_Simple> vertices = meshes[m].vertices_simple;
+				vector<unsigned int> indices = meshes[m].indices;
+				size_t fullTriangles = indices.size() / 3;
+				// each level starts from the previous one
+				for (unsigned int lod = 1; lod < LOD_COUNT; lod++)
+				{
+					MeshSimplifier::Simplify(vertices, indices, max((size_t)(fullTriangles * LodRatio(lod)), (size_t)1));
+					lodVertices[(lod - 1) * numMeshes + m] = vertices;
+					lodIndices[(lod - 1) * numMeshes + m] = indices;
+				}
+			});
+			writeLodCache(cachePath, path, lodVertices, lodIndices);
+		}
+		lods.resize(LOD_COUNT - 1);
+		for (unsigned int lod = 1; lod < LOD_COUNT; lod++)
+		{
+			vector<Mesh>& level = lods[lod - 1];
+			level.reserve(numMeshes);
+			for (size_t m = 0; m < numMeshes; m++)
+				if (!lodIndices[(lod - 1) * numMeshes + m].empty())
+					level.push_back(Mesh(lodVertices[(lod - 1) * numMeshes + m], lodIndices[(lod - 1) * numMeshes + m], meshes[m].textures));
+		}
+	}
+
+	static const unsigned int LOD_CACHE_MAGIC = 0x444F4C4B; // "KLOD"
+	static const unsigned int LOD_CACHE_VERSION = 1;
+
+	// the cache is stale once the model file changes size or modification time
+	static void lodCacheStamp(const string& path, unsigned long long& size, long long& time)
+	{
+		std::error_code ec;
+		size = (unsigned long long)filesystem::file_size(path, ec);
+		time = (long long)filesystem::last_write_time(path, ec).time_since_epoch().count();
+	}
+
+	bool readLodCache(const string& cachePath, const string& path, vector<vector<Vertex_Simple>>& lodVertices, vector<vector<unsigned int>>& lodIndices) const
+	{
+		ifstream in(cachePath, ios::binary);
+		if (!in)
+			return false;
+		unsigned int magic = 0, version = 0, lodCount = 0, meshCount = 0;
+		unsigned long long size, cachedSize = 0;
+		long long time, cachedTime = 0;
+		lodCacheStamp(path, size, time);
+		in.read((char*)&magic, sizeof(magic));
+		in.read((char*)&version, sizeof(version));
+		in.read((char*)&cachedSize, sizeof(cachedSize));
+		in.read((char*)&cachedTime, sizeof(cachedTime));
+		in.read((char*)&lodCount, sizeof(lodCount));
+		in.read((char*)&meshCount, sizeof(meshCount));
+		if (!in || magic != LOD_CACHE_MAGIC || version != LOD_CACHE_VERSION || cachedSize != size || cachedTime != time ||
+			lodCount != LOD_COUNT || meshCount != meshes.size())
+			return false;
+		for (size_t i = 0; i < lodVertices.size(); i++)
+		{
+			unsigned int numVertices = 0, numIndices = 0;
+			in.read((char*)&numVertices, sizeof(numVertices));
+			if (!in || numVertices > meshes[i % meshCount].vertices_simple.size())
+				return false;
+			lodVertices[i].resize(numVertices);
+			in.read((char*)lodVertices[i].data(), numVertices * sizeof(Vertex_Simple));
+			in.read((char*)&numIndices, sizeof(numIndices));
+			if (!in || numIndices > meshes[i % meshCount].indices.size())
+				return false;
+			lodIndices[i].resize(numIndices);
+			in.read((char*)lodIndices[i].data(), numIndices * sizeof(unsigned int));
+			if (!in)
+				return false;
+		}
+		return true;
+	}
+
+	void writeLodCache(const string& cachePath, const string& path, const vector<vector<Vertex_Simple>>& lodVertices, const vector<vector<unsigned int>>& lodIndices) const
+	{
+		ofstream out(cachePath, ios::binary);
+		if (!out)
+		{
+			cout << "LOD cache could not be written to " << cachePath << endl;
+			return;
+		}
+		unsigned int magic = LOD_CACHE_MAGIC, version = LOD_CACHE_VERSION, lodCount = LOD_COUNT, meshCount = (unsigned int)meshes.size();
+		unsigned long long size;
+		long long time;
+		lodCacheStamp(path, size, time);
+		out.write((const char*)&magic, sizeof(magic));
+		out.write((const char*)&version, sizeof(version));
+		out.write((const char*)&size, sizeof(size));
+		out.write((const char*)&time, sizeof(time));
+		out.write((const char*)&lodCount, sizeof(lodCount));
+		out.write((const char*)&meshCount, sizeof(meshCount));
+		for (size_t i = 0; i < lodVertices.size(); i++)
+		{
+			unsigned int numVertices = (unsigned int)lodVertices[i].size(), numIndices = (unsigned int)lodIndices[i].size();
+			out.write((const char*)&numVertices, sizeof(numVertices));
+			out.write((const char*)lodVertices[i].data(), numVertices * sizeof(Vertex_Simple));
+			out.write((const char*)&numIndices, sizeof(numIndices));
+			out.write((const char*)lodIndices[i].data(), numIndices * sizeof(unsigned int));
+		}
+	}
+
+	// keeps the largest triangles as a simplified occluder. A subset of the real surface never
+	// occludes more than the model itself does, so the culling stays conservative.
+	void buildOccluder()
+	{
+		struct Face { float area; unsigned int mesh, first; };
+		vector<Face> faces;
+		for (unsigned int m = 0; m < meshes.size(); m++)
+		{
+			const Mesh& mesh = meshes[m];
+			for (unsigned int i = 0; i + 2 < mesh.indices.size(); i += 3)
+			{
+				const glm::vec3& a = mesh.vertices_simple[mesh.indices[i]].Position;
+				const glm::vec3& b = mesh.vertices_simple[mesh.indices[i + 1]].Position;
+				const glm::vec3& c = mesh.vertices_simple[mesh.indices[i + 2]].Position;
+				float area = 0.5f * glm::length(glm::cross(b - a, c - a));
+				faces.push_back(Face{ area, m, i });
+			}
+		}
+		if (faces.size() > MAX_OCCLUDER_TRIANGLES)
+		{
+			nth_element(faces.begin(), faces.begin() + MAX_OCCLUDER_TRIANGLES, faces.end(),
+				[](const Face& l, const Face& r) { return l.area > r.area; });
+			faces.resize(MAX_OCCLUDER_TRIANGLES);
+		}
+		occluderTriangles.clear();
+		for (const Face& f : faces)
+		{
+			const Mesh& mesh = meshes[f.mesh];
+			for (unsigned int k = 0; k < 3; k++)
+				occluderTriangles.push_back(mesh.vertices_simple[mesh.indices[f.first + k]].Position);
+		}
 	}
 
 	// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -185,6 +368,8 @@ private:
 			vector.y = mesh->mVertices[i].y;
 			vector.z = mesh->mVertices[i].z;
 			vertex_simple.Position = vector;
+			boundsMin = glm::min(boundsMin, vector);
+			boundsMax = glm::max(boundsMax, vector);
 			// normals
 			if (mesh->HasNormals())
 			{
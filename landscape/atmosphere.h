@@ -0,0 +1,372 @@
+#ifndef ATMOSPHERE_H
+#define ATMOSPHERE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <Shader.h>
+#include <light.h>
+#include <shadow.h>
+#include <common.h>
+#include <RenderSettings.h>
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+
+namespace KooNan
+{
+	// Sky and sun of the time of day. The sky comes from precomputed tables (landscape/atmosphere_lut.fs):
+	// transmittance and multiple scattering only depend on the atmosphere and are drawn again when
+	// its parameters change; the sky view table holds the light from every direction for the current
+	// sun and is drawn again when the sun moved a step, RenderSettings::sunStepDegrees. Drawing the sky
+	// is then a lookup per pixel (landscape/sky.fs). The same step recolors the DirLight: the sun through
+	// the transmittance, the ambient from the sky view table integrated over the upper hemisphere.
+	class Atmosphere
+	{
+	public:
+		static const int TRANSMITTANCE_WIDTH = 256, TRANSMITTANCE_HEIGHT = 64;
+		static const int MULTI_SCATTERING_SIZE = 32;
+		static const int SKY_VIEW_WIDTH = 192, SKY_VIEW_HEIGHT = 108;
+		static const int CUBE_SIZE = 128;
+		// the earth, distances in km and coefficients per km
+		struct Parameters
+		{
+			float bottomRadius = 6360.0f;
+			float topRadius = 6460.0f;
+			glm::vec3 rayleighScattering = glm::vec3(0.005802f, 0.013558f, 0.0331f);
+			float rayleighScaleHeight = 8.0f;
+			float mieScattering = 0.003996f;
+			float mieExtinction = 0.00444f;
+			float mieScaleHeight = 1.2f;
+			float mieG = 0.8f;
+			glm::vec3 ozoneAbsorption = glm::vec3(0.00065f, 0.001881f, 0.000085f);
+			float ozoneCenter = 25.0f;
+			float ozoneWidth = 15.0f;
+			glm::vec3 groundAlbedo = glm::vec3(0.3f);
+			float viewHeight = 0.5f; // of the camera in the sky view table, the scene is too small to matter
+		};
+		Parameters parameters; // the tables follow changes on the next Update
+		float hours; // time of day, 12 is noon
+		float latitude; // in degrees, north positive
+		float declination; // of the sun in degrees, the season: 23.44 in June, -23.44 in December
+		// the DirLight made from the sky, for a sun of illuminance 1
+		float sunDiffuse;
+		float sunSpecular;
+		float skyAmbient; // scales the hemisphere irradiance of the sky
+		float exposure; // of the sky itself
+		glm::vec3 nightAmbient; // the ambient floor after sunset
+		glm::vec3 nightSky;
+	private:
+		unsigned int frameBuffer;
+		unsigned int transmittanceLut;
+		unsigned int multiScatteringLut;
+		unsigned int skyViewLut;
+		unsigned int cubeMap; // sky.fs drawn into the faces, for the water, SSR and probe fallbacks
+		unsigned int emptyVAO;
+		Shader lutShader;
+		Shader skyShader;
+		Parameters built; // parameters of the current transmittance and multiple scattering tables
+		bool tablesValid;
+		bool skyValid;
+		glm::vec3 sunDirection; // towards the sun, of the current sky view table
+		std::vector<glm::vec3> skyTexels; // read back for the ambient
+	public:
+		Atmosphere() : hours(10.0f), latitude(30.0f), declination(10.0f), sunDiffuse(0.45f), sunSpecular(0.6f), skyAmbient(3.0f), exposure(40.0f),
+			nightAmbient(0.02f, 0.025f, 0.04f), nightSky(0.01f, 0.015f, 0.03f),
+			lutShader("landscape/fullscreen.vs", "landscape/atmosphere_lut.fs"), skyShader("landscape/sky.vs", "landscape/sky.fs"),
+			tablesValid(false), skyValid(false), sunDirection(0.0f, 1.0f, 0.0f)
+		{
+			glGenFramebuffers(1, &frameBuffer);
+			transmittanceLut = CreateTable(TRANSMITTANCE_WIDTH, TRANSMITTANCE_HEIGHT, GL_CLAMP_TO_EDGE);
+			multiScatteringLut = CreateTable(MULTI_SCATTERING_SIZE, MULTI_SCATTERING_SIZE, GL_CLAMP_TO_EDGE);
+			// the azimuth wraps around
+			skyViewLut = CreateTable(SKY_VIEW_WIDTH, SKY_VIEW_HEIGHT, GL_REPEAT);
+			glGenTextures(1, &cubeMap);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMap);
+			for (int face = 0; face < 6; face++)
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB8, CUBE_SIZE, CUBE_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)nullptr);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+			glGenVertexArrays(1, &emptyVAO);
+			skyTexels.resize(SKY_VIEW_WIDTH * SKY_VIEW_HEIGHT);
+		}
+		void cleanUp()
+		{
+			glDeleteFramebuffers(1, &frameBuffer);
+			glDeleteTextures(1, &transmittanceLut);
+			glDeleteTextures(1, &multiScatteringLut);
+			glDeleteTextures(1, &skyViewLut);
+			glDeleteTextures(1, &cubeMap);
+			glDeleteVertexArrays(1, &emptyVAO);
+		}
+
+		// Update: advance the clock, follow parameter changes and, once the sun moved a step, the sky and light
+		//   light: the directional light, only written when the sky changed
+		//   return: whether the sky changed
+		bool Update(float deltaTime, DirLight& light)
+		{
+			if (RenderSettings::dayLength > 0.0f)
+				hours = std::fmod(hours + deltaTime * 24.0f / RenderSettings::dayLength, 24.0f);
+			if (!tablesValid || std::memcmp(&built, &parameters, sizeof(Parameters)) != 0)
+			{
+				built = parameters;
+				BuildTables();
+				tablesValid = true;
+				skyValid = false;
+			}
+			glm::vec3 sun = SunDirection();
+			float step = glm::cos(glm::radians(RenderSettings::sunStepDegrees));
+			if (skyValid && glm::dot(sun, sunDirection) > step)
+				return false;
+			sunDirection = sun;
+			BuildSky();
+			ApplyLight(light);
+			skyValid = true;
+			return true;
+		}
+
+		// SunDirection: towards the sun at the current hour; x points east, z north
+		glm::vec3 SunDirection() const
+		{
+			float hourAngle = glm::radians((hours - 12.0f) * 15.0f);
+			float phi = glm::radians(latitude), delta = glm::radians(declination);
+			glm::vec3 dir(-std::cos(delta) * std::sin(hourAngle),
+				std::sin(phi) * std::sin(delta) + std::cos(phi) * std::cos(delta) * std::cos(hourAngle),
+				std::cos(phi) * std::sin(delta) - std::sin(phi) * std::cos(delta) * std::cos(hourAngle));
+			return glm::normalize(dir);
+		}
+
+		// Draw: the sky where the depth buffer is still clear
+		void Draw(const glm::mat4& projection, const glm::mat4& view)
+		{
+			GLint depthFunc;
+			glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+			glDepthFunc(GL_LEQUAL);
+			glDepthMask(GL_FALSE);
+			skyShader.use();
+			skyShader.setMat4("invViewProjection", glm::inverse(projection * glm::mat4(glm::mat3(view))));
+			SetSkyUniforms();
+			glBindVertexArray(emptyVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glBindVertexArray(0);
+			glActiveTexture(GL_TEXTURE0);
+			glDepthMask(GL_TRUE);
+			glDepthFunc(depthFunc);
+		}
+
+		unsigned int getCubeMap()
+		{
+			return cubeMap;
+		}
+
+	private:
+		static unsigned int CreateTable(int width, int height, GLint wrap)
+		{
+			unsigned int texture;
+			glGenTextures(1, &texture);
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, (void*)nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			return texture;
+		}
+
+		void SetParameters(Shader& shader)
+		{
+			shader.setFloat("bottomRadius", built.bottomRadius);
+			shader.setFloat("topRadius", built.topRadius);
+			shader.setVec3("rayleighScattering", built.rayleighScattering);
+			shader.setFloat("rayleighScaleHeight", built.rayleighScaleHeight);
+			shader.setFloat("mieScattering", built.mieScattering);
+			shader.setFloat("mieExtinction", built.mieExtinction);
+			shader.setFloat("mieScaleHeight", built.mieScaleHeight);
+			shader.setFloat("mieG", built.mieG);
+			shader.setVec3("ozoneAbsorption", built.ozoneAbsorption);
+			shader.setFloat("ozoneCenter", built.ozoneCenter);
+			shader.setFloat("ozoneWidth", built.ozoneWidth);
+			shader.setVec3("groundAlbedo", built.groundAlbedo);
+			shader.setFloat("viewHeight", built.viewHeight);
+		}
+
+		void SetSkyUniforms()
+		{
+			skyShader.setInt("skyViewLut", 0);
+			skyShader.setInt("transmittanceLut", 1);
+			skyShader.setVec3("sunDirection", sunDirection);
+			skyShader.setFloat("bottomRadius", built.bottomRadius);
+			skyShader.setFloat("topRadius", built.topRadius);
+			skyShader.setFloat("viewHeight", built.viewHeight);
+			skyShader.setFloat("sunAngularRadius", glm::radians(0.27f));
+			skyShader.setFloat("exposure", exposure);
+			// the night sky fades in through the civil twilight
+			skyShader.setVec3("nightColor", nightSky * (1.0f - glm::smoothstep(-0.1f, 0.05f, sunDirection.y)));
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, skyViewLut);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, transmittanceLut);
+		}
+
+		// DrawTable: one mode of atmosphere_lut.fs into a table, the GL state is set by the caller
+		void DrawTable(int mode, unsigned int table, int width, int height)
+		{
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, table, 0);
+			glViewport(0, 0, width, height);
+			lutShader.setInt("mode", mode);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+
+		void BeginPasses(GLboolean& depthTest, GLboolean& blend, GLboolean& clip)
+		{
+			depthTest = glIsEnabled(GL_DEPTH_TEST);
+			blend = glIsEnabled(GL_BLEND);
+			clip = glIsEnabled(GL_CLIP_DISTANCE0);
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
+			glDisable(GL_CLIP_DISTANCE0);
+			glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+			glDrawBuffer(GL_COLOR_ATTACHMENT0);
+			glBindVertexArray(emptyVAO);
+		}
+		void EndPasses(GLboolean depthTest, GLboolean blend, GLboolean clip)
+		{
+			glBindVertexArray(0);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, Common::SCR_WIDTH, Common::SCR_HEIGHT);
+			glActiveTexture(GL_TEXTURE0);
+			if (depthTest) glEnable(GL_DEPTH_TEST);
+			if (blend) glEnable(GL_BLEND);
+			if (clip) glEnable(GL_CLIP_DISTANCE0);
+		}
+
+		// BuildTables: transmittance, then the multiple scattering that reads it
+		void BuildTables()
+		{
+			GLboolean depthTest, blend, clip;
+			BeginPasses(depthTest, blend, clip);
+			lutShader.use();
+			SetParameters(lutShader);
+			lutShader.setInt("transmittanceLut", 0);
+			lutShader.setInt("multiScatteringLut", 1);
+			// neither table may be bound while it is drawn
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			DrawTable(0, transmittanceLut, TRANSMITTANCE_WIDTH, TRANSMITTANCE_HEIGHT);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, transmittanceLut);
+			DrawTable(1, multiScatteringLut, MULTI_SCATTERING_SIZE, MULTI_SCATTERING_SIZE);
+			EndPasses(depthTest, blend, clip);
+		}
+
+		// BuildSky: the sky view table for sunDirection, then the faces of the cube map from it
+		void BuildSky()
+		{
+			GLboolean depthTest, blend, clip;
+			BeginPasses(depthTest, blend, clip);
+			lutShader.use();
+			SetParameters(lutShader);
+			lutShader.setVec3("sunDirection", sunDirection);
+			lutShader.setInt("transmittanceLut", 0);
+			lutShader.setInt("multiScatteringLut", 1);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, transmittanceLut);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, multiScatteringLut);
+			DrawTable(2, skyViewLut, SKY_VIEW_WIDTH, SKY_VIEW_HEIGHT);
+			// small, and read once per sun step only
+			glReadBuffer(GL_COLOR_ATTACHMENT0);
+			glReadPixels(0, 0, SKY_VIEW_WIDTH, SKY_VIEW_HEIGHT, GL_RGB, GL_FLOAT, &skyTexels[0]);
+
+			skyShader.use();
+			SetSkyUniforms();
+			glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+			glViewport(0, 0, CUBE_SIZE, CUBE_SIZE);
+			for (int face = 0; face < 6; face++)
+			{
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cubeMap, 0);
+				glm::mat4 view = PointShadowAtlas::FaceView(glm::vec3(0.0f), face);
+				skyShader.setMat4("invViewProjection", glm::inverse(projection * view));
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+			}
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+			EndPasses(depthTest, blend, clip);
+		}
+
+		// SkyViewZenith: zenith angle of row coordinate v of the sky view table, as in atmosphere_lut.fs
+		float SkyViewZenith(float v) const
+		{
+			float r = built.bottomRadius + built.viewHeight;
+			float beta = std::acos(std::sqrt(r * r - built.bottomRadius * built.bottomRadius) / r);
+			float horizonZenith = glm::pi<float>() - beta;
+			if (v < 0.5f)
+			{
+				float c = 1.0f - 2.0f * v;
+				return horizonZenith * (1.0f - c * c);
+			}
+			float c = v * 2.0f - 1.0f;
+			return horizonZenith + beta * c * c;
+		}
+
+		// SunTransmittance: of the atmosphere between the camera and the sun, 0 once it set
+		glm::vec3 SunTransmittance() const
+		{
+			glm::vec3 o(0.0f, built.bottomRadius + built.viewHeight, 0.0f);
+			float b = glm::dot(o, sunDirection);
+			float c = glm::dot(o, o) - built.bottomRadius * built.bottomRadius;
+			if (b < 0.0f && b * b - c > 0.0f)
+				return glm::vec3(0.0f);
+			float top = -b + std::sqrt(b * b - (glm::dot(o, o) - built.topRadius * built.topRadius));
+			const int STEPS = 40;
+			glm::vec3 opticalDepth(0.0f);
+			for (int i = 0; i < STEPS; i++)
+			{
+				float height = glm::length(o + sunDirection * ((i + 0.5f) * top / STEPS)) - built.bottomRadius;
+				float mieDensity = std::exp(-height / built.mieScaleHeight);
+				float ozone = glm::max(0.0f, 1.0f - std::abs(height - built.ozoneCenter) / built.ozoneWidth);
+				opticalDepth += built.rayleighScattering * std::exp(-height / built.rayleighScaleHeight)
+					+ glm::vec3(built.mieExtinction * mieDensity) + built.ozoneAbsorption * ozone;
+			}
+			return glm::exp(-opticalDepth * (top / STEPS));
+		}
+
+		// SkyIrradiance: light of the sky view table falling on a surface facing up
+		glm::vec3 SkyIrradiance() const
+		{
+			glm::vec3 irradiance(0.0f);
+			float azimuthStep = 2.0f * glm::pi<float>() / SKY_VIEW_WIDTH;
+			for (int y = 0; y < SKY_VIEW_HEIGHT; y++)
+			{
+				float z0 = SkyViewZenith((float)y / SKY_VIEW_HEIGHT), z1 = SkyViewZenith((float)(y + 1) / SKY_VIEW_HEIGHT);
+				float zenith = 0.5f * (z0 + z1);
+				if (zenith >= 0.5f * glm::pi<float>())
+					break;
+				float weight = std::cos(zenith) * std::sin(zenith) * (z1 - z0) * azimuthStep;
+				for (int x = 0; x < SKY_VIEW_WIDTH; x++)
+					irradiance += skyTexels[y * SKY_VIEW_WIDTH + x] * weight;
+			}
+			return irradiance;
+		}
+
+		void ApplyLight(DirLight& light)
+		{
+			glm::vec3 sun = SunTransmittance();
+			light.direction = -sunDirection;
+			light.diffuse = sun * sunDiffuse;
+			light.specular = sun * sunSpecular;
+			light.ambient = SkyIrradiance() * skyAmbient + nightAmbient;
+		}
+	};
+}
+
+#endif // !ATMOSPHERE_H
@@ -0,0 +1,199 @@
+#version 330 core
+// The lookup tables of the sky, one per mode, in the style of Hillaire 2020:
+//   0: transmittance from a height along a zenith angle to the top of the atmosphere
+//   1: multiple scattering, the light of all orders above the second reaching a point,
+//      for a height and sun zenith angle; folded into the single scattering of mode 2
+//   2: sky view, the light arriving at the viewer from every direction for the current sun
+// Modes 0 and 1 only change with the atmosphere, mode 2 also with the sun.
+// Distances are in km, the planet is centered at the origin.
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform int mode;
+uniform float bottomRadius;
+uniform float topRadius;
+uniform vec3 rayleighScattering;
+uniform float rayleighScaleHeight;
+uniform float mieScattering;
+uniform float mieExtinction;
+uniform float mieScaleHeight;
+uniform float mieG;
+uniform vec3 ozoneAbsorption;
+uniform float ozoneCenter; // height of the densest ozone
+uniform float ozoneWidth; // half width of the tent of the ozone density
+uniform vec3 groundAlbedo;
+uniform vec3 sunDirection; // towards the sun, mode 2
+uniform float viewHeight; // above the ground, mode 2
+uniform sampler2D transmittanceLut; // modes 1 and 2
+uniform sampler2D multiScatteringLut; // mode 2
+
+const float PI = 3.14159265;
+
+struct Medium
+{
+    vec3 rayleigh; // scattering
+    float mie; // scattering
+    vec3 extinction;
+};
+
+Medium SampleMedium(float height)
+{
+    Medium m;
+    m.rayleigh = rayleighScattering * exp(-height / rayleighScaleHeight);
+    float mieDensity = exp(-height / mieScaleHeight);
+    m.mie = mieScattering * mieDensity;
+    float ozone = max(0.0, 1.0 - abs(height - ozoneCenter) / ozoneWidth);
+    m.extinction = m.rayleigh + vec3(mieExtinction * mieDensity) + ozoneAbsorption * ozone;
+    return m;
+}
+
+// RaySphere: distance along d to the sphere around the origin, the nearer positive one, -1 for a miss
+float RaySphere(vec3 o, vec3 d, float radius)
+{
+    float b = dot(o, d);
+    float c = dot(o, o) - radius * radius;
+    float disc = b * b - c;
+    if (disc < 0.0)
+        return -1.0;
+    float s = sqrt(disc);
+    if (-b - s >= 0.0)
+        return -b - s;
+    return -b + s >= 0.0 ? -b + s : -1.0;
+}
+
+// parametrization of the transmittance table of Bruneton, finer near the horizon
+vec2 TransmittanceUV(float r, float mu)
+{
+    float H = sqrt(topRadius * topRadius - bottomRadius * bottomRadius);
+    float rho = sqrt(max(r * r - bottomRadius * bottomRadius, 0.0));
+    float discriminant = r * r * (mu * mu - 1.0) + topRadius * topRadius;
+    float d = max(-r * mu + sqrt(max(discriminant, 0.0)), 0.0);
+    float dMin = topRadius - r, dMax = rho + H;
+    return vec2((d - dMin) / (dMax - dMin), rho / H);
+}
+
+vec3 Transmittance(float r, float mu)
+{
+    return texture(transmittanceLut, TransmittanceUV(r, mu)).rgb;
+}
+
+vec3 MultiScattering(float r, float mu)
+{
+    vec2 uv = vec2(mu * 0.5 + 0.5, (r - bottomRadius) / (topRadius - bottomRadius));
+    return texture(multiScatteringLut, clamp(uv, 0.0, 1.0)).rgb;
+}
+
+// Integrate: light scattered towards o along d from a sun of illuminance 1
+//   isotropic: uniform phase function, for the multiple scattering
+//   multiple: add the multiple scattering table
+//   fms: the share of light scattered again along the way, for the multiple scattering
+vec3 Integrate(vec3 o, vec3 d, vec3 sun, int steps, bool isotropic, bool multiple, out vec3 fms)
+{
+    fms = vec3(0.0);
+    float tTop = RaySphere(o, d, topRadius);
+    if (tTop < 0.0)
+        return vec3(0.0);
+    float tBottom = RaySphere(o, d, bottomRadius);
+    float tMax = tBottom > 0.0 ? tBottom : tTop;
+    float dt = tMax / float(steps);
+    float cosTheta = dot(d, sun);
+    float phaseRayleigh = 3.0 / (16.0 * PI) * (1.0 + cosTheta * cosTheta);
+    float g2 = mieG * mieG;
+    float phaseMie = (1.0 - g2) / (4.0 * PI * pow(1.0 + g2 - 2.0 * mieG * cosTheta, 1.5));
+    vec3 L = vec3(0.0), throughput = vec3(1.0);
+    for (int i = 0; i < steps; i++)
+    {
+        vec3 p = o + d * ((float(i) + 0.5) * dt);
+        float r = length(p);
+        float muSun = dot(p / r, sun);
+        Medium m = SampleMedium(r - bottomRadius);
+        vec3 scattering = m.rayleigh + vec3(m.mie);
+        float shadow = RaySphere(p, sun, bottomRadius) > 0.0 ? 0.0 : 1.0;
+        vec3 phased = isotropic ? scattering / (4.0 * PI) : m.rayleigh * phaseRayleigh + vec3(m.mie * phaseMie);
+        vec3 S = Transmittance(r, muSun) * shadow * phased;
+        if (multiple)
+            S += MultiScattering(r, muSun) * scattering;
+        // integrated analytically over the step, stays right for thick steps
+        vec3 stepTransmittance = exp(-m.extinction * dt);
+        vec3 extinction = max(m.extinction, vec3(1e-7));
+        L += throughput * (S - S * stepTransmittance) / extinction;
+        fms += throughput * (scattering - scattering * stepTransmittance) / extinction;
+        throughput *= stepTransmittance;
+    }
+    if (tBottom > 0.0)
+    {
+        // lambertian ground, lit by the sun through the atmosphere
+        vec3 p = o + d * tBottom;
+        float muSun = dot(normalize(p), sun);
+        L += throughput * Transmittance(bottomRadius, muSun) * max(muSun, 0.0) * groundAlbedo / PI;
+    }
+    return L;
+}
+
+void main()
+{
+    vec3 fms;
+    if (mode == 0)
+    {
+        // inverse of TransmittanceUV
+        float H = sqrt(topRadius * topRadius - bottomRadius * bottomRadius);
+        float rho = H * TexCoord.y;
+        float r = sqrt(rho * rho + bottomRadius * bottomRadius);
+        float dMin = topRadius - r, dMax = rho + H;
+        float d = dMin + TexCoord.x * (dMax - dMin);
+        float mu = d == 0.0 ? 1.0 : clamp((H * H - rho * rho - d * d) / (2.0 * r * d), -1.0, 1.0);
+        vec3 o = vec3(0.0, r, 0.0), dir = vec3(sqrt(1.0 - mu * mu), mu, 0.0);
+        float t = RaySphere(o, dir, topRadius);
+        const int STEPS = 40;
+        vec3 opticalDepth = vec3(0.0);
+        for (int i = 0; i < STEPS; i++)
+            opticalDepth += SampleMedium(length(o + dir * ((float(i) + 0.5) * t / STEPS)) - bottomRadius).extinction;
+        FragColor = vec4(exp(-opticalDepth * t / STEPS), 1.0);
+    }
+    else if (mode == 1)
+    {
+        float muSun = TexCoord.x * 2.0 - 1.0;
+        float r = bottomRadius + max(TexCoord.y * (topRadius - bottomRadius), 0.01);
+        vec3 o = vec3(0.0, r, 0.0), sun = vec3(sqrt(1.0 - muSun * muSun), muSun, 0.0);
+        // directions of equal solid angle over the whole sphere
+        const int N = 8;
+        vec3 L2 = vec3(0.0), f = vec3(0.0);
+        for (int i = 0; i < N; i++)
+            for (int j = 0; j < N; j++)
+            {
+                float cosTheta = 1.0 - 2.0 * (float(i) + 0.5) / N;
+                float phi = 2.0 * PI * (float(j) + 0.5) / N;
+                float sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+                L2 += Integrate(o, vec3(sinTheta * cos(phi), cosTheta, sinTheta * sin(phi)), sun, 20, true, false, fms);
+                f += fms;
+            }
+        L2 /= float(N * N);
+        f /= float(N * N);
+        // the scattering orders form a geometric series with ratio f
+        FragColor = vec4(L2 / (1.0 - f), 1.0);
+    }
+    else
+    {
+        float r = bottomRadius + viewHeight;
+        // finer around the horizon, which sits at v = 0.5
+        float beta = acos(sqrt(r * r - bottomRadius * bottomRadius) / r);
+        float horizonZenith = PI - beta;
+        float zenith;
+        if (TexCoord.y < 0.5)
+        {
+            float c = 1.0 - 2.0 * TexCoord.y;
+            zenith = horizonZenith * (1.0 - c * c);
+        }
+        else
+        {
+            float c = TexCoord.y * 2.0 - 1.0;
+            zenith = horizonZenith + beta * c * c;
+        }
+        float azimuth = TexCoord.x * 2.0 * PI; // from the sun
+        float muSun = sunDirection.y;
+        vec3 sun = vec3(sqrt(max(1.0 - muSun * muSun, 0.0)), muSun, 0.0);
+        vec3 dir = vec3(sin(zenith) * cos(azimuth), cos(zenith), sin(zenith) * sin(azimuth));
+        FragColor = vec4(Integrate(vec3(0.0, r, 0.0), dir, sun, 30, false, true, fms), 1.0);
+    }
+}
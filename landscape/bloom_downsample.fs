@@ -0,0 +1,67 @@
+#version 330 core
+// One step down the bloom chain: 13 taps in overlapping 4x4 boxes (Jimenez 2014), the
+// first step from the scene also keeps only the light above the threshold and weights
+// its boxes by brightness, so single bright pixels do not flicker as they move.
+in vec2 TexCoord;
+
+out vec3 FragColor;
+
+uniform sampler2D source;
+uniform vec2 sourceTexel; // 1 / size of source
+uniform int prefilter; // 1 for the step from the scene
+uniform float threshold;
+uniform float knee;
+
+float Luma(vec3 c)
+{
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// soft threshold with a quadratic knee
+vec3 Prefilter(vec3 c)
+{
+    float brightness = max(c.r, max(c.g, c.b));
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 1e-5);
+    return c * max(soft, brightness - threshold) / max(brightness, 1e-5);
+}
+
+vec3 Box(vec3 a, vec3 b, vec3 c, vec3 d)
+{
+    return (a + b + c + d) * 0.25;
+}
+
+void main()
+{
+    vec2 t = sourceTexel;
+    vec3 a = texture(source, TexCoord + t * vec2(-2.0, 2.0)).rgb;
+    vec3 b = texture(source, TexCoord + t * vec2(0.0, 2.0)).rgb;
+    vec3 c = texture(source, TexCoord + t * vec2(2.0, 2.0)).rgb;
+    vec3 d = texture(source, TexCoord + t * vec2(-2.0, 0.0)).rgb;
+    vec3 e = texture(source, TexCoord).rgb;
+    vec3 f = texture(source, TexCoord + t * vec2(2.0, 0.0)).rgb;
+    vec3 g = texture(source, TexCoord + t * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(source, TexCoord + t * vec2(0.0, -2.0)).rgb;
+    vec3 i = texture(source, TexCoord + t * vec2(2.0, -2.0)).rgb;
+    vec3 j = texture(source, TexCoord + t * vec2(-1.0, 1.0)).rgb;
+    vec3 k = texture(source, TexCoord + t * vec2(1.0, 1.0)).rgb;
+    vec3 l = texture(source, TexCoord + t * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(source, TexCoord + t * vec2(1.0, -1.0)).rgb;
+    vec3 boxes[5] = vec3[5](Box(j, k, l, m), Box(a, b, d, e), Box(b, c, e, f), Box(d, e, g, h), Box(e, f, h, i));
+    float weights[5] = float[5](0.5, 0.125, 0.125, 0.125, 0.125);
+    if (prefilter == 0)
+    {
+        FragColor = boxes[0] * weights[0] + (boxes[1] + boxes[2] + boxes[3] + boxes[4]) * 0.125;
+        return;
+    }
+    // Karis average: boxes weighted down by their brightness
+    vec3 color = vec3(0.0);
+    float sum = 0.0;
+    for (int n = 0; n < 5; n++)
+    {
+        float w = weights[n] / (1.0 + Luma(boxes[n]));
+        color += boxes[n] * w;
+        sum += w;
+    }
+    FragColor = Prefilter(color / sum);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+// One step up the bloom chain: a 3x3 tent over the smaller level, added onto the
+// larger one by the blend state, so each level ends up with all those below it.
+in vec2 TexCoord;
+
+out vec3 FragColor;
+
+uniform sampler2D source;
+uniform vec2 sourceTexel; // 1 / size of source
+uniform float radius; // spread of the tent, in texels of source
+
+void main()
+{
+    vec2 t = sourceTexel * radius;
+    vec3 color = texture(source, TexCoord).rgb * 4.0;
+    color += (texture(source, TexCoord + vec2(-t.x, 0.0)).rgb + texture(source, TexCoord + vec2(t.x, 0.0)).rgb
+        + texture(source, TexCoord + vec2(0.0, -t.y)).rgb + texture(source, TexCoord + vec2(0.0, t.y)).rgb) * 2.0;
+    color += texture(source, TexCoord - t).rgb + texture(source, TexCoord + t).rgb
+        + texture(source, TexCoord + vec2(-t.x, t.y)).rgb + texture(source, TexCoord + vec2(t.x, -t.y)).rgb;
+    FragColor = color / 16.0;
+}
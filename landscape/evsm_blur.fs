@@ -0,0 +1,23 @@
+#version 330 core
+// one direction of the separable Gaussian over the shadow moments
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D source;
+uniform vec2 direction; // one texel along the blur axis
+uniform int radius;
+
+void main()
+{
+    float sigma = max(float(radius) * 0.5, 0.5);
+    vec2 sum = vec2(0.0);
+    float weights = 0.0;
+    for(int i = -radius; i <= radius; ++i)
+    {
+        float w = exp(-float(i * i) / (2.0 * sigma * sigma));
+        sum += texture(source, TexCoord + direction * float(i)).rg * w;
+        weights += w;
+    }
+    FragColor = vec4(sum / weights, 0.0, 1.0);
+}
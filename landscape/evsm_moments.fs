@@ -0,0 +1,25 @@
+#version 330 core
+// warped depth and its square, averaged over the four depth texels under one moment texel
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2DArray depthMap;
+uniform int cascade;
+uniform float exponent; // e^(2 exponent) must stay below the float range
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(depthMap, 0).xy);
+    vec2 moments = vec2(0.0);
+    for(int x = 0; x <= 1; ++x)
+    {
+        for(int y = 0; y <= 1; ++y)
+        {
+            float depth = texture(depthMap, vec3(TexCoord + (vec2(x, y) - 0.5) * texel, float(cascade))).r;
+            float warped = exp(exponent * (depth * 2.0 - 1.0));
+            moments += vec2(warped, warped * warped);
+        }
+    }
+    FragColor = vec4(moments * 0.25, 0.0, 1.0);
+}
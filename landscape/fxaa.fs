@@ -0,0 +1,121 @@
+#version 330 core
+// FXAA in the manner of Lottes' quality preset: finds the direction of a luma edge, walks
+// along it to both ends and moves the sample across the edge by how far the pixel is from
+// the nearer end, with a subpixel blend for isolated bright pixels.
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D image; // 8 bit, after the tonemapping
+uniform vec2 texel;
+uniform float edgeThreshold; // relative contrast below which nothing is done
+uniform float edgeThresholdMin; // absolute contrast below which nothing is done, for dark areas
+uniform float subpixel; // strength of the subpixel blend
+
+const int STEPS = 10;
+const float STEP_SIZES[STEPS] = float[](1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 2.0, 4.0, 8.0);
+
+float Luma(vec3 c)
+{
+    return sqrt(dot(c, vec3(0.299, 0.587, 0.114)));
+}
+
+float LumaAt(vec2 uv)
+{
+    return Luma(textureLod(image, uv, 0.0).rgb);
+}
+
+void main()
+{
+    vec3 colorM = textureLod(image, TexCoord, 0.0).rgb;
+    float lumaM = Luma(colorM);
+    float lumaN = LumaAt(TexCoord + vec2(0.0, texel.y));
+    float lumaS = LumaAt(TexCoord - vec2(0.0, texel.y));
+    float lumaE = LumaAt(TexCoord + vec2(texel.x, 0.0));
+    float lumaW = LumaAt(TexCoord - vec2(texel.x, 0.0));
+    float lumaMax = max(lumaM, max(max(lumaN, lumaS), max(lumaE, lumaW)));
+    float lumaMin = min(lumaM, min(min(lumaN, lumaS), min(lumaE, lumaW)));
+    float range = lumaMax - lumaMin;
+    if (range < max(edgeThresholdMin, lumaMax * edgeThreshold))
+    {
+        FragColor = vec4(colorM, 1.0);
+        return;
+    }
+
+    float lumaNE = LumaAt(TexCoord + texel);
+    float lumaSW = LumaAt(TexCoord - texel);
+    float lumaNW = LumaAt(TexCoord + vec2(-texel.x, texel.y));
+    float lumaSE = LumaAt(TexCoord + vec2(texel.x, -texel.y));
+    float lumaNS = lumaN + lumaS, lumaWE = lumaW + lumaE;
+    float lumaWCorners = lumaNW + lumaSW, lumaECorners = lumaNE + lumaSE;
+    float lumaNCorners = lumaNW + lumaNE, lumaSCorners = lumaSW + lumaSE;
+    float edgeHorizontal = abs(-2.0 * lumaW + lumaWCorners) + 2.0 * abs(-2.0 * lumaM + lumaNS) + abs(-2.0 * lumaE + lumaECorners);
+    float edgeVertical = abs(-2.0 * lumaN + lumaNCorners) + 2.0 * abs(-2.0 * lumaM + lumaWE) + abs(-2.0 * lumaS + lumaSCorners);
+    bool horizontal = edgeHorizontal >= edgeVertical;
+
+    // the side of the edge with the steeper gradient
+    float luma1 = horizontal ? lumaS : lumaW;
+    float luma2 = horizontal ? lumaN : lumaE;
+    float gradient1 = luma1 - lumaM, gradient2 = luma2 - lumaM;
+    bool side1 = abs(gradient1) >= abs(gradient2);
+    float gradientScaled = 0.25 * max(abs(gradient1), abs(gradient2));
+    float stepLength = horizontal ? texel.y : texel.x;
+    float lumaLocalAverage;
+    if (side1)
+    {
+        stepLength = -stepLength;
+        lumaLocalAverage = 0.5 * (luma1 + lumaM);
+    }
+    else
+        lumaLocalAverage = 0.5 * (luma2 + lumaM);
+
+    // walk along the middle of the edge to both ends
+    vec2 uv = TexCoord;
+    if (horizontal)
+        uv.y += stepLength * 0.5;
+    else
+        uv.x += stepLength * 0.5;
+    vec2 along = horizontal ? vec2(texel.x, 0.0) : vec2(0.0, texel.y);
+    vec2 uv1 = uv - along, uv2 = uv + along;
+    float lumaEnd1 = LumaAt(uv1) - lumaLocalAverage;
+    float lumaEnd2 = LumaAt(uv2) - lumaLocalAverage;
+    bool reached1 = abs(lumaEnd1) >= gradientScaled;
+    bool reached2 = abs(lumaEnd2) >= gradientScaled;
+    for (int i = 1; i < STEPS && !(reached1 && reached2); i++)
+    {
+        if (!reached1)
+        {
+            uv1 -= along * STEP_SIZES[i];
+            lumaEnd1 = LumaAt(uv1) - lumaLocalAverage;
+            reached1 = abs(lumaEnd1) >= gradientScaled;
+        }
+        if (!reached2)
+        {
+            uv2 += along * STEP_SIZES[i];
+            lumaEnd2 = LumaAt(uv2) - lumaLocalAverage;
+            reached2 = abs(lumaEnd2) >= gradientScaled;
+        }
+    }
+
+    float distance1 = horizontal ? TexCoord.x - uv1.x : TexCoord.y - uv1.y;
+    float distance2 = horizontal ? uv2.x - TexCoord.x : uv2.y - TexCoord.y;
+    bool nearer1 = distance1 < distance2;
+    float distanceNearer = min(distance1, distance2);
+    float edgeLength = distance1 + distance2;
+    // only move when the nearer end turns away from the center pixel, the other end belongs to a neighbour
+    bool centerSmaller = lumaM < lumaLocalAverage;
+    bool correctVariation = ((nearer1 ? lumaEnd1 : lumaEnd2) < 0.0) != centerSmaller;
+    float pixelOffset = correctVariation ? -distanceNearer / edgeLength + 0.5 : 0.0;
+
+    float lumaAverage = (2.0 * (lumaNS + lumaWE) + lumaWCorners + lumaECorners) / 12.0;
+    float subpixelOffset = clamp(abs(lumaAverage - lumaM) / range, 0.0, 1.0);
+    subpixelOffset = (-2.0 * subpixelOffset + 3.0) * subpixelOffset * subpixelOffset;
+    pixelOffset = max(pixelOffset, subpixelOffset * subpixelOffset * subpixel);
+
+    vec2 finalUV = TexCoord;
+    if (horizontal)
+        finalUV.y += pixelOffset * stepLength;
+    else
+        finalUV.x += pixelOffset * stepLength;
+    FragColor = vec4(textureLod(image, finalUV, 0.0).rgb, 1.0);
+}
@@ -0,0 +1,129 @@
+#ifndef HORIZON_H
+#define HORIZON_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <Shader.h>
+#include <terrain.h>
+#include <horizonfield.h>
+#include <RenderSettings.h>
+#include <RenderStats.h>
+
+#include <cmath>
+#include <chrono>
+
+namespace KooNan
+{
+	// Horizon of the terrain around every height sample, for a fixed set of azimuths.
+	// The chunks of the scene are merged into one height grid; each layer of the texture
+	// array holds, for one azimuth, the tangent of the highest elevation seen from the
+	// ground, the distance to that point and the ground height itself. The lit shaders
+	// compare the sun against it instead of rasterizing the terrain into the shadow map.
+	// The marching itself is HorizonField, this class feeds it the chunks and uploads it.
+	class HorizonMap
+	{
+	public:
+		static const int DIRECTIONS = HorizonField::DIRECTIONS;
+	private:
+		unsigned int texture;
+		HorizonField field;
+		int chunkCells; // cells per chunk side
+		float spacing;
+		glm::vec2 origin; // world x, z of sample (0, 0)
+	public:
+		HorizonMap() : chunkCells(0), spacing(1.0f), origin(0.0f)
+		{
+			glGenTextures(1, &texture);
+		}
+		void cleanUp()
+		{
+			glDeleteTextures(1, &texture);
+		}
+
+		// Build: merge the chunks and compute every sample
+		//   width, height: chunk grid of the scene, chunks[i * height + j] is at grid index (i, j)
+		void Build(std::vector<Terrain>& chunks, int width, int height)
+		{
+			if (chunks.empty())
+				return;
+			Terrain& first = chunks.front();
+			chunkCells = first.GetVertexCount() - 1;
+			spacing = first.GetSize() / chunkCells;
+			origin = first.GetFirstVertex() - glm::vec2(first.GetGridX(), first.GetGridZ()) * first.GetSize();
+			field.Resize(width * chunkCells + 1, height * chunkCells + 1, spacing);
+			for (Terrain& chunk : chunks)
+				CopyHeights(chunk, 0, 0, chunkCells, chunkCells);
+
+			glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB16F, field.GetSizeX(), field.GetSizeZ(), DIRECTIONS, 0, GL_RGB, GL_FLOAT, NULL);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+			Compute(0, 0, field.GetSizeX() - 1, field.GetSizeZ() - 1);
+		}
+
+		// Update: take the edited heights of one chunk and recompute the samples whose horizon can see them
+		//   x0, z0, x1, z1: edited vertices of the chunk, inclusive
+		void Update(Terrain& chunk, int x0, int z0, int x1, int z1)
+		{
+			if (field.Empty())
+				return;
+			CopyHeights(chunk, x0, z0, x1, z1);
+			int gx = chunk.GetGridX() * chunkCells, gz = chunk.GetGridZ() * chunkCells;
+			x0 += gx; z0 += gz; x1 += gx; z1 += gz;
+			field.Reach(x0, z0, x1, z1, SearchSteps());
+			Compute(x0, z0, x1, z1);
+		}
+
+		// Bind: the map and its placement for HorizonShadow in terrain.fs and model.fs
+		void Bind(Shader& shader, int unit)
+		{
+			shader.use();
+			shader.setInt("horizonMap", unit);
+			shader.setVec2("horizonOrigin", origin);
+			shader.setFloat("horizonSpacing", spacing);
+			shader.setInt("horizonShadows", RenderSettings::horizonShadows && !field.Empty() ? 1 : 0);
+			glActiveTexture(GL_TEXTURE0 + unit);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+			glActiveTexture(GL_TEXTURE0);
+		}
+
+	private:
+		void CopyHeights(Terrain& chunk, int x0, int z0, int x1, int z1)
+		{
+			const std::vector<float>& src = chunk.GetHeights();
+			int n = chunk.GetVertexCount();
+			int gx = chunk.GetGridX() * chunkCells, gz = chunk.GetGridZ() * chunkCells;
+			for (int z = z0; z <= z1; z++)
+				for (int x = x0; x <= x1; x++)
+					field.Height(gx + x, gz + z) = src[z * n + x];
+		}
+		int SearchSteps() const
+		{
+			return (int)std::ceil(RenderSettings::horizonSearchDistance / spacing);
+		}
+		// Compute: march every azimuth from the samples of the rectangle, then upload it
+		//   x0, z0, x1, z1: samples of the merged grid, inclusive
+		void Compute(int x0, int z0, int x1, int z1)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			field.March(x0, z0, x1, z1, SearchSteps());
+
+			glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, field.GetSizeX());
+			glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, field.GetSizeZ());
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x0, z0, 0, x1 - x0 + 1, z1 - z0 + 1, DIRECTIONS, GL_RGB, GL_FLOAT,
+				&field.GetTexels()[((size_t)z0 * field.GetSizeX() + x0) * HorizonField::CHANNELS]);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+			glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+			RenderStats::horizonTexelsUpdated += (unsigned int)((x1 - x0 + 1) * (z1 - z0 + 1));
+			RenderStats::horizonCpuMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+	};
+}
+
+#endif // !HORIZON_H
@@ -0,0 +1,121 @@
+#ifndef HORIZONFIELD_H
+#define HORIZONFIELD_H
+
+#include <glm/glm.hpp>
+
+#include <ThreadPool.h>
+
+#include <vector>
+#include <cmath>
+
+namespace KooNan
+{
+	// The CPU half of HorizonMap: the merged height grid and the horizon marched from it.
+	// Needs no GL context, HorizonMap uploads the texels it marches.
+	class HorizonField
+	{
+	public:
+		static const int DIRECTIONS = 8; // azimuth k points along (cos, sin)(2 pi k / DIRECTIONS) in (x, z)
+		static const int CHANNELS = 3; // tangent, distance, ground height
+	private:
+		int sizeX, sizeZ;
+		float spacing;
+		std::vector<float> heights; // sizeX * sizeZ, row z at z * sizeX
+		std::vector<float> texels; // DIRECTIONS layers of sizeX * sizeZ * CHANNELS
+	public:
+		HorizonField() : sizeX(0), sizeZ(0), spacing(1.0f) {}
+
+		// Resize: a flat grid with nothing marched yet
+		//   spacing: world distance between neighbouring samples
+		void Resize(int sizeX, int sizeZ, float spacing)
+		{
+			this->sizeX = sizeX;
+			this->sizeZ = sizeZ;
+			this->spacing = spacing;
+			heights.assign((size_t)sizeX * sizeZ, 0.0f);
+			texels.assign((size_t)DIRECTIONS * sizeX * sizeZ * CHANNELS, 0.0f);
+		}
+		bool Empty() const
+		{
+			return heights.empty();
+		}
+		int GetSizeX() const
+		{
+			return sizeX;
+		}
+		int GetSizeZ() const
+		{
+			return sizeZ;
+		}
+		float& Height(int x, int z)
+		{
+			return heights[(size_t)z * sizeX + x];
+		}
+		// GetTexels: layer d, row z, sample x at ((d * sizeZ + z) * sizeX + x) * CHANNELS
+		const std::vector<float>& GetTexels() const
+		{
+			return texels;
+		}
+
+		// Reach: grow a rectangle of changed heights to the samples whose horizon can see them
+		//   x0, z0, x1, z1: inclusive, clamped to the grid
+		//   steps: samples marched from each sample, as given to March
+		void Reach(int& x0, int& z0, int& x1, int& z1, int steps) const
+		{
+			x0 = glm::max(x0 - steps, 0);
+			z0 = glm::max(z0 - steps, 0);
+			x1 = glm::min(x1 + steps, sizeX - 1);
+			z1 = glm::min(z1 + steps, sizeZ - 1);
+		}
+
+		// March: every azimuth from the samples of the rectangle, on the shared thread pool
+		//   x0, z0, x1, z1: inclusive
+		//   steps: samples marched along each azimuth, the horizon search distance over the spacing
+		void March(int x0, int z0, int x1, int z1, int steps)
+		{
+			float maxX = (float)(sizeX - 1), maxZ = (float)(sizeZ - 1);
+			ThreadPool::Instance().ParallelFor(z1 - z0 + 1, [&](int row) {
+				int z = z0 + row;
+				for (int d = 0; d < DIRECTIONS; d++)
+				{
+					float angle = 2.0f * 3.14159265f * d / DIRECTIONS;
+					float dx = std::cos(angle), dz = std::sin(angle);
+					float* out = &texels[(((size_t)d * sizeZ + z) * sizeX) * CHANNELS];
+					for (int x = x0; x <= x1; x++)
+					{
+						float h0 = heights[z * sizeX + x];
+						float bestTan = -64.0f, bestDist = steps * spacing;
+						for (int s = 1; s <= steps; s++)
+						{
+							float px = x + dx * s, pz = z + dz * s;
+							if (px < 0.0f || pz < 0.0f || px > maxX || pz > maxZ)
+								break;
+							float tangent = (HeightAt(px, pz) - h0) / (s * spacing);
+							if (tangent > bestTan)
+							{
+								bestTan = tangent;
+								bestDist = s * spacing;
+							}
+						}
+						out[x * CHANNELS + 0] = glm::min(bestTan, 64.0f);
+						out[x * CHANNELS + 1] = bestDist;
+						out[x * CHANNELS + 2] = h0;
+					}
+				}
+			});
+		}
+
+	private:
+		float HeightAt(float x, float z) const
+		{
+			int ix = glm::min((int)x, sizeX - 2), iz = glm::min((int)z, sizeZ - 2);
+			float fx = x - ix, fz = z - iz;
+			const float* row = &heights[iz * sizeX + ix];
+			float top = row[0] + (row[1] - row[0]) * fx;
+			float bottom = row[sizeX] + (row[sizeX + 1] - row[sizeX]) * fx;
+			return top + (bottom - top) * fz;
+		}
+	};
+}
+
+#endif // !HORIZONFIELD_H
@@ -6,6 +6,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <vector>
 #include <string>
+#include <cmath>
+#include <cfloat>
 #include <Shader.h>
 #include <Camera.h>
 #include <cube.h>
@@ -24,6 +26,18 @@ namespace KooNan
 		glm::vec3 diffuse;
 		glm::vec3 specular;
 	};
+	// LightRange: distance at which the attenuated diffuse term falls below a few 8 bit steps,
+	//   FLT_MAX for lights without falloff
+	inline float LightRange(const PointLight& light)
+	{
+		float brightest = glm::max(glm::max(light.diffuse.r, light.diffuse.g), light.diffuse.b);
+		float c = light.constant - brightest * 256.0f / 5.0f;
+		if (light.quadratic > 1e-6f)
+			return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+		if (light.linear > 1e-6f)
+			return glm::max(-c / light.linear, 0.0f);
+		return FLT_MAX;
+	}
 	struct DirLight {
 		glm::vec3 direction;
 
@@ -5,5 +5,6 @@ uniform vec3 viewPos;
 
 void main()
 {
-    FragColor = vec4(1.0); // set alle 4 vector values to 1.0
+    // brighter than white, so the lamps bloom in the HDR pipeline; the 8 bit targets clamp it to white
+    FragColor = vec4(vec3(4.0), 1.0);
 }
\ No newline at end of file
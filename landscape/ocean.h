@@ -0,0 +1,173 @@
+#ifndef OCEAN_H
+#define OCEAN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <Shader.h>
+#include <oceanfft.h>
+#include <RenderSettings.h>
+#include <RenderStats.h>
+
+#include <vector>
+#include <chrono>
+
+namespace KooNan
+{
+	// FFT waves on the sea level. OceanFFT fills a displacement and a normal map each
+	// frame; the surface is one grid that follows the camera, its vertex spacing growing
+	// with the distance from the center, displaced in water.vs and clamped to the water chunks.
+	class Ocean
+	{
+	public:
+		static const int GRID_SIZE = 128; // vertices per side
+	private:
+		OceanFFT* sim;
+		unsigned int displacementMap, normalMap;
+		unsigned int VAO, VBO, EBO;
+		int indexCount;
+		float time;
+	public:
+		Ocean() : sim(NULL), time(0.0f)
+		{
+			glGenTextures(1, &displacementMap);
+			glGenTextures(1, &normalMap);
+			setUpGrid();
+		}
+		void cleanUp()
+		{
+			delete sim;
+			sim = NULL;
+			glDeleteTextures(1, &displacementMap);
+			glDeleteTextures(1, &normalMap);
+			glDeleteVertexArrays(1, &VAO);
+			glDeleteBuffers(1, &VBO);
+			glDeleteBuffers(1, &EBO);
+		}
+
+		// Update: advance the simulation and upload the maps, nothing while the waves are off
+		void Update(float deltaTime)
+		{
+			if (!RenderSettings::oceanWaves)
+				return;
+			if (sim == NULL || sim->GetResolution() != RenderSettings::oceanResolution)
+			{
+				delete sim;
+				sim = new OceanFFT(RenderSettings::oceanResolution, RenderSettings::oceanPatchSize, RenderSettings::oceanWindSpeed,
+					RenderSettings::oceanWindAngle, RenderSettings::oceanWaveHeight, RenderSettings::oceanChoppiness);
+				allocateMaps();
+			}
+			time += deltaTime;
+			auto start = std::chrono::high_resolution_clock::now();
+			sim->Simulate(time);
+			RenderStats::oceanCpuMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			int n = sim->GetResolution();
+			glBindTexture(GL_TEXTURE_2D, displacementMap);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, n, n, GL_RGB, GL_FLOAT, sim->GetDisplacement().data());
+			glBindTexture(GL_TEXTURE_2D, normalMap);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, n, n, GL_RGB, GL_FLOAT, sim->GetNormals().data());
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+
+		bool IsActive() const
+		{
+			return RenderSettings::oceanWaves && sim != NULL;
+		}
+
+		// Draw: the grid around viewPos, clamped to the water rectangle extentMin .. extentMax (x, z)
+		//   displacementUnit, normalUnit: texture units for the two maps
+		void Draw(Shader& shader, const glm::vec3& viewPos, const glm::vec2& extentMin, const glm::vec2& extentMax, float waterHeight,
+			int displacementUnit, int normalUnit)
+		{
+			// snap to the finest spacing so the inner vertices do not swim
+			float spacing = centerSpacing();
+			glm::vec2 origin = glm::floor(glm::vec2(viewPos.x, viewPos.z) / spacing) * spacing;
+			shader.use();
+			shader.setInt("waves", 1);
+			shader.setVec2("gridOrigin", origin);
+			shader.setVec2("waterExtentMin", extentMin);
+			shader.setVec2("waterExtentMax", extentMax);
+			shader.setFloat("waterHeight", waterHeight);
+			shader.setFloat("wavePatchSize", sim->GetPatchSize());
+			shader.setFloat("waveFadeDistance", RenderSettings::oceanFadeDistance);
+			shader.setInt("displacementMap", displacementUnit);
+			shader.setInt("waveNormalMap", normalUnit);
+			glActiveTexture(GL_TEXTURE0 + displacementUnit);
+			glBindTexture(GL_TEXTURE_2D, displacementMap);
+			glActiveTexture(GL_TEXTURE0 + normalUnit);
+			glBindTexture(GL_TEXTURE_2D, normalMap);
+			glActiveTexture(GL_TEXTURE0);
+
+			glBindVertexArray(VAO);
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+			glBindVertexArray(0);
+			shader.setInt("waves", 0);
+		}
+
+	private:
+		// grid coordinate u in [-1, 1] to a distance from the center, fine near 0 and coarse at the rim
+		static float warp(float u)
+		{
+			const float inner = 0.06f; // share of the linear term
+			return RenderSettings::oceanGridExtent * u * (inner + (1.0f - inner) * u * u);
+		}
+		static float centerSpacing()
+		{
+			return warp(2.0f / (GRID_SIZE - 1));
+		}
+		void setUpGrid()
+		{
+			std::vector<float> vertices;
+			for (int j = 0; j < GRID_SIZE; j++)
+				for (int i = 0; i < GRID_SIZE; i++)
+				{
+					float u = i * 2.0f / (GRID_SIZE - 1) - 1.0f;
+					float v = j * 2.0f / (GRID_SIZE - 1) - 1.0f;
+					vertices.push_back(warp(u));
+					vertices.push_back(0.0f);
+					vertices.push_back(warp(v));
+				}
+			std::vector<unsigned int> indices;
+			for (int j = 0; j + 1 < GRID_SIZE; j++)
+				for (int i = 0; i + 1 < GRID_SIZE; i++)
+				{
+					unsigned int a = j * GRID_SIZE + i, b = a + 1, c = a + GRID_SIZE, d = c + 1;
+					indices.insert(indices.end(), { a, c, b, b, c, d });
+				}
+			indexCount = (int)indices.size();
+			glGenVertexArrays(1, &VAO);
+			glGenBuffers(1, &VBO);
+			glGenBuffers(1, &EBO);
+			glBindVertexArray(VAO);
+			glBindBuffer(GL_ARRAY_BUFFER, VBO);
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+			glBindVertexArray(0);
+		}
+		void allocateMaps()
+		{
+			int n = sim->GetResolution();
+			unsigned int maps[2] = { displacementMap, normalMap };
+			for (unsigned int map : maps)
+			{
+				glBindTexture(GL_TEXTURE_2D, map);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, n, n, 0, GL_RGB, GL_FLOAT, (void*)nullptr);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			}
+			// the normals are read by the fragments, minified far away
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+	};
+}
+
+#endif // !OCEAN_H
@@ -0,0 +1,313 @@
+#ifndef OCEANFFT_H
+#define OCEANFFT_H
+
+#include <glm/glm.hpp>
+
+#include <ThreadPool.h>
+
+#include <vector>
+#include <complex>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KOONAN_OCEAN_SSE
+#endif
+
+namespace KooNan
+{
+	// Tessendorf ocean: a Phillips spectrum evolved in time and brought to space with
+	// inverse FFTs. The result covers one square patch and tiles seamlessly, since the
+	// FFT is periodic. Needs no GL context.
+	// The 2D transform runs as butterflies down the columns, four columns per SIMD
+	// lane set and one task per four columns, then a transpose and the same again.
+	class OceanFFT
+	{
+	public:
+		static const int FIELDS = 5; // height, displacement x, displacement z, slope x, slope z
+	private:
+		int N;
+		float patchSize;
+		float choppiness;
+		std::vector<std::complex<float>> h0; // h0(k)
+		std::vector<std::complex<float>> h0MinusConj; // conj(h0(-k))
+		std::vector<float> omega; // dispersion, deep water
+		std::vector<float> re[FIELDS], im[FIELDS];
+		std::vector<float> scratch[FIELDS]; // transpose target
+		std::vector<float> twiddleRe, twiddleIm; // e^(+2 pi i j / N), j < N / 2
+		std::vector<int> bitReverse;
+		std::vector<glm::vec3> displacement;
+		std::vector<glm::vec3> normals;
+	public:
+		/*
+		int resolution: samples per side, a power of two >= 4
+		float patch_size: side of the patch in world units
+		float wind_speed, wind_angle: wind in m/s and its heading in degrees, from +x towards +z
+		float wave_height: significant wave height (four standard deviations of the surface)
+		float choppiness: horizontal displacement factor, 0 gives round crests
+		*/
+		OceanFFT(int resolution, float patch_size, float wind_speed, float wind_angle, float wave_height, float choppiness, unsigned int seed = 1) :
+			N(resolution), patchSize(patch_size), choppiness(choppiness)
+		{
+			int count = N * N;
+			h0.resize(count);
+			h0MinusConj.resize(count);
+			omega.resize(count);
+			for (int f = 0; f < FIELDS; f++)
+			{
+				re[f].resize(count);
+				im[f].resize(count);
+				scratch[f].resize(count);
+			}
+			displacement.resize(count);
+			normals.resize(count);
+
+			int bits = 0;
+			while ((1 << bits) < N)
+				bits++;
+			bitReverse.resize(N);
+			for (int i = 0; i < N; i++)
+			{
+				int r = 0;
+				for (int b = 0; b < bits; b++)
+					r |= ((i >> b) & 1) << (bits - 1 - b);
+				bitReverse[i] = r;
+			}
+			for (int j = 0; j < N / 2; j++)
+			{
+				float a = 2.0f * 3.14159265f * j / N;
+				twiddleRe.push_back(std::cos(a));
+				twiddleIm.push_back(std::sin(a));
+			}
+
+			// Phillips spectrum
+			const float g = 9.81f;
+			float windRad = glm::radians(wind_angle);
+			glm::vec2 windDir(std::cos(windRad), std::sin(windRad));
+			float Lw = wind_speed * wind_speed / g; // largest wave from the wind
+			float damping = Lw * 0.001f; // suppresses waves much shorter than the wind allows
+			std::vector<float> phillips(count);
+			double variance = 0.0;
+			for (int m = 0; m < N; m++)
+				for (int n = 0; n < N; n++)
+				{
+					glm::vec2 k = WaveVector(n, m);
+					float k2 = glm::dot(k, k);
+					int idx = m * N + n;
+					if (k2 < 1e-12f)
+					{
+						phillips[idx] = 0.0f;
+						continue;
+					}
+					float kdotw = glm::dot(k / std::sqrt(k2), windDir);
+					float p = std::exp(-1.0f / (k2 * Lw * Lw)) / (k2 * k2) * kdotw * kdotw * std::exp(-k2 * damping * damping);
+					if (kdotw < 0.0f)
+						p *= 0.07f; // waves against the wind are weak
+					phillips[idx] = p;
+					omega[idx] = std::sqrt(g * std::sqrt(k2));
+				}
+			for (int idx = 0; idx < count; idx++)
+			{
+				int n = idx % N, m = idx / N;
+				variance += phillips[idx] + phillips[((N - m) % N) * N + (N - n) % N];
+			}
+			// the spectrum is only known up to a constant, pick it from the wave height
+			float amplitude = variance > 0.0 ? wave_height / (4.0f * (float)std::sqrt(variance)) : 0.0f;
+
+			std::mt19937 rng(seed);
+			std::normal_distribution<float> gauss(0.0f, 1.0f);
+			for (int idx = 0; idx < count; idx++)
+			{
+				float xr = gauss(rng), xi = gauss(rng);
+				h0[idx] = std::complex<float>(xr, xi) * (amplitude * std::sqrt(phillips[idx] * 0.5f));
+			}
+			for (int idx = 0; idx < count; idx++)
+			{
+				int n = idx % N, m = idx / N;
+				h0MinusConj[idx] = std::conj(h0[((N - m) % N) * N + (N - n) % N]);
+			}
+		}
+
+		// Simulate: evaluate the surface at time seconds, on the shared thread pool
+		void Simulate(float time)
+		{
+			ThreadPool& pool = ThreadPool::Instance();
+			pool.ParallelFor(N, [this, time](int m) { FillSpectrum(m, time); });
+
+			int groups = N / 4;
+			pool.ParallelFor(FIELDS * groups, [this, groups](int task) {
+				int f = task / groups;
+				TransformColumns(re[f].data(), im[f].data(), (task % groups) * 4);
+			});
+			pool.ParallelFor(FIELDS, [this](int f) {
+				Transpose(re[f], scratch[f]);
+				re[f].swap(scratch[f]);
+				Transpose(im[f], scratch[f]);
+				im[f].swap(scratch[f]);
+			});
+			pool.ParallelFor(FIELDS * groups, [this, groups](int task) {
+				int f = task / groups;
+				TransformColumns(re[f].data(), im[f].data(), (task % groups) * 4);
+			});
+			pool.ParallelFor(N, [this](int z) { WriteRow(z); });
+		}
+
+		// EvaluateDirect: sample (x, z) at time seconds by a direct sum over the spectrum
+		//   O(N^2) per sample, the reference the FFT is checked against
+		void EvaluateDirect(float time, int x, int z, glm::vec3& outDisplacement, glm::vec3& outNormal) const
+		{
+			double sum[FIELDS] = {};
+			std::complex<float> value[FIELDS];
+			for (int m = 0; m < N; m++)
+				for (int n = 0; n < N; n++)
+				{
+					SpectrumAt(m * N + n, time, value);
+					double a = 2.0 * 3.14159265358979 * ((n * x + m * z) % N) / N;
+					double c = std::cos(a), s = std::sin(a);
+					// only the real part, the spectra are hermitian
+					for (int f = 0; f < FIELDS; f++)
+						sum[f] += value[f].real() * c - value[f].imag() * s;
+				}
+			outDisplacement = glm::vec3(choppiness * (float)sum[1], (float)sum[0], choppiness * (float)sum[2]);
+			outNormal = glm::normalize(glm::vec3(-(float)sum[3], 1.0f, -(float)sum[4]));
+		}
+
+		int GetResolution() const
+		{
+			return N;
+		}
+		float GetPatchSize() const
+		{
+			return patchSize;
+		}
+		// GetDisplacement: x, y, z offsets of each sample, row z at z * N
+		const std::vector<glm::vec3>& GetDisplacement() const
+		{
+			return displacement;
+		}
+		const std::vector<glm::vec3>& GetNormals() const
+		{
+			return normals;
+		}
+
+	private:
+		glm::vec2 WaveVector(int n, int m) const
+		{
+			// standard FFT order, the upper half stands for negative frequencies
+			int kn = n < N / 2 ? n : n - N;
+			int km = m < N / 2 ? m : m - N;
+			return glm::vec2(kn, km) * (2.0f * 3.14159265f / patchSize);
+		}
+
+		// SpectrumAt: the five spectra of frequency idx at the given time
+		void SpectrumAt(int idx, float time, std::complex<float> out[FIELDS]) const
+		{
+			glm::vec2 k = WaveVector(idx % N, idx / N);
+			float len = glm::length(k);
+			if (len < 1e-6f)
+			{
+				for (int f = 0; f < FIELDS; f++)
+					out[f] = 0.0f;
+				return;
+			}
+			float c = std::cos(omega[idx] * time), s = std::sin(omega[idx] * time);
+			std::complex<float> h = h0[idx] * std::complex<float>(c, s) + h0MinusConj[idx] * std::complex<float>(c, -s);
+			float ux = k.x / len, uz = k.y / len;
+			out[0] = h;
+			// -i k / |k| h
+			out[1] = std::complex<float>(ux * h.imag(), -ux * h.real());
+			out[2] = std::complex<float>(uz * h.imag(), -uz * h.real());
+			// i k h
+			out[3] = std::complex<float>(-k.x * h.imag(), k.x * h.real());
+			out[4] = std::complex<float>(-k.y * h.imag(), k.y * h.real());
+		}
+
+		// FillSpectrum: the five spectra of row m at the given time
+		void FillSpectrum(int m, float time)
+		{
+			std::complex<float> value[FIELDS];
+			for (int n = 0; n < N; n++)
+			{
+				int idx = m * N + n;
+				SpectrumAt(idx, time, value);
+				for (int f = 0; f < FIELDS; f++)
+				{
+					re[f][idx] = value[f].real();
+					im[f][idx] = value[f].imag();
+				}
+			}
+		}
+
+		// TransformColumns: in place inverse FFT of columns x0 .. x0 + 3
+		void TransformColumns(float* r, float* i, int x0) const
+		{
+			for (int a = 0; a < N; a++)
+			{
+				int b = bitReverse[a];
+				if (b <= a)
+					continue;
+				for (int c = 0; c < 4; c++)
+				{
+					std::swap(r[a * N + x0 + c], r[b * N + x0 + c]);
+					std::swap(i[a * N + x0 + c], i[b * N + x0 + c]);
+				}
+			}
+			for (int size = 2; size <= N; size *= 2)
+			{
+				int half = size / 2, step = N / size;
+				for (int start = 0; start < N; start += size)
+					for (int k = 0; k < half; k++)
+					{
+						float wr = twiddleRe[k * step], wi = twiddleIm[k * step];
+						float* ar = r + (start + k) * N + x0;
+						float* ai = i + (start + k) * N + x0;
+						float* br = r + (start + k + half) * N + x0;
+						float* bi = i + (start + k + half) * N + x0;
+#ifdef KOONAN_OCEAN_SSE
+						__m128 vwr = _mm_set1_ps(wr), vwi = _mm_set1_ps(wi);
+						__m128 xr = _mm_loadu_ps(br), xi = _mm_loadu_ps(bi);
+						__m128 tr = _mm_sub_ps(_mm_mul_ps(xr, vwr), _mm_mul_ps(xi, vwi));
+						__m128 ti = _mm_add_ps(_mm_mul_ps(xr, vwi), _mm_mul_ps(xi, vwr));
+						__m128 yr = _mm_loadu_ps(ar), yi = _mm_loadu_ps(ai);
+						_mm_storeu_ps(ar, _mm_add_ps(yr, tr));
+						_mm_storeu_ps(ai, _mm_add_ps(yi, ti));
+						_mm_storeu_ps(br, _mm_sub_ps(yr, tr));
+						_mm_storeu_ps(bi, _mm_sub_ps(yi, ti));
+#else
+						for (int c = 0; c < 4; c++)
+						{
+							float tr = br[c] * wr - bi[c] * wi;
+							float ti = br[c] * wi + bi[c] * wr;
+							br[c] = ar[c] - tr;
+							bi[c] = ai[c] - ti;
+							ar[c] += tr;
+							ai[c] += ti;
+						}
+#endif
+					}
+			}
+		}
+
+		void Transpose(const std::vector<float>& src, std::vector<float>& dst) const
+		{
+			for (int y = 0; y < N; y++)
+				for (int x = 0; x < N; x++)
+					dst[x * N + y] = src[y * N + x];
+		}
+
+		// WriteRow: after the second pass the value of (x, z) sits at x * N + z
+		void WriteRow(int z)
+		{
+			for (int x = 0; x < N; x++)
+			{
+				int t = x * N + z;
+				displacement[z * N + x] = glm::vec3(choppiness * re[1][t], re[0][t], choppiness * re[2][t]);
+				normals[z * N + x] = glm::normalize(glm::vec3(-re[3][t], 1.0f, -re[4][t]));
+			}
+		}
+	};
+}
+
+#endif // !OCEANFFT_H
@@ -0,0 +1,11 @@
+#version 330 core
+in vec3 FragPos;
+
+uniform vec3 lightPos;
+uniform float farPlane; // range of the light
+
+void main()
+{
+    // linear distance, the same value the lit shaders compute per fragment
+    gl_FragDepth = length(FragPos - lightPos) / farPlane;
+}
@@ -0,0 +1,80 @@
+#version 330 core
+// One face of one mip of a reflection probe: the captured environment convolved with the
+// GGX lobe of the roughness of that mip, importance sampled with the view along the normal.
+// Samples of low density read coarser mips of the capture instead of being many.
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform samplerCube environment; // the capture, mipmapped
+uniform int face; // GL cube map face order
+uniform float roughness;
+uniform float environmentSize; // face size of mip 0 of environment
+
+const int SAMPLES = 64;
+const float PI = 3.14159265;
+
+// FaceDirection: direction through a texel of the face, with the axes of the GL cube map faces
+vec3 FaceDirection(vec2 uv)
+{
+    vec2 st = uv * 2.0 - 1.0;
+    if (face == 0) return vec3(1.0, -st.y, -st.x);
+    if (face == 1) return vec3(-1.0, -st.y, st.x);
+    if (face == 2) return vec3(st.x, 1.0, st.y);
+    if (face == 3) return vec3(st.x, -1.0, -st.y);
+    if (face == 4) return vec3(st.x, -st.y, 1.0);
+    return vec3(-st.x, -st.y, -1.0);
+}
+
+vec2 Hammersley(uint i)
+{
+    uint bits = i;
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return vec2(float(i) / float(SAMPLES), float(bits) * 2.3283064365386963e-10);
+}
+
+// ImportanceSampleGGX: half vector around n, distributed like the GGX lobe of roughness
+vec3 ImportanceSampleGGX(vec2 xi, vec3 n, float a)
+{
+    float phi = 2.0 * PI * xi.x;
+    float cosTheta = sqrt((1.0 - xi.y) / (1.0 + (a * a - 1.0) * xi.y));
+    float sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+    vec3 up = abs(n.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent = normalize(cross(up, n));
+    vec3 bitangent = cross(n, tangent);
+    return normalize(tangent * (cos(phi) * sinTheta) + bitangent * (sin(phi) * sinTheta) + n * cosTheta);
+}
+
+void main()
+{
+    vec3 n = normalize(FaceDirection(TexCoord));
+    if (roughness <= 0.0)
+    {
+        FragColor = vec4(textureLod(environment, n, 0.0).rgb, 1.0);
+        return;
+    }
+    float a = roughness * roughness;
+    float texelSolidAngle = 4.0 * PI / (6.0 * environmentSize * environmentSize);
+    vec3 color = vec3(0.0);
+    float weight = 0.0;
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        vec3 h = ImportanceSampleGGX(Hammersley(uint(i)), n, a);
+        float nDotH = max(dot(n, h), 0.0);
+        vec3 l = 2.0 * nDotH * h - n;
+        float nDotL = dot(n, l);
+        if (nDotL <= 0.0)
+            continue;
+        // with v = n the pdf of l is D(h) / 4
+        float d = a * a / (PI * pow(nDotH * nDotH * (a * a - 1.0) + 1.0, 2.0));
+        float sampleSolidAngle = 1.0 / (float(SAMPLES) * d * 0.25 + 0.0001);
+        float lod = 0.5 * log2(sampleSolidAngle / texelSolidAngle) + 1.0;
+        color += textureLod(environment, l, max(lod, 0.0)).rgb * nDotL;
+        weight += nDotL;
+    }
+    FragColor = vec4(color / max(weight, 0.0001), 1.0);
+}
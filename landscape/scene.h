@@ -6,19 +6,32 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
 #include <GameController.h>
 #include <common.h>
 #include <Shader.h>
 #include <Camera.h>
 #include <terrain.h>
+#include <horizon.h>
 #include <water.h>
+#include <ocean.h>
 #include <skybox.h>
+#include <atmosphere.h>
 #include <Texture.h>
+#include <RenderSettings.h>
 
 
 namespace KooNan
 {
+	// a placed reflection probe, objects centered within radius reflect what it sees
+	struct ReflectionProbe
+	{
+		glm::vec3 position;
+		float radius;
+	};
+
 	class Scene {
 	private:
 		float chunk_size;
@@ -26,6 +39,10 @@ namespace KooNan
 		vector<Terrain> all_terrain_chunks;
 		vector<Water> all_water_chunks;
 		Skybox skybox;
+		Ocean ocean; // FFT waves, replaces the flat chunks of the sea level while RenderSettings::oceanWaves is on
+		HorizonMap horizon; // terrain self shadowing, over all chunks
+		Atmosphere atmosphere; // sky and sun while RenderSettings::timeOfDay is on, the skybox otherwise
+		vector<ReflectionProbe> reflectionProbes; // placed in the editor, captured by ReflectionProbes
 		vector<string> groundPaths;
 		int width;
 		int height;
@@ -35,6 +52,7 @@ namespace KooNan
 		Shader& SkyShader;
 		float waterMoveFactor;
 		unsigned int reflect_text, refract_text, dudvMap, normalMap, depthMap, shadowMap;
+		int reflection_mode; // 0: reflect_text is the planar reflection, 1: it is indexed by screen position, 2: skybox only
 	public:
 		/*
 		float chunk_size: define size of each chunk
@@ -51,8 +69,30 @@ namespace KooNan
 			water_height(water_height), TerrainShader(TerrainShader), WaterShader(WaterShader), SkyShader(SkyShader)
 		{
 			waterMoveFactor = 0.0f;
+			reflection_mode = 0;
 			InitScene(groundPaths);
 		}
+		// cleanUp: release the GL objects, call before the context is destroyed
+		void cleanUp()
+		{
+			ocean.cleanUp();
+			horizon.cleanUp();
+			atmosphere.cleanUp();
+		}
+		// ApplyTerrainEdits: upload the heights changed with Terrain::SetHeight and update the horizon around them
+		//   return: whether any chunk was edited
+		bool ApplyTerrainEdits()
+		{
+			int x0, z0, x1, z1;
+			bool edited = false;
+			for (Terrain& chunk : all_terrain_chunks)
+				if (chunk.TakeEdits(x0, z0, x1, z1))
+				{
+					horizon.Update(chunk, x0, z0, x1, z1);
+					edited = true;
+				}
+			return edited;
+		}
 		float getWaterHeight()
 		{
 			return this->water_height;
@@ -61,6 +101,10 @@ namespace KooNan
 		{
 			reflect_text = textID;
 		}
+		void setReflectionMode(int mode)
+		{
+			reflection_mode = mode;
+		}
 		void setRefractText(unsigned int textID)
 		{
 			refract_text = textID;
@@ -83,12 +127,12 @@ namespace KooNan
 		}
 		void Draw(float deltaTime, Camera& cam, glm::vec4 clippling_plane, bool draw_water, bool draw_shadow = false)
 		{
-			glm::mat4 projection = glm::perspective(glm::radians(cam.Zoom), (float)Common::SCR_WIDTH / (float)Common::SCR_HEIGHT, 0.1f, 1000.0f);
+			glm::mat4 projection = Common::GetPerspectiveMat(cam);
 			glm::mat4 view = cam.GetViewMatrix();
 			glm::vec3 viewPos = cam.Position;
+			Frustum frustum(projection * view);
 
-			SkyShader.use();
-			skybox.Draw(SkyShader, glm::scale(glm::mat4(1.0f), glm::vec3(500.0f)), view, projection);
+			DrawSky(projection, view);
 			if(draw_shadow)
 			{
 				TerrainShader.use();
@@ -97,12 +141,15 @@ namespace KooNan
 				TerrainShader.setVec4("plane", clippling_plane);
 				TerrainShader.setVec3("viewPos", viewPos);
 				TerrainShader.setVec3("skyColor", glm::vec3(0.527f, 0.805f, 0.918f));
+				TerrainShader.setFloat("fogDensity", RenderSettings::fogDensity);
+				TerrainShader.setFloat("fogGradient", RenderSettings::fogGradient);
 				TerrainShader.setInt("shadowMap", 5);
 				glActiveTexture(GL_TEXTURE5);
-				glBindTexture(GL_TEXTURE_2D, shadowMap);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, shadowMap);
 				for (int i = 0; i < all_terrain_chunks.size(); i++)
 				{
-					all_terrain_chunks[i].Draw(TerrainShader);
+					if (IsChunkVisible(all_terrain_chunks[i].GetBounds(), frustum, clippling_plane))
+						all_terrain_chunks[i].Draw(TerrainShader);
 				}
 			}
 			else
@@ -113,15 +160,121 @@ namespace KooNan
 				TerrainShader.setVec4("plane", clippling_plane);
 				TerrainShader.setVec3("viewPos", viewPos);
 				TerrainShader.setVec3("skyColor", glm::vec3(0.527f, 0.805f, 0.918f));
+				TerrainShader.setFloat("fogDensity", RenderSettings::fogDensity);
+				TerrainShader.setFloat("fogGradient", RenderSettings::fogGradient);
 				for (int i = 0; i < all_terrain_chunks.size(); i++)
 				{
-					all_terrain_chunks[i].Draw(TerrainShader);
+					if (IsChunkVisible(all_terrain_chunks[i].GetBounds(), frustum, clippling_plane))
+						all_terrain_chunks[i].Draw(TerrainShader);
 				}
 			}
 			if (draw_water)
+				DrawWater(deltaTime, cam);
+		}
+		// DrawSky: the sky of the time of day or the skybox, before everything else
+		void DrawSky(const glm::mat4& projection, const glm::mat4& view)
+		{
+			if (RenderSettings::timeOfDay)
+			{
+				atmosphere.Draw(projection, view);
+				return;
+			}
+			SkyShader.use();
+			skybox.Draw(SkyShader, glm::scale(glm::mat4(1.0f), glm::vec3(500.0f)), view, projection);
+		}
+		// getSkyCubeMap: the sky as a cube map, for reflections that miss the scene
+		unsigned int getSkyCubeMap()
+		{
+			return RenderSettings::timeOfDay ? atmosphere.getCubeMap() : skybox.getCubeMap();
+		}
+		// DrawView: sky and, with draw_terrain, the terrain from any view without clipping, for probe captures
+		void DrawView(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& viewPos, bool draw_terrain)
+		{
+			DrawSky(projection, view);
+			if (!draw_terrain)
+				return;
+			Frustum frustum(projection * view);
+			glm::vec4 noClipping(0.0f, -1.0f, 0.0f, 99999.0f);
+			TerrainShader.use();
+			TerrainShader.setMat4("projection", projection);
+			TerrainShader.setMat4("view", view);
+			TerrainShader.setVec4("plane", noClipping);
+			TerrainShader.setVec3("viewPos", viewPos);
+			TerrainShader.setVec3("skyColor", glm::vec3(0.527f, 0.805f, 0.918f));
+			TerrainShader.setFloat("fogDensity", RenderSettings::fogDensity);
+			TerrainShader.setFloat("fogGradient", RenderSettings::fogGradient);
+			for (int i = 0; i < all_terrain_chunks.size(); i++)
+			{
+				if (IsChunkVisible(all_terrain_chunks[i].GetBounds(), frustum, noClipping))
+					all_terrain_chunks[i].Draw(TerrainShader);
+			}
+		}
+		// DrawTerrainDepth: the visible terrain chunks with a position only shader, for depth prepasses
+		void DrawTerrainDepth(Shader& depthShader, const glm::mat4& projection, const glm::mat4& view)
+		{
+			Frustum frustum(projection * view);
+			glm::vec4 noClipping(0.0f, -1.0f, 0.0f, 99999.0f);
+			depthShader.use();
+			depthShader.setMat4("projection", projection);
+			depthShader.setMat4("view", view);
+			depthShader.setMat4("model", glm::mat4(1.0f));
+			for (int i = 0; i < all_terrain_chunks.size(); i++)
+			{
+				if (IsChunkVisible(all_terrain_chunks[i].GetBounds(), frustum, noClipping))
+					all_terrain_chunks[i].Draw(depthShader);
+			}
+		}
+		// AddWaterBody: a pond or lake bounded by outline (x, z), at its own height
+		void AddWaterBody(const vector<glm::vec2>& outline, float body_height)
+		{
+			all_water_chunks.push_back(Water(outline, body_height, chunk_size));
+		}
+		// getWaterLevels: distinct heights of the water surfaces, ascending
+		vector<float> getWaterLevels()
+		{
+			vector<float> levels;
+			for (int j = 0; j < all_water_chunks.size(); j++)
+			{
+				float h = all_water_chunks[j].getHeight();
+				bool known = false;
+				for (float level : levels)
+					known = known || SameLevel(level, h);
+				if (!known)
+					levels.push_back(h);
+			}
+			std::sort(levels.begin(), levels.end());
+			return levels;
+		}
+		AABB getWaterLevelBounds(float level)
+		{
+			AABB bounds;
+			for (int j = 0; j < all_water_chunks.size(); j++)
+				if (SameLevel(all_water_chunks[j].getHeight(), level))
+					bounds.Expand(all_water_chunks[j].getBounds());
+			return bounds;
+		}
+		// AdvanceWater: scroll the ripples and step the waves, once per frame
+		void AdvanceWater(float deltaTime)
+		{
+			waterMoveFactor += deltaTime * 0.1f;
+			waterMoveFactor = waterMoveFactor - (int)waterMoveFactor;
+			ocean.Update(deltaTime);
+		}
+		// DrawWater: draw every water chunk with the current reflection and refraction textures
+		void DrawWater(float deltaTime, Camera& cam)
+		{
+			AdvanceWater(deltaTime);
+			for (float level : getWaterLevels())
+				DrawWater(cam, level);
+		}
+		// DrawWater: draw the water chunks at one height with the current textures
+		void DrawWater(Camera& cam, float level)
+		{
+			glm::mat4 projection = Common::GetPerspectiveMat(cam);
+			glm::mat4 view = cam.GetViewMatrix();
+			glm::vec3 viewPos = cam.Position;
+			Frustum frustum(projection * view);
 			{
-				waterMoveFactor += deltaTime * 0.1f;
-				waterMoveFactor = waterMoveFactor - (int)waterMoveFactor;
 				WaterShader.use();
 
 				WaterShader.setMat4("projection", projection);
@@ -132,9 +285,13 @@ namespace KooNan
 				WaterShader.setInt("dudvMap", 2);
 				WaterShader.setInt("normalMap", 3);
 				WaterShader.setInt("depthMap", 4);
+				WaterShader.setInt("skybox", 6);
+				WaterShader.setInt("reflectionMode", reflection_mode);
 				WaterShader.setFloat("chunk_size", chunk_size);
 				WaterShader.setFloat("moveOffset", waterMoveFactor);
 				WaterShader.setVec3("skyColor", glm::vec3(0.527f, 0.805f, 0.918f));
+				WaterShader.setFloat("fogDensity", RenderSettings::fogDensity);
+				WaterShader.setFloat("fogGradient", RenderSettings::fogGradient);
 				glActiveTexture(GL_TEXTURE0);
 				glBindTexture(GL_TEXTURE_2D, reflect_text);
 				glActiveTexture(GL_TEXTURE1);
@@ -145,12 +302,40 @@ namespace KooNan
 				glBindTexture(GL_TEXTURE_2D, normalMap);
 				glActiveTexture(GL_TEXTURE4);
 				glBindTexture(GL_TEXTURE_2D, depthMap);
+				glActiveTexture(GL_TEXTURE6);
+				glBindTexture(GL_TEXTURE_CUBE_MAP, getSkyCubeMap());
+				glActiveTexture(GL_TEXTURE0);
+				AABB sea; // grid chunks at this level, covered by the ocean grid instead
 				for (int j = 0; j < all_water_chunks.size(); j++)
 				{
-					all_water_chunks[j].Draw(WaterShader);
+					if (!SameLevel(all_water_chunks[j].getHeight(), level))
+						continue;
+					if (ocean.IsActive() && all_water_chunks[j].getOutline().empty())
+						sea.Expand(all_water_chunks[j].getBounds());
+					else if (frustum.Intersects(all_water_chunks[j].getBounds()))
+						all_water_chunks[j].Draw(WaterShader);
 				}
+				if (sea.IsValid() && frustum.Intersects(sea))
+					ocean.Draw(WaterShader, viewPos, glm::vec2(sea.min.x, sea.min.z), glm::vec2(sea.max.x, sea.max.z), level, 7, 8);
 			}
 		}
+		// IsWaterInFrustum: whether any water chunk touches the frustum of projection * view
+		bool IsWaterInFrustum(const glm::mat4& viewProjection)
+		{
+			Frustum frustum(viewProjection);
+			for (int j = 0; j < all_water_chunks.size(); j++)
+				if (frustum.Intersects(all_water_chunks[j].getBounds()))
+					return true;
+			return false;
+		}
+		bool IsWaterInFrustum(const glm::mat4& viewProjection, float level)
+		{
+			Frustum frustum(viewProjection);
+			for (int j = 0; j < all_water_chunks.size(); j++)
+				if (SameLevel(all_water_chunks[j].getHeight(), level) && frustum.Intersects(all_water_chunks[j].getBounds()))
+					return true;
+			return false;
+		}
 		float getTerrainHeight(float x, float z)
 		{
 			float relativeX = x + chunk_size / 2;
@@ -166,6 +351,16 @@ namespace KooNan
 			
 		}
 	private:
+		// surfaces closer than this share one reflection
+		static bool SameLevel(float a, float b)
+		{
+			return std::abs(a - b) < 1e-3f;
+		}
+		// chunks entirely outside the frustum or on the clipped side of the water plane are skipped
+		static bool IsChunkVisible(const AABB& bounds, const Frustum& frustum, const glm::vec4& clippling_plane)
+		{
+			return frustum.Intersects(bounds) && !IsClipped(clippling_plane, bounds);
+		}
 		void InitScene(vector<string> ground_path)
 		{
 			bool use_heightMap = false;
@@ -213,6 +408,7 @@ namespace KooNan
 			WaterShader.setFloat("material.shininess", 128.0f);
 			setDudvMap(textures[textures.size() - 2].id);
 			setNormalMap(textures[textures.size() - 1].id);
+			horizon.Build(all_terrain_chunks, width, height);
 
 		}
 
@@ -6,16 +6,35 @@
 
 namespace KooNan
 {
+	// Cascaded shadow map of the directional light. Each cascade covers one slice of the
+	// camera frustum and owns a layer of a depth texture array. Static casters are kept in
+	// a second array that is only redrawn where something changed; each frame the cache
+	// is copied into the shadow map and the dynamic casters are drawn on top. Both arrays
+	// are 16 bit, together they take the memory of a single 4096 x 4096 map.
 	class Shadow_Frame_Buffer
 	{
+	public:
+		static const int CASCADES = 4; // NR_CASCADES in terrain.fs
+		static const unsigned int CASCADE_SIZE = 2048;
+		// where a cascade was placed when its static depth was drawn
+		struct CascadeCache
+		{
+			glm::vec3 center;
+			float radius; // padded, the slices of later frames fit inside until the camera moves far enough
+			glm::vec3 lightDir;
+			glm::mat4 lightView, lightProjection;
+			bool valid;
+			bool hadDynamic; // dynamic casters were drawn over the cache last frame
+		};
 	private:
 		unsigned int shadow_fbo;
 		unsigned int shadow_map;
+		unsigned int cache_fbo;
+		unsigned int cache_map; // static casters only
 	public:
-		const unsigned int SHADOW_WIDTH = 4096;
-		const unsigned int SHADOW_HEIGHT = 4096;
-		glm::mat4 lightProjection;
-		glm::mat4 lightView;
+		glm::mat4 cascadeViewProjection[CASCADES]; // light projection * light view of each cascade
+		float cascadeSplits[CASCADES]; // far end of each cascade, as view depth of the main camera
+		CascadeCache cascadeCache[CASCADES];
 	public:
 		Shadow_Frame_Buffer()
 		{
@@ -25,14 +44,32 @@ namespace KooNan
 		{
 
 		}
-		void bindFrameBuffer()
+		// bindFrameBuffer: draw into the layer of one cascade
+		void bindFrameBuffer(int cascade)
 		{
 			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadow_fbo);
+			glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadow_map, 0, cascade);
+		}
+		// bindCacheFrameBuffer: draw into the static depth of one cascade
+		void bindCacheFrameBuffer(int cascade)
+		{
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cache_fbo);
+			glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cache_map, 0, cascade);
+		}
+		// compositeCascade: copy the static depth into the shadow map, leaves that layer bound for the dynamic casters
+		void compositeCascade(int cascade)
+		{
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, cache_fbo);
+			glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cache_map, 0, cascade);
+			bindFrameBuffer(cascade);
+			glBlitFramebuffer(0, 0, CASCADE_SIZE, CASCADE_SIZE, 0, 0, CASCADE_SIZE, CASCADE_SIZE, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 		}
 		void unbindFrameBuffer()
 		{
 			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 		}
+		// getShadowTexture: GL_TEXTURE_2D_ARRAY, one layer per cascade
 		unsigned int getShadowTexture()
 		{
 			return shadow_map;
@@ -40,20 +77,114 @@ namespace KooNan
 	private:
 		void FBOInit()
 		{
-			glGenFramebuffers(1, &shadow_fbo);
-			glBindFramebuffer(GL_FRAMEBUFFER, shadow_fbo);
-			glGenTextures(1, &shadow_map);
-			glBindTexture(GL_TEXTURE_2D, shadow_map);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
-				SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+			DepthArrayInit(shadow_fbo, shadow_map);
+			DepthArrayInit(cache_fbo, cache_map);
+			for (int i = 0; i < CASCADES; i++)
+			{
+				cascadeViewProjection[i] = glm::mat4(1.0f);
+				cascadeSplits[i] = 0.0f;
+				cascadeCache[i].valid = false;
+				cascadeCache[i].hadDynamic = false;
+			}
+		}
+		void DepthArrayInit(unsigned int& fbo, unsigned int& map)
+		{
+			glGenFramebuffers(1, &fbo);
+			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+			glGenTextures(1, &map);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, map);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT16,
+				CASCADE_SIZE, CASCADE_SIZE, CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, map, 0, 0);
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
+	};
+
+	// Distance maps of the shadowed point lights, packed in one depth texture: each row
+	// is a slot holding the six cube faces of a light side by side. A slot keeps its
+	// light and is only redrawn when something inside the light range changes.
+	class PointShadowAtlas
+	{
+	public:
+		static const int SLOTS = 4; // rows, NR_POINT_LIGHTS in model.fs and terrain.fs
+		static const int FACES = 6; // columns, in the order of the GL cube map faces
+		static const unsigned int TILE_SIZE = 512;
+		struct Slot
+		{
+			int light; // index into Light, -1 when free
+			glm::vec3 position;
+			float range;
+			bool valid; // the distance maps match position and range
+			bool hadDynamic; // a dynamic caster was in range when it was last drawn
+		};
+		Slot slots[SLOTS];
+	private:
+		unsigned int fbo;
+		unsigned int atlas;
+	public:
+		PointShadowAtlas()
+		{
+			glGenFramebuffers(1, &fbo);
+			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+			glGenTextures(1, &atlas);
+			glBindTexture(GL_TEXTURE_2D, atlas);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, TILE_SIZE * FACES, TILE_SIZE * SLOTS, 0,
+				GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadow_map, 0);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlas, 0);
 			glDrawBuffer(GL_NONE);
 			glReadBuffer(GL_NONE);
 			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			for (Slot& slot : slots)
+			{
+				slot.light = -1;
+				slot.valid = slot.hadDynamic = false;
+			}
+		}
+		void cleanUp()
+		{
+			glDeleteFramebuffers(1, &fbo);
+			glDeleteTextures(1, &atlas);
+		}
+		// bindFace: draw into one tile and clear it, leaves the scissor test on
+		void bindFace(int slot, int face)
+		{
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+			glViewport(face * TILE_SIZE, slot * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+			glEnable(GL_SCISSOR_TEST);
+			glScissor(face * TILE_SIZE, slot * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+		void unbindFrameBuffer()
+		{
+			glDisable(GL_SCISSOR_TEST);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		}
+		unsigned int getAtlasTexture()
+		{
+			return atlas;
+		}
+		// FaceView: view matrix of one cube face, PointShadow in the lit shaders uses the same axes
+		static glm::mat4 FaceView(const glm::vec3& position, int face)
+		{
+			static const glm::vec3 forward[FACES] = {
+				glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+				glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+			};
+			static const glm::vec3 up[FACES] = {
+				glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+				glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+			};
+			return glm::lookAt(position, position + forward[face], up[face]);
 		}
 	};
 
@@ -0,0 +1,60 @@
+#version 330 core
+// The sky of Atmosphere: a lookup into the sky view table of atmosphere_lut.fs along the
+// view direction, plus the sun disk dimmed by the transmittance table.
+in vec3 ViewRay;
+
+out vec4 FragColor;
+
+uniform sampler2D skyViewLut;
+uniform sampler2D transmittanceLut;
+uniform vec3 sunDirection; // towards the sun
+uniform float bottomRadius;
+uniform float topRadius;
+uniform float viewHeight; // the sky view table was made for this height
+uniform float sunAngularRadius;
+uniform float exposure;
+uniform vec3 nightColor; // added after the sun set, there are no stars
+
+const float PI = 3.14159265;
+
+// the same parametrizations as in atmosphere_lut.fs
+vec2 TransmittanceUV(float r, float mu)
+{
+    float H = sqrt(topRadius * topRadius - bottomRadius * bottomRadius);
+    float rho = sqrt(max(r * r - bottomRadius * bottomRadius, 0.0));
+    float discriminant = r * r * (mu * mu - 1.0) + topRadius * topRadius;
+    float d = max(-r * mu + sqrt(max(discriminant, 0.0)), 0.0);
+    float dMin = topRadius - r, dMax = rho + H;
+    return vec2((d - dMin) / (dMax - dMin), rho / H);
+}
+
+vec2 SkyViewUV(vec3 dir, float r)
+{
+    float beta = acos(sqrt(r * r - bottomRadius * bottomRadius) / r);
+    float horizonZenith = PI - beta;
+    float zenith = acos(clamp(dir.y, -1.0, 1.0));
+    float v = zenith < horizonZenith
+        ? 0.5 - 0.5 * sqrt(1.0 - zenith / horizonZenith)
+        : 0.5 + 0.5 * sqrt((zenith - horizonZenith) / beta);
+    float azimuth = atan(dir.z, dir.x) - atan(sunDirection.z, sunDirection.x + 1e-6);
+    return vec2(fract(azimuth / (2.0 * PI)), v);
+}
+
+void main()
+{
+    vec3 dir = normalize(ViewRay);
+    float r = bottomRadius + viewHeight;
+    vec3 L = texture(skyViewLut, SkyViewUV(dir, r)).rgb;
+
+    float cosAngle = dot(dir, sunDirection);
+    float cosRadius = cos(sunAngularRadius);
+    bool aboveGround = dir.y > -sqrt(1.0 - bottomRadius * bottomRadius / (r * r));
+    if (cosAngle > cosRadius && aboveGround)
+    {
+        // illuminance 1 spread over the disk, with a soft rim
+        float radiance = 1.0 / (2.0 * PI * (1.0 - cosRadius));
+        float rim = smoothstep(cosRadius, mix(cosRadius, 1.0, 0.3), cosAngle);
+        L += texture(transmittanceLut, TransmittanceUV(r, dir.y)).rgb * radiance * rim;
+    }
+    FragColor = vec4(vec3(1.0) - exp(-L * exposure) + nightColor, 1.0);
+}
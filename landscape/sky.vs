@@ -0,0 +1,15 @@
+#version 330 core
+// one triangle covering the viewport, with the world direction of each corner for sky.fs
+
+out vec3 ViewRay;
+
+uniform mat4 invViewProjection; // of the view without its translation
+
+void main()
+{
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    vec4 world = invViewProjection * vec4(p, 1.0, 1.0);
+    ViewRay = world.xyz / world.w;
+    gl_Position = vec4(p, 1.0, 1.0); // on the far plane, behind whatever was drawn before
+    gl_ClipDistance[0] = 1.0; // the water passes clip, the sky is never below the water plane
+}
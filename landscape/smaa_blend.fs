@@ -0,0 +1,36 @@
+#version 330 core
+// Last pass of the morphological antialiasing: mixes each pixel with the neighbours across
+// its four edges by the weights of the second pass.
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D image;
+uniform sampler2D weightsMap; // see smaa_weights.fs
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 last = textureSize(image, 0) - 1;
+    vec4 own = texelFetch(weightsMap, p, 0);
+    // the bottom and right neighbours hold the edges this pixel shares with them
+    float fromTop = own.x;
+    float fromLeft = own.z;
+    float fromBottom = p.y > 0 ? texelFetch(weightsMap, p + ivec2(0, -1), 0).y : 0.0;
+    float fromRight = p.x < last.x ? texelFetch(weightsMap, p + ivec2(1, 0), 0).w : 0.0;
+    float total = fromTop + fromLeft + fromBottom + fromRight;
+    vec3 color = texelFetch(image, p, 0).rgb;
+    if (total == 0.0)
+    {
+        FragColor = vec4(color, 1.0);
+        return;
+    }
+    // at corners the weights can add up to more than the pixel
+    float scale = total > 1.0 ? 1.0 / total : 1.0;
+    vec3 mixed = color * (1.0 - total * scale);
+    mixed += texelFetch(image, min(p + ivec2(0, 1), last), 0).rgb * (fromTop * scale);
+    mixed += texelFetch(image, max(p + ivec2(-1, 0), ivec2(0)), 0).rgb * (fromLeft * scale);
+    mixed += texelFetch(image, max(p + ivec2(0, -1), ivec2(0)), 0).rgb * (fromBottom * scale);
+    mixed += texelFetch(image, min(p + ivec2(1, 0), last), 0).rgb * (fromRight * scale);
+    FragColor = vec4(mixed, 1.0);
+}
@@ -0,0 +1,40 @@
+#version 330 core
+// First pass of the morphological antialiasing: luma edges of each pixel with its left (r)
+// and top (g) neighbour, kept only where they stand out from the other edges around,
+// like the local contrast adaptation of SMAA.
+in vec2 TexCoord;
+
+out vec2 FragColor;
+
+uniform sampler2D image; // 8 bit, after the tonemapping
+uniform float threshold; // luma difference of an edge
+
+float Luma(ivec2 p)
+{
+    p = clamp(p, ivec2(0), textureSize(image, 0) - 1);
+    return dot(texelFetch(image, p, 0).rgb, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    float l = Luma(p);
+    float left = Luma(p + ivec2(-1, 0));
+    float top = Luma(p + ivec2(0, 1));
+    vec2 delta = abs(l - vec2(left, top));
+    vec2 edges = step(threshold, delta);
+    if (edges.x + edges.y == 0.0)
+    {
+        FragColor = vec2(0.0);
+        return;
+    }
+    // an edge next to a much stronger one is its soft shoulder
+    float right = Luma(p + ivec2(1, 0));
+    float bottom = Luma(p + ivec2(0, -1));
+    float leftLeft = Luma(p + ivec2(-2, 0));
+    float topTop = Luma(p + ivec2(0, 2));
+    float maxDelta = max(max(delta.x, delta.y), max(abs(l - right), abs(l - bottom)));
+    maxDelta = max(maxDelta, max(abs(left - leftLeft), abs(top - topTop)));
+    edges *= step(0.5 * maxDelta, delta);
+    FragColor = edges;
+}
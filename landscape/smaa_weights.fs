@@ -0,0 +1,79 @@
+#version 330 core
+// Second pass of the morphological antialiasing: how much of each side of the left and top
+// edges of a pixel the other side covers. The edge is followed to its ends, the crossing
+// edges there tell the shape (L, U or Z) and the silhouette runs from half a pixel across
+// at an end with a crossing to the middle of the edge. The area under it is computed
+// directly instead of read from the precomputed area texture of SMAA; diagonals are left out.
+in vec2 TexCoord;
+
+// x: this pixel takes from its top neighbour, y: the top neighbour takes from this pixel,
+// z: this pixel takes from its left neighbour, w: the left neighbour takes from this pixel
+out vec4 FragColor;
+
+uniform sampler2D edgesMap; // r: edge with the left neighbour, g: edge with the top neighbour
+uniform int maxSearch; // pixels followed along an edge in each direction
+
+ivec2 size;
+
+vec2 Edges(ivec2 p)
+{
+    if (any(lessThan(p, ivec2(0))) || any(greaterThanEqual(p, size)))
+        return vec2(0.0);
+    return texelFetch(edgesMap, p, 0).rg;
+}
+
+// Search: pixels beyond p along dir still on the edge of the given channel
+int Search(ivec2 p, ivec2 dir, int channel)
+{
+    int d = 0;
+    while (d < maxSearch && Edges(p + dir * (d + 1))[channel] > 0.5)
+        d++;
+    return d;
+}
+
+// Crossing: +0.5 for a crossing edge on the other side, -0.5 on this side, 0 for none or both
+float Crossing(float otherSide, float thisSide)
+{
+    if ((otherSide > 0.5) == (thisSide > 0.5))
+        return 0.0;
+    return otherSide > 0.5 ? 0.5 : -0.5;
+}
+
+// Coverage: height of the silhouette over the middle of a pixel dNear pixels from the
+// nearer end of an edge of the given length, positive towards the other side
+float Coverage(int dNear, int dFar, float crossing)
+{
+    float halfLength = 0.5 * float(dNear + dFar + 1);
+    return crossing * max(1.0 - (float(dNear) + 0.5) / halfLength, 0.0);
+}
+
+void main()
+{
+    size = textureSize(edgesMap, 0);
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    vec2 e = Edges(p);
+    vec4 weights = vec4(0.0);
+    if (e.g > 0.5)
+    {
+        // top edge, between row y and y + 1
+        int dLeft = Search(p, ivec2(-1, 0), 1);
+        int dRight = Search(p, ivec2(1, 0), 1);
+        ivec2 leftEnd = p - ivec2(dLeft, 0), rightEnd = p + ivec2(dRight + 1, 0);
+        float h = dLeft <= dRight ?
+            Coverage(dLeft, dRight, dLeft < maxSearch ? Crossing(Edges(leftEnd + ivec2(0, 1)).r, Edges(leftEnd).r) : 0.0) :
+            Coverage(dRight, dLeft, dRight < maxSearch ? Crossing(Edges(rightEnd + ivec2(0, 1)).r, Edges(rightEnd).r) : 0.0);
+        weights.xy = vec2(max(-h, 0.0), max(h, 0.0));
+    }
+    if (e.r > 0.5)
+    {
+        // left edge, between column x - 1 and x
+        int dBottom = Search(p, ivec2(0, -1), 0);
+        int dTop = Search(p, ivec2(0, 1), 0);
+        ivec2 bottomEnd = p - ivec2(0, dBottom + 1), topEnd = p + ivec2(0, dTop);
+        float h = dBottom <= dTop ?
+            Coverage(dBottom, dTop, dBottom < maxSearch ? Crossing(Edges(bottomEnd + ivec2(-1, 0)).g, Edges(bottomEnd).g) : 0.0) :
+            Coverage(dTop, dBottom, dTop < maxSearch ? Crossing(Edges(topEnd + ivec2(-1, 0)).g, Edges(topEnd).g) : 0.0);
+        weights.zw = vec2(max(-h, 0.0), max(h, 0.0));
+    }
+    FragColor = weights;
+}
@@ -0,0 +1,80 @@
+#version 330 core
+// Horizon based ambient occlusion at half resolution. For a few screen directions
+// the horizon around the pixel is raised step by step through the depth of the
+// prepass; the rise above the tangent plane, fading with distance, is the occlusion.
+in vec2 TexCoord;
+
+out float FragColor;
+
+uniform sampler2D depthMap;
+uniform mat4 projection;
+uniform mat4 invProjection;
+uniform float radius; // world size of the neighbourhood
+uniform float intensity;
+uniform int directions;
+uniform int steps;
+uniform float frameJitter; // turns the pattern every frame while the history averages it
+
+const float tangentBias = 0.1; // sine of the angle ignored above the tangent plane, hides tessellation
+
+vec3 ViewPos(vec2 uv)
+{
+    float depth = texture(depthMap, uv).r;
+    vec4 p = invProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return p.xyz / p.w;
+}
+
+// interleaved gradient noise, the same pattern as model.fs
+float Noise(vec2 pixel)
+{
+    return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+void main()
+{
+    if (texture(depthMap, TexCoord).r >= 1.0)
+    {
+        FragColor = 1.0;
+        return;
+    }
+    vec2 texel = 1.0 / vec2(textureSize(depthMap, 0));
+    vec3 p = ViewPos(TexCoord);
+    // normal from the neighbours on the same surface, the nearer one on each axis
+    vec3 right = ViewPos(TexCoord + vec2(texel.x, 0.0)) - p, left = p - ViewPos(TexCoord - vec2(texel.x, 0.0));
+    vec3 up = ViewPos(TexCoord + vec2(0.0, texel.y)) - p, down = p - ViewPos(TexCoord - vec2(0.0, texel.y));
+    vec3 dx = abs(right.z) < abs(left.z) ? right : left;
+    vec3 dy = abs(up.z) < abs(down.z) ? up : down;
+    vec3 n = normalize(cross(dx, dy));
+    if (dot(n, p) > 0.0)
+        n = -n;
+
+    vec2 radiusUV = radius * 0.5 * vec2(projection[0][0], projection[1][1]) / -p.z;
+    if (radiusUV.y < texel.y)
+    {
+        FragColor = 1.0;
+        return;
+    }
+    float noise = fract(Noise(gl_FragCoord.xy) + frameJitter);
+    float occlusion = 0.0;
+    for (int d = 0; d < directions; d++)
+    {
+        float angle = (float(d) + noise) * 6.28318531 / float(directions);
+        vec2 dir = vec2(cos(angle), sin(angle)) * radiusUV;
+        float horizon = tangentBias;
+        for (int s = 0; s < steps; s++)
+        {
+            vec2 uv = TexCoord + dir * (float(s) + fract(noise * 7.0)) / float(steps);
+            vec3 v = ViewPos(uv) - p;
+            float dist2 = dot(v, v);
+            if (dist2 > radius * radius || dist2 < 1e-8)
+                continue;
+            float elevation = dot(n, v) * inversesqrt(dist2);
+            if (elevation > horizon)
+            {
+                occlusion += (elevation - horizon) * (1.0 - dist2 / (radius * radius));
+                horizon = elevation;
+            }
+        }
+    }
+    FragColor = clamp(1.0 - occlusion / float(directions) * intensity, 0.0, 1.0);
+}
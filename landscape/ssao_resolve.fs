@@ -0,0 +1,61 @@
+#version 330 core
+// Denoises the raw occlusion with a 3x3 depth aware blur and, with the history on,
+// blends it into the occlusion of the last frame at the same world position.
+// Writes the occlusion with its linear depth, for the bilateral upsampling in the lit shaders.
+in vec2 TexCoord;
+
+out vec2 FragColor;
+
+uniform sampler2D rawMap;
+uniform sampler2D depthMap;
+uniform sampler2D historyMap; // FragColor of the last frame
+uniform mat4 invProjection;
+uniform mat4 invView;
+uniform mat4 prevViewProjection;
+uniform float nearPlane;
+uniform float farPlane;
+uniform float historyBlend; // 0 ignores the history
+
+float LinearDepth(float depth)
+{
+    return nearPlane * farPlane / (farPlane - depth * (farPlane - nearPlane));
+}
+
+void main()
+{
+    float depth = texture(depthMap, TexCoord).r;
+    if (depth >= 1.0)
+    {
+        FragColor = vec2(1.0, farPlane);
+        return;
+    }
+    float z = LinearDepth(depth);
+    vec2 texel = 1.0 / vec2(textureSize(rawMap, 0));
+    float sum = 0.0, weights = 0.0;
+    for (int x = -1; x <= 1; x++)
+    {
+        for (int y = -1; y <= 1; y++)
+        {
+            vec2 uv = TexCoord + vec2(x, y) * texel;
+            float w = 1.0 / (0.001 + abs(LinearDepth(texture(depthMap, uv).r) - z) / z);
+            sum += texture(rawMap, uv).r * w;
+            weights += w;
+        }
+    }
+    float ao = sum / weights;
+
+    if (historyBlend > 0.0)
+    {
+        vec4 view = invProjection * vec4(vec3(TexCoord, depth) * 2.0 - 1.0, 1.0);
+        vec4 prevClip = prevViewProjection * (invView * vec4(view.xyz / view.w, 1.0));
+        vec2 prevUV = prevClip.xy / prevClip.w * 0.5 + 0.5;
+        if (all(greaterThanEqual(prevUV, vec2(0.0))) && all(lessThanEqual(prevUV, vec2(1.0))))
+        {
+            vec2 history = texture(historyMap, prevUV).rg;
+            // w of the clip position is the distance along the old view direction
+            if (abs(history.y - prevClip.w) < 0.05 * prevClip.w)
+                ao = mix(ao, history.x, historyBlend);
+        }
+    }
+    FragColor = vec2(ao, z);
+}
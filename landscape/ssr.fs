@@ -0,0 +1,93 @@
+#version 330 core
+// Screen space reflection of the water plane. For every pixel the view ray is
+// intersected with the plane y = waterHeight, mirrored, and marched through the
+// depth of the main pass. Misses fall back to the sky box.
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D sceneColor;
+uniform sampler2D sceneDepth;
+uniform samplerCube skybox;
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 invProjection;
+uniform mat4 invView;
+uniform float waterHeight;
+uniform float nearPlane;
+uniform float farPlane;
+uniform int maxSteps;
+uniform float thickness; // how far behind the depth buffer a sample still counts as a hit
+
+const float firstStep = 0.2;
+const float stepGrowth = 1.08;
+const int refineSteps = 5;
+
+float LinearDepth(float depth)
+{
+    float z = depth * 2.0 - 1.0;
+    return 2.0 * nearPlane * farPlane / (farPlane + nearPlane - z * (farPlane - nearPlane));
+}
+
+// view space point to screen coordinates, z is the distance along the view axis
+vec3 ToScreen(vec3 p)
+{
+    vec4 clip = projection * vec4(p, 1.0);
+    return vec3(clip.xy / clip.w * 0.5 + 0.5, -p.z);
+}
+
+bool OnScreen(vec2 uv)
+{
+    return all(greaterThanEqual(uv, vec2(0.0))) && all(lessThanEqual(uv, vec2(1.0)));
+}
+
+void main()
+{
+    vec4 target = invProjection * vec4(TexCoord * 2.0 - 1.0, 1.0, 1.0);
+    vec3 dir = normalize(mat3(invView) * normalize(target.xyz / target.w));
+    vec3 camPos = invView[3].xyz;
+    float tPlane = (waterHeight - camPos.y) / dir.y;
+    if (abs(dir.y) < 1e-5 || tPlane <= 0.0)
+    {
+        // no water under this pixel, water.fs never reads it
+        FragColor = vec4(0.0);
+        return;
+    }
+    vec3 R = reflect(dir, vec3(0.0, 1.0, 0.0));
+    vec3 sky = texture(skybox, R).rgb;
+
+    vec3 origin = (view * vec4(camPos + dir * tPlane, 1.0)).xyz;
+    vec3 rayDir = normalize(mat3(view) * R);
+    float t = 0.0, stepLength = firstStep;
+    for (int i = 0; i < maxSteps; i++)
+    {
+        float tNext = t + stepLength;
+        vec3 s = ToScreen(origin + rayDir * tNext);
+        if (s.z <= nearPlane || !OnScreen(s.xy))
+            break;
+        float sceneZ = LinearDepth(texture(sceneDepth, s.xy).r);
+        if (s.z > sceneZ && s.z - sceneZ < max(thickness, stepLength * 2.0))
+        {
+            // binary search between the last miss and this hit
+            float lo = t, hi = tNext;
+            for (int j = 0; j < refineSteps; j++)
+            {
+                float mid = 0.5 * (lo + hi);
+                vec3 m = ToScreen(origin + rayDir * mid);
+                if (m.z > LinearDepth(texture(sceneDepth, m.xy).r))
+                    hi = mid;
+                else
+                    lo = mid;
+            }
+            vec3 hit = ToScreen(origin + rayDir * hi);
+            // fade out near the screen border and for rays turning back to the camera
+            vec2 border = min(hit.xy, 1.0 - hit.xy);
+            float fade = clamp(min(border.x, border.y) * 10.0, 0.0, 1.0) * clamp(-rayDir.z * 4.0 + 1.0, 0.0, 1.0);
+            FragColor = vec4(mix(sky, texture(sceneColor, hit.xy).rgb, fade), 1.0);
+            return;
+        }
+        t = tNext;
+        stepLength *= stepGrowth;
+    }
+    FragColor = vec4(sky, 1.0);
+}
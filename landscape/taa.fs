@@ -0,0 +1,87 @@
+#version 330 core
+// Temporal antialiasing: the main pass is drawn with a different subpixel jitter every frame
+// and accumulated here. The history is reprojected with the camera motion, reconstructed from
+// the depth of the nearest neighbour so edges carry their own motion, and clipped to the
+// colors around the pixel so moving objects and disocclusions do not leave ghosts.
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D image; // this frame, 8 bit after the tonemapping
+uniform sampler2D depthMap; // of the main pass
+uniform sampler2D historyMap; // FragColor of the last frame
+uniform mat4 invViewProjection; // of this frame, with the jitter
+uniform mat4 prevViewProjection; // of the last frame, without the jitter
+uniform float feedback; // weight of the history
+uniform int historyValid;
+
+vec3 RgbToYCoCg(vec3 c)
+{
+    return vec3(0.25 * c.r + 0.5 * c.g + 0.25 * c.b, 0.5 * c.r - 0.5 * c.b, -0.25 * c.r + 0.5 * c.g - 0.25 * c.b);
+}
+
+vec3 YCoCgToRgb(vec3 c)
+{
+    return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// ClipToBox: moves the history towards the center of the box until it lies inside
+vec3 ClipToBox(vec3 history, vec3 boxMin, vec3 boxMax)
+{
+    vec3 center = 0.5 * (boxMax + boxMin);
+    vec3 extent = 0.5 * (boxMax - boxMin) + 0.0001;
+    vec3 offset = history - center;
+    vec3 units = abs(offset / extent);
+    float maxUnit = max(units.x, max(units.y, units.z));
+    return maxUnit > 1.0 ? center + offset / maxUnit : history;
+}
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 last = textureSize(image, 0) - 1;
+    vec3 current = texelFetch(image, p, 0).rgb;
+    if (historyValid == 0)
+    {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+
+    // mean and deviation of the neighbourhood, and the nearest depth in it
+    vec3 m1 = vec3(0.0), m2 = vec3(0.0);
+    float nearestDepth = 1.0;
+    ivec2 nearest = p;
+    for (int x = -1; x <= 1; x++)
+    {
+        for (int y = -1; y <= 1; y++)
+        {
+            ivec2 q = clamp(p + ivec2(x, y), ivec2(0), last);
+            vec3 c = RgbToYCoCg(texelFetch(image, q, 0).rgb);
+            m1 += c;
+            m2 += c * c;
+            float depth = texelFetch(depthMap, q, 0).r;
+            if (depth < nearestDepth)
+            {
+                nearestDepth = depth;
+                nearest = q;
+            }
+        }
+    }
+    vec3 mean = m1 / 9.0;
+    vec3 deviation = sqrt(max(m2 / 9.0 - mean * mean, 0.0));
+
+    vec2 uv = (vec2(nearest) + 0.5) / vec2(last + 1);
+    vec4 world = invViewProjection * vec4(vec3(uv, nearestDepth) * 2.0 - 1.0, 1.0);
+    vec4 prevClip = prevViewProjection * vec4(world.xyz / world.w, 1.0);
+    vec2 prevUV = prevClip.xy / prevClip.w * 0.5 + 0.5 + (TexCoord - uv);
+    if (prevClip.w <= 0.0 || any(lessThan(prevUV, vec2(0.0))) || any(greaterThan(prevUV, vec2(1.0))))
+    {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+    vec3 history = RgbToYCoCg(texture(historyMap, prevUV).rgb);
+    // a little wider than one deviation, tighter boxes make still edges flicker
+    history = ClipToBox(history, mean - 1.25 * deviation, mean + 1.25 * deviation);
+    vec3 color = mix(RgbToYCoCg(current), history, feedback);
+    FragColor = vec4(YCoCgToRgb(color), 1.0);
+}
@@ -4,7 +4,7 @@ out vec4 FragColor;
 in vec3 FragPos;
 in vec2 TexCoord;
 in vec3 Normal;
-in vec4 FragPosInLightSpace;
+in float ViewDepth;
 in float visibility;
 
 
@@ -37,10 +37,133 @@ uniform sampler2D texture_diffuse4;//g-3
 uniform sampler2D texture_diffuse5;//b-4
 //uniform sampler2D .....
 uniform vec3 skyColor;
-uniform sampler2D shadowMap;//-5
+uniform sampler2DArray shadowMap;//-5, one layer per cascade
+
+#define NR_CASCADES 4
+uniform mat4 lightSpaceMatrices[NR_CASCADES];
+uniform float cascadeSplits[NR_CASCADES]; // far end of each cascade in view depth
+uniform sampler2DArray evsmMap; // EvsmFilter: blurred, mipmapped moments of each cascade
+uniform int shadowFilter; // 0: PCF, 1: EVSM
+uniform float evsmExponent;
+uniform float evsmBleedReduction;
+
+// EvsmShadow: Chebyshev bound on the share of occluders, from one filtered fetch
+float EvsmShadow(vec3 projCoords, int cascade)
+{
+    vec2 moments = texture(evsmMap, vec3(projCoords.xy, float(cascade))).rg;
+    float warped = exp(evsmExponent * (projCoords.z * 2.0 - 1.0));
+    if (warped <= moments.x)
+        return 0.0;
+    // the smallest variance stands in for the depth bias, scaled by the slope of the warp
+    float minVariance = pow(0.0002 * float(cascade + 1) * 2.0 * evsmExponent * warped, 2.0);
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float d = warped - moments.x;
+    float visibility = variance / (variance + d * d);
+    return 1.0 - clamp((visibility - evsmBleedReduction) / (1.0 - evsmBleedReduction), 0.0, 1.0);
+}
 
 #define NR_POINT_LIGHTS 4
 uniform PointLight pointLights[NR_POINT_LIGHTS];
+uniform sampler2D pointShadowAtlas; // PointShadowAtlas, a row of six cube faces per slot
+uniform int pointShadowSlot[NR_POINT_LIGHTS]; // -1: the light casts no shadow
+uniform float pointShadowRange[NR_POINT_LIGHTS];
+
+// cube face axes, the same as PointShadowAtlas::FaceView
+const vec3 faceForward[6] = vec3[6](vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0),
+    vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+const vec3 faceUp[6] = vec3[6](vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0),
+    vec3(0.0, 0.0, -1.0), vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0));
+
+uniform sampler2DArray horizonMap; // HorizonMap: tangent of the horizon, its distance and the ground height, a layer per azimuth
+uniform vec2 horizonOrigin; // world x, z of the first sample
+uniform float horizonSpacing;
+uniform int horizonShadows;
+
+uniform sampler2D lightmap; // LightBaker: ambient of all lights, occluded, and the AO
+uniform vec2 lightmapOrigin; // world x, z of the corner of the lightmap
+uniform vec2 lightmapExtent;
+uniform int bakedLighting; // 1: the lightmap replaces the ambient terms of the lights, 2: only its AO darkens them
+
+uniform sampler2D ssaoMap; // AmbientOcclusion: occlusion and linear depth at half resolution
+uniform int ssao; // 1: ssaoMap belongs to this view, only in the main pass
+uniform vec2 ssaoNearFar;
+
+// ScreenOcclusion: the half resolution occlusion at this pixel, the four nearest texels weighted
+// by distance and by how close their depth is, so edges do not bleed into the background
+float ScreenOcclusion()
+{
+    if (ssao != 1)
+        return 1.0;
+    float z = ssaoNearFar.x * ssaoNearFar.y / (ssaoNearFar.y - gl_FragCoord.z * (ssaoNearFar.y - ssaoNearFar.x));
+    ivec2 size = textureSize(ssaoMap, 0);
+    vec2 pos = gl_FragCoord.xy * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(pos));
+    vec2 f = pos - vec2(base);
+    float sum = 0.0, weights = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        vec2 s = texelFetch(ssaoMap, clamp(base + offset, ivec2(0), size - 1), 0).rg;
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float w = (bilinear.x * bilinear.y + 0.001) / (0.001 + abs(s.y - z) / z);
+        sum += s.x * w;
+        weights += w;
+    }
+    return sum / weights;
+}
+
+// HorizonShadow: share of the sun hidden behind the terrain, for a point at or above the ground
+float HorizonShadow(vec3 fragPos, vec3 lightDirection)
+{
+    if (horizonShadows == 0)
+        return 0.0;
+    ivec3 size = textureSize(horizonMap, 0);
+    vec2 uv = ((fragPos.xz - horizonOrigin) / horizonSpacing + 0.5) / vec2(size.xy);
+    if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+        return 0.0;
+    vec3 toSun = normalize(-lightDirection);
+    float azimuth = fract(atan(toSun.z, toSun.x) / 6.28318531) * float(size.z);
+    int layer = int(azimuth);
+    vec3 horizon = mix(texture(horizonMap, vec3(uv, float(layer))).xyz,
+        texture(horizonMap, vec3(uv, float((layer + 1) % size.z))).xyz, fract(azimuth));
+    // seen from higher up, the same ridge is lower
+    float above = max(fragPos.y - horizon.z, 0.0);
+    float horizonAngle = atan(horizon.x - above / max(horizon.y, 0.001));
+    float sunAngle = atan(toSun.y, length(toSun.xz));
+    return 1.0 - smoothstep(-0.03, 0.03, sunAngle - horizonAngle);
+}
+
+// PointShadow: share of point light i blocked on its way to fragPos
+float PointShadow(int i, vec3 fragPos)
+{
+    int slot = pointShadowSlot[i];
+    if (slot < 0)
+        return 0.0;
+    vec3 d = fragPos - pointLights[i].position;
+    float current = length(d) / pointShadowRange[i];
+    if (current >= 1.0)
+        return 0.0;
+    vec3 a = abs(d);
+    int face = a.x >= a.y && a.x >= a.z ? (d.x > 0.0 ? 0 : 1) : (a.y >= a.z ? (d.y > 0.0 ? 2 : 3) : (d.z > 0.0 ? 4 : 5));
+    vec3 s = normalize(cross(faceForward[face], faceUp[face]));
+    vec3 u = cross(s, faceForward[face]);
+    vec2 ndc = vec2(dot(s, d), dot(u, d)) / dot(faceForward[face], d);
+    vec2 atlasSize = vec2(textureSize(pointShadowAtlas, 0));
+    vec2 tile = atlasSize / vec2(6.0, 4.0);
+    // stay inside the tile, the PCF taps must not read the neighbouring face
+    vec2 texel = clamp((ndc * 0.5 + 0.5) * tile, vec2(1.5), tile - 1.5) + vec2(face, slot) * tile;
+    float bias = 0.003;
+    float shadow = 0.0;
+    for(int x = -1; x <= 1; ++x)
+    {
+        for(int y = -1; y <= 1; ++y)
+        {
+            float closest = texture(pointShadowAtlas, (texel + vec2(x, y)) / atlasSize).r;
+            shadow += current - bias > closest ? 1.0 : 0.0;
+        }
+    }
+    return shadow / 9.0;
+}
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 inputColor, float shadow)
 {
@@ -57,7 +180,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 inputColor, fl
     return (ambient + (diffuse + specular) * (1.0f - shadow));
 }
 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 inputColor)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 inputColor, float shadow)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
@@ -75,39 +198,47 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, v
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
-    return (ambient + diffuse + specular);
+    return (ambient + (diffuse + specular) * (1.0 - shadow));
 }
 
-float ShadowCaculation(vec4 fragPosLightSpace)
+float ShadowCaculation(vec3 fragPos)
 {
+    // the nearest cascade that still covers the fragment
+    int cascade = NR_CASCADES;
+    for (int i = NR_CASCADES - 1; i >= 0; --i)
+        if (ViewDepth < cascadeSplits[i])
+            cascade = i;
+    if (cascade == NR_CASCADES)
+        return 0.0;
+    vec4 fragPosLightSpace = lightSpaceMatrices[cascade] * vec4(fragPos, 1.0);
     // perform perspective divide
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     // Transform to [0,1] range
     projCoords = projCoords * 0.5 + 0.5;
+    // Keep the shadow at 0.0 when outside the far_plane region of the light's frustum.
+    if(projCoords.z > 1.0)
+        return 0.0;
+    if (shadowFilter == 1)
+        return EvsmShadow(projCoords, cascade);
     // Get closest depth value from light's perspective (using [0,1] range fragPosLight as coords)
-    float closestDepth = texture(shadowMap, projCoords.xy).r; 
     // Get depth of current fragment from light's perspective
     float currentDepth = projCoords.z;
     // Calculate bias (based on depth map resolution and slope)
-    float bias = 0.0001;
+    float bias = 0.0001 * float(cascade + 1); // the outer cascades span more depth per texel
     // Check whether current frag pos is in shadow
     // float shadow = currentDepth - bias > closestDepth  ? 1.0 : 0.0;
     // PCF
     float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
     for(int x = -1; x <= 1; ++x)
     {
         for(int y = -1; y <= 1; ++y)
         {
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r; 
+            float pcfDepth = texture(shadowMap, vec3(projCoords.xy + vec2(x, y) * texelSize, float(cascade))).r;
             shadow += currentDepth - bias > pcfDepth  ? 1.0 : 0.0;        
         }    
     }
     shadow /= 9.0;
-    
-    // Keep the shadow at 0.0 when outside the far_plane region of the light's frustum.
-    if(projCoords.z > 1.0)
-        shadow = 0.0;
         
     return shadow;
 }
@@ -126,10 +257,40 @@ void main()
 
 	vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
-    float shadow = ShadowCaculation(FragPosInLightSpace);
-	vec3 result = CalcDirLight(dirLight, norm, viewDir, vec3(totalColor), shadow) * 1.2f;
+    float shadow = max(ShadowCaculation(FragPos), HorizonShadow(FragPos, dirLight.direction));
+    DirLight sun = dirLight;
+    vec4 baked = vec4(1.0);
+    if (bakedLighting == 1)
+    {
+        baked = texture(lightmap, (FragPos.xz - lightmapOrigin) / lightmapExtent);
+        sun.ambient = baked.rgb;
+        sun.specular *= baked.a;
+    }
+    else if (bakedLighting == 2)
+    {
+        baked = texture(lightmap, (FragPos.xz - lightmapOrigin) / lightmapExtent);
+        sun.ambient *= baked.a;
+        sun.specular *= baked.a;
+    }
+    float ao = ScreenOcclusion();
+    sun.ambient *= ao;
+	vec3 result = CalcDirLight(sun, norm, viewDir, vec3(totalColor), shadow) * 1.2f;
     for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir, vec3(totalColor));  
+    {
+        PointLight light = pointLights[i];
+        if (bakedLighting == 1)
+        {
+            light.ambient = vec3(0.0); // part of the lightmap
+            light.specular *= baked.a;
+        }
+        else if (bakedLighting == 2)
+        {
+            light.ambient *= baked.a;
+            light.specular *= baked.a;
+        }
+        light.ambient *= ao;
+        result += CalcPointLight(light, norm, FragPos, viewDir, vec3(totalColor), PointShadow(i, FragPos));  
+    }
     FragColor = vec4(result, 1.0);
 	//FragColor = mix(vec4(skyColor, 1.0), vec4(result, 1.0), visibility);
 }
\ No newline at end of file
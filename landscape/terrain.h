@@ -16,6 +16,9 @@
 #include <terrain_random.h>
 #include <vector>
 #include <string>
+#include <climits>
+
+#include <Bounds.h>
 
 namespace KooNan
 {
@@ -30,18 +33,90 @@ namespace KooNan
 		bool flatten;
 		std::vector<float> land_heights;
 		Mesh terrain_mesh;	
+		AABB bounds;
+		int editMinX, editMinZ, editMaxX, editMaxZ; // vertices changed by SetHeight since the last TakeEdits
 	public:
 		Terrain(int grid_index_x, int grid_index_z, vector<Texture> texture, float chunk_size = 32.0f, int vertex_count = 32, float if_flatten = false) :
 			size(chunk_size), vertex_count(vertex_count), index_x(grid_index_x), index_z(grid_index_z), 
 			world_x(index_x * size), world_z(index_z * size), flatten(if_flatten), terrain_mesh(generateTerrain(texture, if_flatten))
-		{}
+		{
+			computeBounds();
+			clearEdits();
+		}
 		Terrain(int grid_index_x, int grid_index_z, vector<Texture> texture, string heightmap_path, float chunk_size = 32.0f, int vertex_count = 32):
 			size(chunk_size), index_x(grid_index_x),index_z(grid_index_z), world_x(index_x * size), world_z(index_z * size),flatten(false), terrain_mesh(LoadTerrain(texture,heightmap_path))
-		{}
+		{
+			computeBounds();
+			clearEdits();
+		}
 		void Draw(Shader &shader)
 		{
 			this->terrain_mesh.Draw(&shader);
 		}
+		const AABB& GetBounds() const
+		{
+			return bounds;
+		}
+		const Mesh& GetMesh() const
+		{
+			return terrain_mesh;
+		}
+		const std::vector<float>& GetHeights() const
+		{
+			return land_heights;
+		}
+		int GetVertexCount() const
+		{
+			return vertex_count;
+		}
+		float GetSize() const
+		{
+			return size;
+		}
+		int GetGridX() const
+		{
+			return index_x;
+		}
+		int GetGridZ() const
+		{
+			return index_z;
+		}
+		// GetFirstVertex: world x, z of vertex (0, 0), the corner of the chunk
+		glm::vec2 GetFirstVertex() const
+		{
+			const glm::vec3& p = terrain_mesh.vertices_simple.front().Position;
+			return glm::vec2(p.x, p.z);
+		}
+
+		// SetHeight: move one vertex, the mesh is updated by the next TakeEdits
+		void SetHeight(int x, int z, float y)
+		{
+			land_heights[x + z * vertex_count] = y;
+			editMinX = glm::min(editMinX, x);
+			editMinZ = glm::min(editMinZ, z);
+			editMaxX = glm::max(editMaxX, x);
+			editMaxZ = glm::max(editMaxZ, z);
+		}
+		// TakeEdits: upload the vertices moved by SetHeight and their normals
+		//   x0, z0, x1, z1: the moved vertices, inclusive
+		//   return: whether anything was edited
+		bool TakeEdits(int& x0, int& z0, int& x1, int& z1)
+		{
+			if (editMinX > editMaxX)
+				return false;
+			x0 = editMinX; z0 = editMinZ; x1 = editMaxX; z1 = editMaxZ;
+			for (int z = glm::max(z0 - 1, 0); z <= glm::min(z1 + 1, vertex_count - 1); z++)
+				for (int x = glm::max(x0 - 1, 0); x <= glm::min(x1 + 1, vertex_count - 1); x++)
+				{
+					Vertex_Simple& v = terrain_mesh.vertices_simple[x + z * vertex_count];
+					v.Position.y = land_heights[x + z * vertex_count];
+					v.Normal = calculateNormalFromHeights(x, z);
+				}
+			terrain_mesh.updateVertices();
+			computeBounds();
+			clearEdits();
+			return true;
+		}
 		float GetTerrainHeight(float x, float z)
 		{
 			float relativeX = x - world_x + size / 2;
@@ -72,6 +147,17 @@ namespace KooNan
 
 		}
 	private:
+		void clearEdits()
+		{
+			editMinX = editMinZ = INT_MAX;
+			editMaxX = editMaxZ = INT_MIN;
+		}
+		void computeBounds()
+		{
+			bounds = AABB();
+			for (const Vertex_Simple& v : terrain_mesh.vertices_simple)
+				bounds.Expand(v.Position);
+		}
 		Mesh generateTerrain(vector<Texture> texture, bool flatten = false)
 		{
 			this->flatten = flatten;
@@ -203,6 +289,15 @@ namespace KooNan
 			glm::vec3 Norm = glm::normalize(glm::vec3(heightL - heightR, 2.0f, heightD - heightU));
 			return Norm;
 		}
+		glm::vec3 calculateNormalFromHeights(int x, int z)
+		{
+			float heightL = land_heights[glm::max(x - 1, 0) + z * vertex_count];
+			float heightR = land_heights[glm::min(x + 1, vertex_count - 1) + z * vertex_count];
+			float heightD = land_heights[x + glm::max(z - 1, 0) * vertex_count];
+			float heightU = land_heights[x + glm::min(z + 1, vertex_count - 1) * vertex_count];
+			glm::vec3 Norm = glm::normalize(glm::vec3(heightL - heightR, 2.0f, heightD - heightU));
+			return Norm;
+		}
 		float barryCentric(glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, glm::vec2 pos) {
 			float det = (p2.z - p3.z) * (p1.x - p3.x) + (p3.x - p2.x) * (p1.z - p3.z);
 			float l1 = ((p2.z - p3.z) * (pos.x - p3.x) + (p3.x - p2.x) * (pos.y - p3.z)) / det;
@@ -6,28 +6,26 @@ layout (location = 2) in vec2 aTexCoord;
 out vec3 FragPos;
 out vec2 TexCoord;
 out vec3 Normal;
-out vec4 FragPosInLightSpace;
+out float ViewDepth;
 out float visibility;
 
 uniform mat4 view;
 uniform mat4 projection;
 uniform vec4 plane;
 
-uniform mat4 lightView;
-uniform mat4 lightProjection;
-const float density = 0.001;
-const float gradient = 1.5;
+uniform float fogDensity; // RenderSettings::fogDensity
+uniform float fogGradient;
 
 void main()
 {
 	vec4 World_Pos =  vec4(aPos, 1.0f);
 	FragPos = vec3(World_Pos);
-	FragPosInLightSpace = lightProjection * lightView * vec4(FragPos, 1.0f);
     Normal = aNormal; 
 	gl_ClipDistance[0] = dot(World_Pos , plane);
 	vec4 CamRelativePos = view * World_Pos;
+	ViewDepth = -CamRelativePos.z;
 	float CamRelativeDistance = length(CamRelativePos.xyz);
-	visibility = clamp(exp(-pow((CamRelativeDistance * density), gradient)), 0.0, 1.0);
+	visibility = clamp(exp(-pow((CamRelativeDistance * fogDensity), fogGradient)), 0.0, 1.0);
 	gl_Position = projection * CamRelativePos;
 	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
 }
\ No newline at end of file
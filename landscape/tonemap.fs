@@ -0,0 +1,48 @@
+#version 330 core
+// The last pass before the GUI: bloom, exposure, the ACES curve, color grading and dithering
+// in one read of the HDR scene, writing the 8 bit window.
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform sampler2D bloomMap; // top of the bloom chain, half size
+uniform int bloom;
+uniform float bloomIntensity;
+uniform float exposure;
+uniform float contrast;
+uniform float saturation;
+uniform int dither;
+uniform float frameNoise; // moves the dither pattern every frame
+
+// fit of the ACES filmic curve by Narkowicz
+vec3 Aces(vec3 x)
+{
+    return clamp(x * (2.51 * x + 0.03) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+float InterleavedGradientNoise(vec2 p)
+{
+    return fract(52.9829189 * fract(dot(p, vec2(0.06711056, 0.00583715))));
+}
+
+void main()
+{
+    vec3 color = texture(scene, TexCoord).rgb;
+    if (bloom == 1)
+        color += texture(bloomMap, TexCoord).rgb * bloomIntensity;
+    color = Aces(color * exposure);
+
+    float luma = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    color = mix(vec3(luma), color, saturation);
+    color = clamp((color - 0.5) * contrast + 0.5, 0.0, 1.0);
+
+    if (dither == 1)
+    {
+        // triangular noise of one 8 bit step, breaks up the banding of smooth gradients
+        float a = InterleavedGradientNoise(gl_FragCoord.xy + frameNoise);
+        float b = InterleavedGradientNoise(gl_FragCoord.xy + vec2(19.0, 47.0) + frameNoise);
+        color += (a + b - 1.0) / 255.0;
+    }
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,39 @@
+#version 330 core
+// Brings the quarter size fog to the full window and lays it over the scene, blended with
+// GL_ONE, GL_SRC_ALPHA. The four fog pixels around a pixel are weighted by how close their
+// depth is to its own, so the fog of the background does not bleed over the edges in front.
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D fogMap; // resolved fog, in-scattered light and transmittance
+uniform sampler2D fogDepthMap; // view depth of each fog pixel
+uniform sampler2D depthMap; // of the main pass
+uniform float nearPlane;
+uniform float farPlane;
+
+float LinearDepth(float depth)
+{
+    return nearPlane * farPlane / (farPlane - depth * (farPlane - nearPlane));
+}
+
+void main()
+{
+    float z = LinearDepth(texelFetch(depthMap, ivec2(gl_FragCoord.xy), 0).r);
+    ivec2 last = textureSize(fogMap, 0) - 1;
+    vec2 position = gl_FragCoord.xy * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+    vec4 fog = vec4(0.0);
+    float weights = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 q = clamp(base + offset, ivec2(0), last);
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float w = bilinear.x * bilinear.y / (0.001 + abs(texelFetch(fogDepthMap, q, 0).r - z) / z);
+        fog += texelFetch(fogMap, q, 0) * w;
+        weights += w;
+    }
+    FragColor = weights > 0.0 ? fog / weights : vec4(0.0, 0.0, 0.0, 1.0);
+}
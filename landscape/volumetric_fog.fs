@@ -0,0 +1,100 @@
+#version 330 core
+// Fog lit by the sun at a quarter of the pixels: each pixel marches its view ray through the
+// sun cascades up to the nearest surface of its 2x2 block, starting at a blue noise offset that
+// changes every frame. The fog follows the distance law of terrain.vs, its optical depth up to
+// distance t is (t * fogDensity) ^ fogGradient; past maxDistance it is added without shadows.
+in vec2 TexCoord;
+
+layout (location = 0) out vec4 FragColor; // in-scattered light, transmittance
+layout (location = 1) out float FogDepth; // view depth the ray ended at, for the upsampling
+
+#define NR_CASCADES 4
+
+uniform sampler2D depthMap; // of the main pass, full size
+uniform sampler2DArray shadowMap; // cascades of the sun, see Shadow_Frame_Buffer
+uniform sampler2D blueNoise; // ranks of a 64x64 blue noise tile
+uniform mat4 lightSpaceMatrices[NR_CASCADES];
+uniform float cascadeSplits[NR_CASCADES];
+uniform mat4 invViewProjection;
+uniform vec3 viewPos;
+uniform vec3 viewForward;
+uniform float farPlane;
+uniform vec3 sunDirection; // towards the sun
+uniform vec3 sunColor;
+uniform vec3 ambientColor;
+uniform float fogDensity;
+uniform float fogGradient;
+uniform float anisotropy;
+uniform float intensity;
+uniform float maxDistance;
+uniform int steps;
+uniform float noiseOffset; // golden ratio steps over the frames
+
+float OpticalDepth(float t)
+{
+    return pow(t * fogDensity, fogGradient);
+}
+
+// SunVisibility: 1 where the sun reaches p, one tap of the finest cascade covering it
+float SunVisibility(vec3 p, float viewDepth)
+{
+    for (int i = 0; i < NR_CASCADES; ++i)
+    {
+        if (viewDepth > cascadeSplits[i])
+            continue;
+        vec4 lightSpace = lightSpaceMatrices[i] * vec4(p, 1.0);
+        vec3 projCoords = lightSpace.xyz / lightSpace.w * 0.5 + 0.5;
+        if (any(lessThan(projCoords, vec3(0.0))) || any(greaterThan(projCoords, vec3(1.0))))
+            return 1.0;
+        float depth = textureLod(shadowMap, vec3(projCoords.xy, float(i)), 0.0).r;
+        return projCoords.z - 0.0001 * float(i + 1) > depth ? 0.0 : 1.0;
+    }
+    return 1.0;
+}
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(depthMap, 0);
+    float depth = 1.0;
+    for (int i = 0; i < 4; i++)
+        depth = min(depth, texelFetch(depthMap, min(p * 2 + ivec2(i & 1, i >> 1), size - 1), 0).r);
+    bool sky = depth >= 1.0;
+
+    vec2 uv = vec2(p * 2 + 1) / vec2(size);
+    vec4 world = invViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec3 toSurface = world.xyz / world.w - viewPos;
+    float distance = length(toSurface);
+    vec3 rayDir = toSurface / distance;
+    float forward = dot(rayDir, viewForward);
+    FogDepth = sky ? farPlane : distance * forward;
+
+    // Henyey-Greenstein, scaled so isotropic scattering is 1
+    float g = anisotropy;
+    float phase = (1.0 - g * g) / pow(1.0 + g * g - 2.0 * g * dot(rayDir, sunDirection), 1.5);
+    vec3 sunLight = sunColor * phase * intensity;
+    vec3 ambientLight = ambientColor * intensity;
+
+    float end = min(distance, maxDistance);
+    float dt = end / float(steps);
+    float offset = fract(texelFetch(blueNoise, p & 63, 0).r + noiseOffset);
+    vec3 light = vec3(0.0);
+    float transmittance = 1.0, tau = 0.0;
+    for (int i = 0; i < steps; i++)
+    {
+        float t = (float(i) + offset) * dt;
+        float nextTau = OpticalDepth(float(i + 1) * dt);
+        float segment = exp(tau - nextTau);
+        float lit = SunVisibility(viewPos + rayDir * t, t * forward);
+        light += transmittance * (1.0 - segment) * (sunLight * lit + ambientLight);
+        transmittance *= segment;
+        tau = nextTau;
+    }
+    if (!sky && distance > end)
+    {
+        float segment = exp(tau - OpticalDepth(distance));
+        light += transmittance * (1.0 - segment) * (sunLight + ambientLight);
+        transmittance *= segment;
+    }
+    FragColor = vec4(light, transmittance);
+}
@@ -0,0 +1,51 @@
+#version 330 core
+// Blends the fog of this frame into the fog of the last frame at the same world position,
+// which turns the blue noise of the ray offsets into more steps. The history is clamped to
+// the fog around the pixel, so it cannot linger where the view changed.
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D fogMap; // volumetric_fog.fs, this frame
+uniform sampler2D fogDepthMap; // view depth of each fog pixel
+uniform sampler2D historyMap; // FragColor of the last frame
+uniform mat4 invViewProjection;
+uniform mat4 prevViewProjection;
+uniform vec3 viewPos;
+uniform vec3 viewForward;
+uniform float historyBlend; // 0 ignores the history
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 last = textureSize(fogMap, 0) - 1;
+    vec4 current = texelFetch(fogMap, p, 0);
+    if (historyBlend <= 0.0)
+    {
+        FragColor = current;
+        return;
+    }
+    vec4 low = current, high = current;
+    for (int x = -1; x <= 1; x++)
+    {
+        for (int y = -1; y <= 1; y++)
+        {
+            vec4 c = texelFetch(fogMap, clamp(p + ivec2(x, y), ivec2(0), last), 0);
+            low = min(low, c);
+            high = max(high, c);
+        }
+    }
+
+    vec4 farPoint = invViewProjection * vec4(TexCoord * 2.0 - 1.0, 1.0, 1.0);
+    vec3 rayDir = normalize(farPoint.xyz / farPoint.w - viewPos);
+    float distance = texelFetch(fogDepthMap, p, 0).r / dot(rayDir, viewForward);
+    vec4 prevClip = prevViewProjection * vec4(viewPos + rayDir * distance, 1.0);
+    vec2 prevUV = prevClip.xy / prevClip.w * 0.5 + 0.5;
+    if (prevClip.w <= 0.0 || any(lessThan(prevUV, vec2(0.0))) || any(greaterThan(prevUV, vec2(1.0))))
+    {
+        FragColor = current;
+        return;
+    }
+    vec4 history = clamp(texture(historyMap, prevUV), low, high);
+    FragColor = mix(current, history, historyBlend);
+}
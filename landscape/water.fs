@@ -4,6 +4,8 @@ in vec4 clipspace;
 in vec2 TexCoord;
 in vec3 FragPos;
 in float visibility;
+in vec2 WaveCoord;
+in float WaveFade;
 
 out vec4 FragColor;
 
@@ -15,6 +17,10 @@ uniform sampler2D depthMap;
 uniform vec3 skyColor;
 uniform vec3 lightColor;
 uniform float moveOffset;
+uniform int reflectionMode; // 0: planar, mirrored coordinates; 1: screen space, same coordinates as the pixel; 2: skybox only
+uniform samplerCube skybox; // reflection of small water bodies that get no planar pass
+uniform int waves; // 1: FFT ocean, the wave normals replace the normal map up close
+uniform sampler2D waveNormalMap;
 
 const float distStrength = 0.004;
 
@@ -82,7 +88,7 @@ void main()
 {
     vec2 ndc = (clipspace.xy/clipspace.w)/2.0 + 0.5;
     vec2 refractTexCoord = vec2(ndc.x, ndc.y);
-    vec2 reflectTexCoord = vec2(ndc.x, -ndc.y);
+    vec2 reflectTexCoord = reflectionMode == 1 ? ndc : vec2(ndc.x, -ndc.y);
 
     float near = 0.1;
     float far = 1000.0;
@@ -93,6 +99,8 @@ void main()
     float waterDistance = 2.0 * near * far / (far + near - (2.0 * depth - 1.0) * (far - near));
 
     float waterDepth = floorDistance - waterDistance;
+    if (reflectionMode == 2)
+        waterDepth = 1.0; // depthMap belongs to another water level
 
     vec2 distortedTexCoords = texture(dudvMap, vec2(TexCoord.x + moveOffset, TexCoord.y)).rg*0.1;
 	distortedTexCoords = TexCoord + vec2(distortedTexCoords.x, distortedTexCoords.y+moveOffset);
@@ -101,12 +109,17 @@ void main()
     vec4 normalMapColor = texture(normalMap, distortedTexCoords);
     vec3 normal = vec3(normalMapColor.r * 2.0 - 1.0, normalMapColor.b * 3.0, normalMapColor.g * 2.0 - 1.0);
     normal = normalize(normal);
+    if (waves == 1)
+        normal = normalize(mix(normal, texture(waveNormalMap, WaveCoord).xyz, WaveFade));
 
     refractTexCoord += totalDistortion;
     refractTexCoord = clamp(refractTexCoord, 0.001, 0.999);
     reflectTexCoord += totalDistortion;
     reflectTexCoord.x = clamp(reflectTexCoord.x, 0.001, 0.999);
-    reflectTexCoord.y = clamp(reflectTexCoord.y, -0.999, -0.001);
+    if (reflectionMode == 1)
+        reflectTexCoord.y = clamp(reflectTexCoord.y, 0.001, 0.999);
+    else
+        reflectTexCoord.y = clamp(reflectTexCoord.y, -0.999, -0.001);
     float refractiveFactor = dot(normalize(viewPos - FragPos), normalize(vec3(normal.x, normal.y + 3.0, normal.z)));
     refractiveFactor = clamp(pow(refractiveFactor, 2.0), 0.0, 1.0);//The greater the expon the more the water will reflect
 
@@ -118,6 +131,13 @@ void main()
         result += CalcPointLight(pointLights[i], normal, FragPos, viewDir); 
     
     result *= clamp(waterDepth * 5, 0.0, 1.0);
+    if (reflectionMode == 2)
+    {
+        // no refraction target either, blending shows the scene under the surface
+        vec3 skyReflect = texture(skybox, reflect(-viewDir, normal)).rgb;
+        FragColor = vec4(mix(skyReflect, vec3(0.0, 0.3, 0.5), 0.3) + result, 1.0 - refractiveFactor * 0.7);
+        return;
+    }
     vec4 reflectColor = texture(reflection, reflectTexCoord);
     vec4 refractColor = texture(refraction, refractTexCoord);
     FragColor = mix(mix(reflectColor, refractColor, refractiveFactor), vec4(0.0, 0.3, 0.5, 1.0), 0.05) + vec4(result, 0.0) * 1.0;
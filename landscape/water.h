@@ -2,6 +2,11 @@
 #define WATER_H
 
 #include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <Bounds.h>
+
+#include <vector>
 
 namespace KooNan
 {
@@ -13,6 +18,9 @@ namespace KooNan
 		int index_z;
 		float height;
 		unsigned int VBO;
+		int vertexCount;
+		AABB bounds;
+		std::vector<glm::vec2> outline; // x, z of a water body, empty for a grid chunk
 
 	public:
 		unsigned int VAO;
@@ -24,18 +32,108 @@ namespace KooNan
 			this->height = water_height;
 			setUp(grid_index_x, grid_index_z, chunk_size, water_height);
 		}
+		/*
+		vector<glm::vec2> outline: x, z of a simple polygon, either winding
+		float water_height: height of the surface
+		float chunk_size: the DUDV tiling follows it, pass the scene's chunk size
+		*/
+		Water(const std::vector<glm::vec2>& outline, float water_height, float chunk_size = 32.0f)
+		{
+			this->size = chunk_size;
+			this->index_x = 0;
+			this->index_z = 0;
+			this->height = water_height;
+			this->outline = outline;
+			std::vector<float> vertices;
+			for (unsigned int i : Triangulate(outline))
+			{
+				vertices.push_back(outline[i].x);
+				vertices.push_back(water_height);
+				vertices.push_back(outline[i].y);
+			}
+			bounds = AABB();
+			for (const glm::vec2& p : outline)
+				bounds.Expand(glm::vec3(p.x, water_height, p.y));
+			upload(vertices);
+		}
 		float getHeight()
 		{
 			return this->height;
 		}
+		AABB getBounds() const
+		{
+			return bounds;
+		}
+		const std::vector<glm::vec2>& getOutline() const
+		{
+			return outline;
+		}
 		void Draw(Shader &shader)
 		{
 			shader.use();
 			glBindVertexArray(VAO);
 			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			glDrawArrays(GL_TRIANGLES, 0, 6);
+			glDrawArrays(GL_TRIANGLES, 0, vertexCount);
 			glBindVertexArray(0);
 		}
+
+		// Triangulate: ear clipping of a simple polygon
+		//   返回three outline indices per triangle
+		static std::vector<unsigned int> Triangulate(const std::vector<glm::vec2>& polygon)
+		{
+			std::vector<unsigned int> result;
+			int n = (int)polygon.size();
+			if (n < 3)
+				return result;
+			float area = 0.0f;
+			for (int i = 0; i < n; i++)
+			{
+				const glm::vec2& a = polygon[i];
+				const glm::vec2& b = polygon[(i + 1) % n];
+				area += a.x * b.y - b.x * a.y;
+			}
+			std::vector<unsigned int> remaining;
+			for (int i = 0; i < n; i++)
+				remaining.push_back(area > 0.0f ? i : n - 1 - i); // counter clockwise from here on
+			while (remaining.size() > 3)
+			{
+				bool clipped = false;
+				int m = (int)remaining.size();
+				for (int i = 0; i < m; i++)
+				{
+					unsigned int ia = remaining[(i + m - 1) % m], ib = remaining[i], ic = remaining[(i + 1) % m];
+					const glm::vec2& a = polygon[ia];
+					const glm::vec2& b = polygon[ib];
+					const glm::vec2& c = polygon[ic];
+					if (Cross(a, b, c) <= 0.0f)
+						continue; // reflex corner
+					bool empty = true;
+					for (unsigned int j : remaining)
+						if (j != ia && j != ib && j != ic && InTriangle(polygon[j], a, b, c))
+						{
+							empty = false;
+							break;
+						}
+					if (!empty)
+						continue;
+					result.push_back(ia);
+					result.push_back(ib);
+					result.push_back(ic);
+					remaining.erase(remaining.begin() + i);
+					clipped = true;
+					break;
+				}
+				if (!clipped)
+					break; // self intersecting outline, keep what was clipped so far
+			}
+			if (remaining.size() == 3)
+			{
+				result.push_back(remaining[0]);
+				result.push_back(remaining[1]);
+				result.push_back(remaining[2]);
+			}
+			return result;
+		}
 	private:
 		void setUp(int grid_index_x, int grid_index_z, float chunk_size, float water_height)
 		{
@@ -44,7 +142,7 @@ namespace KooNan
 			float Right = -chunk_size / 2.0f + (grid_index_x + 1) * chunk_size;
 			float Up = -chunk_size / 2.0f + grid_index_z * chunk_size;
 			float Down = -chunk_size / 2.0f + (grid_index_z + 1) * chunk_size;
-			float vertices[] = {
+			std::vector<float> vertices = {
 				Left,water_height,Up,//UpLeft
 				Left,water_height,Down,//DownLeft
 				Right,water_height,Up,//UpRight
@@ -52,19 +150,33 @@ namespace KooNan
 				Left,water_height,Down,//DownLeft
 				Right,water_height,Down//DownRight
 			};
+			bounds = AABB(glm::vec3(Left, water_height, Up), glm::vec3(Right, water_height, Down));
+			upload(vertices);
+		}
+		void upload(const std::vector<float>& vertices)
+		{
+			vertexCount = (int)vertices.size() / 3;
 			glGenVertexArrays(1, &VAO);
 			glGenBuffers(1, &VBO);
 			glBindVertexArray(VAO);
 			glBindBuffer(GL_ARRAY_BUFFER, VBO);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
 			glEnableVertexAttribArray(0);
 			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 			glBindVertexArray(0);
 		}
+		static float Cross(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c)
+		{
+			return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		}
+		static bool InTriangle(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b, const glm::vec2& c)
+		{
+			return Cross(a, b, p) >= 0.0f && Cross(b, c, p) >= 0.0f && Cross(c, a, p) >= 0.0f;
+		}
 
 
 	};
 }
 
 
-#endif
\ No newline at end of file
+#endif
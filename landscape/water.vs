@@ -6,6 +6,8 @@ out vec4 clipspace;
 out vec2 TexCoord;
 out vec3 FragPos;
 out float visibility;
+out vec2 WaveCoord;
+out float WaveFade;
 
 uniform mat4 view;
 uniform mat4 projection;
@@ -13,18 +15,40 @@ uniform vec3 lightPos;
 uniform float chunk_size;
 
 const float tiling = 8;
-const float density = 0.001;
-const float gradient = 1.5;
+uniform float fogDensity; // RenderSettings::fogDensity
+uniform float fogGradient;
+
+// FFT ocean, see Ocean::Draw
+uniform int waves; // 1: aPos is an offset in the camera centered grid
+uniform vec2 gridOrigin;
+uniform vec2 waterExtentMin;
+uniform vec2 waterExtentMax;
+uniform float waterHeight;
+uniform float wavePatchSize;
+uniform float waveFadeDistance;
+uniform sampler2D displacementMap;
 
 void main()
 {
-    vec4 World_Pos =  vec4(aPos, 1.0f);
+    vec3 flatPos = aPos;
+    WaveFade = 0.0;
+    if (waves == 1)
+    {
+        // vertices outside the chunks collapse onto their border
+        flatPos.xz = clamp(aPos.xz + gridOrigin, waterExtentMin, waterExtentMax);
+        flatPos.y = waterHeight;
+        WaveCoord = flatPos.xz / wavePatchSize;
+        WaveFade = clamp(1.0 - length(flatPos.xz - gridOrigin) / waveFadeDistance, 0.0, 1.0);
+    }
+    vec4 World_Pos = vec4(flatPos, 1.0f);
+    if (waves == 1)
+        World_Pos.xyz += textureLod(displacementMap, WaveCoord, 0.0).xyz * WaveFade;
     vec4 CamRelativePos = view * World_Pos;
     float CamRelativeDistance = length(CamRelativePos.xyz);
-	visibility = clamp(exp(-pow((CamRelativeDistance * density), gradient)), 0.0, 1.0);
+	visibility = clamp(exp(-pow((CamRelativeDistance * fogDensity), fogGradient)), 0.0, 1.0);
 	FragPos = vec3(World_Pos);
     clipspace = projection * CamRelativePos;
     gl_Position = clipspace;
-    TexCoord = vec2(aPos.x/chunk_size + 0.5, aPos.z/chunk_size + 0.5) * tiling;
+    TexCoord = vec2(flatPos.x/chunk_size + 0.5, flatPos.z/chunk_size + 0.5) * tiling;
 
 }
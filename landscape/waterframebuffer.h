@@ -4,6 +4,8 @@
 #include <glad/glad.h>
 #include <common.h>
 #include <GameController.h>
+#include <RenderSettings.h>
+#include <SceneFrameBuffer.h>
 
 
 namespace KooNan
@@ -11,10 +13,11 @@ namespace KooNan
 	class Water_Frame_Buffer
 	{
 	private:
-		const int REFLECTION_WIDTH = 1920;
-		const int REFLECTION_HEIGHT = 1080;
-		const int REFRACTION_WIDTH = 1920;
-		const int REFRACTION_HEIGHT = 1080;
+		// sizes follow the window, scaled by RenderSettings::waterReflectionScale and waterRefractionScale
+		int reflectionWidth, reflectionHeight;
+		int refractionWidth, refractionHeight;
+		// Scene_Frame_Buffer::ColorFormat of each color target, HDR while the scene is
+		GLint reflectionFormat, refractionFormat, layeredFormat;
 		unsigned int reflectionFrameBuffer;
 		unsigned int reflectionTexture;
 		unsigned int reflectionDepthBuffer;
@@ -23,18 +26,65 @@ namespace KooNan
 		unsigned int refractionTexture;
 		unsigned int refractionDepthTexture;
 
+		// both views as layers of one target, created on first use by the layered water pass
+		unsigned int layeredFrameBuffer;
+		unsigned int layeredColorArray;
+		unsigned int layeredDepthArray;
+		int layeredWidth, layeredHeight;
+
 	public:
-		Water_Frame_Buffer()
+		static const int REFLECTION_LAYER = 0;
+		static const int REFRACTION_LAYER = 1;
+
+		Water_Frame_Buffer() : reflectionFormat(0), refractionFormat(0), layeredFormat(0), layeredFrameBuffer(0), layeredWidth(0), layeredHeight(0)
 		{
+			reflectionWidth = scaledSize(Common::SCR_WIDTH, RenderSettings::waterReflectionScale);
+			reflectionHeight = scaledSize(Common::SCR_HEIGHT, RenderSettings::waterReflectionScale);
+			refractionWidth = scaledSize(Common::SCR_WIDTH, RenderSettings::waterRefractionScale);
+			refractionHeight = scaledSize(Common::SCR_HEIGHT, RenderSettings::waterRefractionScale);
 			initialiseReflectionFrameBuffer();
 			initialiseRefractionFrameBuffer();
 		}
 		void bindReflectionFrameBuffer() {//call before rendering to this FBO
-			bindFrameBuffer(reflectionFrameBuffer, REFLECTION_WIDTH, REFLECTION_HEIGHT);
+			fitReflection();
+			bindFrameBuffer(reflectionFrameBuffer, reflectionWidth, reflectionHeight);
 		}
 
 		void bindRefractionFrameBuffer() {//call before rendering to this FBO
-			bindFrameBuffer(refractionFrameBuffer, REFRACTION_WIDTH, REFRACTION_HEIGHT);
+			fitRefraction();
+			bindFrameBuffer(refractionFrameBuffer, refractionWidth, refractionHeight);
+		}
+
+		// bindLayeredFrameBuffer: bind both layers at once, a geometry shader picks the layer with gl_Layer
+		void bindLayeredFrameBuffer() {
+			fitLayered();
+			glBindFramebuffer(GL_FRAMEBUFFER, layeredFrameBuffer);
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, layeredColorArray, 0);
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, layeredDepthArray, 0);
+			glViewport(0, 0, layeredWidth, layeredHeight);
+		}
+
+		// bindLayer: bind a single layer, for draws that are not layered
+		void bindLayer(int layer) {
+			fitLayered();
+			glBindFramebuffer(GL_FRAMEBUFFER, layeredFrameBuffer);
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, layeredColorArray, 0, layer);
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, layeredDepthArray, 0, layer);
+			glViewport(0, 0, layeredWidth, layeredHeight);
+		}
+
+		// resolveLayers: copy the layers into the reflection and refraction targets water.fs samples
+		void resolveLayers() {
+			fitReflection();
+			fitRefraction();
+			bindLayer(REFLECTION_LAYER);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, reflectionFrameBuffer);
+			glBlitFramebuffer(0, 0, layeredWidth, layeredHeight, 0, 0, reflectionWidth, reflectionHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			bindLayer(REFRACTION_LAYER);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, refractionFrameBuffer);
+			glBlitFramebuffer(0, 0, layeredWidth, layeredHeight, 0, 0, refractionWidth, refractionHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			glBlitFramebuffer(0, 0, layeredWidth, layeredHeight, 0, 0, refractionWidth, refractionHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+			unbindCurrentFrameBuffer();
 		}
 
 		void unbindCurrentFrameBuffer() {//call to switch to default frame buffer
@@ -55,15 +105,17 @@ namespace KooNan
 
 		void initialiseReflectionFrameBuffer() {
 			reflectionFrameBuffer = createFrameBuffer();
-			reflectionTexture = createTextureAttachment(REFLECTION_WIDTH, REFLECTION_HEIGHT);
-			reflectionDepthBuffer = createDepthBufferAttachment(REFLECTION_WIDTH, REFLECTION_HEIGHT);
+			reflectionFormat = Scene_Frame_Buffer::ColorFormat();
+			reflectionTexture = createTextureAttachment(reflectionWidth, reflectionHeight);
+			reflectionDepthBuffer = createDepthBufferAttachment(reflectionWidth, reflectionHeight);
 			unbindCurrentFrameBuffer();
 		}
 
 		void initialiseRefractionFrameBuffer() {
 			refractionFrameBuffer = createFrameBuffer();
-			refractionTexture = createTextureAttachment(REFRACTION_WIDTH, REFRACTION_HEIGHT);
-			refractionDepthTexture = createDepthTextureAttachment(REFRACTION_WIDTH, REFRACTION_HEIGHT);
+			refractionFormat = Scene_Frame_Buffer::ColorFormat();
+			refractionTexture = createTextureAttachment(refractionWidth, refractionHeight);
+			refractionDepthTexture = createDepthTextureAttachment(refractionWidth, refractionHeight);
 			unbindCurrentFrameBuffer();
 		}
 
@@ -74,9 +126,91 @@ namespace KooNan
 			glDeleteFramebuffers(1, &refractionFrameBuffer);
 			glDeleteTextures(1, &refractionTexture);
 			glDeleteTextures(1, &refractionDepthTexture);
+			if (layeredFrameBuffer != 0)
+			{
+				glDeleteFramebuffers(1, &layeredFrameBuffer);
+				glDeleteTextures(1, &layeredColorArray);
+				glDeleteTextures(1, &layeredDepthArray);
+			}
 		}
 
 	private:
+		void fitReflection() {
+			int width = scaledSize(Common::SCR_WIDTH, RenderSettings::waterReflectionScale);
+			int height = scaledSize(Common::SCR_HEIGHT, RenderSettings::waterReflectionScale);
+			if (width != reflectionWidth || height != reflectionHeight || reflectionFormat != Scene_Frame_Buffer::ColorFormat())
+			{
+				reflectionWidth = width;
+				reflectionHeight = height;
+				reflectionFormat = Scene_Frame_Buffer::ColorFormat();
+				glBindTexture(GL_TEXTURE_2D, reflectionTexture);
+				glTexImage2D(GL_TEXTURE_2D, 0, reflectionFormat, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)nullptr);
+				glBindRenderbuffer(GL_RENDERBUFFER, reflectionDepthBuffer);
+				glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
+			}
+		}
+
+		void fitRefraction() {
+			int width = scaledSize(Common::SCR_WIDTH, RenderSettings::waterRefractionScale);
+			int height = scaledSize(Common::SCR_HEIGHT, RenderSettings::waterRefractionScale);
+			if (width != refractionWidth || height != refractionHeight || refractionFormat != Scene_Frame_Buffer::ColorFormat())
+			{
+				refractionWidth = width;
+				refractionHeight = height;
+				refractionFormat = Scene_Frame_Buffer::ColorFormat();
+				glBindTexture(GL_TEXTURE_2D, refractionTexture);
+				glTexImage2D(GL_TEXTURE_2D, 0, refractionFormat, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)nullptr);
+				glBindTexture(GL_TEXTURE_2D, refractionDepthTexture);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)nullptr);
+				setDepthFilter();
+			}
+		}
+
+		// the layers share one size, the larger of the two targets
+		void fitLayered() {
+			float scale = RenderSettings::waterReflectionScale > RenderSettings::waterRefractionScale ?
+				RenderSettings::waterReflectionScale : RenderSettings::waterRefractionScale;
+			int width = scaledSize(Common::SCR_WIDTH, scale);
+			int height = scaledSize(Common::SCR_HEIGHT, scale);
+			if (layeredFrameBuffer == 0)
+			{
+				glGenFramebuffers(1, &layeredFrameBuffer);
+				glGenTextures(1, &layeredColorArray);
+				glGenTextures(1, &layeredDepthArray);
+			}
+			else if (width == layeredWidth && height == layeredHeight && layeredFormat == Scene_Frame_Buffer::ColorFormat())
+				return;
+			layeredWidth = width;
+			layeredHeight = height;
+			layeredFormat = Scene_Frame_Buffer::ColorFormat();
+			glBindTexture(GL_TEXTURE_2D_ARRAY, layeredColorArray);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, layeredFormat, width, height, 2, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)nullptr);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			// same format as the refraction depth, glBlitFramebuffer copies depth only between equal formats
+			glBindTexture(GL_TEXTURE_2D_ARRAY, layeredDepthArray);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32, width, height, 2, 0, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)nullptr);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		}
+
+		// a minimized window reports a zero sized framebuffer
+		static int scaledSize(unsigned int windowSize, float scale)
+		{
+			int size = (int)(windowSize * scale + 0.5f);
+			return size > 0 ? size : 1;
+		}
+
+		// water.fs only reads depth to fade the shore, so below full size nearest
+		// samples avoid blending foreground and background depth across an edge
+		void setDepthFilter()
+		{
+			GLint filter = RenderSettings::waterRefractionScale < 1.0f ? GL_NEAREST : GL_LINEAR;
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+		}
+
 		void bindFrameBuffer(int frameBuffer, int width, int height) {
 			glBindTexture(GL_TEXTURE_2D, 0);//To make sure the texture isn't bound
 			glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
@@ -95,7 +229,7 @@ namespace KooNan
 			unsigned int texture;
 			glGenTextures(1, &texture);
 			glBindTexture(GL_TEXTURE_2D, texture);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)nullptr);
+			glTexImage2D(GL_TEXTURE_2D, 0, Scene_Frame_Buffer::ColorFormat(), width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)nullptr);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
@@ -108,8 +242,7 @@ namespace KooNan
 			glGenTextures(1, &texture);
 			glBindTexture(GL_TEXTURE_2D, texture);
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)nullptr);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			setDepthFilter();
 			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0);
 
 			return texture;
@@ -24,6 +24,8 @@
 #include <light.h>
 #include <Texture.h>
 #include <Render.h>
+#include <Impostor.h>
+#include <LightBaker.h>
 #include <iostream>
 
 
@@ -77,15 +79,27 @@ std::vector<std::string> groundPaths = {
 void addlights(Light& light);
 
 
-int main()
+int main(int argc, char** argv)
 {
+	// --bake-impostors: bake the vegetation impostor caches in a hidden window and quit
+	bool bakeImpostorsOnly = argc > 1 && std::string(argv[1]) == "--bake-impostors";
+	// --bake-lighting: bake ambient light and AO of the saved scene next to the save file and quit;
+	//   the bake itself runs on the CPU, the hidden window only serves the scene and model loaders
+	bool bakeLightingOnly = argc > 1 && std::string(argv[1]) == "--bake-lighting";
+	// --msaa <samples>: multisample the window, the antialiasing passes replace it otherwise
+	for (int i = 1; i + 1 < argc; i++)
+		if (std::string(argv[i]) == "--msaa")
+			RenderSettings::msaaSamples = std::max(std::atoi(argv[i + 1]), 0);
+
 	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_SAMPLES, 4);
+	glfwWindowHint(GLFW_SAMPLES, RenderSettings::msaaSamples);
+	if (bakeImpostorsOnly || bakeLightingOnly)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 #ifdef __APPLE__
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
@@ -118,7 +132,8 @@ int main()
 
 	// configure global opengl state
 	// -----------------------------
-	glEnable(GL_MULTISAMPLE);
+	if (RenderSettings::msaaSamples > 0)
+		glEnable(GL_MULTISAMPLE);
 
     // build and compile our shader program
     // ------------------------------------
@@ -148,6 +163,14 @@ int main()
 	//Model* planet = new Model(FileSystem::getPath("model\\rsc\\Memorial Gate\\Memorial Gates.obj"));
 	Model::loadModelsFromPath("model\\rsc\\", Model::ModelType::ComplexModel);
 	Model::loadModelsFromPath("model\\basic voxel\\", Model::ModelType::BasicVoxel);
+	if (bakeImpostorsOnly)
+	{
+		ImpostorRenderer impostors;
+		impostors.Prepare();
+		impostors.cleanUp();
+		glfwTerminate();
+		return 0;
+	}
 
 	// Instantiate the light(with only "parallel" light component)
 	// ------------------------------------
@@ -166,6 +189,15 @@ int main()
 		GameObject* p3 = new GameObject("model/rsc/Temple1/Temple1.obj",
 			scale(translate(mat4(1.0f), vec3(-7.0f, main_scene.getTerrainHeight(-7.0f, -7.0f), -7.0f)), vec3(0.2f, 0.2f, 0.2f)), true);
 	}
+	if (bakeLightingOnly)
+	{
+		BakedScene baked;
+		LightBaker baker;
+		baker.Bake(main_scene.all_terrain_chunks, main_light, baked);
+		baked.Save(Common::lightingFileName);
+		glfwTerminate();
+		return 0;
+	}
 	// Object
 	// ------------------------------------
 	//GameObject* p1 = new GameObject(string("model/rsc/planet/planet.obj"),
@@ -198,6 +230,8 @@ int main()
         // per-frame time logic
         // --------------------
 		GameController::updateGameController(window);
+		RenderStats::BeginFrame();
+		main_renderer.AdvanceTimeOfDay(GameController::deltaTime);
 
 
 		//需要渲染三次 前两次不渲染水面 最后一次渲染水面
@@ -229,13 +263,14 @@ int main()
 	}
 	
 	// GameObject clear
-	for (GameObject* obj : GameObject::gameObjList)
-		delete obj;
-	GameObject::gameObjList.clear();
+	while (!GameObject::gameObjList.empty())
+		delete GameObject::gameObjList.front(); // unlinks itself from gameObjList
 	unordered_map<string, Model*>::iterator itr;
 	for (itr = Model::modelList.begin(); itr != Model::modelList.end(); ++itr)
 		delete itr->second;
 	Model::modelList.clear();
+	main_renderer.cleanUp();
+	main_scene.cleanUp();
 	waterfb.cleanUp();
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
@@ -0,0 +1,99 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 QuadUV;
+in vec3 ObjViewDir;
+in vec3 FragPos;
+in float Fade;
+in mat3 ModelRot;
+
+uniform sampler2D albedoAtlas;
+uniform sampler2D normalDepthAtlas;
+uniform int gridSize;
+uniform float boundsRadius;
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+
+struct PointLight {
+    vec3 position;
+    
+    float constant;
+    float linear;
+    float quadratic;
+	
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+#define NR_POINT_LIGHTS 4
+uniform DirLight dirLight;
+uniform PointLight pointLights[NR_POINT_LIGHTS];
+
+// octahedral mapping of the sphere onto [0, 1]^2, y up; must match ImpostorAtlas::OctDecode
+vec2 OctEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 p = n.xz;
+    if (n.y < 0.0)
+        p = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+    return p * 0.5 + 0.5;
+}
+
+// interleaved gradient noise, the mesh side of the cross-fade uses the complement
+float Dither()
+{
+    return fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+}
+
+vec4 SampleFrame(sampler2D atlas, vec2 frame)
+{
+    return texture(atlas, (frame + QuadUV) / float(gridSize));
+}
+
+void main()
+{
+    if (Dither() >= Fade)
+        discard;
+
+    // blend the four baked views around the view direction
+    vec2 grid = OctEncode(normalize(ObjViewDir)) * float(gridSize - 1);
+    vec2 f0 = min(floor(grid), vec2(gridSize - 2));
+    vec2 w = grid - f0;
+    float w00 = (1.0 - w.x) * (1.0 - w.y), w10 = w.x * (1.0 - w.y), w01 = (1.0 - w.x) * w.y, w11 = w.x * w.y;
+    vec4 albedo = SampleFrame(albedoAtlas, f0) * w00 + SampleFrame(albedoAtlas, f0 + vec2(1.0, 0.0)) * w10
+        + SampleFrame(albedoAtlas, f0 + vec2(0.0, 1.0)) * w01 + SampleFrame(albedoAtlas, f0 + vec2(1.0, 1.0)) * w11;
+    if (albedo.a < 0.5)
+        discard;
+    vec4 nd = SampleFrame(normalDepthAtlas, f0) * w00 + SampleFrame(normalDepthAtlas, f0 + vec2(1.0, 0.0)) * w10
+        + SampleFrame(normalDepthAtlas, f0 + vec2(0.0, 1.0)) * w01 + SampleFrame(normalDepthAtlas, f0 + vec2(1.0, 1.0)) * w11;
+    vec3 color = albedo.rgb / albedo.a; // undo the blend with the empty background
+    vec3 normal = normalize(ModelRot * (nd.xyz / albedo.a * 2.0 - 1.0));
+
+    // push the fragment to the baked surface so that it intersects the ground correctly
+    vec3 toCam = normalize(viewPos - FragPos);
+    float scale = length(ModelRot[0]);
+    vec3 surfacePos = FragPos + toCam * (0.5 - nd.a / albedo.a) * 2.0 * boundsRadius * scale;
+    vec4 clip = projection * view * vec4(surfacePos, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+    // diffuse lighting only, foliage has no specular maps
+    vec3 result = dirLight.ambient * color + dirLight.diffuse * max(dot(normal, normalize(-dirLight.direction)), 0.0) * color;
+    for (int i = 0; i < NR_POINT_LIGHTS; i++)
+    {
+        vec3 lightDir = normalize(pointLights[i].position - surfacePos);
+        float distance = length(pointLights[i].position - surfacePos);
+        float attenuation = 1.0 / (pointLights[i].constant + pointLights[i].linear * distance + pointLights[i].quadratic * (distance * distance));
+        result += (pointLights[i].ambient + pointLights[i].diffuse * max(dot(normal, lightDir), 0.0)) * color * attenuation;
+    }
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,45 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner; // quad corner in [-1, 1]
+layout (location = 1) in mat4 aModel; // per instance, locations 1-4
+layout (location = 5) in float aFade; // per instance, share of the pixels covered by the impostor
+
+out vec2 QuadUV;
+out vec3 ObjViewDir;
+out vec3 FragPos;
+out float Fade;
+out mat3 ModelRot;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec4 plane;
+uniform vec3 viewPos;
+uniform vec3 boundsCenter;
+uniform float boundsRadius;
+
+// must match ImpostorAtlas::FrameBasis
+void FrameBasis(vec3 dir, out vec3 right, out vec3 up)
+{
+    vec3 worldUp = abs(dir.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    right = normalize(cross(worldUp, dir));
+    up = cross(dir, right);
+}
+
+void main()
+{
+    mat3 rot = mat3(aModel);
+    vec3 center = vec3(aModel * vec4(boundsCenter, 1.0));
+    float radius = boundsRadius * length(rot[0]);
+    vec3 objDir = normalize(inverse(rot) * (viewPos - center));
+
+    vec3 right, up;
+    FrameBasis(objDir, right, up);
+    vec3 worldPos = center + (aCorner.x * normalize(rot * right) + aCorner.y * normalize(rot * up)) * radius;
+
+    QuadUV = aCorner * 0.5 + 0.5;
+    ObjViewDir = objDir;
+    FragPos = worldPos;
+    Fade = aFade;
+    ModelRot = rot;
+    gl_ClipDistance[0] = dot(vec4(worldPos, 1.0), plane);
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalDepth;
+
+in vec2 TexCoord;
+in vec3 Normal;
+
+uniform sampler2D texture_diffuse1;
+
+void main()
+{
+    vec4 color = texture(texture_diffuse1, TexCoord); // no alpha test, as in model.fs
+    // faces seen from behind keep the normal pointing to the camera, foliage is two sided
+    vec3 n = normalize(gl_FrontFacing ? Normal : -Normal);
+    Albedo = vec4(color.rgb, 1.0);
+    // depth of the orthographic view is 0.5 on the plane through the bounds center
+    NormalDepth = vec4(n * 0.5 + 0.5, gl_FragCoord.z);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoord;
+out vec3 Normal;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    TexCoord = aTexCoords;
+    Normal = aNormal; // model space, the impostor is rotated with its object
+    gl_Position = projection * view * vec4(aPos, 1.0f);
+}
@@ -4,6 +4,7 @@ out vec4 FragColor;
 in vec2 TexCoord;
 in vec3 FragPos;
 in vec3 Normal;
+in vec4 BakedLight; // LightBaker: ambient of all lights, occluded, and the AO
 
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_diffuse2;
@@ -35,12 +36,184 @@ struct DirLight {
 #define NR_POINT_LIGHTS 4
 uniform DirLight dirLight;
 uniform PointLight pointLights[NR_POINT_LIGHTS];
+uniform sampler2D pointShadowAtlas; // PointShadowAtlas, a row of six cube faces per slot
+uniform int pointShadowSlot[NR_POINT_LIGHTS]; // -1: the light casts no shadow
+uniform float pointShadowRange[NR_POINT_LIGHTS];
+
+// cube face axes, the same as PointShadowAtlas::FaceView
+const vec3 faceForward[6] = vec3[6](vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0),
+    vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+const vec3 faceUp[6] = vec3[6](vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0),
+    vec3(0.0, 0.0, -1.0), vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0));
+
+uniform sampler2DArray shadowMap; // cascades of the sun, see Shadow_Frame_Buffer
+#define NR_CASCADES 4
+uniform mat4 lightSpaceMatrices[NR_CASCADES];
+uniform sampler2DArray evsmMap; // EvsmFilter: blurred, mipmapped moments of each cascade
+uniform int shadowFilter; // 0: PCF, 1: EVSM
+uniform float evsmExponent;
+uniform float evsmBleedReduction;
+
+// EvsmShadow: Chebyshev bound on the share of occluders, from one filtered fetch
+float EvsmShadow(vec3 projCoords, int cascade)
+{
+    vec2 moments = texture(evsmMap, vec3(projCoords.xy, float(cascade))).rg;
+    float warped = exp(evsmExponent * (projCoords.z * 2.0 - 1.0));
+    if (warped <= moments.x)
+        return 0.0;
+    // the smallest variance stands in for the depth bias, scaled by the slope of the warp
+    float minVariance = pow(0.0002 * float(cascade + 1) * 2.0 * evsmExponent * warped, 2.0);
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float d = warped - moments.x;
+    float visibility = variance / (variance + d * d);
+    return 1.0 - clamp((visibility - evsmBleedReduction) / (1.0 - evsmBleedReduction), 0.0, 1.0);
+}
+
+// DirShadow: share of the sun blocked on its way to fragPos, from the finest cascade covering it
+float DirShadow(vec3 fragPos)
+{
+    // the reflection passes draw from a mirrored camera, so pick the cascade by coverage instead of view depth
+    for (int i = 0; i < NR_CASCADES; ++i)
+    {
+        vec4 lightSpace = lightSpaceMatrices[i] * vec4(fragPos, 1.0);
+        vec3 projCoords = lightSpace.xyz / lightSpace.w * 0.5 + 0.5;
+        if (any(lessThan(projCoords.xy, vec2(0.01))) || any(greaterThan(projCoords.xy, vec2(0.99))))
+            continue;
+        if (projCoords.z > 1.0)
+            return 0.0;
+        if (shadowFilter == 1)
+            return EvsmShadow(projCoords, i);
+        float bias = 0.0001 * float(i + 1);
+        float shadow = 0.0;
+        vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+        for(int x = -1; x <= 1; ++x)
+        {
+            for(int y = -1; y <= 1; ++y)
+            {
+                float pcfDepth = texture(shadowMap, vec3(projCoords.xy + vec2(x, y) * texelSize, float(i))).r;
+                shadow += projCoords.z - bias > pcfDepth ? 1.0 : 0.0;
+            }
+        }
+        return shadow / 9.0;
+    }
+    return 0.0;
+}
+
+uniform sampler2DArray horizonMap; // HorizonMap: tangent of the horizon, its distance and the ground height, a layer per azimuth
+uniform vec2 horizonOrigin; // world x, z of the first sample
+uniform float horizonSpacing;
+uniform int horizonShadows;
+
+// HorizonShadow: share of the sun hidden behind the terrain, for a point at or above the ground
+float HorizonShadow(vec3 fragPos, vec3 lightDirection)
+{
+    if (horizonShadows == 0)
+        return 0.0;
+    ivec3 size = textureSize(horizonMap, 0);
+    vec2 uv = ((fragPos.xz - horizonOrigin) / horizonSpacing + 0.5) / vec2(size.xy);
+    if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+        return 0.0;
+    vec3 toSun = normalize(-lightDirection);
+    float azimuth = fract(atan(toSun.z, toSun.x) / 6.28318531) * float(size.z);
+    int layer = int(azimuth);
+    vec3 horizon = mix(texture(horizonMap, vec3(uv, float(layer))).xyz,
+        texture(horizonMap, vec3(uv, float((layer + 1) % size.z))).xyz, fract(azimuth));
+    // seen from higher up, the same ridge is lower
+    float above = max(fragPos.y - horizon.z, 0.0);
+    float horizonAngle = atan(horizon.x - above / max(horizon.y, 0.001));
+    float sunAngle = atan(toSun.y, length(toSun.xz));
+    return 1.0 - smoothstep(-0.03, 0.03, sunAngle - horizonAngle);
+}
+
+// PointShadow: share of point light i blocked on its way to fragPos
+float PointShadow(int i, vec3 fragPos)
+{
+    int slot = pointShadowSlot[i];
+    if (slot < 0)
+        return 0.0;
+    vec3 d = fragPos - pointLights[i].position;
+    float current = length(d) / pointShadowRange[i];
+    if (current >= 1.0)
+        return 0.0;
+    vec3 a = abs(d);
+    int face = a.x >= a.y && a.x >= a.z ? (d.x > 0.0 ? 0 : 1) : (a.y >= a.z ? (d.y > 0.0 ? 2 : 3) : (d.z > 0.0 ? 4 : 5));
+    vec3 s = normalize(cross(faceForward[face], faceUp[face]));
+    vec3 u = cross(s, faceForward[face]);
+    vec2 ndc = vec2(dot(s, d), dot(u, d)) / dot(faceForward[face], d);
+    vec2 atlasSize = vec2(textureSize(pointShadowAtlas, 0));
+    vec2 tile = atlasSize / vec2(6.0, 4.0);
+    // stay inside the tile, the PCF taps must not read the neighbouring face
+    vec2 texel = clamp((ndc * 0.5 + 0.5) * tile, vec2(1.5), tile - 1.5) + vec2(face, slot) * tile;
+    float bias = 0.003;
+    float shadow = 0.0;
+    for(int x = -1; x <= 1; ++x)
+    {
+        for(int y = -1; y <= 1; ++y)
+        {
+            float closest = texture(pointShadowAtlas, (texel + vec2(x, y)) / atlasSize).r;
+            shadow += current - bias > closest ? 1.0 : 0.0;
+        }
+    }
+    return shadow / 9.0;
+}
 
 uniform vec3 viewPos;
 
 uniform vec3 selected_color;
+uniform float ditherFade; // share of the pixels handed over to the impostor, 0 draws all of them
+uniform int bakedLighting; // 1: BakedLight replaces the ambient terms of the lights, 2: only its AO darkens them
+
+uniform sampler2D ssaoMap; // AmbientOcclusion: occlusion and linear depth at half resolution
+uniform int ssao; // 1: ssaoMap belongs to this view, only in the main pass
+uniform vec2 ssaoNearFar;
+
+uniform samplerCube reflectionProbeMap; // ReflectionProbes: prefiltered environment of the probe nearest to the object
+uniform int reflectionProbe; // 1: add the reflection of reflectionProbeMap
+uniform float reflectionProbeLod; // mip of the gloss of the surfaces
+uniform float reflectionProbeStrength;
+
+// ProbeReflection: the environment in the mirror direction, weighted by the specular map and Fresnel
+vec3 ProbeReflection(vec3 normal, vec3 viewDir)
+{
+    if (reflectionProbe != 1)
+        return vec3(0.0);
+    vec3 r = reflect(-viewDir, normal);
+    float fresnel = 0.04 + 0.96 * pow(1.0 - max(dot(normal, viewDir), 0.0), 5.0);
+    return textureLod(reflectionProbeMap, r, reflectionProbeLod).rgb * fresnel * reflectionProbeStrength *
+        vec3(texture(texture_specular1, TexCoord));
+}
+
+// ScreenOcclusion: the half resolution occlusion at this pixel, the four nearest texels weighted
+// by distance and by how close their depth is, so edges do not bleed into the background
+float ScreenOcclusion()
+{
+    if (ssao != 1)
+        return 1.0;
+    float z = ssaoNearFar.x * ssaoNearFar.y / (ssaoNearFar.y - gl_FragCoord.z * (ssaoNearFar.y - ssaoNearFar.x));
+    ivec2 size = textureSize(ssaoMap, 0);
+    vec2 pos = gl_FragCoord.xy * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(pos));
+    vec2 f = pos - vec2(base);
+    float sum = 0.0, weights = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        vec2 s = texelFetch(ssaoMap, clamp(base + offset, ivec2(0), size - 1), 0).rg;
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float w = (bilinear.x * bilinear.y + 0.001) / (0.001 + abs(s.y - z) / z);
+        sum += s.x * w;
+        weights += w;
+    }
+    return sum / weights;
+}
+
+// interleaved gradient noise, the same pattern as impostor.fs
+float Dither()
+{
+    return fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+}
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow)
 {
     vec3 lightDir = normalize(-light.direction);
     // 漫反射着色
@@ -52,10 +225,10 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 ambient  = light.ambient  * vec3(texture(texture_diffuse1, TexCoord));
     vec3 diffuse  = light.diffuse  * diff * vec3(texture(texture_diffuse1, TexCoord));
     vec3 specular = light.specular * spec * vec3(texture(texture_specular1, TexCoord));
-    return (ambient + diffuse + specular);
+    return (ambient + (diffuse + specular) * (1.0 - shadow));
 }
 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
@@ -73,16 +246,46 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
-    return (ambient + diffuse + specular);
+    return (ambient + (diffuse + specular) * (1.0 - shadow));
 }
 
 void main()
 {    
+    if (ditherFade > 0.0 && Dither() < ditherFade)
+        discard;
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
-	vec3 result = CalcDirLight(dirLight, norm, viewDir);
+    DirLight sun = dirLight;
+    if (bakedLighting == 1)
+    {
+        sun.ambient = BakedLight.rgb;
+        sun.specular *= BakedLight.a;
+    }
+    else if (bakedLighting == 2)
+    {
+        sun.ambient *= BakedLight.a;
+        sun.specular *= BakedLight.a;
+    }
+    float ao = ScreenOcclusion();
+    sun.ambient *= ao;
+	vec3 result = CalcDirLight(sun, norm, viewDir, max(DirShadow(FragPos), HorizonShadow(FragPos, dirLight.direction)));
 	for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);    
+    {
+        PointLight light = pointLights[i];
+        if (bakedLighting == 1)
+        {
+            light.ambient = vec3(0.0); // part of BakedLight
+            light.specular *= BakedLight.a;
+        }
+        else if (bakedLighting == 2)
+        {
+            light.ambient *= BakedLight.a;
+            light.specular *= BakedLight.a;
+        }
+        light.ambient *= ao;
+        result += CalcPointLight(light, norm, FragPos, viewDir, PointShadow(i, FragPos));    
+    }
+    result += ProbeReflection(norm, viewDir) * ao * (bakedLighting != 0 ? BakedLight.a : 1.0);
 
 	FragColor = vec4(result + selected_color, 1.0);
 }
\ No newline at end of file
@@ -2,10 +2,12 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in vec4 aBakedLight; // GameObject::SetBakedLighting, only read while bakedLighting is set
 
 out vec2 TexCoord;
 out vec3 Normal;
 out vec3 FragPos;
+out vec4 BakedLight;
 
 uniform mat4 model;
 uniform mat4 view;
@@ -19,5 +21,6 @@ void main()
     Normal = mat3(transpose(inverse(model))) * aNormal;
     gl_ClipDistance[0] = dot(World_Pos , plane);
     TexCoord = aTexCoords;    
+    BakedLight = aBakedLight;
     gl_Position = projection * view * World_Pos;
 }
\ No newline at end of file
@@ -0,0 +1,39 @@
+#version 330 core
+// Emits every triangle once per water view: layer 0 is the reflection, layer 1 the refraction.
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 6) out;
+
+in vec2 vTexCoord[];
+in vec3 vNormal[];
+in vec4 vWorldPos[];
+in vec4 vBakedLight[];
+
+out vec2 TexCoord;
+out vec3 Normal;
+out vec3 FragPos;
+out vec4 BakedLight;
+
+uniform mat4 viewProjections[2];
+uniform vec4 planes[2];
+uniform int layerMask; // bit i set: the object is drawn into layer i
+
+void main()
+{
+    for (int layer = 0; layer < 2; layer++)
+    {
+        if ((layerMask & (1 << layer)) == 0)
+            continue;
+        for (int i = 0; i < 3; i++)
+        {
+            gl_Layer = layer;
+            gl_Position = viewProjections[layer] * vWorldPos[i];
+            gl_ClipDistance[0] = dot(vWorldPos[i], planes[layer]);
+            TexCoord = vTexCoord[i];
+            Normal = vNormal[i];
+            FragPos = vec3(vWorldPos[i]);
+            BakedLight = vBakedLight[i];
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
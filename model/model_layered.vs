@@ -0,0 +1,21 @@
+#version 330 core
+// model.vs for the layered water pass, projection and clipping move to model_layered.gs
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in vec4 aBakedLight;
+
+out vec2 vTexCoord;
+out vec3 vNormal;
+out vec4 vWorldPos;
+out vec4 vBakedLight;
+
+uniform mat4 model;
+
+void main()
+{
+    vWorldPos = model * vec4(aPos, 1.0f);
+    vNormal = mat3(transpose(inverse(model))) * aNormal;
+    vTexCoord = aTexCoords;
+    vBakedLight = aBakedLight;
+}
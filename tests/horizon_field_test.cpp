@@ -0,0 +1,82 @@
+// Headless check of the incremental horizon update: marching only the samples that Reach
+// grows an edited rectangle to must give the same texels as marching the whole grid again.
+//   g++ -std=c++17 -O2 -pthread -Iinclude -Ibasic -Ilandscape tests/horizon_field_test.cpp -o horizon_field_test
+//   cl /std:c++17 /O2 /EHsc /Iinclude /Ibasic /Ilandscape tests\horizon_field_test.cpp
+#include <horizonfield.h>
+
+#include <random>
+#include <cstdio>
+#include <cstring>
+
+using namespace KooNan;
+
+static const int SIZE_X = 97, SIZE_Z = 65; // three by two chunks of 32 cells
+static const float SPACING = 1.0f;
+static const int STEPS = 12;
+
+static void Fill(HorizonField& field, const std::vector<float>& heights)
+{
+	for (int z = 0; z < SIZE_Z; z++)
+		for (int x = 0; x < SIZE_X; x++)
+			field.Height(x, z) = heights[z * SIZE_X + x];
+}
+
+// Edit: raise or dig the rectangle, then compare the updated field against a fresh full march
+//   grow: whether Reach is applied, without it the check must fail
+static bool Edit(HorizonField& field, std::vector<float>& heights, int x0, int z0, int x1, int z1, float amount, bool grow)
+{
+	for (int z = z0; z <= z1; z++)
+		for (int x = x0; x <= x1; x++)
+		{
+			heights[z * SIZE_X + x] += amount;
+			field.Height(x, z) = heights[z * SIZE_X + x];
+		}
+	if (grow)
+		field.Reach(x0, z0, x1, z1, STEPS);
+	field.March(x0, z0, x1, z1, STEPS);
+
+	HorizonField full;
+	full.Resize(SIZE_X, SIZE_Z, SPACING);
+	Fill(full, heights);
+	full.March(0, 0, SIZE_X - 1, SIZE_Z - 1, STEPS);
+	const std::vector<float>& a = field.GetTexels();
+	const std::vector<float>& b = full.GetTexels();
+	return memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+int main()
+{
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<float> heights(SIZE_X * SIZE_Z);
+	for (int z = 0; z < SIZE_Z; z++)
+		for (int x = 0; x < SIZE_X; x++)
+			heights[z * SIZE_X + x] = 4.0f * std::sin(x * 0.21f) * std::cos(z * 0.17f) + unit(rng);
+
+	HorizonField field;
+	field.Resize(SIZE_X, SIZE_Z, SPACING);
+	Fill(field, heights);
+	field.March(0, 0, SIZE_X - 1, SIZE_Z - 1, STEPS);
+
+	int failures = 0;
+	// inside, across chunk borders, on the grid edges and single samples
+	const int rects[][4] = { { 40, 20, 48, 30 }, { 30, 30, 34, 34 }, { 0, 0, 3, 5 }, { 90, 58, 96, 64 }, { 50, 0, 50, 0 }, { 63, 31, 65, 33 } };
+	for (int i = 0; i < 40; i++)
+	{
+		const int* r = rects[i % 6];
+		float amount = (unit(rng) - 0.5f) * 20.0f;
+		if (!Edit(field, heights, r[0], r[1], r[2], r[3], amount, true))
+		{
+			printf("FAILED: update of (%d, %d) - (%d, %d) differs from a full march\n", r[0], r[1], r[2], r[3]);
+			failures++;
+		}
+	}
+	// the check itself: without Reach the samples around the edit keep their old horizon
+	if (Edit(field, heights, 40, 20, 48, 30, 15.0f, false))
+	{
+		printf("FAILED: an update without Reach should differ from a full march\n");
+		failures++;
+	}
+	printf(failures ? "%d FAILED\n" : "OK\n", failures);
+	return failures ? 1 : 0;
+}
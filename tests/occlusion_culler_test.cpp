@@ -0,0 +1,137 @@
+// Headless test of the CPU occlusion culler: the depth buffer must not depend on the
+// submission order or the threads, and an object seen through a gap narrower than a
+// pixel of the buffer must stay visible.
+//   g++ -std=c++17 -O2 -pthread -Iinclude -Ibasic tests/occlusion_culler_test.cpp -o occlusion_culler_test
+//   cl /std:c++17 /O2 /EHsc /Iinclude /Ibasic tests\occlusion_culler_test.cpp
+#include <OcclusionCuller.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+using namespace KooNan;
+
+static int failures = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+// Quad: two triangles of an axis aligned rectangle facing the camera at depth z
+static std::vector<glm::vec3> Quad(float x0, float x1, float y0, float y1, float z)
+{
+	return { glm::vec3(x0, y0, z), glm::vec3(x1, y0, z), glm::vec3(x1, y1, z),
+		glm::vec3(x0, y0, z), glm::vec3(x1, y1, z), glm::vec3(x0, y1, z) };
+}
+
+static void TestDeterminism()
+{
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<std::vector<glm::vec3>> occluders;
+	for (int i = 0; i < 300; i++)
+	{
+		std::vector<glm::vec3> tris;
+		glm::vec3 c(unit(rng) * 200.0f - 100.0f, unit(rng) * 20.0f, unit(rng) * 200.0f - 100.0f);
+		for (int t = 0; t < 12; t++)
+			for (int k = 0; k < 3; k++)
+				tris.push_back(c + glm::vec3(unit(rng), unit(rng), unit(rng)) * 12.0f - 6.0f);
+		occluders.push_back(tris);
+	}
+	glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 500.0f) *
+		glm::lookAt(glm::vec3(0.0f, 30.0f, 150.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	OcclusionCuller reference;
+	reference.Begin(viewProjection);
+	for (const std::vector<glm::vec3>& tris : occluders)
+		reference.AddOccluder(tris, glm::mat4(1.0f));
+	reference.Rasterize();
+	Check(reference.NumTriangles() > 0, "determinism: occluders reach the buffer");
+
+	for (int run = 0; run < 20; run++)
+	{
+		std::shuffle(occluders.begin(), occluders.end(), rng);
+		OcclusionCuller culler;
+		culler.Begin(viewProjection);
+		for (const std::vector<glm::vec3>& tris : occluders)
+			culler.AddOccluder(tris, glm::mat4(1.0f));
+		culler.Rasterize();
+		const std::vector<float>& a = reference.GetDepth();
+		const std::vector<float>& b = culler.GetDepth();
+		Check(memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0, "determinism: same depth for any order and threads");
+	}
+}
+
+static void TestGap()
+{
+	// one unit of the orthographic view is one pixel of the buffer
+	const float halfW = OcclusionCuller::BUFFER_WIDTH * 0.5f, halfH = OcclusionCuller::BUFFER_HEIGHT * 0.5f;
+	glm::mat4 viewProjection = glm::ortho(-halfW, halfW, -halfH, halfH, 0.1f, 100.0f);
+	const float gaps[] = { 0.2f, 0.45f, 0.7f, 1.0f, 1.6f };
+	for (float gap : gaps)
+	{
+		for (int step = 0; step < 20; step++)
+		{
+			// two walls at z = -10 leave a vertical slit starting at a different subpixel offset each step
+			float left = 3.0f + step * 0.05f, right = left + gap;
+			OcclusionCuller culler;
+			culler.Begin(viewProjection);
+			culler.AddOccluder(Quad(-halfW, left, -halfH, halfH, -10.0f), glm::mat4(1.0f));
+			culler.AddOccluder(Quad(right, halfW, -halfH, halfH, -10.0f), glm::mat4(1.0f));
+			culler.Rasterize();
+
+			char what[128];
+			AABB behindGap(glm::vec3(left + gap * 0.25f, -5.0f, -30.0f), glm::vec3(right - gap * 0.25f, 5.0f, -20.0f));
+			snprintf(what, sizeof(what), "gap %.2f at %.2f: object behind the gap is visible", gap, left);
+			Check(culler.IsVisible(behindGap), what);
+
+			AABB behindWall(glm::vec3(-40.0f, -5.0f, -30.0f), glm::vec3(-20.0f, 5.0f, -20.0f));
+			snprintf(what, sizeof(what), "gap %.2f at %.2f: object behind the wall is culled", gap, left);
+			Check(!culler.IsVisible(behindWall), what);
+
+			AABB inFront(glm::vec3(-40.0f, -5.0f, -8.0f), glm::vec3(-20.0f, 5.0f, -5.0f));
+			snprintf(what, sizeof(what), "gap %.2f at %.2f: object in front of the wall is visible", gap, left);
+			Check(culler.IsVisible(inFront), what);
+		}
+	}
+}
+
+static void TestSlopedDepth()
+{
+	// a wall leaning away from the camera, its depth changes across every pixel
+	const float halfW = OcclusionCuller::BUFFER_WIDTH * 0.5f, halfH = OcclusionCuller::BUFFER_HEIGHT * 0.5f;
+	glm::mat4 viewProjection = glm::ortho(-halfW, halfW, -halfH, halfH, 0.1f, 100.0f);
+	OcclusionCuller culler;
+	culler.Begin(viewProjection);
+	std::vector<glm::vec3> ramp = { glm::vec3(-50.0f, -50.0f, -10.0f), glm::vec3(50.0f, -50.0f, -90.0f), glm::vec3(50.0f, 50.0f, -90.0f),
+		glm::vec3(-50.0f, -50.0f, -10.0f), glm::vec3(50.0f, 50.0f, -90.0f), glm::vec3(-50.0f, 50.0f, -10.0f) };
+	culler.AddOccluder(ramp, glm::mat4(1.0f));
+	culler.Rasterize();
+	// the ramp goes 0.8 deeper per unit in x; a thin box just in front of it shares its pixels with
+	// parts of the ramp up to 0.4 nearer, only the farthest depth over the pixel leaves it visible
+	for (int i = 0; i < 20; i++)
+	{
+		float x = -20.0f + i * 1.37f;
+		float rampZ = -10.0f - 0.8f * (x + 50.0f);
+		AABB box(glm::vec3(x, 30.0f, rampZ - 1.0f), glm::vec3(x + 0.05f, 40.0f, rampZ + 0.05f));
+		Check(culler.IsVisible(box), "sloped occluder: box just in front of the ramp is visible");
+	}
+}
+
+int main()
+{
+	TestDeterminism();
+	TestGap();
+	TestSlopedDepth();
+	printf(failures ? "%d FAILED\n" : "OK\n", failures);
+	return failures ? 1 : 0;
+}
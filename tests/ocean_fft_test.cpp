@@ -0,0 +1,64 @@
+// Headless check and benchmark of the CPU ocean: the FFT surface must match a direct sum
+// over the same spectrum at every sample, then Simulate is timed per resolution.
+//   g++ -std=c++17 -O2 -pthread -Iinclude -Ibasic -Ilandscape tests/ocean_fft_test.cpp -o ocean_fft_test
+//   cl /std:c++17 /O2 /EHsc /Iinclude /Ibasic /Ilandscape tests\ocean_fft_test.cpp
+#include <oceanfft.h>
+
+#include <chrono>
+#include <cstdio>
+
+using namespace KooNan;
+
+// CompareToDirect: largest difference between Simulate and EvaluateDirect over all samples
+//   returns false when it exceeds a thousandth of the largest value of the field
+static bool CompareToDirect(int resolution, float time)
+{
+	OceanFFT ocean(resolution, 64.0f, 12.0f, 30.0f, 2.0f, 1.2f, 7);
+	ocean.Simulate(time);
+	const std::vector<glm::vec3>& displacement = ocean.GetDisplacement();
+	const std::vector<glm::vec3>& normals = ocean.GetNormals();
+	float maxDisplacement = 0.0f, displacementError = 0.0f, normalError = 0.0f;
+	for (int z = 0; z < resolution; z++)
+		for (int x = 0; x < resolution; x++)
+		{
+			glm::vec3 d, n;
+			ocean.EvaluateDirect(time, x, z, d, n);
+			const glm::vec3& fd = displacement[z * resolution + x];
+			const glm::vec3& fn = normals[z * resolution + x];
+			for (int c = 0; c < 3; c++)
+			{
+				maxDisplacement = std::max(maxDisplacement, std::fabs(d[c]));
+				displacementError = std::max(displacementError, std::fabs(fd[c] - d[c]));
+				normalError = std::max(normalError, std::fabs(fn[c] - n[c]));
+			}
+		}
+	bool ok = maxDisplacement > 0.0f && displacementError <= 1e-3f * maxDisplacement && normalError <= 1e-3f;
+	printf("%4d x %-4d t = %5.2f  largest displacement %.4f  error %.2e  normal error %.2e  %s\n", resolution, resolution, time,
+		maxDisplacement, displacementError, normalError, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+int main()
+{
+	bool ok = true;
+	const int resolutions[] = { 4, 16, 32, 64 };
+	const float times[] = { 0.0f, 1.7f, 13.25f };
+	for (int resolution : resolutions)
+		for (float time : times)
+			ok = CompareToDirect(resolution, time) && ok;
+
+	printf("\n%10s %14s\n", "resolution", "Simulate ms");
+	for (int resolution = 64; resolution <= 512; resolution *= 2)
+	{
+		OceanFFT ocean(resolution, 256.0f, 12.0f, 30.0f, 2.0f, 1.2f);
+		ocean.Simulate(0.0f); // warms up the thread pool
+		const int RUNS = 20;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int run = 0; run < RUNS; run++)
+			ocean.Simulate(run * 0.033f);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / RUNS;
+		printf("%10d %14.3f\n", resolution, ms);
+	}
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+// Microbenchmark of the AABBTree queries against the object count, with the linear scan of a
+// flat list as the baseline, and a check that both return the same objects.
+// Headless, depends only on glm:
+//   g++ -std=c++17 -O2 -pthread -Iinclude -Ibasic tests/spatial_index_bench.cpp -o spatial_index_bench
+//   cl /std:c++17 /O2 /EHsc /Iinclude /Ibasic tests\spatial_index_bench.cpp
+#include <SpatialIndex.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace KooNan;
+
+struct Object
+{
+	AABB box;
+	int id;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double Milliseconds(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// the queries of one run, the same for the tree and the list
+struct Queries
+{
+	std::vector<Frustum> frustums;
+	std::vector<AABB> boxes;
+	std::vector<glm::vec4> spheres; // xyz: center, w: radius
+	std::vector<Ray> rays;
+};
+
+static Queries MakeQueries(std::mt19937& rng, float worldSize, int count)
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	Queries q;
+	for (int i = 0; i < count; i++)
+	{
+		glm::vec3 eye(unit(rng) * worldSize, 10.0f, unit(rng) * worldSize);
+		glm::vec3 target(unit(rng) * worldSize, 0.0f, unit(rng) * worldSize);
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+		q.frustums.push_back(Frustum(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f))));
+		glm::vec3 c(unit(rng) * worldSize, unit(rng) * 20.0f, unit(rng) * worldSize);
+		q.boxes.push_back(AABB(c - glm::vec3(20.0f), c + glm::vec3(20.0f)));
+		q.spheres.push_back(glm::vec4(c, 30.0f));
+		Ray ray;
+		ray.origin = eye;
+		ray.dir = glm::normalize(target - eye);
+		q.rays.push_back(ray);
+	}
+	return q;
+}
+
+// RunQueries: every query of q against the tree, or the list when tree is null
+//   returns the number of objects reported, the results are compared by it
+static long long RunQueries(const AABBTree<Object>* tree, const std::vector<Object>& objects, const Queries& q, double ms[4])
+{
+	long long reported = 0;
+	Clock::time_point start = Clock::now();
+	for (const Frustum& f : q.frustums)
+	{
+		if (tree)
+			tree->QueryFrustum(f, [&](Object* o) { reported += f.Intersects(o->box); });
+		else
+			for (const Object& o : objects)
+				reported += f.Intersects(o.box);
+	}
+	ms[0] = Milliseconds(start);
+	start = Clock::now();
+	for (const AABB& b : q.boxes)
+	{
+		if (tree)
+			tree->QueryBox(b, [&](Object* o) { reported += o->box.Intersects(b); });
+		else
+			for (const Object& o : objects)
+				reported += o.box.Intersects(b);
+	}
+	ms[1] = Milliseconds(start);
+	start = Clock::now();
+	for (const glm::vec4& s : q.spheres)
+	{
+		glm::vec3 c(s);
+		if (tree)
+			tree->QuerySphere(c, s.w, [&](Object* o) { reported += IntersectSphere(c, s.w, o->box); });
+		else
+			for (const Object& o : objects)
+				reported += IntersectSphere(c, s.w, o.box);
+	}
+	ms[2] = Milliseconds(start);
+	start = Clock::now();
+	const float range = 500.0f;
+	for (const Ray& r : q.rays)
+	{
+		float tHit;
+		if (tree)
+			tree->QueryRay(r, range, [&](Object* o, float) { reported += IntersectRay(r, o->box, range, tHit); return range; });
+		else
+			for (const Object& o : objects)
+				reported += IntersectRay(r, o.box, range, tHit);
+	}
+	ms[3] = Milliseconds(start);
+	return reported;
+}
+
+int main(int argc, char** argv)
+{
+	int maxCount = argc > 1 ? atoi(argv[1]) : 1000000;
+	const int QUERIES = 200;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	bool ok = true;
+
+	printf("%9s %9s %9s | %-33s | %-33s\n", "objects", "build ms", "height", "tree us/query: frustum box sphere ray",
+		"list us/query: frustum box sphere ray");
+	for (int count = 1000; count <= maxCount; count *= 10)
+	{
+		// constant density, about one object per 10 x 10 m of ground
+		float worldSize = 10.0f * sqrtf((float)count);
+		std::vector<Object> objects(count);
+		for (int i = 0; i < count; i++)
+		{
+			glm::vec3 p(unit(rng) * worldSize, unit(rng) * 5.0f, unit(rng) * worldSize);
+			glm::vec3 half(0.5f + unit(rng) * 4.0f, 0.5f + unit(rng) * 8.0f, 0.5f + unit(rng) * 4.0f);
+			objects[i].box = AABB(p - half, p + half);
+			objects[i].id = i;
+		}
+
+		AABBTree<Object> tree;
+		Clock::time_point start = Clock::now();
+		for (Object& o : objects)
+			tree.CreateProxy(o.box, &o);
+		double buildMs = Milliseconds(start);
+
+		Queries q = MakeQueries(rng, worldSize, QUERIES);
+		double treeMs[4], listMs[4];
+		long long treeReported = RunQueries(&tree, objects, q, treeMs);
+		long long listReported = RunQueries(nullptr, objects, q, listMs);
+		if (treeReported != listReported)
+		{
+			printf("MISMATCH at %d objects: tree %lld, list %lld\n", count, treeReported, listReported);
+			ok = false;
+		}
+
+		// the queries are const and keep their state on the stack, so threads can share the tree
+		std::vector<long long> threadReported(4);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; t++)
+			threads.emplace_back([&, t]() { double ms[4]; threadReported[t] = RunQueries(&tree, objects, q, ms); });
+		for (std::thread& t : threads)
+			t.join();
+		for (long long r : threadReported)
+			if (r != treeReported)
+			{
+				printf("MISMATCH at %d objects between threads: %lld, %lld\n", count, r, treeReported);
+				ok = false;
+			}
+
+		double us = 1000.0 / QUERIES;
+		printf("%9d %9.1f %9d | %7.2f %7.2f %7.2f %7.2f         | %7.1f %7.1f %7.1f %7.1f\n", count, buildMs, tree.GetHeight(),
+			treeMs[0] * us, treeMs[1] * us, treeMs[2] * us, treeMs[3] * us, listMs[0] * us, listMs[1] * us, listMs[2] * us, listMs[3] * us);
+	}
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}